@@ -466,6 +466,134 @@ static int get_overlap( const dib_info *dst, const RECT *dst_rect,
     return ret;
 }
 
+/* Large primitive calls are split in horizontal bands that run in parallel
+ * on the thread pool. Each band covers whole rows, and the primitives never
+ * depend on the rows above them, so the output is the same as in a single call.
+ * Bands are taken in turn by the calling thread and the workers, and the caller
+ * keeps taking them until none is left, so that it only ever waits for bands
+ * that are being processed. Nothing is lost if the workers can't start, for
+ * instance because the caller holds the loader lock. */
+
+#define MAX_BANDS        16
+#define BAND_MIN_PIXELS  (256 * 256)
+
+struct band_job
+{
+    void      (*func)( void *arg, const RECT *rect );
+    void       *arg;
+    RECT        rect;
+    LONG        count;    /* number of bands */
+    LONG        next;     /* next band to process */
+    LONG        pending;  /* number of bands not processed yet */
+    LONG        refs;     /* the caller and the queued callbacks */
+    HANDLE      done;
+};
+
+static int get_band_count( const RECT *rect )
+{
+    static int nb_cpus;
+    SYSTEM_INFO info;
+    LONGLONG pixels = (LONGLONG)(rect->right - rect->left) * (rect->bottom - rect->top);
+    int count;
+
+    if (!nb_cpus)
+    {
+        GetSystemInfo( &info );
+        nb_cpus = min( info.dwNumberOfProcessors, MAX_BANDS );
+    }
+    count = min( nb_cpus, pixels / BAND_MIN_PIXELS );
+    return min( count, rect->bottom - rect->top );
+}
+
+static void release_band_job( struct band_job *job )
+{
+    if (InterlockedDecrement( &job->refs )) return;
+    CloseHandle( job->done );
+    HeapFree( GetProcessHeap(), 0, job );
+}
+
+static void run_bands( struct band_job *job )
+{
+    int height = job->rect.bottom - job->rect.top;
+    RECT band;
+    LONG i;
+
+    while ((i = InterlockedIncrement( &job->next ) - 1) < job->count)
+    {
+        band.left   = job->rect.left;
+        band.right  = job->rect.right;
+        band.top    = job->rect.top + MulDiv( height, i, job->count );
+        band.bottom = job->rect.top + MulDiv( height, i + 1, job->count );
+        job->func( job->arg, &band );
+        if (!InterlockedDecrement( &job->pending )) SetEvent( job->done );
+    }
+}
+
+static void CALLBACK band_callback( TP_CALLBACK_INSTANCE *instance, void *context )
+{
+    run_bands( context );
+    release_band_job( context );
+}
+
+void process_bands( const RECT *rect, void (*func)( void *arg, const RECT *rect ), void *arg )
+{
+    struct band_job *job;
+    int i, count = get_band_count( rect );
+
+    if (count <= 1 || !(job = HeapAlloc( GetProcessHeap(), 0, sizeof(*job) )))
+    {
+        func( arg, rect );
+        return;
+    }
+    if (!(job->done = CreateEventW( NULL, TRUE, FALSE, NULL )))
+    {
+        HeapFree( GetProcessHeap(), 0, job );
+        func( arg, rect );
+        return;
+    }
+
+    job->func    = func;
+    job->arg     = arg;
+    job->rect    = *rect;
+    job->count   = count;
+    job->next    = 0;
+    job->pending = count;
+    job->refs    = 1;
+
+    for (i = 1; i < count; i++)
+    {
+        InterlockedIncrement( &job->refs );
+        if (!TrySubmitThreadpoolCallback( band_callback, job, NULL ))
+        {
+            release_band_job( job );
+            break;
+        }
+    }
+    run_bands( job );
+
+    WaitForSingleObject( job->done, INFINITE );
+    release_band_job( job );
+}
+
+struct copy_rect_args
+{
+    dib_info       *dst;
+    const dib_info *src;
+    POINT           origin;  /* source coordinates of the top left corner of the rectangle */
+    RECT            rect;
+    int             rop2;
+};
+
+static void copy_rect_band( void *arg, const RECT *band )
+{
+    struct copy_rect_args *args = arg;
+    POINT origin;
+
+    origin.x = args->origin.x;
+    origin.y = args->origin.y + band->top - args->rect.top;
+    args->dst->funcs->copy_rect( args->dst, band, args->src, &origin, args->rop2, 0 );
+}
+
 static void copy_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
                         const struct clipped_rects *clipped_rects, INT rop2 )
 {
@@ -541,7 +669,7 @@ static void copy_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
             }
         }
     }
-    else  /* left to right, top to bottom */
+    else if (overlap)  /* left to right, top to bottom */
     {
         for (i = 0; i < count; i++)
         {
@@ -550,6 +678,21 @@ static void copy_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
             dst->funcs->copy_rect( dst, &rects[i], src, &origin, rop2, overlap );
         }
     }
+    else  /* no overlap, rows can be processed in any order */
+    {
+        struct copy_rect_args args;
+
+        args.dst  = dst;
+        args.src  = src;
+        args.rop2 = rop2;
+        for (i = 0; i < count; i++)
+        {
+            args.origin.x = src_rect->left + rects[i].left - dst_rect->left;
+            args.origin.y = src_rect->top  + rects[i].top  - dst_rect->top;
+            args.rect = rects[i];
+            process_bands( &rects[i], copy_rect_band, &args );
+        }
+    }
 }
 
 static void mask_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
@@ -581,19 +724,42 @@ static void mask_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
     }
 }
 
+struct blend_rect_args
+{
+    dib_info       *dst;
+    const dib_info *src;
+    POINT           origin;  /* source coordinates of the top left corner of the rectangle */
+    RECT            rect;
+    BLENDFUNCTION   blend;
+};
+
+static void blend_rect_band( void *arg, const RECT *band )
+{
+    struct blend_rect_args *args = arg;
+    POINT origin;
+
+    origin.x = args->origin.x;
+    origin.y = args->origin.y + band->top - args->rect.top;
+    args->dst->funcs->blend_rect( args->dst, band, args->src, &origin, args->blend );
+}
+
 static DWORD blend_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
                          HRGN clip, BLENDFUNCTION blend )
 {
-    POINT origin;
+    struct blend_rect_args args;
     struct clipped_rects clipped_rects;
     int i;
 
     if (!get_clipped_rects( dst, dst_rect, clip, &clipped_rects )) return ERROR_SUCCESS;
+    args.dst   = dst;
+    args.src   = src;
+    args.blend = blend;
     for (i = 0; i < clipped_rects.count; i++)
     {
-        origin.x = src_rect->left + clipped_rects.rects[i].left - dst_rect->left;
-        origin.y = src_rect->top  + clipped_rects.rects[i].top  - dst_rect->top;
-        dst->funcs->blend_rect( dst, &clipped_rects.rects[i], src, &origin, blend );
+        args.origin.x = src_rect->left + clipped_rects.rects[i].left - dst_rect->left;
+        args.origin.y = src_rect->top  + clipped_rects.rects[i].top  - dst_rect->top;
+        args.rect = clipped_rects.rects[i];
+        process_bands( &clipped_rects.rects[i], blend_rect_band, &args );
     }
     free_clipped_rects( &clipped_rects );
     return ERROR_SUCCESS;
@@ -678,16 +844,38 @@ static void get_gradient_triangle_vertices( const GRADIENT_TRIANGLE *tri, const
     bounds->bottom = v[2].y;
 }
 
+struct gradient_rect_args
+{
+    dib_info        *dib;
+    const TRIVERTEX *v;
+    int              mode;
+    LONG             failed;
+};
+
+static void gradient_rect_band( void *arg, const RECT *band )
+{
+    struct gradient_rect_args *args = arg;
+
+    if (!args->dib->funcs->gradient_rect( args->dib, band, args->v, args->mode ))
+        InterlockedExchange( &args->failed, TRUE );
+}
+
 static BOOL gradient_rect( dib_info *dib, TRIVERTEX *v, int mode, HRGN clip, const RECT *bounds )
 {
     int i;
     struct clipped_rects clipped_rects;
+    struct gradient_rect_args args;
     BOOL ret = TRUE;
 
     if (!get_clipped_rects( dib, bounds, clip, &clipped_rects )) return TRUE;
+    args.dib    = dib;
+    args.v      = v;
+    args.mode   = mode;
+    args.failed = FALSE;
     for (i = 0; i < clipped_rects.count; i++)
     {
-        if (!(ret = dib->funcs->gradient_rect( dib, &clipped_rects.rects[i], v, mode ))) break;
+        process_bands( &clipped_rects.rects[i], gradient_rect_band, &args );
+        if (!(ret = !args.failed)) break;
     }
     free_clipped_rects( &clipped_rects );
     return ret;
@@ -1183,7 +1183,6 @@ BOOL dibdrv_PatBlt( PHYSDEV dev, struct bitblt_coords *dst, DWORD rop )
     DC *dc = get_physdev_dc( dev );
     int rop2 = get_rop2_from_rop( rop );
     struct clipped_rects clipped_rects;
-    DWORD and = 0, xor = 0;
     BOOL ret = TRUE;
 
     TRACE("(%p, %d, %d, %d, %d, %06x)\n", dev, dst->x, dst->y, dst->width, dst->height, rop);
@@ -1193,12 +1192,10 @@ BOOL dibdrv_PatBlt( PHYSDEV dev, struct bitblt_coords *dst, DWORD rop )
 
     switch (rop2)  /* shortcuts for rops that don't involve the brush */
     {
-    case R2_NOT:   and = ~0u;
-        /* fall through */
-    case R2_WHITE: xor = ~0u;
-        /* fall through */
+    case R2_NOT:
+    case R2_WHITE:
     case R2_BLACK:
-        pdev->dib.funcs->solid_rects( &pdev->dib, clipped_rects.count, clipped_rects.rects, and, xor );
+        fill_with_pixel( dc, &pdev->dib, 0, clipped_rects.count, clipped_rects.rects, rop2 );
         /* fall through */
     case R2_NOP:
         break;
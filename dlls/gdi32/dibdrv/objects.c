@@ -1776,6 +1776,19 @@ COLORREF dibdrv_SetDCPenColor( PHYSDEV dev, COLORREF color )
     return color;
 }
 
+struct solid_rects_args
+{
+    const dib_info *dib;
+    rop_mask        mask;
+};
+
+static void solid_rects_band( void *arg, const RECT *band )
+{
+    struct solid_rects_args *args = arg;
+
+    args->dib->funcs->solid_rects( args->dib, 1, band, args->mask.and, args->mask.xor );
+}
+
 /**********************************************************************
  *             fill_with_pixel
  *
@@ -1783,10 +1796,12 @@ COLORREF dibdrv_SetDCPenColor( PHYSDEV dev, COLORREF color )
  */
 BOOL fill_with_pixel( DC *dc, dib_info *dib, DWORD pixel, int num, const RECT *rects, INT rop )
 {
-    rop_mask mask;
+    struct solid_rects_args args;
+    int i;
 
-    calc_rop_masks( rop, pixel, &mask );
-    dib->funcs->solid_rects( dib, num, rects, mask.and, mask.xor );
+    args.dib = dib;
+    calc_rop_masks( rop, pixel, &args.mask );
+    for (i = 0; i < num; i++) process_bands( &rects[i], solid_rects_band, &args );
     return TRUE;
 }
 
@@ -2021,6 +2036,21 @@ static BOOL select_pattern_brush( dibdrv_physdev *pdev, dib_brush *brush, BOOL *
     return TRUE;
 }
 
+struct pattern_rects_args
+{
+    const dib_info      *dib;
+    const POINT         *origin;
+    const dib_info      *brush;
+    const rop_mask_bits *bits;
+};
+
+static void pattern_rects_band( void *arg, const RECT *band )
+{
+    struct pattern_rects_args *args = arg;
+
+    args->dib->funcs->pattern_rects( args->dib, 1, band, args->origin, args->brush, args->bits );
+}
+
 /**********************************************************************
  *             pattern_brush
  *
@@ -2030,7 +2060,9 @@ static BOOL select_pattern_brush( dibdrv_physdev *pdev, dib_brush *brush, BOOL *
 static BOOL pattern_brush(dibdrv_physdev *pdev, dib_brush *brush, dib_info *dib,
                           int num, const RECT *rects, const POINT *brush_org, INT rop)
 {
+    struct pattern_rects_args args;
     BOOL needs_reselect = FALSE;
+    int i;
 
     if (rop != brush->rop)
     {
@@ -2065,7 +2097,11 @@ static BOOL pattern_brush(dibdrv_physdev *pdev, dib_brush *brush, dib_info *dib,
         }
     }
 
-    dib->funcs->pattern_rects( dib, num, rects, brush_org, &brush->dib, &brush->masks );
+    args.dib    = dib;
+    args.origin = brush_org;
+    args.brush  = &brush->dib;
+    args.bits   = &brush->masks;
+    for (i = 0; i < num; i++) process_bands( &rects[i], pattern_rects_band, &args );
 
     if (needs_reselect) free_pattern_brush( brush );
     return TRUE;
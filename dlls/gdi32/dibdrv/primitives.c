@@ -20,6 +20,12 @@
 
 #include <assert.h>
 
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define USE_SSE2_PRIMITIVES
+#include <emmintrin.h>
+#endif
+
 #include "gdi_private.h"
 #include "dibdrv.h"
 
@@ -108,6 +114,24 @@ static const BYTE pixel_masks_4[2] = {0xf0, 0x0f};
 static const BYTE pixel_masks_1[8] = {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
 static const BYTE edge_masks_1[8] = {0xff, 0x7f, 0x3f, 0x1f, 0x0f, 0x07, 0x03, 0x01};
 
+#ifdef USE_SSE2_PRIMITIVES
+
+#define SSE2_FUNC __attribute__((target("sse2")))
+
+static BOOL sse2_supported(void)
+{
+#ifdef __x86_64__
+    return TRUE;
+#else
+    static int supported = -1;
+
+    if (supported == -1) supported = IsProcessorFeaturePresent( PF_XMMI64_INSTRUCTIONS_AVAILABLE );
+    return supported;
+#endif
+}
+
+#endif  /* USE_SSE2_PRIMITIVES */
+
 #define FILTER_DIBINDEX(rgbquad,other_val) \
     (HIWORD( *(DWORD *)(&rgbquad) ) == 0x10ff ? LOWORD( *(DWORD *)(&rgbquad) ) : (other_val))
 
@@ -264,6 +288,64 @@ static inline void memset_16( WORD *start, WORD val, DWORD size )
 #endif
 }
 
+#ifdef USE_SSE2_PRIMITIVES
+static void SSE2_FUNC do_rop_line_32_sse2( DWORD *ptr, int len, DWORD and, DWORD xor )
+{
+    __m128i and_mask = _mm_set1_epi32( and ), xor_mask = _mm_set1_epi32( xor );
+
+    for ( ; len >= 4; len -= 4, ptr += 4)
+    {
+        __m128i val = _mm_loadu_si128( (__m128i *)ptr );
+        _mm_storeu_si128( (__m128i *)ptr, _mm_xor_si128( _mm_and_si128( val, and_mask ), xor_mask ));
+    }
+    while (len--) do_rop_32( ptr++, and, xor );
+}
+
+/* the three dwords of four 24-bpp pixels of a given color, as 16 pixels in three vectors */
+static inline void SSE2_FUNC get_pattern_24_sse2( DWORD color, __m128i pattern[3] )
+{
+    DWORD dw0 = ( color        & 0x00ffffff) | ((color << 24) & 0xff000000);
+    DWORD dw1 = ((color >>  8) & 0x0000ffff) | ((color << 16) & 0xffff0000);
+    DWORD dw2 = ((color >> 16) & 0x000000ff) | ((color <<  8) & 0xffffff00);
+
+    pattern[0] = _mm_setr_epi32( dw0, dw1, dw2, dw0 );
+    pattern[1] = _mm_setr_epi32( dw1, dw2, dw0, dw1 );
+    pattern[2] = _mm_setr_epi32( dw2, dw0, dw1, dw2 );
+}
+
+/* do_rop_8() over the bytes of a line of 24-bpp pixels, or a plain fill if and is 0 */
+static void SSE2_FUNC do_rop_line_24_sse2( BYTE *ptr, int len, DWORD and, DWORD xor )
+{
+    __m128i and_pattern[3], xor_pattern[3];
+    int i;
+
+    get_pattern_24_sse2( and, and_pattern );
+    get_pattern_24_sse2( xor, xor_pattern );
+
+    if (and)
+    {
+        for ( ; len >= 16; len -= 16, ptr += 48)
+            for (i = 0; i < 3; i++)
+            {
+                __m128i val = _mm_loadu_si128( (__m128i *)ptr + i );
+                val = _mm_xor_si128( _mm_and_si128( val, and_pattern[i] ), xor_pattern[i] );
+                _mm_storeu_si128( (__m128i *)ptr + i, val );
+            }
+    }
+    else
+    {
+        for ( ; len >= 16; len -= 16, ptr += 48)
+            for (i = 0; i < 3; i++) _mm_storeu_si128( (__m128i *)ptr + i, xor_pattern[i] );
+    }
+    for ( ; len > 0; len--)
+    {
+        do_rop_8( ptr++, and, xor );
+        do_rop_8( ptr++, and >> 8, xor >> 8 );
+        do_rop_8( ptr++, and >> 16, xor >> 16 );
+    }
+}
+#endif
+
 static void solid_rects_32(const dib_info *dib, int num, const RECT *rc, DWORD and, DWORD xor)
 {
     DWORD *ptr, *start;
@@ -274,6 +356,12 @@ static void solid_rects_32(const dib_info *dib, int num, const RECT *rc, DWORD a
         assert( !is_rect_empty( rc ));
 
         start = get_pixel_ptr_32(dib, rc->left, rc->top);
+#ifdef USE_SSE2_PRIMITIVES
+        if (and && sse2_supported())
+            for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
+                do_rop_line_32_sse2( start, rc->right - rc->left, and, xor );
+        else
+#endif
         if (and)
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
                 for(x = rc->left, ptr = start; x < rc->right; x++)
@@ -305,6 +393,16 @@ static void solid_rects_24(const dib_info *dib, int num, const RECT *rc, DWORD a
 
         assert( !is_rect_empty( rc ));
 
+#ifdef USE_SSE2_PRIMITIVES
+        if (right - left >= 16 && sse2_supported())
+        {
+            byte_start = get_pixel_ptr_24(dib, rc->left, rc->top);
+            for(y = rc->top; y < rc->bottom; y++, byte_start += dib->stride)
+                do_rop_line_24_sse2( byte_start, right - left, and, xor );
+            continue;
+        }
+#endif
+
         if ((left & ~3) == (right & ~3)) /* Special case for lines that start and end in the same DWORD triplet */
         {
             byte_start = get_pixel_ptr_24(dib, rc->left, rc->top);
@@ -4651,6 +4749,149 @@ static inline DWORD blend_rgb( BYTE dst_r, BYTE dst_g, BYTE dst_b, DWORD src, BL
             blend_color( dst_r, src >> 16, blend.SourceConstantAlpha ) << 16);
 }
 
+#ifdef USE_SSE2_PRIMITIVES
+
+/* (x + 127) / 255 for each 16-bit lane, exact for x <= 255 * 255 */
+static inline __m128i SSE2_FUNC div255_sse2( __m128i x )
+{
+    x = _mm_add_epi16( x, _mm_set1_epi16( 128 ));
+    return _mm_srli_epi16( _mm_add_epi16( x, _mm_srli_epi16( x, 8 )), 8 );
+}
+
+/* replicate the alpha of the two pixels held in 16-bit lanes */
+static inline __m128i SSE2_FUNC get_alpha_sse2( __m128i x )
+{
+    return _mm_shufflehi_epi16( _mm_shufflelo_epi16( x, 0xff ), 0xff );
+}
+
+/* blend_argb_alpha() on four pixels */
+static inline __m128i SSE2_FUNC blend_argb_sse2( __m128i s, __m128i d, DWORD alpha )
+{
+    __m128i zero = _mm_setzero_si128(), ff = _mm_set1_epi16( 0xff );
+    __m128i s_lo = _mm_unpacklo_epi8( s, zero ), s_hi = _mm_unpackhi_epi8( s, zero );
+    __m128i d_lo = _mm_unpacklo_epi8( d, zero ), d_hi = _mm_unpackhi_epi8( d, zero );
+    __m128i carry;
+
+    if (alpha != 255)
+    {
+        s_lo = div255_sse2( _mm_mullo_epi16( s_lo, _mm_set1_epi16( alpha )));
+        s_hi = div255_sse2( _mm_mullo_epi16( s_hi, _mm_set1_epi16( alpha )));
+    }
+    d_lo = _mm_mullo_epi16( d_lo, _mm_sub_epi16( ff, get_alpha_sse2( s_lo )));
+    d_hi = _mm_mullo_epi16( d_hi, _mm_sub_epi16( ff, get_alpha_sse2( s_hi )));
+    d_lo = _mm_add_epi16( s_lo, div255_sse2( d_lo ));
+    d_hi = _mm_add_epi16( s_hi, div255_sse2( d_hi ));
+
+    /* channels of non-premultiplied sources can exceed 255, and the C version
+     * lets them spill into the next channel */
+    carry = _mm_packus_epi16( _mm_srli_epi16( d_lo, 8 ), _mm_srli_epi16( d_hi, 8 ));
+    d = _mm_packus_epi16( _mm_and_si128( d_lo, ff ), _mm_and_si128( d_hi, ff ));
+    return _mm_or_si128( d, _mm_slli_epi32( carry, 8 ));
+}
+
+/* blend_argb_constant_alpha() on four pixels */
+static inline __m128i SSE2_FUNC blend_constant_alpha_sse2( __m128i s, __m128i d, DWORD alpha )
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i src_alpha = _mm_set1_epi16( alpha ), dst_alpha = _mm_set1_epi16( 255 - alpha );
+    __m128i lo = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( s, zero ), src_alpha ),
+                                _mm_mullo_epi16( _mm_unpacklo_epi8( d, zero ), dst_alpha ));
+    __m128i hi = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( s, zero ), src_alpha ),
+                                _mm_mullo_epi16( _mm_unpackhi_epi8( d, zero ), dst_alpha ));
+
+    return _mm_packus_epi16( div255_sse2( lo ), div255_sse2( hi ));
+}
+
+/* blend_argb_alpha() over a line */
+static void SSE2_FUNC blend_argb_line_sse2( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    for ( ; len >= 4; len -= 4, src += 4, dst += 4)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)src );
+        __m128i d = _mm_loadu_si128( (const __m128i *)dst );
+        _mm_storeu_si128( (__m128i *)dst, blend_argb_sse2( s, d, alpha ));
+    }
+    for ( ; len > 0; len--, src++, dst++)
+        *dst = alpha == 255 ? blend_argb( *dst, *src ) : blend_argb_alpha( *dst, *src, alpha );
+}
+
+/* blend_argb_constant_alpha() over a line, with src_bits or'ed into the source pixels */
+static void SSE2_FUNC blend_constant_alpha_line_sse2( DWORD *dst, const DWORD *src, int len, DWORD alpha,
+                                                      DWORD src_bits )
+{
+    __m128i bits = _mm_set1_epi32( src_bits );
+
+    for ( ; len >= 4; len -= 4, src += 4, dst += 4)
+    {
+        __m128i s = _mm_or_si128( _mm_loadu_si128( (const __m128i *)src ), bits );
+        __m128i d = _mm_loadu_si128( (const __m128i *)dst );
+        _mm_storeu_si128( (__m128i *)dst, blend_constant_alpha_sse2( s, d, alpha ));
+    }
+    for ( ; len > 0; len--, src++, dst++)
+        *dst = blend_argb_constant_alpha( *dst, *src | src_bits, alpha );
+}
+
+/* load four 24-bpp pixels, with the top byte cleared */
+static inline __m128i SSE2_FUNC load_24_sse2( const BYTE *ptr )
+{
+    return _mm_setr_epi32( *(const DWORD *)ptr & 0xffffff, *(const DWORD *)(ptr + 3) & 0xffffff,
+                           *(const DWORD *)(ptr + 6) & 0xffffff, *(const DWORD *)(ptr + 8) >> 8 );
+}
+
+/* store the low three bytes of four pixels as 24-bpp pixels */
+static inline void SSE2_FUNC store_24_sse2( BYTE *ptr, __m128i val )
+{
+    __m128i mask = _mm_setr_epi32( 0xffffff, 0, 0, 0 );
+
+    val = _mm_or_si128( _mm_or_si128( _mm_and_si128( val, mask ),
+                                      _mm_srli_si128( _mm_and_si128( val, _mm_slli_si128( mask, 4 )), 1 )),
+                        _mm_or_si128( _mm_srli_si128( _mm_and_si128( val, _mm_slli_si128( mask, 8 )), 2 ),
+                                      _mm_srli_si128( _mm_and_si128( val, _mm_slli_si128( mask, 12 )), 3 )));
+    _mm_storel_epi64( (__m128i *)ptr, val );
+    *(DWORD *)(ptr + 8) = _mm_cvtsi128_si32( _mm_srli_si128( val, 8 ));
+}
+
+/* blend_rgb() over a line of 24-bpp pixels */
+static void SSE2_FUNC blend_line_24_sse2( BYTE *dst, const DWORD *src, int len, BLENDFUNCTION blend )
+{
+    for ( ; len >= 4; len -= 4, src += 4, dst += 12)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)src );
+        __m128i d = load_24_sse2( dst );
+
+        if (blend.AlphaFormat & AC_SRC_ALPHA)
+            store_24_sse2( dst, blend_argb_sse2( s, d, blend.SourceConstantAlpha ));
+        else
+            store_24_sse2( dst, blend_constant_alpha_sse2( s, d, blend.SourceConstantAlpha ));
+    }
+    for ( ; len > 0; len--, src++, dst += 3)
+    {
+        DWORD val = blend_rgb( dst[2], dst[1], dst[0], *src, blend );
+        dst[0] = val;
+        dst[1] = val >> 8;
+        dst[2] = val >> 16;
+    }
+}
+
+static void blend_rect_sse2( const dib_info *dst, const RECT *rc, const dib_info *src,
+                             const POINT *origin, BLENDFUNCTION blend, DWORD src_bits )
+{
+    DWORD *src_ptr = get_pixel_ptr_32( src, origin->x, origin->y );
+    DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
+    int y;
+
+    for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+    {
+        if (blend.AlphaFormat & AC_SRC_ALPHA)
+            blend_argb_line_sse2( dst_ptr, src_ptr, rc->right - rc->left, blend.SourceConstantAlpha );
+        else
+            blend_constant_alpha_line_sse2( dst_ptr, src_ptr, rc->right - rc->left,
+                                            blend.SourceConstantAlpha, src_bits );
+    }
+}
+
+#endif  /* USE_SSE2_PRIMITIVES */
+
 static void blend_rect_8888(const dib_info *dst, const RECT *rc,
                             const dib_info *src, const POINT *origin, BLENDFUNCTION blend)
 {
@@ -4658,6 +4899,14 @@ static void blend_rect_8888(const dib_info *dst, const RECT *rc,
     DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
     int x, y;
 
+#ifdef USE_SSE2_PRIMITIVES
+    if (sse2_supported())
+    {
+        blend_rect_sse2( dst, rc, src, origin, blend, src->compression == BI_RGB ? 0 : 0xff000000 );
+        return;
+    }
+#endif
+
     if (blend.AlphaFormat & AC_SRC_ALPHA)
     {
 	if (blend.SourceConstantAlpha == 255)
@@ -4725,6 +4974,15 @@ static void blend_rect_24(const dib_info *dst, const RECT *rc,
     BYTE *dst_ptr = get_pixel_ptr_24( dst, rc->left, rc->top );
     int x, y;
 
+#ifdef USE_SSE2_PRIMITIVES
+    if (sse2_supported())
+    {
+        for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride, src_ptr += src->stride / 4)
+            blend_line_24_sse2( dst_ptr, src_ptr, rc->right - rc->left, blend );
+        return;
+    }
+#endif
+
     for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride, src_ptr += src->stride / 4)
     {
         for (x = 0; x < rc->right - rc->left; x++)
@@ -4966,6 +5224,74 @@ static inline DWORD gradient_triangle_8( const dib_info *dib, const TRIVERTEX *v
     return rgb_to_pixel_colortable( dib, r * 127, g * 127, b * 127 );
 }
 
+#ifdef USE_SSE2_PRIMITIVES
+/* the blue, green, red and alpha numerators of gradient_triangle_8888() */
+static inline void triangle_numerators( const TRIVERTEX *v, int x, int y, int det, INT64 num[4] )
+{
+    INT64 l1, l2;
+
+    triangle_weights( v, x, y, &l1, &l2 );
+    num[0] = v[0].Blue  * l1 + v[1].Blue  * l2 + v[2].Blue  * (det - l1 - l2);
+    num[1] = v[0].Green * l1 + v[1].Green * l2 + v[2].Green * (det - l1 - l2);
+    num[2] = v[0].Red   * l1 + v[1].Red   * l2 + v[2].Red   * (det - l1 - l2);
+    num[3] = v[0].Alpha * l1 + v[1].Alpha * l2 + v[2].Alpha * (det - l1 - l2);
+}
+
+/* gradient_triangle_8888() over a row of 4 or 3 bytes per pixel pixels. The numerators are
+ * exact in double precision, and below 2^52 the rounded quotient truncates to the same integer
+ * as the C division; rows that don't fit return FALSE and are left to the C version. */
+static BOOL SSE2_FUNC gradient_triangle_line_sse2( BYTE *ptr, int bpp, const TRIVERTEX *v,
+                                                   int left, int right, int y, int det )
+{
+    static const INT64 max_num = (INT64)1 << 52;
+    INT64 start[4], end[4], step[4];
+    INT64 dl1 = v[1].y - v[2].y, dl2 = v[2].y - v[0].y;
+    __m128d n_bg, n_ra, step_bg, step_ra, div = _mm_set1_pd( det * 256.0 );
+    __m128i mask = _mm_set1_epi32( 0xff );
+    int i, x;
+
+    triangle_numerators( v, left, y, det, start );
+    triangle_numerators( v, right - 1, y, det, end );
+    for (i = 0; i < 4; i++)
+    {
+        if (start[i] <= -max_num || start[i] >= max_num) return FALSE;
+        if (end[i] <= -max_num || end[i] >= max_num) return FALSE;
+        if (start[i] / det / 256 != (int)(start[i] / det / 256)) return FALSE;
+        if (end[i] / det / 256 != (int)(end[i] / det / 256)) return FALSE;
+    }
+    step[0] = v[0].Blue  * dl1 + v[1].Blue  * dl2 - v[2].Blue  * (dl1 + dl2);
+    step[1] = v[0].Green * dl1 + v[1].Green * dl2 - v[2].Green * (dl1 + dl2);
+    step[2] = v[0].Red   * dl1 + v[1].Red   * dl2 - v[2].Red   * (dl1 + dl2);
+    step[3] = v[0].Alpha * dl1 + v[1].Alpha * dl2 - v[2].Alpha * (dl1 + dl2);
+
+    n_bg = _mm_setr_pd( start[0], start[1] );
+    n_ra = _mm_setr_pd( start[2], start[3] );
+    step_bg = _mm_setr_pd( step[0], step[1] );
+    step_ra = _mm_setr_pd( step[2], step[3] );
+
+    for (x = left; x < right; x++, ptr += bpp)
+    {
+        __m128i val = _mm_unpacklo_epi64( _mm_cvttpd_epi32( _mm_div_pd( n_bg, div )),
+                                          _mm_cvttpd_epi32( _mm_div_pd( n_ra, div )));
+        DWORD pixel;
+
+        val = _mm_and_si128( val, mask );
+        val = _mm_packs_epi32( val, val );
+        pixel = _mm_cvtsi128_si32( _mm_packus_epi16( val, val ));
+        if (bpp == 4) *(DWORD *)ptr = pixel;
+        else
+        {
+            ptr[0] = pixel;
+            ptr[1] = pixel >> 8;
+            ptr[2] = pixel >> 16;
+        }
+        n_bg = _mm_add_pd( n_bg, step_bg );
+        n_ra = _mm_add_pd( n_ra, step_ra );
+    }
+    return TRUE;
+}
+#endif
+
 static BOOL gradient_rect_8888( const dib_info *dib, const RECT *rc, const TRIVERTEX *v, int mode )
 {
     DWORD *ptr = get_pixel_ptr_32( dib, rc->left, rc->top );
@@ -4994,6 +5320,11 @@ static BOOL gradient_rect_8888( const dib_info *dib, const RECT *rc, const TRIVE
         for (y = rc->top; y < rc->bottom; y++, ptr += dib->stride / 4)
         {
             triangle_coords( v, rc, y, &left, &right );
+#ifdef USE_SSE2_PRIMITIVES
+            if (left < right && sse2_supported() &&
+                gradient_triangle_line_sse2( (BYTE *)(ptr + left - rc->left), 4, v, left, right, y, det ))
+                continue;
+#endif
             for (x = left; x < right; x++) ptr[x - rc->left] = gradient_triangle_8888( v, x, y, det );
         }
         break;
@@ -5097,6 +5428,13 @@ static BOOL gradient_rect_24( const dib_info *dib, const RECT *rc, const TRIVERT
         for (y = rc->top; y < rc->bottom; y++, ptr += dib->stride)
         {
             DWORD val = gradient_rgb_24( v, y - v[0].y, v[1].y - v[0].y );
+#ifdef USE_SSE2_PRIMITIVES
+            if (sse2_supported())
+            {
+                do_rop_line_24_sse2( ptr, rc->right - rc->left, 0, val );
+                continue;
+            }
+#endif
             for (x = 0; x < rc->right - rc->left; x++)
             {
                 ptr[x * 3]     = val;
@@ -5111,6 +5449,11 @@ static BOOL gradient_rect_24( const dib_info *dib, const RECT *rc, const TRIVERT
         for (y = rc->top; y < rc->bottom; y++, ptr += dib->stride)
         {
             triangle_coords( v, rc, y, &left, &right );
+#ifdef USE_SSE2_PRIMITIVES
+            if (left < right && sse2_supported() &&
+                gradient_triangle_line_sse2( ptr + (left - rc->left) * 3, 3, v, left, right, y, det ))
+                continue;
+#endif
             for (x = left; x < right; x++)
             {
                 DWORD val = gradient_triangle_24( v, x, y, det );
@@ -3516,11 +3516,324 @@ static void test_simple_graphics(void)
     DeleteDC(mem_dc);
 }
 
+static inline BYTE blend_channel( BYTE dst, BYTE src, DWORD alpha )
+{
+    return (src * alpha + dst * (255 - alpha) + 127) / 255;
+}
+
+static DWORD swap_red_blue( DWORD pixel )
+{
+    return (pixel & 0xff00ff00) | ((pixel >> 16) & 0xff) | ((pixel & 0xff) << 16);
+}
+
+static DWORD blend_pixel( DWORD dst, DWORD src, BLENDFUNCTION blend )
+{
+    DWORD alpha = blend.SourceConstantAlpha, ret = 0;
+    int i;
+
+    if (!(blend.AlphaFormat & AC_SRC_ALPHA))
+    {
+        for (i = 0; i < 32; i += 8)
+            ret |= blend_channel( dst >> i, src >> i, alpha ) << i;
+        return ret;
+    }
+    for (i = 0; i < 32; i += 8)
+        ret |= (((BYTE)(src >> i) * alpha + 127) / 255) << i;
+    alpha = ret >> 24;
+    for (i = 0; i < 32; i += 8)
+        ret += (((BYTE)(dst >> i) * (255 - alpha) + 127) / 255) << i;
+    return ret;
+}
+
+static const char * const blend_layouts[] = { "rgb", "bitfields", "bgr bitfields" };
+
+/* layout 0 is BI_RGB, 1 is BI_BITFIELDS with the same masks, 2 is BI_BITFIELDS
+ * with red and blue swapped, which goes through the generic 32-bpp primitives */
+static HBITMAP create_blend_dib( HDC hdc, int layout, DWORD **bits )
+{
+    char bmibuf[sizeof(BITMAPINFO) + 3 * sizeof(DWORD)];
+    BITMAPINFO *bmi = (BITMAPINFO *)bmibuf;
+    DWORD *masks = (DWORD *)bmi->bmiColors;
+
+    memset( bmi, 0, sizeof(bmibuf) );
+    bmi->bmiHeader.biSize = sizeof(bmi->bmiHeader);
+    bmi->bmiHeader.biWidth = 64;
+    bmi->bmiHeader.biHeight = -64;
+    bmi->bmiHeader.biBitCount = 32;
+    bmi->bmiHeader.biPlanes = 1;
+    bmi->bmiHeader.biCompression = layout ? BI_BITFIELDS : BI_RGB;
+    masks[0] = layout == 2 ? 0x0000ff : 0xff0000;
+    masks[1] = 0x00ff00;
+    masks[2] = layout == 2 ? 0xff0000 : 0x0000ff;
+    return CreateDIBSection( hdc, bmi, DIB_RGB_COLORS, (void **)bits, NULL, 0 );
+}
+
+/* Check every pixel of small blends at all alignments, so that both the
+ * vectorized and the remaining pixels of each line get exercised. */
+static void test_blend_pixels(void)
+{
+    static const BYTE alphas[] = { 255, 128, 1 };
+    HDC src_dc = CreateCompatibleDC( NULL ), dst_dc = CreateCompatibleDC( NULL );
+    HBITMAP src_dib, dst_dib, orig_src, orig_dst;
+    DWORD *src_bits, *dst_bits, orig[64 * 4], expect;
+    BLENDFUNCTION blend = { AC_SRC_OVER, 0, 0, 0 };
+    int i, x, y, width, layout, format, alpha, a;
+    HBRUSH brush, orig_brush;
+
+    src_dib = create_blend_dib( src_dc, 0, &src_bits );
+    orig_src = SelectObject( src_dc, src_dib );
+    for (i = 0; i < 64 * 64; i++)
+    {
+        /* premultiplied pixels */
+        a = (i * 7) & 0xff;
+        src_bits[i] = (a << 24) | ((i * 13) % (a + 1)) << 16 | ((i * 29) % (a + 1)) << 8 | ((i * 3) % (a + 1));
+    }
+
+    for (layout = 0; layout < ARRAY_SIZE(blend_layouts); layout++)
+    {
+        dst_dib = create_blend_dib( dst_dc, layout, &dst_bits );
+        orig_dst = SelectObject( dst_dc, dst_dib );
+
+        for (format = 0; format < 2; format++)
+        for (alpha = 0; alpha < ARRAY_SIZE(alphas); alpha++)
+        for (width = 1; width <= 19; width++)
+        for (x = 0; x < 4; x++)
+        {
+            blend.AlphaFormat = format ? AC_SRC_ALPHA : 0;
+            blend.SourceConstantAlpha = alphas[alpha];
+            for (i = 0; i < 64 * 4; i++)
+                dst_bits[i] = orig[i] = ((DWORD)i * 0x01030507) ^ (width << 24);
+
+            GdiAlphaBlend( dst_dc, x, 0, width, 4, src_dc, width, width, width, 4, blend );
+            for (y = 0; y < 4; y++)
+                for (i = 0; i < 64; i++)
+                {
+                    expect = orig[y * 64 + i];
+                    if (i >= x && i < x + width)
+                    {
+                        if (layout == 2)
+                        {
+                            /* the generic primitives don't keep the alpha channel */
+                            expect = swap_red_blue( blend_pixel( swap_red_blue( expect ),
+                                                                 src_bits[(width + y) * 64 + width + i - x], blend ));
+                            expect &= 0x00ffffff;
+                        }
+                        else expect = blend_pixel( expect, src_bits[(width + y) * 64 + width + i - x], blend );
+                    }
+                    ok( dst_bits[y * 64 + i] == expect,
+                        "%s format %x alpha %u width %u x %u: pixel %u,%u got %08x expected %08x\n",
+                        blend_layouts[layout], blend.AlphaFormat, blend.SourceConstantAlpha,
+                        width, x, i, y, dst_bits[y * 64 + i], expect );
+                }
+        }
+
+        /* solid rectangles with a rop */
+        brush = CreateSolidBrush( RGB( 0x12, 0x34, 0x56 ));
+        orig_brush = SelectObject( dst_dc, brush );
+        for (width = 1; width <= 19; width++)
+        for (x = 0; x < 4; x++)
+        {
+            for (i = 0; i < 64 * 4; i++) dst_bits[i] = orig[i] = (DWORD)i * 0x01030507;
+            PatBlt( dst_dc, x, 0, width, 4, PATINVERT );
+            for (y = 0; y < 4; y++)
+                for (i = 0; i < 64; i++)
+                {
+                    expect = orig[y * 64 + i];
+                    if (i >= x && i < x + width) expect ^= layout == 2 ? 0x563412 : 0x123456;
+                    ok( dst_bits[y * 64 + i] == expect, "%s PATINVERT width %u x %u: pixel %u,%u got %08x expected %08x\n",
+                        blend_layouts[layout], width, x, i, y, dst_bits[y * 64 + i], expect );
+                }
+        }
+        SelectObject( dst_dc, orig_brush );
+        DeleteObject( brush );
+
+        SelectObject( dst_dc, orig_dst );
+        DeleteObject( dst_dib );
+    }
+
+    SelectObject( src_dc, orig_src );
+    DeleteObject( src_dib );
+    DeleteDC( src_dc );
+    DeleteDC( dst_dc );
+}
+
+/* Same as test_blend_pixels() for a 24-bpp destination, whose vectorized
+ * paths work on blocks of 4 pixels for blending and 16 pixels for rops. */
+static void test_blend_pixels_24(void)
+{
+    static const BYTE alphas[] = { 255, 128, 1 };
+    static const DWORD rops[] = { PATINVERT, PATCOPY };
+    char bmibuf[sizeof(BITMAPINFO)];
+    BITMAPINFO *bmi = (BITMAPINFO *)bmibuf;
+    HDC src_dc = CreateCompatibleDC( NULL ), dst_dc = CreateCompatibleDC( NULL );
+    HBITMAP src_dib, dst_dib, orig_src, orig_dst;
+    DWORD *src_bits, got, expect;
+    BYTE *dst_bits, orig[64 * 3 * 4];
+    BLENDFUNCTION blend = { AC_SRC_OVER, 0, 0, 0 };
+    int i, x, y, width, format, alpha, a, rop;
+    HBRUSH brush, orig_brush;
+
+    src_dib = create_blend_dib( src_dc, 0, &src_bits );
+    orig_src = SelectObject( src_dc, src_dib );
+    for (i = 0; i < 64 * 64; i++)
+    {
+        a = (i * 7) & 0xff;
+        src_bits[i] = (a << 24) | ((i * 13) % (a + 1)) << 16 | ((i * 29) % (a + 1)) << 8 | ((i * 3) % (a + 1));
+    }
+
+    memset( bmi, 0, sizeof(bmibuf) );
+    bmi->bmiHeader.biSize = sizeof(bmi->bmiHeader);
+    bmi->bmiHeader.biWidth = 64;
+    bmi->bmiHeader.biHeight = -4;
+    bmi->bmiHeader.biBitCount = 24;
+    bmi->bmiHeader.biPlanes = 1;
+    bmi->bmiHeader.biCompression = BI_RGB;
+    dst_dib = CreateDIBSection( dst_dc, bmi, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0 );
+    orig_dst = SelectObject( dst_dc, dst_dib );
+
+    for (format = 0; format < 2; format++)
+    for (alpha = 0; alpha < ARRAY_SIZE(alphas); alpha++)
+    for (width = 1; width <= 19; width++)
+    for (x = 0; x < 4; x++)
+    {
+        blend.AlphaFormat = format ? AC_SRC_ALPHA : 0;
+        blend.SourceConstantAlpha = alphas[alpha];
+        for (i = 0; i < sizeof(orig); i++) dst_bits[i] = orig[i] = i * 7 + width;
+
+        GdiAlphaBlend( dst_dc, x, 0, width, 4, src_dc, width, width, width, 4, blend );
+        for (y = 0; y < 4; y++)
+            for (i = 0; i < 64; i++)
+            {
+                BYTE *ptr = orig + y * 64 * 3 + i * 3;
+                expect = ptr[0] | ptr[1] << 8 | ptr[2] << 16;
+                if (i >= x && i < x + width)
+                    expect = blend_pixel( expect, src_bits[(width + y) * 64 + width + i - x], blend ) & 0xffffff;
+                ptr = dst_bits + y * 64 * 3 + i * 3;
+                got = ptr[0] | ptr[1] << 8 | ptr[2] << 16;
+                ok( got == expect, "format %x alpha %u width %u x %u: pixel %u,%u got %06x expected %06x\n",
+                    blend.AlphaFormat, blend.SourceConstantAlpha, width, x, i, y, got, expect );
+            }
+    }
+
+    brush = CreateSolidBrush( RGB( 0x12, 0x34, 0x56 ));
+    orig_brush = SelectObject( dst_dc, brush );
+    for (rop = 0; rop < ARRAY_SIZE(rops); rop++)
+    for (width = 1; width <= 40; width++)
+    for (x = 0; x < 4; x++)
+    {
+        for (i = 0; i < sizeof(orig); i++) dst_bits[i] = orig[i] = i * 7 + width;
+        PatBlt( dst_dc, x, 0, width, 4, rops[rop] );
+        for (y = 0; y < 4; y++)
+            for (i = 0; i < 64; i++)
+            {
+                BYTE *ptr = orig + y * 64 * 3 + i * 3;
+                expect = ptr[0] | ptr[1] << 8 | ptr[2] << 16;
+                if (i >= x && i < x + width)
+                    expect = rops[rop] == PATINVERT ? expect ^ 0x123456 : 0x123456;
+                ptr = dst_bits + y * 64 * 3 + i * 3;
+                got = ptr[0] | ptr[1] << 8 | ptr[2] << 16;
+                ok( got == expect, "rop %06x width %u x %u: pixel %u,%u got %06x expected %06x\n",
+                    rops[rop], width, x, i, y, got, expect );
+            }
+    }
+    SelectObject( dst_dc, orig_brush );
+    DeleteObject( brush );
+
+    SelectObject( dst_dc, orig_dst );
+    DeleteObject( dst_dib );
+    SelectObject( src_dc, orig_src );
+    DeleteObject( src_dib );
+    DeleteDC( src_dc );
+    DeleteDC( dst_dc );
+}
+
+static void draw_large_graphics( HDC hdc, HDC src_dc )
+{
+    static const BLENDFUNCTION blend = { AC_SRC_OVER, 0, 200, AC_SRC_ALPHA };
+    TRIVERTEX vert[3] = { { 0, 0, 0xff00, 0x8000, 0x0000, 0x0000 },
+                          { 1024, 300, 0x0000, 0xff00, 0x4000, 0x8000 },
+                          { 200, 1024, 0x2000, 0x0000, 0xff00, 0xff00 } };
+    GRADIENT_TRIANGLE tri = { 0, 1, 2 };
+    HBRUSH solid = CreateSolidBrush( RGB( 0x10, 0x20, 0x30 ));
+    HBRUSH hatch = CreateHatchBrush( HS_DIAGCROSS, RGB( 0x20, 0x80, 0xc0 ));
+    RECT rect = { 30, 40, 900, 1000 };
+    HBRUSH orig;
+
+    GdiGradientFill( hdc, vert, 3, &tri, 1, GRADIENT_FILL_TRIANGLE );
+    BitBlt( hdc, 10, 20, 1000, 990, src_dc, 3, 7, SRCINVERT );
+    GdiAlphaBlend( hdc, 5, 3, 1017, 1013, src_dc, 1, 2, 1017, 1013, blend );
+
+    FillRect( hdc, &rect, solid );
+    orig = SelectObject( hdc, hatch );
+    PatBlt( hdc, 7, 9, 1010, 1000, PATINVERT );
+    Rectangle( hdc, 100, 50, 1000, 1020 );
+    PatBlt( hdc, 0, 500, 1024, 300, DSTINVERT );
+    SelectObject( hdc, orig );
+    DeleteObject( hatch );
+    DeleteObject( solid );
+}
+
+/* Large operations may be split in bands processed in parallel; the result
+ * must be the same as when drawing through small clip rectangles. */
+static void test_large_graphics(void)
+{
+    BITMAPINFO bmi;
+    HDC src_dc = CreateCompatibleDC( NULL ), dst_dc = CreateCompatibleDC( NULL );
+    HBITMAP src_dib, dst_dib, orig_src, orig_dst;
+    DWORD *src_bits, *dst_bits, *expect;
+    HRGN rgn;
+    int i, x, y;
+
+    memset( &bmi, 0, sizeof(bmi) );
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = 1024;
+    bmi.bmiHeader.biHeight = -1024;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    src_dib = CreateDIBSection( src_dc, &bmi, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    dst_dib = CreateDIBSection( dst_dc, &bmi, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0 );
+    orig_src = SelectObject( src_dc, src_dib );
+    orig_dst = SelectObject( dst_dc, dst_dib );
+    for (i = 0; i < 1024 * 1024; i++)
+    {
+        BYTE a = i / 1024;
+        src_bits[i] = (a << 24) | ((i % (a + 1)) << 16) | (((i / 3) % (a + 1)) << 8) | ((i / 7) % (a + 1));
+    }
+
+    draw_large_graphics( dst_dc, src_dc );
+    expect = HeapAlloc( GetProcessHeap(), 0, 1024 * 1024 * 4 );
+    memcpy( expect, dst_bits, 1024 * 1024 * 4 );
+
+    memset( dst_bits, 0, 1024 * 1024 * 4 );
+    for (y = 0; y < 1024; y += 64)
+        for (x = 0; x < 1024; x += 128)
+        {
+            rgn = CreateRectRgn( x, y, x + 128, y + 64 );
+            SelectClipRgn( dst_dc, rgn );
+            DeleteObject( rgn );
+            draw_large_graphics( dst_dc, src_dc );
+        }
+    SelectClipRgn( dst_dc, NULL );
+    ok( !memcmp( dst_bits, expect, 1024 * 1024 * 4 ), "large graphics differ from tiled ones\n" );
+
+    HeapFree( GetProcessHeap(), 0, expect );
+    SelectObject( src_dc, orig_src );
+    SelectObject( dst_dc, orig_dst );
+    DeleteObject( src_dib );
+    DeleteObject( dst_dib );
+    DeleteDC( src_dc );
+    DeleteDC( dst_dc );
+}
+
 START_TEST(dib)
 {
     CryptAcquireContextW(&crypt_prov, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT);
 
     test_simple_graphics();
+    test_blend_pixels();
+    test_blend_pixels_24();
+    test_large_graphics();
 
     CryptReleaseContext(crypt_prov, 0);
 }
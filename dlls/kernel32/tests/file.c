@@ -62,6 +62,7 @@ static BOOL (WINAPI *pGetQueuedCompletionStatusEx)(HANDLE, OVERLAPPED_ENTRY*, UL
 static void (WINAPI *pRtlInitAnsiString)(PANSI_STRING,PCSZ);
 static void (WINAPI *pRtlFreeUnicodeString)(PUNICODE_STRING);
 static BOOL (WINAPI *pSetFileCompletionNotificationModes)(HANDLE, UCHAR);
+static BOOL (WINAPI *pCancelIoEx)(HANDLE, LPOVERLAPPED);
 
 static char filename[MAX_PATH];
 static const char sillytext[] =
@@ -111,6 +112,7 @@ static void InitFunctionPointers(void)
     pSetFileInformationByHandle = (void *) GetProcAddress(hkernel32, "SetFileInformationByHandle");
     pGetQueuedCompletionStatusEx = (void *) GetProcAddress(hkernel32, "GetQueuedCompletionStatusEx");
     pSetFileCompletionNotificationModes = (void *)GetProcAddress(hkernel32, "SetFileCompletionNotificationModes");
+    pCancelIoEx = (void *)GetProcAddress(hkernel32, "CancelIoEx");
 }
 
 static void test__hread( void )
@@ -4614,6 +4616,71 @@ static void test_WriteFileGather(void)
     DeleteFileA( filename );
 }
 
+static void test_scatter_gather_segments(void)
+{
+    char temp_path[MAX_PATH], filename[MAX_PATH];
+    FILE_SEGMENT_ELEMENT fse[101];
+    OVERLAPPED ovl;
+    SYSTEM_INFO si;
+    HANDLE hfile, evt;
+    DWORD i, j, tx;
+    char *buf;
+    BOOL br;
+
+    GetSystemInfo( &si );
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, "wfg", 0, filename );
+    hfile = CreateFileA( filename, GENERIC_READ | GENERIC_WRITE, 0, 0, CREATE_ALWAYS,
+                         FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, 0 );
+    ok( hfile != INVALID_HANDLE_VALUE, "CreateFile failed err %u\n", GetLastError() );
+    if (hfile == INVALID_HANDLE_VALUE) return;
+
+    evt = CreateEventW( NULL, TRUE, FALSE, NULL );
+    buf = VirtualAlloc( NULL, si.dwPageSize * (ARRAY_SIZE(fse) - 1), MEM_COMMIT, PAGE_READWRITE );
+
+    /* segments don't need to be contiguous nor in order */
+    memset( fse, 0, sizeof(fse) );
+    for (i = 0; i < ARRAY_SIZE(fse) - 1; i++)
+    {
+        j = (i * 7) % (ARRAY_SIZE(fse) - 1);
+        fse[i].Buffer = buf + j * si.dwPageSize;
+        memset( fse[i].Buffer, i, si.dwPageSize );
+    }
+
+    memset( &ovl, 0, sizeof(ovl) );
+    ovl.hEvent = evt;
+    br = WriteFileGather( hfile, fse, si.dwPageSize * (ARRAY_SIZE(fse) - 1), NULL, &ovl );
+    ok( br || GetLastError() == ERROR_IO_PENDING, "WriteFileGather failed err %u\n", GetLastError() );
+    br = GetOverlappedResult( hfile, &ovl, &tx, TRUE );
+    ok( br && tx == si.dwPageSize * (ARRAY_SIZE(fse) - 1), "got %d, %u bytes\n", br, tx );
+
+    /* read it back in reverse order, starting in the middle of the file */
+    memset( buf, 0xcc, si.dwPageSize * (ARRAY_SIZE(fse) - 1) );
+    for (i = 0; i < ARRAY_SIZE(fse) - 1; i++) fse[i].Buffer = buf + (ARRAY_SIZE(fse) - 2 - i) * si.dwPageSize;
+    memset( &ovl, 0, sizeof(ovl) );
+    ovl.hEvent = evt;
+    S(U(ovl)).Offset = si.dwPageSize;
+    ResetEvent( evt );
+    br = ReadFileScatter( hfile, fse, si.dwPageSize * (ARRAY_SIZE(fse) - 1), NULL, &ovl );
+    ok( br == FALSE, "ReadFileScatter should be asynchronous\n" );
+    ok( GetLastError() == ERROR_IO_PENDING, "ReadFileScatter failed err %u\n", GetLastError() );
+    br = GetOverlappedResult( hfile, &ovl, &tx, TRUE );
+    ok( br && tx == si.dwPageSize * (ARRAY_SIZE(fse) - 2), "got %d, %u bytes\n", br, tx );
+
+    for (i = 0; i < ARRAY_SIZE(fse) - 2; i++)
+    {
+        char *page = fse[i].Buffer;
+        ok( page[0] == (char)(i + 1) && page[si.dwPageSize - 1] == (char)(i + 1),
+            "segment %u: got %02x\n", i, (BYTE)page[0] );
+    }
+    ok( *(BYTE *)fse[i].Buffer == 0xcc, "last segment modified\n" );
+
+    VirtualFree( buf, 0, MEM_RELEASE );
+    CloseHandle( evt );
+    CloseHandle( hfile );
+    DeleteFileA( filename );
+}
+
 static unsigned file_map_access(unsigned access)
 {
     if (access & GENERIC_READ)    access |= FILE_GENERIC_READ;
@@ -5060,9 +5127,10 @@ static void test_post_completion(void)
 {
     OVERLAPPED ovl, ovl2, *povl;
     OVERLAPPED_ENTRY entries[2];
+    static OVERLAPPED_ENTRY many[100];
     ULONG_PTR key;
     HANDLE port;
-    ULONG count;
+    ULONG count, i;
     DWORD size;
     BOOL ret;
 
@@ -5161,6 +5229,33 @@ static void test_post_completion(void)
 
     SleepEx(0, TRUE);
 
+    for (i = 0; i < 150; i++)
+    {
+        ret = PostQueuedCompletionStatus( port, i, i * 2, &ovl );
+        ok(ret, "PostQueuedCompletionStatus failed: %u\n", GetLastError());
+    }
+
+    count = 0xdeadbeef;
+    ret = pGetQueuedCompletionStatusEx( port, many, ARRAY_SIZE(many), &count, 0, FALSE );
+    ok(ret, "GetQueuedCompletionStatusEx failed\n");
+    ok(count == ARRAY_SIZE(many), "wrong count %u\n", count);
+    for (i = 0; i < count; i++)
+    {
+        ok(many[i].lpCompletionKey == i * 2, "%u: wrong key %lu\n", i, many[i].lpCompletionKey);
+        ok(many[i].dwNumberOfBytesTransferred == i, "%u: wrong size %u\n", i, many[i].dwNumberOfBytesTransferred);
+    }
+
+    count = 0xdeadbeef;
+    ret = pGetQueuedCompletionStatusEx( port, many, ARRAY_SIZE(many), &count, 0, FALSE );
+    ok(ret, "GetQueuedCompletionStatusEx failed\n");
+    ok(count == 50, "wrong count %u\n", count);
+    for (i = 0; i < count; i++)
+        ok(many[i].lpCompletionKey == (i + 100) * 2, "%u: wrong key %lu\n", i, many[i].lpCompletionKey);
+
+    ret = pGetQueuedCompletionStatusEx( port, many, ARRAY_SIZE(many), &count, 0, FALSE );
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded\n");
+    ok(GetLastError() == WAIT_TIMEOUT, "wrong error %u\n", GetLastError());
+
     CloseHandle( port );
 }
 
@@ -5228,6 +5323,195 @@ static void test_overlapped_read(void)
     ok(ret, "Unexpected error %u.\n", GetLastError());
 }
 
+#define QUEUE_DEPTH      64
+#define QUEUE_CHUNK_SIZE 0x10000
+
+static void queue_overlapped_reads(HANDLE hfile, unsigned char *buffer, OVERLAPPED *ov, HANDLE *events)
+{
+    DWORD i, j;
+    BOOL ret;
+
+    memset(buffer, 0xcc, QUEUE_DEPTH * QUEUE_CHUNK_SIZE);
+    for (i = 0; i < QUEUE_DEPTH; i++)
+    {
+        /* issue them in reverse order to defeat any readahead */
+        j = QUEUE_DEPTH - 1 - i;
+        memset(&ov[j], 0, sizeof(ov[j]));
+        S(U(ov[j])).Offset = j * QUEUE_CHUNK_SIZE;
+        ov[j].hEvent = events[j];
+        ret = ReadFile(hfile, buffer + j * QUEUE_CHUNK_SIZE, QUEUE_CHUNK_SIZE, NULL, &ov[j]);
+        ok(ret || GetLastError() == ERROR_IO_PENDING, "ReadFile %u failed, error %u.\n", j, GetLastError());
+    }
+}
+
+static void check_overlapped_read(const unsigned char *buffer, DWORD i)
+{
+    DWORD j;
+
+    for (j = 0; j < QUEUE_CHUNK_SIZE; j++) if (buffer[i * QUEUE_CHUNK_SIZE + j] != i) break;
+    ok(j == QUEUE_CHUNK_SIZE, "read %u: wrong data at %u.\n", i, j);
+}
+
+static void test_overlapped_requests(void)
+{
+    static const char prefix[] = "pfx";
+    char temp_path[MAX_PATH];
+    char file_name[MAX_PATH];
+    OVERLAPPED ov[QUEUE_DEPTH], *povl;
+    HANDLE events[QUEUE_DEPTH];
+    DWORD bytes_count, i;
+    unsigned char *buffer;
+    HANDLE hfile, hdup, port;
+    BOOL seen[QUEUE_DEPTH];
+    ULONG_PTR key;
+    BOOL ret;
+
+    GetTempPathA(MAX_PATH, temp_path);
+    GetTempFileNameA(temp_path, prefix, 0, file_name);
+    buffer = HeapAlloc(GetProcessHeap(), 0, QUEUE_DEPTH * QUEUE_CHUNK_SIZE);
+
+    hfile = CreateFileA(file_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+            FILE_FLAG_OVERLAPPED, NULL);
+    ok(hfile != INVALID_HANDLE_VALUE, "Failed to create file, GetLastError() %u.\n", GetLastError());
+
+    for (i = 0; i < QUEUE_DEPTH; i++)
+    {
+        events[i] = CreateEventA(NULL, TRUE, FALSE, NULL);
+        memset(buffer + i * QUEUE_CHUNK_SIZE, i, QUEUE_CHUNK_SIZE);
+    }
+
+    /* queue all the writes before waiting for any of them */
+    for (i = 0; i < QUEUE_DEPTH; i++)
+    {
+        memset(&ov[i], 0, sizeof(ov[i]));
+        S(U(ov[i])).Offset = i * QUEUE_CHUNK_SIZE;
+        ov[i].hEvent = events[i];
+        ret = WriteFile(hfile, buffer + i * QUEUE_CHUNK_SIZE, QUEUE_CHUNK_SIZE, NULL, &ov[i]);
+        ok(ret || GetLastError() == ERROR_IO_PENDING, "WriteFile %u failed, error %u.\n", i, GetLastError());
+    }
+    for (i = 0; i < QUEUE_DEPTH; i++)
+    {
+        ret = GetOverlappedResult(hfile, &ov[i], &bytes_count, TRUE);
+        ok(ret && bytes_count == QUEUE_CHUNK_SIZE, "write %u: ret %d, count %u, error %u.\n",
+                i, ret, bytes_count, GetLastError());
+    }
+
+    /* without an event, GetOverlappedResult waits on the file handle */
+    memset(buffer, 0xcc, QUEUE_DEPTH * QUEUE_CHUNK_SIZE);
+    for (i = 0; i < 8; i++)
+    {
+        memset(&ov[i], 0, sizeof(ov[i]));
+        S(U(ov[i])).Offset = i * QUEUE_CHUNK_SIZE;
+        ret = ReadFile(hfile, buffer + i * QUEUE_CHUNK_SIZE, QUEUE_CHUNK_SIZE, NULL, &ov[i]);
+        ok(ret || GetLastError() == ERROR_IO_PENDING, "ReadFile %u failed, error %u.\n", i, GetLastError());
+        ret = GetOverlappedResult(hfile, &ov[i], &bytes_count, TRUE);
+        ok(ret && bytes_count == QUEUE_CHUNK_SIZE, "read %u: ret %d, count %u, error %u.\n",
+                i, ret, bytes_count, GetLastError());
+        check_overlapped_read(buffer, i);
+    }
+
+    /* many requests in flight, each with its own event */
+    queue_overlapped_reads(hfile, buffer, ov, events);
+    WaitForMultipleObjects(QUEUE_DEPTH, events, TRUE, INFINITE);
+    for (i = 0; i < QUEUE_DEPTH; i++)
+    {
+        ret = GetOverlappedResult(hfile, &ov[i], &bytes_count, FALSE);
+        ok(ret && bytes_count == QUEUE_CHUNK_SIZE, "read %u: ret %d, count %u, error %u.\n",
+                i, ret, bytes_count, GetLastError());
+        check_overlapped_read(buffer, i);
+    }
+
+    /* completion port packets, also when the handle is closed before the request is done */
+    port = CreateIoCompletionPort(hfile, NULL, 0xdead, 0);
+    ok(port != NULL, "CreateIoCompletionPort failed, error %u.\n", GetLastError());
+
+    queue_overlapped_reads(hfile, buffer, ov, events);
+    memset(seen, 0, sizeof(seen));
+    for (i = 0; i < QUEUE_DEPTH; i++)
+    {
+        key = 0;
+        povl = NULL;
+        ret = GetQueuedCompletionStatus(port, &bytes_count, &key, &povl, 5000);
+        ok(ret, "GetQueuedCompletionStatus failed, error %u.\n", GetLastError());
+        if (!ret) break;
+        ok(key == 0xdead, "got key %#lx.\n", key);
+        ok(bytes_count == QUEUE_CHUNK_SIZE, "got count %u.\n", bytes_count);
+        ok(povl >= ov && povl < ov + QUEUE_DEPTH && !seen[povl - ov], "got overlapped %p.\n", povl);
+        if (povl >= ov && povl < ov + QUEUE_DEPTH) seen[povl - ov] = TRUE;
+    }
+    for (i = 0; i < QUEUE_DEPTH; i++) check_overlapped_read(buffer, i);
+    ret = GetQueuedCompletionStatus(port, &bytes_count, &key, &povl, 0);
+    ok(!ret && GetLastError() == WAIT_TIMEOUT, "got ret %d, error %u.\n", ret, GetLastError());
+
+    ret = DuplicateHandle(GetCurrentProcess(), hfile, GetCurrentProcess(), &hdup, 0, FALSE, DUPLICATE_SAME_ACCESS);
+    ok(ret, "DuplicateHandle failed, error %u.\n", GetLastError());
+    memset(&ov[0], 0, sizeof(ov[0]));
+    ov[0].hEvent = events[0];
+    ret = ReadFile(hdup, buffer, QUEUE_CHUNK_SIZE, NULL, &ov[0]);
+    ok(ret || GetLastError() == ERROR_IO_PENDING, "ReadFile failed, error %u.\n", GetLastError());
+    CloseHandle(hdup);
+    povl = NULL;
+    ret = GetQueuedCompletionStatus(port, &bytes_count, &key, &povl, 5000);
+    ok(ret, "GetQueuedCompletionStatus failed, error %u.\n", GetLastError());
+    ok(povl == &ov[0], "got overlapped %p.\n", povl);
+    ok(bytes_count == QUEUE_CHUNK_SIZE, "got count %u.\n", bytes_count);
+
+    /* cancelled requests either complete normally or are aborted, and still post a packet */
+    queue_overlapped_reads(hfile, buffer, ov, events);
+    ret = CancelIo(hfile);
+    ok(ret, "CancelIo failed, error %u.\n", GetLastError());
+    for (i = 0; i < QUEUE_DEPTH; i++)
+    {
+        ret = GetOverlappedResult(hfile, &ov[i], &bytes_count, TRUE);
+        if (ret)
+        {
+            ok(bytes_count == QUEUE_CHUNK_SIZE, "read %u: got count %u.\n", i, bytes_count);
+            check_overlapped_read(buffer, i);
+        }
+        else ok(GetLastError() == ERROR_OPERATION_ABORTED, "read %u: got error %u.\n", i, GetLastError());
+    }
+    for (i = 0; i < QUEUE_DEPTH; i++)
+    {
+        povl = NULL;
+        ret = GetQueuedCompletionStatus(port, &bytes_count, &key, &povl, 5000);
+        ok(povl != NULL, "GetQueuedCompletionStatus failed, error %u.\n", GetLastError());
+        if (!povl) break;
+    }
+
+    if (pCancelIoEx)
+    {
+        queue_overlapped_reads(hfile, buffer, ov, events);
+        ret = pCancelIoEx(hfile, &ov[QUEUE_DEPTH - 1]);
+        ok(ret || GetLastError() == ERROR_NOT_FOUND, "CancelIoEx failed, error %u.\n", GetLastError());
+        for (i = 0; i < QUEUE_DEPTH; i++)
+        {
+            ret = GetOverlappedResult(hfile, &ov[i], &bytes_count, TRUE);
+            if (i == QUEUE_DEPTH - 1 && !ret)
+                ok(GetLastError() == ERROR_OPERATION_ABORTED, "read %u: got error %u.\n", i, GetLastError());
+            else
+            {
+                ok(ret && bytes_count == QUEUE_CHUNK_SIZE, "read %u: ret %d, count %u, error %u.\n",
+                        i, ret, bytes_count, GetLastError());
+                check_overlapped_read(buffer, i);
+            }
+            GetQueuedCompletionStatus(port, &bytes_count, &key, &povl, 5000);
+        }
+
+        /* nothing is left to cancel */
+        SetLastError(0xdeadbeef);
+        ret = pCancelIoEx(hfile, &ov[0]);
+        ok(!ret && GetLastError() == ERROR_NOT_FOUND, "got ret %d, error %u.\n", ret, GetLastError());
+    }
+    else win_skip("CancelIoEx is not available.\n");
+
+    for (i = 0; i < QUEUE_DEPTH; i++) CloseHandle(events[i]);
+    CloseHandle(hfile);
+    CloseHandle(port);
+    HeapFree(GetProcessHeap(), 0, buffer);
+    ret = DeleteFileA(file_name);
+    ok(ret, "Unexpected error %u.\n", GetLastError());
+}
+
 START_TEST(file)
 {
     char temp_path[MAX_PATH];
@@ -5291,6 +5575,7 @@ START_TEST(file)
     test_OpenFileById();
     test_SetFileValidData();
     test_WriteFileGather();
+    test_scatter_gather_segments();
     test_file_access();
     test_GetFinalPathNameByHandleA();
     test_GetFinalPathNameByHandleW();
@@ -5298,4 +5583,5 @@ START_TEST(file)
     test_GetFileAttributesExW();
     test_post_completion();
     test_overlapped_read();
+    test_overlapped_requests();
 }
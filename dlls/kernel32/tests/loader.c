@@ -30,6 +30,7 @@
 #include "winbase.h"
 #include "winternl.h"
 #include "winnls.h"
+#include "tlhelp32.h"
 #include "wine/test.h"
 #include "delayloadhandler.h"
 
@@ -3807,6 +3808,64 @@ static void test_InMemoryOrderModuleList(void)
     ok(entry2 == mark2, "expected entry2 == mark2, got %p and %p\n", entry2, mark2);
 }
 
+/* check that the module list of the process still matches the loader list */
+#define check_module_snapshot() check_module_snapshot_(__LINE__)
+static void check_module_snapshot_( unsigned int line )
+{
+    PEB_LDR_DATA *ldr = NtCurrentTeb()->Peb->LdrData;
+    LIST_ENTRY *entry, *mark = &ldr->InLoadOrderModuleList;
+    unsigned int count = 0, snap_count = 0;
+    MODULEENTRY32 me;
+    HMODULE module;
+    HANDLE snap;
+    BOOL ret, found;
+
+    for (entry = mark->Flink; entry != mark; entry = entry->Flink) count++;
+
+    snap = CreateToolhelp32Snapshot( TH32CS_SNAPMODULE, 0 );
+    ok_(__FILE__, line)( snap != INVALID_HANDLE_VALUE, "CreateToolhelp32Snapshot failed %u\n", GetLastError() );
+    me.dwSize = sizeof(me);
+    for (ret = Module32First( snap, &me ); ret; ret = Module32Next( snap, &me ))
+    {
+        snap_count++;
+        found = GetModuleHandleExA( GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                                    GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                                    (const char *)me.modBaseAddr, &module );
+        ok_(__FILE__, line)( found && module == me.hModule, "%s is not loaded anymore\n", me.szModule );
+    }
+    CloseHandle( snap );
+    ok_(__FILE__, line)( snap_count == count, "got %u modules in the snapshot, expected %u\n",
+                         snap_count, count );
+}
+
+static void test_module_teardown(void)
+{
+    /* dlls pulling in a number of dependencies, that are unloaded together */
+    static const char * const dlls[] = { "shell32.dll", "oleaut32.dll", "msxml3.dll",
+                                         "wininet.dll", "setupapi.dll", "comdlg32.dll" };
+    HMODULE modules[ARRAY_SIZE(dlls)];
+    unsigned int i, pass;
+
+    check_module_snapshot();
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (i = 0; i < ARRAY_SIZE(dlls); i++)
+        {
+            modules[i] = LoadLibraryA( dlls[i] );
+            ok( modules[i] != NULL, "failed to load %s: %u\n", dlls[i], GetLastError() );
+        }
+        check_module_snapshot();
+
+        for (i = 0; i < ARRAY_SIZE(dlls); i++)
+        {
+            /* free them in both orders, so that the dependencies go away with the first or last one */
+            HMODULE module = modules[pass ? i : ARRAY_SIZE(dlls) - 1 - i];
+            if (module) FreeLibrary( module );
+        }
+        check_module_snapshot();
+    }
+}
+
 static void test_dll_file( const char *name )
 {
     HMODULE module = GetModuleHandleA( name );
@@ -3925,6 +3984,7 @@ START_TEST(loader)
     test_import_resolution();
     test_ExitProcess();
     test_InMemoryOrderModuleList();
+    test_module_teardown();
     test_dll_file( "ntdll.dll" );
     test_dll_file( "kernel32.dll" );
     test_dll_file( "advapi32.dll" );
@@ -3708,6 +3708,100 @@ static void test_multiple_instances(void)
     CloseHandle(server[0]);
 }
 
+/* byte mode pipes go through Unix sockets in Wine when WINEPIPESOCKETS is set for wineserver */
+static void test_flush_pending_data(void)
+{
+    HANDLE client, server, flush;
+    char data[] = "ab", buf[16];
+
+    create_overlapped_pipe(PIPE_TYPE_BYTE, &client, &server);
+
+    overlapped_write_sync(client, data, 2);
+    flush = test_flush_async(client, ERROR_SUCCESS);
+
+    /* the flush only completes once the reader has consumed everything */
+    overlapped_read_sync(server, buf, 1, 1, FALSE);
+    Sleep(50);
+    test_not_signaled(flush);
+
+    overlapped_read_sync(server, buf, sizeof(buf), 1, FALSE);
+    test_flush_done(flush);
+
+    /* nothing left to read */
+    test_flush_sync(client);
+
+    CloseHandle(client);
+    CloseHandle(server);
+}
+
+static void child_process_disconnect_pipe(HANDLE pipe)
+{
+    BOOL res;
+
+    res = DisconnectNamedPipe(pipe);
+    ok(res, "DisconnectNamedPipe failed: %u\n", GetLastError());
+}
+
+static void test_disconnect_other_process(void)
+{
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION info;
+    HANDLE client, server, inherited;
+    char **argv, buf[MAX_PATH], data[] = "abcd";
+    OVERLAPPED overlapped;
+    DWORD size;
+    BOOL res;
+
+    create_overlapped_pipe(PIPE_TYPE_BYTE, &client, &server);
+
+    /* make sure the server end is in use, and possibly cached, in this process */
+    overlapped_write_sync(client, data, 1);
+    overlapped_read_sync(server, buf, sizeof(buf), 1, FALSE);
+    overlapped_write_sync(server, data + 1, 1);
+    overlapped_read_sync(client, buf, sizeof(buf), 1, FALSE);
+
+    res = DuplicateHandle(GetCurrentProcess(), server, GetCurrentProcess(), &inherited, 0, TRUE, DUPLICATE_SAME_ACCESS);
+    ok(res, "DuplicateHandle failed: %u\n", GetLastError());
+
+    winetest_get_mainargs(&argv);
+    sprintf(buf, "\"%s\" pipe disconnectpipe %lx", argv[0], (UINT_PTR)inherited);
+    res = CreateProcessA(NULL, buf, NULL, NULL, TRUE, 0L, NULL, NULL, &si, &info);
+    ok(res, "CreateProcess failed: %u\n", GetLastError());
+    CloseHandle(info.hThread);
+    winetest_wait_child_process(info.hProcess);
+    CloseHandle(info.hProcess);
+    CloseHandle(inherited);
+
+    /* neither end may still reach the other one */
+    res = WriteFile(server, data, 1, &size, NULL);
+    ok(!res && GetLastError() == ERROR_PIPE_NOT_CONNECTED, "WriteFile returned %x(%u)\n", res, GetLastError());
+    res = WriteFile(client, data, 1, &size, NULL);
+    ok(!res, "WriteFile succeeded\n");
+    res = ReadFile(server, buf, sizeof(buf), &size, NULL);
+    ok(!res && GetLastError() == ERROR_PIPE_NOT_CONNECTED, "ReadFile returned %x(%u)\n", res, GetLastError());
+    CloseHandle(client);
+
+    /* the server handle of this process talks to the next client */
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    res = ConnectNamedPipe(server, &overlapped);
+    ok(!res && GetLastError() == ERROR_IO_PENDING, "ConnectNamedPipe returned %x(%u)\n", res, GetLastError());
+
+    client = CreateFileA(PIPENAME, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+    ok(client != INVALID_HANDLE_VALUE, "CreateFile failed: %u\n", GetLastError());
+    test_overlapped_result(server, &overlapped, 0, FALSE);
+
+    overlapped_write_sync(client, data, 2);
+    overlapped_read_sync(server, buf, sizeof(buf), 2, FALSE);
+    ok(!memcmp(buf, "ab", 2), "got %.2s\n", buf);
+    overlapped_write_sync(server, data + 2, 2);
+    overlapped_read_sync(client, buf, sizeof(buf), 2, FALSE);
+    ok(!memcmp(buf, "cd", 2), "got %.2s\n", buf);
+
+    CloseHandle(client);
+    CloseHandle(server);
+}
+
 START_TEST(pipe)
 {
     char **argv;
@@ -3735,6 +3829,13 @@ START_TEST(pipe)
             child_process_write_pipe((HANDLE)handle);
             return;
         }
+        if (!strcmp(argv[2], "disconnectpipe"))
+        {
+            UINT_PTR handle;
+            sscanf(argv[3], "%lx", &handle);
+            child_process_disconnect_pipe((HANDLE)handle);
+            return;
+        }
         if (!strcmp(argv[2], "checkpid"))
         {
             DWORD pid = GetProcessId(GetCurrentProcess());
@@ -3774,4 +3875,6 @@ START_TEST(pipe)
     test_namedpipe_process_id();
     test_namedpipe_session_id();
     test_multiple_instances();
+    test_flush_pending_data();
+    test_disconnect_other_process();
 }
@@ -112,6 +112,7 @@
 #include "wine/exception.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(file);
+WINE_DECLARE_DEBUG_CHANNEL(dircache);
 
 /* just in case... */
 #undef VFAT_IOCTL_READDIR_BOTH
@@ -2024,6 +2025,277 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
 }
 
 
+/* Case-insensitive lookups in directories of case-sensitive file systems need to
+ * scan the whole directory. The lowercase names of the most recently scanned
+ * directories are kept in a hash table, identified by device and inode, and
+ * validated against the directory modification time, so that looking up another
+ * name, or the same name again, only costs a stat() of the directory. */
+
+#define DIR_CACHE_MAX_DIRS  64
+
+struct dir_cache_name
+{
+    unsigned int hash;      /* hash of the lowercase name */
+    int          next;      /* next name in hash chain, -1 if none */
+    unsigned int order;     /* position of the file in the directory */
+    unsigned int name;      /* offset of the lowercase name in the names buffer */
+    unsigned int len;       /* length of the lowercase name */
+    unsigned int unix_name; /* offset of the Unix name in the Unix names buffer */
+    BOOL         is_short;  /* is it a generated short name? */
+};
+
+struct dir_cache
+{
+    struct list            entry;       /* entry in cached directories list */
+    dev_t                  dev;         /* device of the directory */
+    ino_t                  ino;         /* inode of the directory */
+    time_t                 mtime;       /* modification time when the directory was scanned */
+    unsigned int           count;       /* number of names */
+    unsigned int           hash_size;   /* size of the hash table, a power of two */
+    int                   *hash_table;  /* first name of each hash chain */
+    struct dir_cache_name *names;       /* names, in directory order */
+    WCHAR                 *lower;       /* buffer for the lowercase names */
+    char                  *unix_names;  /* buffer for the Unix names */
+};
+
+static struct list dir_caches = LIST_INIT( dir_caches );
+static unsigned int dir_cache_count;
+static unsigned int dir_cache_hits, dir_cache_misses, dir_cache_stale, dir_cache_uncached;
+
+static RTL_CRITICAL_SECTION dir_cache_section;
+static RTL_CRITICAL_SECTION_DEBUG dir_cache_critsect_debug =
+{
+    0, 0, &dir_cache_section,
+    { &dir_cache_critsect_debug.ProcessLocksList, &dir_cache_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": dir_cache_section") }
+};
+static RTL_CRITICAL_SECTION dir_cache_section = { &dir_cache_critsect_debug, -1, 0, 0, 0, 0 };
+
+static unsigned int hash_lower_name( const WCHAR *name, unsigned int len )
+{
+    unsigned int i, hash = 2166136261u;
+
+    for (i = 0; i < len; i++) hash = (hash ^ name[i]) * 16777619;
+    return hash;
+}
+
+static void free_dir_cache( struct dir_cache *cache )
+{
+    RtlFreeHeap( GetProcessHeap(), 0, cache->hash_table );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->names );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->lower );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->unix_names );
+    RtlFreeHeap( GetProcessHeap(), 0, cache );
+}
+
+/* grow one of the cache buffers to hold at least size elements */
+static BOOL grow_dir_cache_buffer( void **buffer, unsigned int *alloc, unsigned int size, unsigned int elem )
+{
+    unsigned int new_alloc = max( *alloc * 2, 256 );
+    void *new_buffer;
+
+    if (size <= *alloc) return TRUE;
+    while (new_alloc < size) new_alloc *= 2;
+    if (*buffer) new_buffer = RtlReAllocateHeap( GetProcessHeap(), 0, *buffer, new_alloc * elem );
+    else new_buffer = RtlAllocateHeap( GetProcessHeap(), 0, new_alloc * elem );
+    if (!new_buffer) return FALSE;
+    *buffer = new_buffer;
+    *alloc = new_alloc;
+    return TRUE;
+}
+
+/* add a name to a cache that is being built */
+static BOOL add_dir_cache_name( struct dir_cache *cache, const WCHAR *name, unsigned int len,
+                                unsigned int unix_name, unsigned int order, BOOL is_short,
+                                unsigned int *names_alloc, unsigned int *lower_alloc, unsigned int *lower_pos )
+{
+    struct dir_cache_name *entry;
+    unsigned int i;
+
+    if (!grow_dir_cache_buffer( (void **)&cache->names, names_alloc, cache->count + 1, sizeof(*cache->names) ) ||
+        !grow_dir_cache_buffer( (void **)&cache->lower, lower_alloc, *lower_pos + len, sizeof(WCHAR) ))
+        return FALSE;
+
+    entry = &cache->names[cache->count++];
+    for (i = 0; i < len; i++) cache->lower[*lower_pos + i] = tolowerW( name[i] );
+    entry->hash      = hash_lower_name( cache->lower + *lower_pos, len );
+    entry->next      = -1;
+    entry->order     = order;
+    entry->name      = *lower_pos;
+    entry->len       = len;
+    entry->unix_name = unix_name;
+    entry->is_short  = is_short;
+    *lower_pos += len;
+    return TRUE;
+}
+
+/* scan a directory to build its cache; unix_name is the directory name */
+static struct dir_cache *create_dir_cache( const char *unix_name, const struct stat *st )
+{
+    unsigned int names_alloc = 0, lower_alloc = 0, lower_pos = 0, unix_alloc = 0, unix_pos = 0;
+    unsigned int i, order = 0, unix_len;
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    struct dir_cache *cache;
+    UNICODE_STRING str;
+    BOOLEAN spaces;
+    struct dirent *de;
+    DIR *dir;
+    int ret;
+
+    if (!(cache = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache) ))) return NULL;
+    cache->dev   = st->st_dev;
+    cache->ino   = st->st_ino;
+    cache->mtime = st->st_mtime;
+
+    if (!(dir = opendir( unix_name ))) goto error;
+    str.Buffer = buffer;
+    str.MaximumLength = sizeof(buffer);
+    while ((de = readdir( dir )))
+    {
+        if (!strcmp( de->d_name, "." ) || !strcmp( de->d_name, ".." )) continue;
+
+        unix_len = strlen( de->d_name );
+        if (!grow_dir_cache_buffer( (void **)&cache->unix_names, &unix_alloc, unix_pos + unix_len + 1, 1 ))
+            break;
+        memcpy( cache->unix_names + unix_pos, de->d_name, unix_len + 1 );
+
+        ret = ntdll_umbstowcs( 0, de->d_name, unix_len, buffer, MAX_DIR_ENTRY_LEN );
+        if (ret < 0) ret = 0;
+        if (!add_dir_cache_name( cache, buffer, ret, unix_pos, order, FALSE,
+                                 &names_alloc, &lower_alloc, &lower_pos ))
+            break;
+
+        str.Length = ret * sizeof(WCHAR);
+        if (!RtlIsNameLegalDOS8Dot3( &str, NULL, &spaces ) || spaces)
+        {
+            WCHAR short_nameW[12];
+            ret = hash_short_file_name( &str, short_nameW );
+            if (!add_dir_cache_name( cache, short_nameW, ret, unix_pos, order, TRUE,
+                                     &names_alloc, &lower_alloc, &lower_pos ))
+                break;
+        }
+        unix_pos += unix_len + 1;
+        order++;
+    }
+    closedir( dir );
+    if (de) goto error;  /* out of memory */
+
+    for (cache->hash_size = 16; cache->hash_size < cache->count * 2; cache->hash_size *= 2) /* nothing */ ;
+    if (!(cache->hash_table = RtlAllocateHeap( GetProcessHeap(), 0,
+                                               cache->hash_size * sizeof(*cache->hash_table) )))
+        goto error;
+    for (i = 0; i < cache->hash_size; i++) cache->hash_table[i] = -1;
+    /* insert in reverse order so that chains are sorted in directory order */
+    for (i = cache->count; i > 0; i--)
+    {
+        struct dir_cache_name *entry = &cache->names[i - 1];
+        entry->next = cache->hash_table[entry->hash & (cache->hash_size - 1)];
+        cache->hash_table[entry->hash & (cache->hash_size - 1)] = i - 1;
+    }
+    return cache;
+
+error:
+    free_dir_cache( cache );
+    return NULL;
+}
+
+/***********************************************************************
+ *           lookup_dir_cache
+ *
+ * Look for a file in the cached contents of a directory.
+ * unix_name contains the directory name, followed by a '/' at pos - 1
+ * that has been replaced by a null char.
+ * Returns 1 if found (and appends the file name), 0 if not found, -1 if
+ * the directory can't be cached and must be scanned.
+ */
+static int lookup_dir_cache( char *unix_name, int pos, const WCHAR *name, int length,
+                             BOOLEAN is_name_8_dot_3 )
+{
+    WCHAR lower[MAX_DIR_ENTRY_LEN];
+    struct dir_cache *cache = NULL, *cur;
+    struct dir_cache_name *entry, *found = NULL;
+    unsigned int hash;
+    struct stat st;
+    int i, ret = 0;
+
+    if (stat( unix_name, &st ) == -1 || !S_ISDIR( st.st_mode )) return -1;
+
+    /* a directory modified very recently may be modified again without changing its
+     * time stamp, so don't trust its contents for now */
+    if (st.st_mtime >= time( NULL ) - 1)
+    {
+        dir_cache_uncached++;
+        return -1;
+    }
+
+    for (i = 0; i < length; i++) lower[i] = tolowerW( name[i] );
+    hash = hash_lower_name( lower, length );
+
+    RtlEnterCriticalSection( &dir_cache_section );
+
+    LIST_FOR_EACH_ENTRY( cur, &dir_caches, struct dir_cache, entry )
+    {
+        if (cur->dev != st.st_dev || cur->ino != st.st_ino) continue;
+        if (cur->mtime == st.st_mtime) cache = cur;
+        else
+        {
+            list_remove( &cur->entry );
+            free_dir_cache( cur );
+            dir_cache_count--;
+            dir_cache_stale++;
+        }
+        break;
+    }
+
+    if (cache)
+    {
+        dir_cache_hits++;
+        list_remove( &cache->entry );
+    }
+    else
+    {
+        dir_cache_misses++;
+        if (!(cache = create_dir_cache( unix_name, &st )))
+        {
+            RtlLeaveCriticalSection( &dir_cache_section );
+            return -1;
+        }
+        if (dir_cache_count == DIR_CACHE_MAX_DIRS)
+        {
+            struct dir_cache *old = LIST_ENTRY( list_tail( &dir_caches ), struct dir_cache, entry );
+            list_remove( &old->entry );
+            free_dir_cache( old );
+        }
+        else dir_cache_count++;
+        TRACE_(dircache)( "cached %u names for %s\n", cache->count, debugstr_a(unix_name) );
+    }
+    list_add_head( &dir_caches, &cache->entry );
+
+    for (i = cache->hash_table[hash & (cache->hash_size - 1)]; i != -1; i = entry->next)
+    {
+        entry = &cache->names[i];
+        if (entry->hash != hash || entry->len != length) continue;
+        if (entry->is_short && !is_name_8_dot_3) continue;
+        if (memcmp( cache->lower + entry->name, lower, length * sizeof(WCHAR) )) continue;
+        if (!found || entry->order < found->order) found = entry;
+    }
+    if (found)
+    {
+        unix_name[pos - 1] = '/';
+        strcpy( unix_name + pos, cache->unix_names + found->unix_name );
+        ret = 1;
+    }
+
+    if (TRACE_ON(dircache) && !((dir_cache_hits + dir_cache_misses) % 1024))
+        TRACE_(dircache)( "hits %u misses %u stale %u uncached %u, %u directories\n",
+                          dir_cache_hits, dir_cache_misses, dir_cache_stale, dir_cache_uncached,
+                          dir_cache_count );
+
+    RtlLeaveCriticalSection( &dir_cache_section );
+    return ret;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2134,6 +2406,12 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+    switch (lookup_dir_cache( unix_name, pos, name, length, is_name_8_dot_3 ))
+    {
+    case 1: goto success;
+    case 0: goto not_found;
+    }
+
     if (!(dir = opendir( unix_name )))
     {
         if (errno == ENOENT) return STATUS_OBJECT_PATH_NOT_FOUND;
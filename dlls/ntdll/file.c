@@ -42,6 +42,9 @@
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
 #ifdef HAVE_SYS_IOCTL_H
 #include <sys/ioctl.h>
 #endif
@@ -112,6 +115,14 @@
 WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
 WINE_DECLARE_DEBUG_CHANNEL(winediag);
 
+static LONG attr_cache_generation;  /* generation of the attributes name cache */
+
+/* invalidate the attributes name cache after a change to the file namespace */
+static inline void invalidate_attr_cache(void)
+{
+    interlocked_xchg_add( &attr_cache_generation, 1 );
+}
+
 mode_t FILE_umask = 0;
 
 #define SECSPERDAY         86400
@@ -219,6 +230,7 @@ static NTSTATUS FILE_CreateFile( PHANDLE handle, ACCESS_MASK access, POBJECT_ATT
     {
         created = TRUE;
         io->u.Status = STATUS_SUCCESS;
+        invalidate_attr_cache();
     }
 
     if (io->u.Status == STATUS_SUCCESS)
@@ -708,6 +720,7 @@ static NTSTATUS get_io_timeouts( HANDLE handle, enum server_fd_type type, ULONG
         }
         break;
     case FD_TYPE_SOCKET:
+    case FD_TYPE_PIPE:
     case FD_TYPE_CHAR:
         if (is_read) timeouts->interval = 0;  /* return as soon as we got something */
         break;
@@ -760,6 +773,7 @@ static NTSTATUS get_io_avail_mode( HANDLE handle, enum server_fd_type type, BOOL
         break;
     case FD_TYPE_MAILSLOT:
     case FD_TYPE_SOCKET:
+    case FD_TYPE_PIPE:
     case FD_TYPE_CHAR:
         *avail_mode = TRUE;
         break;
@@ -801,6 +815,33 @@ static NTSTATUS register_async_file_read( HANDLE handle, HANDLE event,
 }
 
 
+/* The server end of a byte mode pipe may get a new Unix socket for each connection,
+ * and the one in our fd cache is shut down when another process disconnects the pipe.
+ * Drop it from the cache, and check if the handle now has a different fd, in which
+ * case the I/O must be restarted. */
+static BOOL refresh_pipe_fd( HANDLE handle, int unix_handle, int needs_close )
+{
+    struct stat old_st, new_st;
+    int fd, new_fd, new_needs_close, err = errno;
+    BOOL ret = FALSE;
+
+    if (needs_close) return FALSE;  /* not cached, so it's the current one */
+    if (!fstat( unix_handle, &old_st ) && (fd = server_remove_fd_from_cache( handle )) != -1)
+    {
+        ret = TRUE;
+        if (!server_get_unix_fd( handle, 0, &new_fd, &new_needs_close, NULL, NULL ))
+        {
+            ret = fstat( new_fd, &new_st ) == -1 ||
+                  new_st.st_dev != old_st.st_dev || new_st.st_ino != old_st.st_ino;
+            if (new_needs_close) close( new_fd );
+        }
+        close( fd );
+    }
+    errno = err;
+    return ret;
+}
+
+
 /******************************************************************************
  *  NtReadFile					[NTDLL.@]
  *  ZwReadFile					[NTDLL.@]
@@ -863,7 +904,16 @@ NTSTATUS WINAPI NtReadFile(HANDLE hFile, HANDLE hEvent,
 
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
         {
-            /* async I/O doesn't make sense on regular files */
+            /* the APC has to be queued to the calling thread, so only without one */
+            if (async_read && !apc && length &&
+                uring_submit_rw( hFile, unix_handle, hEvent, io_status, cvalue, buffer,
+                                 length, offset->QuadPart, FALSE ) == STATUS_PENDING)
+            {
+                status = STATUS_PENDING;
+                goto err;
+            }
+
+            /* otherwise async I/O doesn't make sense on regular files */
             while ((result = virtual_locked_pread( unix_handle, buffer, length, offset->QuadPart )) == -1)
             {
                 if (errno != EINTR)
@@ -930,6 +980,15 @@ NTSTATUS WINAPI NtReadFile(HANDLE hFile, HANDLE hEvent,
                         goto done;
                     }
                     break;
+                case FD_TYPE_PIPE:
+                    if (!length)
+                    {
+                        status = STATUS_SUCCESS;
+                        goto done;
+                    }
+                    if (refresh_pipe_fd( hFile, unix_handle, needs_close ))
+                        return NtReadFile( hFile, hEvent, apc, apc_user, io_status, buffer, length, offset, key );
+                    /* fall through */
                 default:
                     status = STATUS_PIPE_BROKEN;
                     goto err;
@@ -1021,6 +1080,33 @@ err:
 }
 
 
+/* transfer data to or from the segments of a scatter/gather request, starting at
+ * byte pos of the first segment; offset is -1 to use the current file position */
+static ssize_t segment_io( int fd, FILE_SEGMENT_ELEMENT *segments, ULONG pos, ULONG length,
+                           LONGLONG offset, BOOL is_write )
+{
+#if defined(HAVE_SYS_UIO_H) && defined(HAVE_PREADV) && defined(HAVE_PWRITEV)
+    struct iovec iov[64];
+    int count;
+
+    for (count = 0; count < ARRAY_SIZE(iov) && length; count++, pos = 0)
+    {
+        iov[count].iov_base = (char *)segments[count].Buffer + pos;
+        iov[count].iov_len  = min( length, page_size - pos );
+        length -= iov[count].iov_len;
+    }
+    if (offset == -1) return is_write ? writev( fd, iov, count ) : readv( fd, iov, count );
+    return is_write ? pwritev( fd, iov, count, offset ) : preadv( fd, iov, count, offset );
+#else
+    char *ptr = (char *)segments->Buffer + pos;
+    size_t size = min( length, page_size - pos );
+
+    if (offset == -1) return is_write ? write( fd, ptr, size ) : read( fd, ptr, size );
+    return is_write ? pwrite( fd, ptr, size, offset ) : pread( fd, ptr, size, offset );
+#endif
+}
+
+
 /******************************************************************************
  *  NtReadFileScatter   [NTDLL.@]
  *  ZwReadFileScatter   [NTDLL.@]
@@ -1057,10 +1143,9 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
     while (length)
     {
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
-            result = pread( unix_handle, (char *)segments->Buffer + pos,
-                            min( length - pos, page_size - pos ), offset->QuadPart + total );
+            result = segment_io( unix_handle, segments, pos, length, offset->QuadPart + total, FALSE );
         else
-            result = read( unix_handle, (char *)segments->Buffer + pos, min( length - pos, page_size - pos ) );
+            result = segment_io( unix_handle, segments, pos, length, -1, FALSE );
 
         if (result == -1)
         {
@@ -1071,11 +1156,9 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         if (!result) break;
         total += result;
         length -= result;
-        if ((pos += result) == page_size)
-        {
-            pos = 0;
-            segments++;
-        }
+        pos += result;
+        segments += pos / page_size;
+        pos %= page_size;
     }
 
     if (total == 0) status = STATUS_END_OF_FILE;
@@ -1267,6 +1350,13 @@ NTSTATUS WINAPI NtWriteFile(HANDLE hFile, HANDLE hEvent,
                 status = STATUS_INVALID_PARAMETER;
                 goto done;
             }
+            else if (async_write && !apc && length &&
+                     uring_submit_rw( hFile, unix_handle, hEvent, io_status, cvalue, (void *)buffer,
+                                      length, off, TRUE ) == STATUS_PENDING)
+            {
+                status = STATUS_PENDING;
+                goto err;
+            }
 
             /* async I/O doesn't make sense on regular files */
             while ((result = pwrite( unix_handle, buffer, length, off )) == -1)
@@ -1319,6 +1409,9 @@ NTSTATUS WINAPI NtWriteFile(HANDLE hFile, HANDLE hEvent,
         else if (errno != EAGAIN)
         {
             if (errno == EINTR) continue;
+            if (errno == EPIPE && type == FD_TYPE_PIPE && !total &&
+                refresh_pipe_fd( hFile, unix_handle, needs_close ))
+                return NtWriteFile( hFile, hEvent, apc, apc_user, io_status, buffer, length, offset, key );
             if (!total)
             {
                 if (errno == EFAULT) status = STATUS_INVALID_USER_BUFFER;
@@ -1452,10 +1545,9 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
     while (length)
     {
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
-            result = pwrite( unix_handle, (char *)segments->Buffer + pos,
-                             page_size - pos, offset->QuadPart + total );
+            result = segment_io( unix_handle, segments, pos, length, offset->QuadPart + total, TRUE );
         else
-            result = write( unix_handle, (char *)segments->Buffer + pos, page_size - pos );
+            result = segment_io( unix_handle, segments, pos, length, -1, TRUE );
 
         if (result == -1)
         {
@@ -1475,11 +1567,9 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         }
         total += result;
         length -= result;
-        if ((pos += result) == page_size)
-        {
-            pos = 0;
-            segments++;
-        }
+        pos += result;
+        segments += pos / page_size;
+        pos %= page_size;
     }
 
     send_completion = cvalue != 0;
@@ -1691,6 +1781,17 @@ NTSTATUS WINAPI NtFsControlFile(HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc
         if (!status) status = DIR_unmount_device( handle );
         return status;
 
+    case FSCTL_PIPE_DISCONNECT:
+        status = server_ioctl_file( handle, event, apc, apc_context, io, code,
+                                    in_buffer, in_size, out_buffer, out_size );
+        if (!status)
+        {
+            /* the next connection may use a different Unix socket */
+            int fd = server_remove_fd_from_cache( handle );
+            if (fd != -1) close( fd );
+        }
+        return status;
+
     case FSCTL_PIPE_IMPERSONATE:
         FIXME("FSCTL_PIPE_IMPERSONATE: impersonating self\n");
         status = RtlImpersonateSelf( SecurityImpersonation );
@@ -2261,7 +2362,7 @@ NTSTATUS WINAPI NtQueryInformationFile( HANDLE hFile, PIO_STATUS_BLOCK io,
         0,                                             /* FileQuotaInformation */
         0,                                             /* FileReparsePointInformation */
         sizeof(FILE_NETWORK_OPEN_INFORMATION),         /* FileNetworkOpenInformation */
-        0,                                             /* FileAttributeTagInformation */
+        sizeof(FILE_ATTRIBUTE_TAG_INFORMATION),        /* FileAttributeTagInformation */
         0,                                             /* FileTrackingInformation */
         0,                                             /* FileIdBothDirectoryInformation */
         0,                                             /* FileIdFullDirectoryInformation */
@@ -2438,37 +2539,38 @@ NTSTATUS WINAPI NtQueryInformationFile( HANDLE hFile, PIO_STATUS_BLOCK io,
     case FileNetworkOpenInformation:
         {
             FILE_NETWORK_OPEN_INFORMATION *info = ptr;
-            ANSI_STRING unix_name;
 
-            if (!(io->u.Status = server_get_unix_name( hFile, &unix_name )))
+            if (fd_get_file_info( fd, &st, &attr ) == -1)
+                io->u.Status = FILE_GetNtStatus();
+            else if (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode))
+                io->u.Status = STATUS_INVALID_INFO_CLASS;
+            else
             {
-                ULONG attributes;
-                struct stat st;
-
-                if (get_file_info( unix_name.Buffer, &st, &attributes ) == -1)
-                    io->u.Status = FILE_GetNtStatus();
-                else if (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode))
-                    io->u.Status = STATUS_INVALID_INFO_CLASS;
-                else
-                {
-                    FILE_BASIC_INFORMATION basic;
-                    FILE_STANDARD_INFORMATION std;
-
-                    fill_file_info( &st, attributes, &basic, FileBasicInformation );
-                    fill_file_info( &st, attributes, &std, FileStandardInformation );
-
-                    info->CreationTime   = basic.CreationTime;
-                    info->LastAccessTime = basic.LastAccessTime;
-                    info->LastWriteTime  = basic.LastWriteTime;
-                    info->ChangeTime     = basic.ChangeTime;
-                    info->AllocationSize = std.AllocationSize;
-                    info->EndOfFile      = std.EndOfFile;
-                    info->FileAttributes = basic.FileAttributes;
-                }
-                RtlFreeAnsiString( &unix_name );
+                FILE_BASIC_INFORMATION basic;
+                FILE_STANDARD_INFORMATION std;
+
+                fill_file_info( &st, attr, &basic, FileBasicInformation );
+                fill_file_info( &st, attr, &std, FileStandardInformation );
+
+                info->CreationTime   = basic.CreationTime;
+                info->LastAccessTime = basic.LastAccessTime;
+                info->LastWriteTime  = basic.LastWriteTime;
+                info->ChangeTime     = basic.ChangeTime;
+                info->AllocationSize = std.AllocationSize;
+                info->EndOfFile      = std.EndOfFile;
+                info->FileAttributes = basic.FileAttributes;
             }
         }
         break;
+    case FileAttributeTagInformation:
+        if (fd_get_file_info( fd, &st, &attr ) == -1) io->u.Status = FILE_GetNtStatus();
+        else
+        {
+            FILE_ATTRIBUTE_TAG_INFORMATION *info = ptr;
+            info->FileAttributes = attr;
+            info->ReparseTag = 0;
+        }
+        break;
     case FileIdInformation:
         if (fd_get_file_info( fd, &st, &attr ) == -1) io->u.Status = FILE_GetNtStatus();
         else
@@ -2731,6 +2833,7 @@ NTSTATUS WINAPI NtSetInformationFile(HANDLE handle, PIO_STATUS_BLOCK io,
                 io->u.Status  = wine_server_call( req );
             }
             SERVER_END_REQ;
+            if (info->DoDeleteFile) invalidate_attr_cache();
         } else
             io->u.Status = STATUS_INVALID_PARAMETER_3;
         break;
@@ -2772,6 +2875,7 @@ NTSTATUS WINAPI NtSetInformationFile(HANDLE handle, PIO_STATUS_BLOCK io,
                 io->u.Status = wine_server_call( req );
             }
             SERVER_END_REQ;
+            invalidate_attr_cache();
 
             RtlFreeAnsiString( &unix_name );
         }
@@ -2815,6 +2919,7 @@ NTSTATUS WINAPI NtSetInformationFile(HANDLE handle, PIO_STATUS_BLOCK io,
                 io->u.Status  = wine_server_call( req );
             }
             SERVER_END_REQ;
+            invalidate_attr_cache();
 
             RtlFreeAnsiString( &unix_name );
         }
@@ -2831,45 +2936,179 @@ NTSTATUS WINAPI NtSetInformationFile(HANDLE handle, PIO_STATUS_BLOCK io,
 }
 
 
+/* Cache of the NT to Unix name translations done by NtQuery(Full)AttributesFile.
+ * Only the translation is cached, the file is still stat'ed on every call, so
+ * a stale entry is detected as soon as the Unix file disappears. The whole
+ * cache is invalidated whenever the process creates, renames or deletes a
+ * file, and entries expire after a short time to catch changes made by other
+ * processes that would make the same NT name resolve to a different file.
+ * The translation depends on the Wow64 redirection state of the thread, so
+ * it is part of the key. */
+
+#define ATTR_CACHE_SIZE      64    /* number of entries, must be a power of 2 */
+#define ATTR_CACHE_LIFETIME  2000  /* lifetime of an entry in milliseconds */
+
+struct attr_cache_entry
+{
+    ULONG  hash;         /* hash of the NT name */
+    ULONG  attributes;   /* object attributes used for the lookup */
+    BOOL   redirect;     /* Wow64 redirection state used for the lookup */
+    LONG   generation;   /* cache generation when the entry was created */
+    DWORD  time;         /* tick count when the entry was created */
+    WCHAR *nt_name;      /* NT name, NULL if the entry is unused */
+    USHORT nt_len;       /* length of the NT name in bytes */
+    USHORT unix_len;     /* length of the Unix name */
+    char  *unix_name;    /* corresponding Unix name */
+};
+
+static struct attr_cache_entry attr_cache[ATTR_CACHE_SIZE];
+
+static RTL_CRITICAL_SECTION attr_cache_section;
+static RTL_CRITICAL_SECTION_DEBUG attr_cache_critsect_debug =
+{
+    0, 0, &attr_cache_section,
+    { &attr_cache_critsect_debug.ProcessLocksList, &attr_cache_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": attr_cache_section") }
+};
+static RTL_CRITICAL_SECTION attr_cache_section = { &attr_cache_critsect_debug, -1, 0, 0, 0, 0 };
+
+static ULONG hash_attr_name( const UNICODE_STRING *name )
+{
+    ULONG i, hash = 0;
+
+    for (i = 0; i < name->Length / sizeof(WCHAR); i++) hash = hash * 31 + name->Buffer[i];
+    return hash;
+}
+
+static inline BOOL is_attr_cacheable( const OBJECT_ATTRIBUTES *attr )
+{
+    return !attr->RootDirectory && attr->ObjectName && attr->ObjectName->Length;
+}
+
+/* retrieve a copy of the cached Unix name for an NT name */
+static BOOL get_cached_unix_name( const OBJECT_ATTRIBUTES *attr, ULONG hash, ANSI_STRING *unix_name )
+{
+    struct attr_cache_entry *entry = &attr_cache[hash & (ATTR_CACHE_SIZE - 1)];
+    BOOL ret = FALSE;
+
+    RtlEnterCriticalSection( &attr_cache_section );
+    if (entry->nt_name && entry->hash == hash && entry->attributes == attr->Attributes &&
+        entry->redirect == !!ntdll_get_thread_data()->wow64_redir &&
+        entry->generation == attr_cache_generation &&
+        NtGetTickCount() - entry->time < ATTR_CACHE_LIFETIME &&
+        entry->nt_len == attr->ObjectName->Length &&
+        !memcmp( entry->nt_name, attr->ObjectName->Buffer, entry->nt_len ))
+    {
+        if ((unix_name->Buffer = RtlAllocateHeap( GetProcessHeap(), 0, entry->unix_len + 1 )))
+        {
+            memcpy( unix_name->Buffer, entry->unix_name, entry->unix_len + 1 );
+            unix_name->Length = entry->unix_len;
+            unix_name->MaximumLength = entry->unix_len + 1;
+            ret = TRUE;
+        }
+    }
+    RtlLeaveCriticalSection( &attr_cache_section );
+    return ret;
+}
+
+/* store the Unix name of an NT name in the cache */
+static void add_cached_unix_name( const OBJECT_ATTRIBUTES *attr, ULONG hash, LONG generation,
+                                  const ANSI_STRING *unix_name )
+{
+    struct attr_cache_entry *entry = &attr_cache[hash & (ATTR_CACHE_SIZE - 1)];
+    WCHAR *nt_name;
+    char *name;
+
+    if (!(nt_name = RtlAllocateHeap( GetProcessHeap(), 0, attr->ObjectName->Length ))) return;
+    if (!(name = RtlAllocateHeap( GetProcessHeap(), 0, unix_name->Length + 1 )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, nt_name );
+        return;
+    }
+    memcpy( nt_name, attr->ObjectName->Buffer, attr->ObjectName->Length );
+    memcpy( name, unix_name->Buffer, unix_name->Length );
+    name[unix_name->Length] = 0;
+
+    RtlEnterCriticalSection( &attr_cache_section );
+    RtlFreeHeap( GetProcessHeap(), 0, entry->nt_name );
+    RtlFreeHeap( GetProcessHeap(), 0, entry->unix_name );
+    entry->hash       = hash;
+    entry->attributes = attr->Attributes;
+    entry->redirect   = !!ntdll_get_thread_data()->wow64_redir;
+    entry->generation = generation;
+    entry->time       = NtGetTickCount();
+    entry->nt_name    = nt_name;
+    entry->nt_len     = attr->ObjectName->Length;
+    entry->unix_len   = unix_name->Length;
+    entry->unix_name  = name;
+    RtlLeaveCriticalSection( &attr_cache_section );
+}
+
+/* resolve an NT name and retrieve the information of the corresponding file */
+static NTSTATUS get_attr_file_info( const OBJECT_ATTRIBUTES *attr, struct stat *st, ULONG *attributes )
+{
+    ANSI_STRING unix_name;
+    NTSTATUS status;
+    ULONG hash = 0;
+    LONG generation = attr_cache_generation;
+    BOOL cacheable = is_attr_cacheable( attr );
+
+    if (cacheable)
+    {
+        hash = hash_attr_name( attr->ObjectName );
+        if (get_cached_unix_name( attr, hash, &unix_name ))
+        {
+            int ret = get_file_info( unix_name.Buffer, st, attributes );
+            RtlFreeAnsiString( &unix_name );
+            if (ret != -1) return STATUS_SUCCESS;
+            /* the file is gone, do a full lookup */
+        }
+    }
+
+    if ((status = nt_to_unix_file_name_attr( attr, &unix_name, FILE_OPEN )))
+    {
+        WARN( "%s not found (%x)\n", debugstr_us(attr->ObjectName), status );
+        return status;
+    }
+    if (get_file_info( unix_name.Buffer, st, attributes ) == -1) status = FILE_GetNtStatus();
+    else if (cacheable) add_cached_unix_name( attr, hash, generation, &unix_name );
+    RtlFreeAnsiString( &unix_name );
+    return status;
+}
+
+
 /******************************************************************************
  *              NtQueryFullAttributesFile   (NTDLL.@)
  */
 NTSTATUS WINAPI NtQueryFullAttributesFile( const OBJECT_ATTRIBUTES *attr,
                                            FILE_NETWORK_OPEN_INFORMATION *info )
 {
-    ANSI_STRING unix_name;
+    ULONG attributes;
+    struct stat st;
     NTSTATUS status;
 
-    if (!(status = nt_to_unix_file_name_attr( attr, &unix_name, FILE_OPEN )))
-    {
-        ULONG attributes;
-        struct stat st;
+    if ((status = get_attr_file_info( attr, &st, &attributes ))) return status;
 
-        if (get_file_info( unix_name.Buffer, &st, &attributes ) == -1)
-            status = FILE_GetNtStatus();
-        else if (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode))
-            status = STATUS_INVALID_INFO_CLASS;
-        else
-        {
-            FILE_BASIC_INFORMATION basic;
-            FILE_STANDARD_INFORMATION std;
+    if (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode))
+        status = STATUS_INVALID_INFO_CLASS;
+    else
+    {
+        FILE_BASIC_INFORMATION basic;
+        FILE_STANDARD_INFORMATION std;
 
-            fill_file_info( &st, attributes, &basic, FileBasicInformation );
-            fill_file_info( &st, attributes, &std, FileStandardInformation );
+        fill_file_info( &st, attributes, &basic, FileBasicInformation );
+        fill_file_info( &st, attributes, &std, FileStandardInformation );
 
-            info->CreationTime   = basic.CreationTime;
-            info->LastAccessTime = basic.LastAccessTime;
-            info->LastWriteTime  = basic.LastWriteTime;
-            info->ChangeTime     = basic.ChangeTime;
-            info->AllocationSize = std.AllocationSize;
-            info->EndOfFile      = std.EndOfFile;
-            info->FileAttributes = basic.FileAttributes;
-            if (DIR_is_hidden_file( attr->ObjectName ))
-                info->FileAttributes |= FILE_ATTRIBUTE_HIDDEN;
-        }
-        RtlFreeAnsiString( &unix_name );
+        info->CreationTime   = basic.CreationTime;
+        info->LastAccessTime = basic.LastAccessTime;
+        info->LastWriteTime  = basic.LastWriteTime;
+        info->ChangeTime     = basic.ChangeTime;
+        info->AllocationSize = std.AllocationSize;
+        info->EndOfFile      = std.EndOfFile;
+        info->FileAttributes = basic.FileAttributes;
+        if (DIR_is_hidden_file( attr->ObjectName ))
+            info->FileAttributes |= FILE_ATTRIBUTE_HIDDEN;
     }
-    else WARN("%s not found (%x)\n", debugstr_us(attr->ObjectName), status );
     return status;
 }
 
@@ -2880,27 +3119,20 @@ NTSTATUS WINAPI NtQueryFullAttributesFile( const OBJECT_ATTRIBUTES *attr,
  */
 NTSTATUS WINAPI NtQueryAttributesFile( const OBJECT_ATTRIBUTES *attr, FILE_BASIC_INFORMATION *info )
 {
-    ANSI_STRING unix_name;
+    ULONG attributes;
+    struct stat st;
     NTSTATUS status;
 
-    if (!(status = nt_to_unix_file_name_attr( attr, &unix_name, FILE_OPEN )))
-    {
-        ULONG attributes;
-        struct stat st;
+    if ((status = get_attr_file_info( attr, &st, &attributes ))) return status;
 
-        if (get_file_info( unix_name.Buffer, &st, &attributes ) == -1)
-            status = FILE_GetNtStatus();
-        else if (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode))
-            status = STATUS_INVALID_INFO_CLASS;
-        else
-        {
-            status = fill_file_info( &st, attributes, info, FileBasicInformation );
-            if (DIR_is_hidden_file( attr->ObjectName ))
-                info->FileAttributes |= FILE_ATTRIBUTE_HIDDEN;
-        }
-        RtlFreeAnsiString( &unix_name );
+    if (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode))
+        status = STATUS_INVALID_INFO_CLASS;
+    else
+    {
+        status = fill_file_info( &st, attributes, info, FileBasicInformation );
+        if (DIR_is_hidden_file( attr->ObjectName ))
+            info->FileAttributes |= FILE_ATTRIBUTE_HIDDEN;
     }
-    else WARN("%s not found (%x)\n", debugstr_us(attr->ObjectName), status );
     return status;
 }
 
@@ -3528,6 +3760,7 @@ NTSTATUS WINAPI NtDeleteFile( POBJECT_ATTRIBUTES ObjectAttributes )
     IO_STATUS_BLOCK io;
 
     TRACE("%p\n", ObjectAttributes);
+    invalidate_attr_cache();
     status = NtCreateFile( &hFile, GENERIC_READ | GENERIC_WRITE | DELETE,
                            ObjectAttributes, &io, NULL, 0,
                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 
@@ -3554,6 +3787,9 @@ NTSTATUS WINAPI NtCancelIoFileEx( HANDLE hFile, PIO_STATUS_BLOCK iosb, PIO_STATU
     }
     SERVER_END_REQ;
 
+    if (uring_cancel( hFile, iosb, FALSE ) && io_status->u.Status == STATUS_NOT_FOUND)
+        io_status->u.Status = STATUS_SUCCESS;
+
     return io_status->u.Status;
 }
 
@@ -3575,6 +3811,8 @@ NTSTATUS WINAPI NtCancelIoFile( HANDLE hFile, PIO_STATUS_BLOCK io_status )
     }
     SERVER_END_REQ;
 
+    uring_cancel( hFile, NULL, TRUE );
+
     return io_status->u.Status;
 }
 
@@ -41,6 +41,7 @@
 #include "winternl.h"
 #include "ntdll_misc.h"
 #include "wine/list.h"
+#include "wine/rbtree.h"
 #include "wine/debug.h"
 #include "wine/server.h"
 
@@ -164,6 +165,7 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    struct lfh_heap *lfh;           /* Low fragmentation heap front end */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -181,6 +183,8 @@ typedef struct tagHEAP
 static HEAP *processHeap;  /* main process heap */
 
 static BOOL HEAP_IsRealArena( HEAP *heapPtr, DWORD flags, LPCVOID block, BOOL quiet );
+static void *allocate_block( HEAP *heapPtr, ULONG flags, SIZE_T size );
+static BOOLEAN free_block( HEAP *heapPtr, ULONG flags, void *ptr );
 
 /* mark a block of memory as free for debugging purposes */
 static inline void mark_block_free( void *ptr, SIZE_T size, DWORD flags )
@@ -925,6 +929,7 @@ static SUBHEAP *HEAP_CreateSubHeap( HEAP *heap, LPVOID address, DWORD flags,
         heap->flags         = flags;
         heap->magic         = HEAP_MAGIC;
         heap->grow_size     = max( HEAP_DEF_SIZE, totalSize );
+        heap->lfh           = NULL;
         list_init( &heap->subheap_list );
         list_init( &heap->large_list );
 
@@ -1530,6 +1535,601 @@ void heap_set_debug_flags( HANDLE handle )
 }
 
 
+/* Low fragmentation heap
+ *
+ * When enabled with RtlSetHeapInformation, small blocks are allocated from
+ * groups of same-size blocks carved out of regular heap blocks. Each thread
+ * owns its groups, so allocations and frees done by the owner thread never
+ * take the heap lock. Blocks freed by other threads are pushed on a lock-free
+ * list in their group, and are collected by the owner when it runs out of
+ * free blocks. The groups of an exiting thread are left to the heap, and
+ * adopted by the next thread needing a group of the same size class.
+ * Pointers passed to the heap functions are looked up in a tree of the group
+ * address ranges, so that nothing is read from a block until it is known to
+ * belong to a group.
+ */
+
+typedef struct
+{
+    WORD   unused1;
+    WORD   data_size;               /* Size of the user data */
+    DWORD  magic : 24;              /* Magic number; must be at the same place as in ARENA_INUSE */
+    DWORD  unused2 : 8;
+} ARENA_LFH;
+
+C_ASSERT( sizeof(ARENA_LFH) == sizeof(ARENA_INUSE) );
+
+#define ARENA_LFH_MAGIC        0x48464c
+#define ARENA_LFH_FREE_MAGIC   0x46464c
+#define LFH_GROUP_MAGIC        ((DWORD)('L' | ('F'<<8) | ('H'<<16) | ('G'<<24)))
+
+/* size classes are ALIGNMENT apart up to LFH_SMALL_BLOCK_SIZE, then 8 per power of two */
+#define LFH_SMALL_BLOCK_SIZE   0x100
+#define LFH_MAX_BLOCK_SIZE     0x4000
+#define LFH_NB_SMALL_CLASSES   (LFH_SMALL_BLOCK_SIZE / ALIGNMENT)
+#define LFH_NB_CLASSES         (LFH_NB_SMALL_CLASSES + 6 * 8)
+#define LFH_MIN_BLOCK_SIZE     ((sizeof(ARENA_LFH) + sizeof(void *) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+#define LFH_MAX_DATA_SIZE      (LFH_MAX_BLOCK_SIZE - sizeof(ARENA_LFH))
+
+#define LFH_GROUP_MIN_SIZE     0x1000
+#define LFH_GROUP_MAX_SIZE     0x10000
+#define LFH_GROUP_BLOCKS       64  /* preferred number of blocks in a group */
+#define LFH_GROUP_MIN_BLOCKS   8
+
+struct lfh_cache;
+
+struct lfh_group
+{
+    DWORD              magic;        /* LFH_GROUP_MAGIC */
+    unsigned int       class;        /* size class of the blocks */
+    HEAP              *heap;         /* heap the group belongs to */
+    struct lfh_cache  *owner;        /* thread cache owning the group, NULL if orphaned */
+    struct list        entry;        /* entry in the owner bin or in the heap orphans list */
+    struct wine_rb_entry range_entry; /* entry in the heap tree of group ranges */
+    SIZE_T             block_size;   /* size of the blocks, including the arena */
+    unsigned int       used;         /* number of blocks not in the local free list */
+    char              *unused;       /* first block never allocated yet */
+    char              *end;          /* end of the blocks */
+    void              *free_list;    /* blocks freed by the owner thread */
+    void              *remote_list;  /* blocks freed by other threads */
+};
+
+#define LFH_GROUP_HEADER_SIZE  ((sizeof(struct lfh_group) + sizeof(ARENA_LFH) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+
+struct lfh_bin
+{
+    struct lfh_group  *active;       /* group used for allocations */
+    struct list        groups;       /* groups owned by the thread */
+};
+
+/* per-thread state of a low fragmentation heap */
+struct lfh_cache
+{
+    struct lfh_cache  *next;         /* next cache of the same thread */
+    struct list        entry;        /* entry in the global list of caches */
+    LONG               id;           /* id of the low fragmentation heap, 0 once destroyed */
+    DWORD              tid;          /* id of the owner thread */
+    TEB               *teb;          /* TEB of the owner thread */
+    struct lfh_bin     bins[LFH_NB_CLASSES];
+};
+
+struct lfh_heap
+{
+    struct list        entry;        /* entry in the global list of low fragmentation heaps */
+    LONG               id;           /* unique id, used to find the thread caches */
+    HEAP              *heap;         /* heap the front end belongs to */
+    struct list        orphans[LFH_NB_CLASSES];  /* groups left behind by exited threads */
+    RTL_SRWLOCK        groups_lock;  /* lock for the groups tree */
+    struct wine_rb_tree groups;      /* all the groups of the heap, by address range */
+};
+
+static struct list lfh_heaps = LIST_INIT( lfh_heaps );
+static LONG lfh_last_id;
+static struct list lfh_caches = LIST_INIT( lfh_caches );
+static unsigned int lfh_nb_caches;
+static unsigned int lfh_reap_threshold = 64;  /* number of caches that triggers a search for dead threads */
+
+static RTL_CRITICAL_SECTION lfh_section;
+static RTL_CRITICAL_SECTION_DEBUG lfh_critsect_debug =
+{
+    0, 0, &lfh_section,
+    { &lfh_critsect_debug.ProcessLocksList, &lfh_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": lfh_section") }
+};
+static RTL_CRITICAL_SECTION lfh_section = { &lfh_critsect_debug, -1, 0, 0, 0, 0 };
+
+/* get the size class of a block; size is the size of the whole block including the arena */
+static inline unsigned int lfh_get_class( SIZE_T block_size )
+{
+    unsigned int bit;
+
+    if (block_size <= LFH_SMALL_BLOCK_SIZE) return (block_size - 1) / ALIGNMENT;
+    bit = RtlFindMostSignificantBit( block_size - 1 );
+    return LFH_NB_SMALL_CLASSES + (bit - 8) * 8 + (((block_size - 1) >> (bit - 3)) & 7);
+}
+
+/* get the size of the blocks of a size class */
+static inline SIZE_T lfh_get_class_size( unsigned int class )
+{
+    if (class < LFH_NB_SMALL_CLASSES) return (class + 1) * ALIGNMENT;
+    class -= LFH_NB_SMALL_CLASSES;
+    return (SIZE_T)(9 + class % 8) << (class / 8 + 5);
+}
+
+/* compare an address with the range of a group */
+static int lfh_group_compare( const void *key, const struct wine_rb_entry *entry )
+{
+    const struct lfh_group *group = WINE_RB_ENTRY_VALUE( entry, const struct lfh_group, range_entry );
+    const char *ptr = key;
+
+    if (ptr < (const char *)group) return -1;
+    if (ptr >= group->end) return 1;
+    return 0;
+}
+
+/* find the low fragmentation heap group of a block, if any; the block itself isn't accessed */
+static struct lfh_group *lfh_get_group( const HEAP *heap, const void *ptr )
+{
+    struct lfh_heap *lfh = heap->lfh;
+    struct wine_rb_entry *entry;
+
+    if (!lfh) return NULL;
+    RtlAcquireSRWLockShared( &lfh->groups_lock );
+    entry = wine_rb_get( &lfh->groups, ptr );
+    RtlReleaseSRWLockShared( &lfh->groups_lock );
+    return entry ? WINE_RB_ENTRY_VALUE( entry, struct lfh_group, range_entry ) : NULL;
+}
+
+/* check that a block is a valid in-use block of a low fragmentation heap */
+static BOOL lfh_validate_block( const HEAP *heap, const struct lfh_group *group, const void *ptr )
+{
+    const ARENA_LFH *arena = (const ARENA_LFH *)ptr - 1;
+    const char *first = (const char *)group + LFH_GROUP_HEADER_SIZE;
+
+    if (group->magic != LFH_GROUP_MAGIC || group->heap != heap)
+        WARN( "Heap %p: invalid group %p for block %p\n", heap, group, ptr );
+    else if ((const char *)ptr < first || (const char *)ptr >= group->unused ||
+             ((const char *)ptr - first) % group->block_size)
+        WARN( "Heap %p: invalid block %p in group %p\n", heap, ptr, group );
+    else if (arena->magic == ARENA_LFH_FREE_MAGIC)
+        WARN( "Heap %p: block %p used after free\n", heap, ptr );
+    else
+        return TRUE;
+    return FALSE;
+}
+
+/* find the cache of the current thread for a low fragmentation heap */
+static inline struct lfh_cache *lfh_get_cache( const struct lfh_heap *lfh )
+{
+    struct lfh_cache *cache;
+
+    for (cache = ntdll_get_thread_data()->heap_cache; cache; cache = cache->next)
+        if (cache->id == lfh->id) return cache;
+    return NULL;
+}
+
+static void lfh_prune_caches(void);
+
+/* create the cache of the current thread for a low fragmentation heap */
+static struct lfh_cache *lfh_create_cache( const struct lfh_heap *lfh )
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct lfh_cache *cache;
+    unsigned int i;
+
+    /* caches are always allocated from the process heap, as they may outlive their heap */
+    if (!(cache = allocate_block( processHeap, processHeap->flags & ~HEAP_GENERATE_EXCEPTIONS,
+                                  sizeof(*cache) )))
+        return NULL;
+
+    cache->id = lfh->id;
+    cache->tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    cache->teb = NtCurrentTeb();
+    for (i = 0; i < LFH_NB_CLASSES; i++)
+    {
+        cache->bins[i].active = NULL;
+        list_init( &cache->bins[i].groups );
+    }
+
+    RtlEnterCriticalSection( &lfh_section );
+    lfh_prune_caches();
+    cache->next = thread_data->heap_cache;
+    thread_data->heap_cache = cache;
+    list_add_tail( &lfh_caches, &cache->entry );
+    lfh_nb_caches++;
+    RtlLeaveCriticalSection( &lfh_section );
+    return cache;
+}
+
+/* check if a group has blocks available */
+static inline BOOL lfh_group_has_free_blocks( const struct lfh_group *group )
+{
+    return group->free_list || group->remote_list || group->unused < group->end;
+}
+
+/* get a new group for the current thread, either adopted or allocated from the heap arenas */
+static struct lfh_group *lfh_new_group( HEAP *heap, struct lfh_cache *cache, unsigned int class )
+{
+    struct lfh_heap *lfh = heap->lfh;
+    struct lfh_group *group;
+    SIZE_T block_size = lfh_get_class_size( class ), size;
+
+    RtlEnterCriticalSection( &heap->critSection );
+
+    LIST_FOR_EACH_ENTRY( group, &lfh->orphans[class], struct lfh_group, entry )
+    {
+        if (!lfh_group_has_free_blocks( group )) continue;
+        list_remove( &group->entry );
+        goto done;
+    }
+
+    size = min( max( block_size * LFH_GROUP_BLOCKS, LFH_GROUP_MIN_SIZE ), LFH_GROUP_MAX_SIZE );
+    size = max( size, LFH_GROUP_HEADER_SIZE + block_size * LFH_GROUP_MIN_BLOCKS );
+    if ((group = allocate_block( heap, heap->flags & ~HEAP_GENERATE_EXCEPTIONS, size )))
+    {
+        group->magic       = LFH_GROUP_MAGIC;
+        group->class       = class;
+        group->heap        = heap;
+        group->block_size  = block_size;
+        group->used        = 0;
+        group->unused      = (char *)group + LFH_GROUP_HEADER_SIZE;
+        group->end         = group->unused + (size - LFH_GROUP_HEADER_SIZE) / block_size * block_size;
+        group->free_list   = NULL;
+        group->remote_list = NULL;
+        RtlAcquireSRWLockExclusive( &lfh->groups_lock );
+        wine_rb_put( &lfh->groups, group, &group->range_entry );
+        RtlReleaseSRWLockExclusive( &lfh->groups_lock );
+    }
+
+done:
+    if (group) group->owner = cache;
+    RtlLeaveCriticalSection( &heap->critSection );
+    return group;
+}
+
+/* give a group back to the heap arenas once all its blocks are free */
+static void lfh_release_group( HEAP *heap, struct lfh_group *group )
+{
+    struct lfh_heap *lfh = heap->lfh;
+
+    RtlAcquireSRWLockExclusive( &lfh->groups_lock );
+    wine_rb_remove( &lfh->groups, &group->range_entry );
+    RtlReleaseSRWLockExclusive( &lfh->groups_lock );
+    list_remove( &group->entry );
+    group->magic = 0;
+    free_block( heap, heap->flags, group );
+}
+
+/* allocate a block from a group owned by the current thread */
+static inline void *lfh_group_alloc( struct lfh_group *group )
+{
+    void *ptr;
+
+    if (!group->free_list && group->remote_list)
+    {
+        /* collect the blocks freed by other threads */
+        group->free_list = interlocked_xchg_ptr( &group->remote_list, NULL );
+        for (ptr = group->free_list; ptr; ptr = *(void **)ptr) group->used--;
+    }
+
+    if ((ptr = group->free_list)) group->free_list = *(void **)ptr;
+    else if (group->unused < group->end)
+    {
+        ptr = group->unused;
+        group->unused += group->block_size;
+    }
+    else return NULL;
+
+    group->used++;
+    return ptr;
+}
+
+/***********************************************************************
+ *           lfh_allocate
+ *
+ * Allocate a block from the low fragmentation heap. Returns NULL if the
+ * allocation should be done from the heap arenas instead.
+ */
+static void *lfh_allocate( HEAP *heap, ULONG flags, SIZE_T size )
+{
+    struct lfh_cache *cache;
+    struct lfh_bin *bin;
+    struct lfh_group *group, *next;
+    ARENA_LFH *arena;
+    SIZE_T block_size;
+    unsigned int class;
+    void *ptr;
+
+    if (size > LFH_MAX_DATA_SIZE) return NULL;
+    block_size = max( (size + sizeof(ARENA_LFH) + ALIGNMENT - 1) & ~(ALIGNMENT - 1), LFH_MIN_BLOCK_SIZE );
+    class = lfh_get_class( block_size );
+
+    if (!(cache = lfh_get_cache( heap->lfh )) && !(cache = lfh_create_cache( heap->lfh ))) return NULL;
+    bin = &cache->bins[class];
+
+    if (!(group = bin->active) || !(ptr = lfh_group_alloc( group )))
+    {
+        /* the groups with free blocks are kept at the head of the list */
+        group = NULL;
+        LIST_FOR_EACH_ENTRY( next, &bin->groups, struct lfh_group, entry )
+        {
+            if (next == bin->active || !lfh_group_has_free_blocks( next )) continue;
+            group = next;
+            break;
+        }
+        if (!group)
+        {
+            if (!(group = lfh_new_group( heap, cache, class ))) return NULL;
+            list_add_head( &bin->groups, &group->entry );
+        }
+        bin->active = group;
+        if (!(ptr = lfh_group_alloc( group ))) return NULL;
+    }
+
+    arena = (ARENA_LFH *)ptr - 1;
+    arena->magic = ARENA_LFH_MAGIC;
+    arena->data_size = size;
+    if (flags & HEAP_ZERO_MEMORY) memset( ptr, 0, size );
+    return ptr;
+}
+
+/***********************************************************************
+ *           lfh_free
+ *
+ * Free a block of the low fragmentation heap.
+ */
+static BOOLEAN lfh_free( HEAP *heap, struct lfh_group *group, void *ptr )
+{
+    ARENA_LFH *arena = (ARENA_LFH *)ptr - 1;
+    struct lfh_cache *cache;
+    struct lfh_bin *bin;
+    void *next;
+
+    if (!lfh_validate_block( heap, group, ptr ))
+    {
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+        TRACE("(%p,%p): returning FALSE\n", heap, ptr );
+        return FALSE;
+    }
+    arena->magic = ARENA_LFH_FREE_MAGIC;
+
+    if ((cache = lfh_get_cache( heap->lfh )) && group->owner == cache)
+    {
+        bin = &cache->bins[group->class];
+        if (group != bin->active && !lfh_group_has_free_blocks( group ))
+        {
+            list_remove( &group->entry );
+            list_add_head( &bin->groups, &group->entry );
+        }
+        *(void **)ptr = group->free_list;
+        group->free_list = ptr;
+        if (!--group->used && group != bin->active) lfh_release_group( heap, group );
+    }
+    else
+    {
+        do
+        {
+            next = group->remote_list;
+            *(void **)ptr = next;
+        } while (interlocked_cmpxchg_ptr( &group->remote_list, ptr, next ) != next);
+    }
+
+    TRACE("(%p,%p): returning TRUE\n", heap, ptr );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           lfh_reallocate
+ *
+ * Resize a block of the low fragmentation heap.
+ */
+static void *lfh_reallocate( HEAP *heap, ULONG flags, struct lfh_group *group, void *ptr, SIZE_T size )
+{
+    ARENA_LFH *arena = (ARENA_LFH *)ptr - 1;
+    SIZE_T old_size, block_size;
+    void *ret;
+
+    if (!lfh_validate_block( heap, group, ptr ))
+    {
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+        return NULL;
+    }
+
+    /* keep the block if it has the right size class, or if it can't be moved */
+    old_size = arena->data_size;
+    block_size = max( (size + sizeof(ARENA_LFH) + ALIGNMENT - 1) & ~(ALIGNMENT - 1), LFH_MIN_BLOCK_SIZE );
+    if (size <= LFH_MAX_DATA_SIZE && block_size <= group->block_size &&
+        ((flags & HEAP_REALLOC_IN_PLACE_ONLY) || lfh_get_class( block_size ) == group->class))
+    {
+        if (size > old_size && (flags & HEAP_ZERO_MEMORY))
+            memset( (char *)ptr + old_size, 0, size - old_size );
+        arena->data_size = size;
+        ret = ptr;
+    }
+    else if (!(flags & HEAP_REALLOC_IN_PLACE_ONLY) &&
+             (ret = RtlAllocateHeap( heap, flags & (HEAP_GENERATE_EXCEPTIONS | HEAP_ZERO_MEMORY), size )))
+    {
+        memcpy( ret, ptr, min( old_size, size ));
+        lfh_free( heap, group, ptr );
+    }
+    else
+    {
+        if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_NO_MEMORY );
+        ret = NULL;
+    }
+
+    TRACE("(%p,%08x,%p,%08lx): returning %p\n", heap, flags, ptr, size, ret );
+    return ret;
+}
+
+/***********************************************************************
+ *           lfh_enable
+ *
+ * Enable the low fragmentation front end of a heap.
+ */
+static NTSTATUS lfh_enable( HEAP *heap )
+{
+    struct lfh_heap *lfh;
+    unsigned int i;
+
+    if (heap->lfh) return STATUS_SUCCESS;
+    if (RUNNING_ON_VALGRIND) return STATUS_UNSUCCESSFUL;
+    if (heap->flags & (HEAP_NO_SERIALIZE | HEAP_SHARED | HEAP_PAGE_ALLOCS | HEAP_VALIDATE |
+                       HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED))
+        return STATUS_UNSUCCESSFUL;
+
+    if (!(lfh = allocate_block( heap, heap->flags & ~HEAP_GENERATE_EXCEPTIONS, sizeof(*lfh) )))
+        return STATUS_NO_MEMORY;
+    lfh->heap = heap;
+    for (i = 0; i < LFH_NB_CLASSES; i++) list_init( &lfh->orphans[i] );
+    RtlInitializeSRWLock( &lfh->groups_lock );
+    wine_rb_init( &lfh->groups, lfh_group_compare );
+
+    /* the heap must be in the global list before any thread cache can be created */
+    RtlEnterCriticalSection( &lfh_section );
+    if (!heap->lfh)
+    {
+        lfh->id = ++lfh_last_id;
+        list_add_tail( &lfh_heaps, &lfh->entry );
+        heap->lfh = lfh;
+        lfh = NULL;
+    }
+    RtlLeaveCriticalSection( &lfh_section );
+
+    if (lfh) free_block( heap, heap->flags, lfh );
+    TRACE( "enabled low fragmentation heap for %p\n", heap );
+    return STATUS_SUCCESS;
+}
+
+/* hand the groups of an exiting thread over to their heap */
+static void lfh_orphan_groups( struct lfh_heap *lfh, struct lfh_cache *cache )
+{
+    HEAP *heap = lfh->heap;
+    struct lfh_group *group, *next;
+    unsigned int i;
+
+    RtlEnterCriticalSection( &heap->critSection );
+    for (i = 0; i < LFH_NB_CLASSES; i++)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( group, next, &cache->bins[i].groups, struct lfh_group, entry )
+        {
+            if (!group->used)
+            {
+                lfh_release_group( heap, group );
+                continue;
+            }
+            list_remove( &group->entry );
+            group->owner = NULL;
+            list_add_tail( &lfh->orphans[i], &group->entry );
+        }
+    }
+    RtlLeaveCriticalSection( &heap->critSection );
+}
+
+/* free a thread cache, handing its groups over to the heap if it still exists;
+ * the cache must already be removed from its thread list; lfh_section must be held */
+static void lfh_free_cache( struct lfh_cache *cache )
+{
+    struct lfh_heap *lfh;
+
+    if (cache->id)
+    {
+        LIST_FOR_EACH_ENTRY( lfh, &lfh_heaps, struct lfh_heap, entry )
+        {
+            if (lfh->id != cache->id) continue;
+            lfh_orphan_groups( lfh, cache );
+            break;
+        }
+    }
+    list_remove( &cache->entry );
+    lfh_nb_caches--;
+    free_block( processHeap, processHeap->flags, cache );
+}
+
+/* free the caches of the current thread whose heap has been destroyed; lfh_section must be held */
+static void lfh_free_dead_caches(void)
+{
+    struct lfh_cache *cache, **prev = &ntdll_get_thread_data()->heap_cache;
+
+    while ((cache = *prev))
+    {
+        if (cache->id)
+        {
+            prev = &cache->next;
+            continue;
+        }
+        *prev = cache->next;
+        lfh_free_cache( cache );
+    }
+}
+
+/* check if the owner thread of a cache has exited */
+static BOOL lfh_cache_thread_exited( const struct lfh_cache *cache )
+{
+    THREAD_BASIC_INFORMATION info;
+    OBJECT_ATTRIBUTES attr;
+    CLIENT_ID cid;
+    HANDLE handle;
+    NTSTATUS status;
+
+    cid.UniqueProcess = 0;
+    cid.UniqueThread = ULongToHandle( cache->tid );
+    InitializeObjectAttributes( &attr, NULL, 0, NULL, NULL );
+    if (NtOpenThread( &handle, THREAD_QUERY_INFORMATION, &attr, &cid )) return TRUE;
+    status = NtQueryInformationThread( handle, ThreadBasicInformation, &info, sizeof(info), NULL );
+    NtClose( handle );
+    if (status) return FALSE;
+    /* the thread id may have been reused by another thread */
+    return info.ExitStatus != STATUS_PENDING || info.TebBaseAddress != cache->teb ||
+           info.ClientId.UniqueProcess != NtCurrentTeb()->ClientId.UniqueProcess;
+}
+
+/* Free the caches of destroyed heaps in the current thread, and the caches of threads
+ * that exited without going through LdrShutdownThread, e.g. with TerminateThread.
+ * Looking for dead threads is only done once the number of caches has doubled,
+ * to keep the cost of the server calls amortized. lfh_section must be held. */
+static void lfh_prune_caches(void)
+{
+    DWORD tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    struct lfh_cache *cache, *next;
+
+    lfh_free_dead_caches();
+    if (lfh_nb_caches < lfh_reap_threshold) return;
+
+    LIST_FOR_EACH_ENTRY_SAFE( cache, next, &lfh_caches, struct lfh_cache, entry )
+    {
+        if (cache->tid == tid || !lfh_cache_thread_exited( cache )) continue;
+        /* the TEB of the dead thread is gone, so it's only unlinked from the global list */
+        lfh_free_cache( cache );
+    }
+    lfh_reap_threshold = max( 64, lfh_nb_caches * 2 );
+}
+
+
+/***********************************************************************
+ *           heap_thread_detach
+ *
+ * Release the low fragmentation heap caches of the current thread.
+ */
+void heap_thread_detach(void)
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct lfh_cache *cache, *next;
+
+    if (!thread_data->heap_cache) return;
+
+    RtlEnterCriticalSection( &lfh_section );
+    for (cache = thread_data->heap_cache; cache; cache = next)
+    {
+        next = cache->next;
+        lfh_free_cache( cache );
+    }
+    thread_data->heap_cache = NULL;
+    RtlLeaveCriticalSection( &lfh_section );
+}
+
+
 /***********************************************************************
  *           RtlCreateHeap   (NTDLL.@)
  *
@@ -1612,6 +2212,19 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
     list_remove( &heapPtr->entry );
     RtlLeaveCriticalSection( &processHeap->critSection );
 
+    if (heapPtr->lfh)
+    {
+        struct lfh_cache *cache;
+
+        RtlEnterCriticalSection( &lfh_section );
+        list_remove( &heapPtr->lfh->entry );
+        /* the other threads free their caches the next time they create one, or on exit */
+        LIST_FOR_EACH_ENTRY( cache, &lfh_caches, struct lfh_cache, entry )
+            if (cache->id == heapPtr->lfh->id) cache->id = 0;
+        lfh_free_dead_caches();
+        RtlLeaveCriticalSection( &lfh_section );
+    }
+
     heapPtr->critSection.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &heapPtr->critSection );
 
@@ -1664,17 +2277,36 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
  */
 void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
 {
-    ARENA_FREE *pArena;
-    ARENA_INUSE *pInUse;
-    SUBHEAP *subheap;
     HEAP *heapPtr = HEAP_GetPtr( heap );
-    SIZE_T rounded_size;
+    void *ret;
 
     /* Validate the parameters */
 
     if (!heapPtr) return NULL;
     flags &= HEAP_GENERATE_EXCEPTIONS | HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY;
     flags |= heapPtr->flags;
+
+    if (heapPtr->lfh && (ret = lfh_allocate( heapPtr, flags, size )))
+    {
+        TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
+        return ret;
+    }
+    return allocate_block( heapPtr, flags, size );
+}
+
+
+/***********************************************************************
+ *           allocate_block
+ *
+ * Allocate a block from the heap arenas; the flags must have been validated.
+ */
+static void *allocate_block( HEAP *heapPtr, ULONG flags, SIZE_T size )
+{
+    ARENA_FREE *pArena;
+    ARENA_INUSE *pInUse;
+    SUBHEAP *subheap;
+    SIZE_T rounded_size;
+
     rounded_size = ROUND_SIZE(size) + HEAP_TAIL_EXTRA_SIZE( flags );
     if (rounded_size < size)  /* overflow */
     {
@@ -1687,10 +2319,10 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
 
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
     {
-        void *ret = allocate_large_block( heap, flags, size );
+        void *ret = allocate_large_block( heapPtr, flags, size );
         if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
         if (!ret && (flags & HEAP_GENERATE_EXCEPTIONS)) RtlRaiseStatus( STATUS_NO_MEMORY );
-        TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
+        TRACE("(%p,%08x,%08lx): returning %p\n", heapPtr, flags, size, ret );
         return ret;
     }
 
@@ -1699,7 +2331,7 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
     if (!(pArena = HEAP_FindFreeBlock( heapPtr, rounded_size, &subheap )))
     {
         TRACE("(%p,%08x,%08lx): returning NULL\n",
-                  heap, flags, size  );
+                  heapPtr, flags, size  );
         if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
         if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
         return NULL;
@@ -1728,7 +2360,7 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
 
     if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
 
-    TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, pInUse + 1 );
+    TRACE("(%p,%08x,%08lx): returning %p\n", heapPtr, flags, size, pInUse + 1 );
     return pInUse + 1;
 }
 
@@ -1749,8 +2381,7 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
  */
 BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE heap, ULONG flags, void *ptr )
 {
-    ARENA_INUSE *pInUse;
-    SUBHEAP *subheap;
+    struct lfh_group *group;
     HEAP *heapPtr;
 
     /* Validate the parameters */
@@ -1766,6 +2397,22 @@ BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE heap, ULONG flags, void *pt
 
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+
+    if ((group = lfh_get_group( heapPtr, ptr ))) return lfh_free( heapPtr, group, ptr );
+    return free_block( heapPtr, flags, ptr );
+}
+
+
+/***********************************************************************
+ *           free_block
+ *
+ * Free a block allocated from the heap arenas; the flags must have been validated.
+ */
+static BOOLEAN free_block( HEAP *heapPtr, ULONG flags, void *ptr )
+{
+    ARENA_INUSE *pInUse;
+    SUBHEAP *subheap;
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     /* Inform valgrind we are trying to free memory, so it can throw up an error message */
@@ -1781,13 +2428,13 @@ BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE heap, ULONG flags, void *pt
         HEAP_MakeInUseBlockFree( subheap, pInUse );
 
     if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
-    TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
+    TRACE("(%p,%08x,%p): returning TRUE\n", heapPtr, flags, ptr );
     return TRUE;
 
 error:
     if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
     RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
-    TRACE("(%p,%08x,%p): returning FALSE\n", heap, flags, ptr );
+    TRACE("(%p,%08x,%p): returning FALSE\n", heapPtr, flags, ptr );
     return FALSE;
 }
 
@@ -1809,6 +2456,7 @@ error:
  */
 PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size )
 {
+    struct lfh_group *group;
     ARENA_INUSE *pArena;
     HEAP *heapPtr;
     SUBHEAP *subheap;
@@ -1827,6 +2475,8 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     flags &= HEAP_GENERATE_EXCEPTIONS | HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY |
              HEAP_REALLOC_IN_PLACE_ONLY;
     flags |= heapPtr->flags;
+    if ((group = lfh_get_group( heapPtr, ptr ))) return lfh_reallocate( heapPtr, flags, group, ptr, size );
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     rounded_size = ROUND_SIZE(size) + HEAP_TAIL_EXTRA_SIZE(flags);
@@ -2024,6 +2674,7 @@ BOOLEAN WINAPI RtlUnlockHeap( HANDLE heap )
  */
 SIZE_T WINAPI RtlSizeHeap( HANDLE heap, ULONG flags, const void *ptr )
 {
+    struct lfh_group *group;
     SIZE_T ret;
     const ARENA_INUSE *pArena;
     SUBHEAP *subheap;
@@ -2034,6 +2685,16 @@ SIZE_T WINAPI RtlSizeHeap( HANDLE heap, ULONG flags, const void *ptr )
         RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_HANDLE );
         return ~0UL;
     }
+    if ((group = lfh_get_group( heapPtr, ptr )))
+    {
+        if (!lfh_validate_block( heapPtr, group, ptr ))
+        {
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+            return ~0UL;
+        }
+        return ((const ARENA_LFH *)ptr - 1)->data_size;
+    }
+
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
@@ -2077,7 +2738,10 @@ SIZE_T WINAPI RtlSizeHeap( HANDLE heap, ULONG flags, const void *ptr )
 BOOLEAN WINAPI RtlValidateHeap( HANDLE heap, ULONG flags, LPCVOID ptr )
 {
     HEAP *heapPtr = HEAP_GetPtr( heap );
+    struct lfh_group *group;
+
     if (!heapPtr) return FALSE;
+    if (ptr && (group = lfh_get_group( heapPtr, ptr ))) return lfh_validate_block( heapPtr, group, ptr );
     return HEAP_IsRealArena( heapPtr, flags, ptr, QUIET );
 }
 
@@ -2246,6 +2910,8 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
+    HEAP *heapPtr;
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
@@ -2254,7 +2920,8 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+        *(ULONG *)info = heapPtr->lfh ? 2 : 0; /* low fragmentation or standard heap */
         return STATUS_SUCCESS;
 
     default:
@@ -2268,6 +2935,27 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class, PVOID info, SIZE_T size)
 {
-    FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
-    return STATUS_SUCCESS;
+    HEAP *heapPtr;
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+
+        switch (*(ULONG *)info)
+        {
+        case 0:  /* standard heap */
+        case 1:  /* look-aside lists, not supported */
+            return heapPtr->lfh ? STATUS_UNSUCCESSFUL : STATUS_SUCCESS;
+        case 2:  /* low fragmentation heap */
+            return lfh_enable( heapPtr );
+        default:
+            return STATUS_INVALID_PARAMETER;
+        }
+
+    default:
+        FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
+        return STATUS_SUCCESS;
+    }
 }
@@ -3076,6 +3076,8 @@ void WINAPI LdrShutdownThread(void)
     RtlFreeHeap( GetProcessHeap(), 0, NtCurrentTeb()->FlsSlots );
     RtlFreeHeap( GetProcessHeap(), 0, NtCurrentTeb()->TlsExpansionSlots );
     RtlLeaveCriticalSection( &loader_section );
+
+    heap_thread_detach();
 }
 
 
@@ -3096,13 +3098,6 @@ static void free_modref( WINE_MODREF *wm )
                         debugstr_w(wm->ldr.FullDllName.Buffer),
                         (wm->ldr.Flags & LDR_WINE_INTERNAL) ? "builtin" : "native" );
 
-    SERVER_START_REQ( unload_dll )
-    {
-        req->base = wine_server_client_ptr( wm->ldr.BaseAddress );
-        wine_server_call( req );
-    }
-    SERVER_END_REQ;
-
     free_tls_slot( &wm->ldr );
     RtlReleaseActivationContext( wm->ldr.ActivationContext );
     if (wm->ldr.Flags & LDR_WINE_INTERNAL) wine_dll_unload( wm->ldr.SectionHandle );
@@ -3123,9 +3118,42 @@ static void free_modref( WINE_MODREF *wm )
  */
 static void MODULE_FlushModrefs(void)
 {
+    struct __server_request_info reqs[SERVER_BATCH_MAX];
+    struct unload_dll_request *req;
     PLIST_ENTRY mark, entry, prev;
     PLDR_MODULE mod;
     WINE_MODREF*wm;
+    unsigned int nb = 0;
+
+    /* notify the server of the unloads in the order the modules are freed below,
+     * with as few server calls as possible */
+    mark = &NtCurrentTeb()->Peb->LdrData->InInitializationOrderModuleList;
+    for (entry = mark->Blink; entry != mark; entry = entry->Blink)
+    {
+        mod = CONTAINING_RECORD(entry, LDR_MODULE, InInitializationOrderModuleList);
+        if (mod->LoadCount) continue;
+        if (nb == SERVER_BATCH_MAX)
+        {
+            server_call_batch( reqs, nb );
+            nb = 0;
+        }
+        req = server_init_batch_request( &reqs[nb++], REQ_unload_dll );
+        req->base = wine_server_client_ptr( mod->BaseAddress );
+    }
+    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
+    for (entry = mark->Blink; entry != mark; entry = entry->Blink)
+    {
+        mod = CONTAINING_RECORD(entry, LDR_MODULE, InLoadOrderModuleList);
+        if (mod->LoadCount || mod->InInitializationOrderModuleList.Flink) continue;
+        if (nb == SERVER_BATCH_MAX)
+        {
+            server_call_batch( reqs, nb );
+            nb = 0;
+        }
+        req = server_init_batch_request( &reqs[nb++], REQ_unload_dll );
+        req->base = wine_server_client_ptr( mod->BaseAddress );
+    }
+    server_call_batch( reqs, nb );
 
     mark = &NtCurrentTeb()->Peb->LdrData->InInitializationOrderModuleList;
     for (entry = mark->Blink; entry != mark; entry = prev)
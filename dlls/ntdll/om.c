@@ -371,6 +371,7 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
             {
                 int fd = server_remove_fd_from_cache( source );
                 if (fd != -1) close( fd );
+                fast_sync_remove_from_cache( source );
             }
         }
     }
@@ -390,6 +391,8 @@ NTSTATUS close_handle( HANDLE handle )
     NTSTATUS ret;
     int fd = server_remove_fd_from_cache( handle );
 
+    fast_sync_remove_from_cache( handle );
+
     SERVER_START_REQ( close_handle )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -419,6 +422,30 @@ NTSTATUS close_handle( HANDLE handle )
     return ret;
 }
 
+/* close several internal handles with a single server call; null handles are ignored */
+void close_handles( const HANDLE *handles, unsigned int count )
+{
+    struct __server_request_info reqs[SERVER_BATCH_MAX];
+    int fds[SERVER_BATCH_MAX];
+    unsigned int i, nb;
+
+    while (count)
+    {
+        for (nb = 0; count && nb < SERVER_BATCH_MAX; handles++, count--)
+        {
+            struct close_handle_request *req;
+
+            if (!*handles) continue;
+            fds[nb] = server_remove_fd_from_cache( *handles );
+            fast_sync_remove_from_cache( *handles );
+            req = server_init_batch_request( &reqs[nb++], REQ_close_handle );
+            req->handle = wine_server_obj_handle( *handles );
+        }
+        server_call_batch( reqs, nb );
+        for (i = 0; i < nb; i++) if (fds[i] != -1) close( fds[i] );
+    }
+}
+
 /**************************************************************************
  *                 NtClose				[NTDLL.@]
  *
@@ -1230,15 +1230,52 @@ static NTSTATUS RTL_GetKeyHandle(ULONG RelativeTo, PCWSTR Path, PHANDLE handle)
  * RETURNS
  *  STATUS_SUCCESS or an appropriate NTSTATUS error code.
  */
+#define ENUM_VALUE_BATCH_SIZE 512  /* size of each value buffer in enum_values_batch */
+
+/* retrieve the full information of SERVER_BATCH_MAX consecutive values with a single server call */
+static void enum_values_batch( HANDLE handle, ULONG index, char *buffer, NTSTATUS *status, ULONG *len )
+{
+    static const size_t fixed_size = FIELD_OFFSET( KEY_VALUE_FULL_INFORMATION, Name );
+    struct __server_request_info reqs[SERVER_BATCH_MAX];
+    unsigned int i;
+
+    for (i = 0; i < SERVER_BATCH_MAX; i++)
+    {
+        struct enum_key_value_request *req = server_init_batch_request( &reqs[i], REQ_enum_key_value );
+
+        req->hkey       = wine_server_obj_handle( handle );
+        req->index      = index + i;
+        req->info_class = KeyValueFullInformation;
+        wine_server_set_reply( req, buffer + i * ENUM_VALUE_BATCH_SIZE + fixed_size,
+                               ENUM_VALUE_BATCH_SIZE - fixed_size );
+    }
+    server_call_batch( reqs, SERVER_BATCH_MAX );
+
+    for (i = 0; i < SERVER_BATCH_MAX; i++)
+    {
+        const struct enum_key_value_reply *reply = &reqs[i].u.reply.enum_key_value_reply;
+
+        if ((status[i] = reply->__header.error)) continue;
+        copy_key_value_info( KeyValueFullInformation, buffer + i * ENUM_VALUE_BATCH_SIZE,
+                             ENUM_VALUE_BATCH_SIZE, reply->type, reply->namelen,
+                             reply->__header.reply_size - reply->namelen );
+        len[i] = fixed_size + reply->total;
+        if (len[i] > ENUM_VALUE_BATCH_SIZE) status[i] = STATUS_BUFFER_OVERFLOW;
+    }
+}
+
 NTSTATUS WINAPI RtlQueryRegistryValues(IN ULONG RelativeTo, IN PCWSTR Path,
                                        IN PRTL_QUERY_REGISTRY_TABLE QueryTable, IN PVOID Context,
                                        IN PVOID Environment OPTIONAL)
 {
     UNICODE_STRING Value;
     HANDLE handle, topkey;
-    PKEY_VALUE_FULL_INFORMATION pInfo = NULL;
-    ULONG len, buflen = 0;
-    NTSTATUS status=STATUS_SUCCESS, ret = STATUS_SUCCESS;
+    PKEY_VALUE_FULL_INFORMATION pInfo = NULL, info;
+    ULONG len, buflen = 0, batch_len[SERVER_BATCH_MAX];
+    NTSTATUS status=STATUS_SUCCESS, ret = STATUS_SUCCESS, batch_status[SERVER_BATCH_MAX];
+    HANDLE handles[2];
+    char *batch = NULL;
+    BOOL use_batch;
     INT i;
 
     TRACE("(%d, %s, %p, %p, %p)\n", RelativeTo, debugstr_w(Path), QueryTable, Context, Environment);
@@ -1306,11 +1343,31 @@ NTSTATUS WINAPI RtlQueryRegistryValues(IN ULONG RelativeTo, IN PCWSTR Path,
                 goto out;
             }
 
+            /* values are fetched in batches, unless deleting them shifts the indices */
+            use_batch = !(QueryTable->Flags & RTL_QUERY_REGISTRY_DELETE);
+            if (use_batch && !batch)
+                use_batch = (batch = RtlAllocateHeap(GetProcessHeap(), 0,
+                                                     SERVER_BATCH_MAX * ENUM_VALUE_BATCH_SIZE)) != NULL;
+
             /* Report all subkeys */
             for (i = 0;; ++i)
             {
-                status = NtEnumerateValueKey(handle, i,
-                    KeyValueFullInformation, pInfo, buflen, &len);
+                info = pInfo;
+                if (use_batch)
+                {
+                    if (!(i % SERVER_BATCH_MAX))
+                        enum_values_batch(handle, i, batch, batch_status, batch_len);
+                    status = batch_status[i % SERVER_BATCH_MAX];
+                    len = batch_len[i % SERVER_BATCH_MAX];
+                    if (status == STATUS_SUCCESS)
+                        info = (PKEY_VALUE_FULL_INFORMATION)(batch + (i % SERVER_BATCH_MAX) * ENUM_VALUE_BATCH_SIZE);
+                    else if (status == STATUS_BUFFER_OVERFLOW && len <= buflen)
+                        status = NtEnumerateValueKey(handle, i,
+                            KeyValueFullInformation, pInfo, buflen, &len);
+                }
+                else
+                    status = NtEnumerateValueKey(handle, i,
+                        KeyValueFullInformation, pInfo, buflen, &len);
                 if (status == STATUS_NO_MORE_ENTRIES)
                     break;
                 if (status == STATUS_BUFFER_OVERFLOW ||
@@ -1318,12 +1375,12 @@ NTSTATUS WINAPI RtlQueryRegistryValues(IN ULONG RelativeTo, IN PCWSTR Path,
                 {
                     buflen = len;
                     RtlFreeHeap(GetProcessHeap(), 0, pInfo);
-                    pInfo = RtlAllocateHeap(GetProcessHeap(), 0, buflen);
+                    info = pInfo = RtlAllocateHeap(GetProcessHeap(), 0, buflen);
                     NtEnumerateValueKey(handle, i, KeyValueFullInformation,
                         pInfo, buflen, &len);
                 }
 
-                status = RTL_ReportRegistryValue(pInfo, QueryTable, Context, Environment);
+                status = RTL_ReportRegistryValue(info, QueryTable, Context, Environment);
                 if(status != STATUS_SUCCESS && status != STATUS_BUFFER_TOO_SMALL)
                 {
                     ret = status;
@@ -1331,7 +1388,7 @@ NTSTATUS WINAPI RtlQueryRegistryValues(IN ULONG RelativeTo, IN PCWSTR Path,
                 }
                 if (QueryTable->Flags & RTL_QUERY_REGISTRY_DELETE)
                 {
-                    RtlInitUnicodeString(&Value, pInfo->Name);
+                    RtlInitUnicodeString(&Value, info->Name);
                     NtDeleteValueKey(handle, &Value);
                 }
             }
@@ -1386,9 +1443,10 @@ NTSTATUS WINAPI RtlQueryRegistryValues(IN ULONG RelativeTo, IN PCWSTR Path,
 
 out:
     RtlFreeHeap(GetProcessHeap(), 0, pInfo);
-    if (handle != topkey)
-        NtClose(handle);
-    NtClose(topkey);
+    RtlFreeHeap(GetProcessHeap(), 0, batch);
+    handles[0] = handle != topkey ? handle : 0;
+    handles[1] = topkey;
+    close_handles(handles, ARRAY_SIZE(handles));
     return ret;
 }
 
@@ -51,6 +51,9 @@
 #ifdef HAVE_SYS_MMAN_H
 #include <sys/mman.h>
 #endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 #ifdef HAVE_SYS_PRCTL_H
 # include <sys/prctl.h>
 #endif
@@ -80,6 +83,7 @@
 #include "wine/library.h"
 #include "wine/server.h"
 #include "wine/debug.h"
+#include "wine/exception.h"
 #include "ntdll_misc.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(server);
@@ -277,14 +281,107 @@ static inline unsigned int wait_reply( struct __server_request_info *req )
 }
 
 
+#ifdef __linux__
+static inline int wait_request_shm( int *addr, int val, const struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, 0 /* FUTEX_WAIT */, val, timeout, 0, 0 );
+}
+#else
+static inline int wait_request_shm( int *addr, int val, const struct timespec *timeout )
+{
+    errno = ENOSYS;
+    return -1;
+}
+#endif
+
+/***********************************************************************
+ *           server_disconnected
+ *
+ * Check if the server closed the connection; helper for shm_server_call.
+ */
+static BOOL server_disconnected(void)
+{
+#ifdef HAVE_POLL_H
+    struct pollfd pfd;
+
+    pfd.fd = ntdll_get_thread_data()->reply_fd;
+    pfd.events = POLLIN;
+    return poll( &pfd, 1, 0 ) == 1 && (pfd.revents & (POLLHUP | POLLERR));
+#else
+    return FALSE;
+#endif
+}
+
+
+/***********************************************************************
+ *           shm_server_call
+ *
+ * Perform a server call through the shared memory area of the thread.
+ * The request and reply are copied through the area, and only a single
+ * byte is written to the request pipe to wake up the server.
+ */
+static unsigned int shm_server_call( struct __server_request_info *req, struct request_shm *shm )
+{
+    static const char doorbell;
+    static const struct timespec timeout = { 1, 0 };
+    char *data = (char *)(shm + 1);
+    unsigned int i;
+    int ret, state;
+
+    memcpy( &shm->header, &req->u.req, sizeof(req->u.req) );
+    __TRY
+    {
+        for (i = 0; i < req->data_count; i++)
+        {
+            memcpy( data, req->data[i].ptr, req->data[i].size );
+            data += req->data[i].size;
+        }
+    }
+    __EXCEPT_PAGE_FAULT
+    {
+        return STATUS_ACCESS_VIOLATION;
+    }
+    __ENDTRY
+
+    shm->state = REQUEST_SHM_PENDING;
+    if ((ret = write( ntdll_get_thread_data()->request_fd, &doorbell, 1 )) != 1)
+    {
+        if (ret >= 0) server_protocol_error( "partial write %d\n", ret );
+        if (errno == EPIPE) abort_thread(0);
+        server_protocol_perror( "write" );
+    }
+
+    while ((state = interlocked_cmpxchg( &shm->state, REQUEST_SHM_WAITING,
+                                         REQUEST_SHM_PENDING )) != REQUEST_SHM_DONE)
+    {
+        if (state == REQUEST_SHM_CLOSED) abort_thread(0);
+        /* the server doesn't update the state if it dies, so check the pipe from time to time */
+        if (wait_request_shm( &shm->state, REQUEST_SHM_WAITING, &timeout ) == -1 &&
+            errno == ETIMEDOUT && server_disconnected())
+            abort_thread(0);
+    }
+
+    memcpy( &req->u.reply, &shm->header, sizeof(req->u.reply) );
+    if (req->u.reply.reply_header.reply_size)
+        memcpy( req->reply_data, shm + 1, req->u.reply.reply_header.reply_size );
+    shm->state = REQUEST_SHM_IDLE;
+    return req->u.reply.reply_header.error;
+}
+
+
 /***********************************************************************
  *           server_call_unlocked
  */
 unsigned int server_call_unlocked( void *req_ptr )
 {
     struct __server_request_info * const req = req_ptr;
+    struct request_shm *shm = ntdll_get_thread_data()->request_shm;
     unsigned int ret;
 
+    if (shm && req->u.req.request_header.request_size <= REQUEST_SHM_DATA_SIZE &&
+        req->u.req.request_header.reply_size <= REQUEST_SHM_DATA_SIZE)
+        return shm_server_call( req, shm );
+
     if ((ret = send_request( req ))) return ret;
     return wait_reply( req );
 }
@@ -324,6 +421,101 @@ unsigned int wine_server_call( void *req_ptr )
 }
 
 
+/***********************************************************************
+ *           server_init_batch_request
+ *
+ * Initialize a request that will be sent with server_call_batch.
+ */
+void *server_init_batch_request( struct __server_request_info *info, enum request type )
+{
+    memset( &info->u.req, 0, sizeof(info->u.req) );
+    info->u.req.request_header.req = type;
+    info->data_count = 0;
+    info->reply_data = NULL;
+    return &info->u.req;
+}
+
+
+/***********************************************************************
+ *           server_call_batch
+ *
+ * Send several independent requests to the server in a single batch
+ * request, and dispatch the replies back to the individual requests.
+ * Only requests that are accepted by the server batch handler can be used.
+ * Returns the number of requests that have been executed; the remaining
+ * ones have their error set to the status of the batch.
+ */
+unsigned int server_call_batch( struct __server_request_info *reqs, unsigned int count )
+{
+    static const char padding[8];
+    struct __server_request_info batch;
+    struct iovec vec[1 + SERVER_BATCH_MAX * (__SERVER_MAX_DATA + 2)];
+    data_size_t reply_size = 0;
+    unsigned int i, j, done = 0, nb_vec = 1;
+    sigset_t old_set;
+    int ret;
+
+    assert( count <= SERVER_BATCH_MAX );
+    if (!count) return 0;
+
+    memset( &batch.u.req, 0, sizeof(batch.u.req) );
+    batch.u.req.request_header.req = REQ_batch;
+    vec[0].iov_base = &batch.u.req;
+    vec[0].iov_len = sizeof(batch.u.req);
+
+    for (i = 0; i < count; i++)
+    {
+        data_size_t size = reqs[i].u.req.request_header.request_size;
+
+        vec[nb_vec].iov_base = &reqs[i].u.req;
+        vec[nb_vec++].iov_len = sizeof(reqs[i].u.req);
+        for (j = 0; j < reqs[i].data_count; j++)
+        {
+            vec[nb_vec].iov_base = (void *)reqs[i].data[j].ptr;
+            vec[nb_vec++].iov_len = reqs[i].data[j].size;
+        }
+        if (size & 7)
+        {
+            vec[nb_vec].iov_base = (void *)padding;
+            vec[nb_vec++].iov_len = 8 - (size & 7);
+        }
+        batch.u.req.request_header.request_size += sizeof(reqs[i].u.req) + ((size + 7) & ~7);
+        reply_size += sizeof(reqs[i].u.reply) + reqs[i].u.req.request_header.reply_size;
+    }
+    batch.u.req.request_header.reply_size = reply_size;
+
+    pthread_sigmask( SIG_BLOCK, &server_block_set, &old_set );
+
+    ret = writev( ntdll_get_thread_data()->request_fd, vec, nb_vec );
+    if (ret != batch.u.req.request_header.request_size + sizeof(batch.u.req))
+    {
+        if (ret >= 0) server_protocol_error( "partial write %d\n", ret );
+        if (errno == EPIPE) abort_thread(0);
+        if (errno != EFAULT) server_protocol_perror( "write" );
+        pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+        for (i = 0; i < count; i++) reqs[i].u.reply.reply_header.error = STATUS_ACCESS_VIOLATION;
+        return 0;
+    }
+
+    read_reply_data( &batch.u.reply, sizeof(batch.u.reply) );
+    done = ((struct batch_reply *)&batch.u.reply)->count;
+    for (i = 0; i < done; i++)
+    {
+        read_reply_data( &reqs[i].u.reply, sizeof(reqs[i].u.reply) );
+        if (reqs[i].u.reply.reply_header.reply_size)
+            read_reply_data( reqs[i].reply_data, reqs[i].u.reply.reply_header.reply_size );
+    }
+    pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+
+    for (i = done; i < count; i++)
+    {
+        reqs[i].u.reply.reply_header.error = batch.u.reply.reply_header.error;
+        reqs[i].u.reply.reply_header.reply_size = 0;
+    }
+    return done;
+}
+
+
 /***********************************************************************
  *           server_enter_uninterrupted_section
  */
@@ -1468,6 +1660,44 @@ void server_init_process_done(void)
 }
 
 
+/***********************************************************************
+ *           init_request_shm
+ *
+ * Map the shared memory area used to pass requests, if enabled.
+ */
+static void init_request_shm(void)
+{
+#if defined(__linux__) && defined(HAVE_SYS_MMAN_H)
+    static int enabled = -1;
+    HANDLE handle = 0;
+    int fd, needs_close;
+    void *ptr;
+
+    if (enabled == -1)
+    {
+        const char *env = getenv( "WINESERVERSHM" );
+        enabled = env && atoi( env );
+    }
+    if (!enabled) return;
+
+    SERVER_START_REQ( get_request_shm )
+    {
+        if (!wine_server_call( req )) handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+    if (!handle) return;
+
+    if (!server_get_unix_fd( handle, FILE_READ_DATA | FILE_WRITE_DATA, &fd, &needs_close, NULL, NULL ))
+    {
+        ptr = mmap( NULL, REQUEST_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        if (ptr != MAP_FAILED) ntdll_get_thread_data()->request_shm = ptr;
+        if (needs_close) close( fd );
+    }
+    close_handle( handle );
+#endif
+}
+
+
 /***********************************************************************
  *           server_init_thread
  *
@@ -1524,6 +1754,7 @@ size_t server_init_thread( void *entry_point, BOOL *suspend )
     switch (ret)
     {
     case STATUS_SUCCESS:
+        init_request_shm();
         if (arch)
         {
             if (!strcmp( arch, "win32" ) && (is_win64 || is_wow64))
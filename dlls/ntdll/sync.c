@@ -34,6 +34,9 @@
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #ifdef HAVE_POLL_H
 #include <poll.h>
 #endif
@@ -57,6 +60,7 @@
 #define NONAMELESSUNION
 #include "windef.h"
 #include "winternl.h"
+#include "wine/library.h"
 #include "wine/server.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
@@ -130,8 +134,432 @@ static void timespec_from_timeout( struct timespec *timespec, const LARGE_INTEGE
     timespec->tv_sec  = diff / TICKSPERSEC;
     timespec->tv_nsec = (diff % TICKSPERSEC) * 100;
 }
+
+
+/*
+ * Fast sync support
+ *
+ * With WINEFASTSYNC set, the state of events and semaphores lives in a
+ * shared memory region exported by the server, and they can be signaled
+ * and waited upon without any server round trip. The server sets the
+ * FAST_SYNC_SERVER_WAIT flag in the state while one of its own threads is
+ * queued on the object, in which case we fall back to regular requests.
+ */
+
+#ifndef __NR_futex_waitv
+#define __NR_futex_waitv 449
 #endif
 
+struct futex_waitv
+{
+    ULONG64 val;
+    ULONG64 uaddr;
+    unsigned int flags;
+    unsigned int reserved;
+};
+
+struct kernel_timespec
+{
+    LONGLONG tv_sec;
+    LONGLONG tv_nsec;
+};
+
+#define FUTEX2_SIZE_U32 0x02
+
+union fast_sync_cache_entry
+{
+    LONG64 data;
+    struct
+    {
+        unsigned int index;   /* slot index + 1, FAST_SYNC_MAX_SLOTS + 1 if not a fast sync object */
+        unsigned int access;  /* access rights of the handle */
+    } s;
+};
+
+#define FAST_SYNC_CACHE_BLOCK_SIZE  (65536 / sizeof(union fast_sync_cache_entry))
+#define FAST_SYNC_CACHE_ENTRIES     128
+
+static union fast_sync_cache_entry *fast_sync_cache[FAST_SYNC_CACHE_ENTRIES];
+static struct fast_sync_slot *fast_sync_slots;
+static int have_futex_waitv = -1;
+
+static inline int shared_futex_wait( const int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, 0 /* FUTEX_WAIT */, val, timeout, 0, 0 );
+}
+
+static inline int shared_futex_wake( const int *addr, int val )
+{
+    return syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */, val, NULL, 0, 0 );
+}
+
+static inline int futex_waitv( struct futex_waitv *waiters, unsigned int count,
+                               const struct kernel_timespec *end )
+{
+    return syscall( __NR_futex_waitv, waiters, count, 0, end, CLOCK_MONOTONIC );
+}
+
+static BOOL do_fast_sync(void)
+{
+    static int enabled = -1;
+
+    if (enabled == -1)
+    {
+        const char *env = getenv( "WINEFASTSYNC" );
+        HANDLE handle = 0;
+        data_size_t size = 0;
+        int fd, needs_close;
+        void *ptr;
+
+        if (!env || !atoi( env ) || !use_futexes()) return (enabled = 0);
+
+        SERVER_START_REQ( get_fast_sync_region )
+        {
+            if (!wine_server_call( req ))
+            {
+                handle = wine_server_ptr_handle( reply->handle );
+                size = reply->size;
+            }
+        }
+        SERVER_END_REQ;
+        if (!handle) return (enabled = 0);
+
+        if (!server_get_unix_fd( handle, FILE_READ_DATA | FILE_WRITE_DATA, &fd, &needs_close, NULL, NULL ))
+        {
+            ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+            if (ptr != MAP_FAILED && interlocked_cmpxchg_ptr( (void **)&fast_sync_slots, ptr, NULL ))
+                munmap( ptr, size );  /* another thread got there first */
+            if (needs_close) close( fd );
+        }
+        NtClose( handle );
+        enabled = (fast_sync_slots != NULL);
+        if (enabled) TRACE( "using fast sync objects\n" );
+    }
+    return enabled;
+}
+
+static inline unsigned int fast_sync_handle_to_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / FAST_SYNC_CACHE_BLOCK_SIZE;
+    return idx % FAST_SYNC_CACHE_BLOCK_SIZE;
+}
+
+/* retrieve the shared slot of an event or semaphore, NULL if it doesn't have one */
+static struct fast_sync_slot *get_fast_sync_slot( HANDLE handle, unsigned int *access )
+{
+    unsigned int entry, idx;
+    union fast_sync_cache_entry cache;
+    union fast_sync_cache_entry *block;
+
+    if (!handle || (LONG_PTR)handle < 0 || !do_fast_sync()) return NULL;
+
+    idx = fast_sync_handle_to_index( handle, &entry );
+    if (entry >= FAST_SYNC_CACHE_ENTRIES) return NULL;
+
+    if (!(block = fast_sync_cache[entry]))
+    {
+        block = wine_anon_mmap( NULL, FAST_SYNC_CACHE_BLOCK_SIZE * sizeof(*block),
+                                PROT_READ | PROT_WRITE, 0 );
+        if (block == MAP_FAILED) return NULL;
+        if (interlocked_cmpxchg_ptr( (void **)&fast_sync_cache[entry], block, NULL ))
+        {
+            munmap( block, FAST_SYNC_CACHE_BLOCK_SIZE * sizeof(*block) );
+            block = fast_sync_cache[entry];
+        }
+    }
+
+    cache.data = interlocked_cmpxchg64( &block[idx].data, 0, 0 );
+    if (!cache.data)
+    {
+        unsigned int index = FAST_SYNC_NO_SLOT;
+
+        SERVER_START_REQ( get_fast_sync_slot )
+        {
+            req->handle = wine_server_obj_handle( handle );
+            if (wine_server_call( req )) return NULL;  /* don't cache invalid handles */
+            index = reply->index;
+            cache.s.access = reply->access;
+        }
+        SERVER_END_REQ;
+        cache.s.index = (index < FAST_SYNC_MAX_SLOTS ? index : FAST_SYNC_MAX_SLOTS) + 1;
+        interlocked_cmpxchg64( &block[idx].data, cache.data, 0 );
+    }
+    if (cache.s.index > FAST_SYNC_MAX_SLOTS) return NULL;
+    *access = cache.s.access;
+    return &fast_sync_slots[cache.s.index - 1];
+}
+
+/* forget the cached slot of a handle that is being closed */
+void fast_sync_remove_from_cache( HANDLE handle )
+{
+    unsigned int entry, idx;
+
+    if (!fast_sync_slots || !handle || (LONG_PTR)handle < 0) return;
+    idx = fast_sync_handle_to_index( handle, &entry );
+    if (entry < FAST_SYNC_CACHE_ENTRIES && fast_sync_cache[entry])
+    {
+        LONG64 *data = &fast_sync_cache[entry][idx].data;
+        LONG64 cur;
+
+        do cur = *data; while (interlocked_cmpxchg64( data, 0, cur ) != cur);
+    }
+}
+
+/* atomically set the state of an event, unless the server has taken it over */
+static BOOL fast_sync_set_event( struct fast_sync_slot *slot, int value )
+{
+    int cur;
+
+    for (;;)
+    {
+        cur = slot->state;
+        if (cur & FAST_SYNC_SERVER_WAIT) return FALSE;
+        if ((cur & FAST_SYNC_EVENT_SIGNALED) == value) return TRUE;
+        /* keep the pulse count */
+        if (interlocked_cmpxchg( &slot->state, (cur & ~FAST_SYNC_EVENT_SIGNALED) | value, cur ) == cur) break;
+    }
+    if (value && slot->waiters) shared_futex_wake( &slot->state, INT_MAX );
+    return TRUE;
+}
+
+/* atomically increment the count of a semaphore, unless the server has taken it over */
+static BOOL fast_sync_release_semaphore( struct fast_sync_slot *slot, ULONG count,
+                                         ULONG *prev, NTSTATUS *status )
+{
+    int cur;
+
+    for (;;)
+    {
+        cur = slot->state;
+        if (cur & FAST_SYNC_SERVER_WAIT) return FALSE;
+        if (prev) *prev = cur;
+        if (count > slot->max || cur > slot->max - count)
+        {
+            *status = STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+            return TRUE;
+        }
+        if (interlocked_cmpxchg( &slot->state, cur + count, cur ) == cur) break;
+    }
+    if (slot->waiters) shared_futex_wake( &slot->state, INT_MAX );
+    *status = STATUS_SUCCESS;
+    return TRUE;
+}
+
+/* take one of the releases left by a PulseEvent */
+static BOOL fast_sync_take_pulse( struct fast_sync_slot *slot )
+{
+    int cur;
+
+    while ((cur = slot->pulsed) > 0)
+        if (interlocked_cmpxchg( &slot->pulsed, cur - 1, cur ) == cur) return TRUE;
+    return FALSE;
+}
+
+/* try to acquire a slot; return 1 on success, 0 if not signaled, -1 if the server must be used */
+static int fast_sync_try_acquire( struct fast_sync_slot *slot, int *pulse, int *state )
+{
+    int cur;
+
+    for (;;)
+    {
+        cur = *state = slot->state;
+        if (slot->type != FAST_SYNC_SEMAPHORE)
+        {
+            /* the event was pulsed since we started waiting */
+            if ((cur & ~FAST_SYNC_EVENT_SIGNALED & FAST_SYNC_VALUE_MASK) != *pulse)
+            {
+                *pulse = cur & ~FAST_SYNC_EVENT_SIGNALED & FAST_SYNC_VALUE_MASK;
+                if (fast_sync_take_pulse( slot )) return 1;
+            }
+        }
+        if (cur & FAST_SYNC_SERVER_WAIT) return -1;
+        switch (slot->type)
+        {
+        case FAST_SYNC_MANUAL_EVENT:
+            return (cur & FAST_SYNC_EVENT_SIGNALED) ? 1 : 0;
+        case FAST_SYNC_AUTO_EVENT:
+            if (!(cur & FAST_SYNC_EVENT_SIGNALED)) return 0;
+            if (interlocked_cmpxchg( &slot->state, cur & ~FAST_SYNC_EVENT_SIGNALED, cur ) == cur) return 1;
+            break;
+        case FAST_SYNC_SEMAPHORE:
+            if (!cur) return 0;
+            if (interlocked_cmpxchg( &slot->state, cur - 1, cur ) == cur) return 1;
+            break;
+        default:
+            return -1;
+        }
+    }
+}
+
+static void get_monotonic_time( struct kernel_timespec *ts )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    ts->tv_sec = now.tv_sec;
+    ts->tv_nsec = now.tv_nsec;
+}
+
+/* wait on fast sync objects; return STATUS_NOT_IMPLEMENTED if the server needs to be used,
+ * in which case remaining is set to the timeout that is left for the server wait */
+static NTSTATUS fast_sync_wait( DWORD count, const HANDLE *handles, BOOLEAN wait_any,
+                                const LARGE_INTEGER *timeout, LARGE_INTEGER *remaining )
+{
+    struct fast_sync_slot *slots[MAXIMUM_WAIT_OBJECTS];
+    struct futex_waitv waiters[MAXIMUM_WAIT_OBJECTS];
+    int pulse[MAXIMUM_WAIT_OBJECTS];
+    struct kernel_timespec end, now;
+    struct timespec rel;
+    BOOL infinite = !timeout || timeout->QuadPart == TIMEOUT_INFINITE;
+    unsigned int access;
+    NTSTATUS status;
+    int ret, state;
+    DWORD i;
+
+    if (timeout) *remaining = *timeout;
+
+    if (!wait_any && count > 1) return STATUS_NOT_IMPLEMENTED;
+    if (count > 1 && !have_futex_waitv) return STATUS_NOT_IMPLEMENTED;
+
+    for (i = 0; i < count; i++)
+    {
+        if (!(slots[i] = get_fast_sync_slot( handles[i], &access ))) return STATUS_NOT_IMPLEMENTED;
+        if (!(access & SYNCHRONIZE)) return STATUS_NOT_IMPLEMENTED;
+    }
+
+    if (!infinite)
+    {
+        timespec_from_timeout( &rel, timeout );
+        get_monotonic_time( &end );
+        end.tv_sec += rel.tv_sec;
+        end.tv_nsec += rel.tv_nsec;
+        if (end.tv_nsec >= 1000000000)
+        {
+            end.tv_sec++;
+            end.tv_nsec -= 1000000000;
+        }
+        else if (end.tv_nsec < 0)
+        {
+            end.tv_sec--;
+            end.tv_nsec += 1000000000;
+        }
+    }
+
+    /* the waiters count tells signalers that they need to wake us up, and a PulseEvent
+     * how many threads it releases; the pulse count is read after being counted, so
+     * that any pulse we notice has taken us into account */
+    for (i = 0; i < count; i++)
+    {
+        interlocked_xchg_add( &slots[i]->waiters, 1 );
+        pulse[i] = slots[i]->state & ~FAST_SYNC_EVENT_SIGNALED & FAST_SYNC_VALUE_MASK;
+    }
+
+    for (;;)
+    {
+        for (i = 0; i < count; i++)
+        {
+            switch (fast_sync_try_acquire( slots[i], &pulse[i], &state ))
+            {
+            case 1:
+                status = STATUS_WAIT_0 + i;
+                goto done;
+            case -1:
+                status = STATUS_NOT_IMPLEMENTED;
+                goto done;
+            }
+            waiters[i].val = state;
+            waiters[i].uaddr = (ULONG_PTR)&slots[i]->state;
+            waiters[i].flags = FUTEX2_SIZE_U32;
+            waiters[i].reserved = 0;
+        }
+
+        if (!infinite)
+        {
+            get_monotonic_time( &now );
+            if (now.tv_sec > end.tv_sec || (now.tv_sec == end.tv_sec && now.tv_nsec >= end.tv_nsec))
+            {
+                status = STATUS_TIMEOUT;
+                goto done;
+            }
+            rel.tv_sec = end.tv_sec - now.tv_sec;
+            rel.tv_nsec = end.tv_nsec - now.tv_nsec;
+            if (rel.tv_nsec < 0)
+            {
+                rel.tv_sec--;
+                rel.tv_nsec += 1000000000;
+            }
+        }
+
+        /* if the state changed in the meantime, the futex wait fails immediately */
+        if (count == 1)
+            ret = shared_futex_wait( &slots[0]->state, waiters[0].val, infinite ? NULL : &rel );
+        else
+            ret = futex_waitv( waiters, count, infinite ? NULL : &end );
+
+        if (count > 1)
+        {
+            if (ret == -1 && errno == ENOSYS)
+            {
+                have_futex_waitv = 0;
+                status = STATUS_NOT_IMPLEMENTED;
+                goto done;
+            }
+            have_futex_waitv = 1;
+        }
+        /* a timeout is detected by the next iteration, after a last check of the state */
+    }
+
+done:
+    for (i = 0; i < count; i++) interlocked_xchg_add( &slots[i]->waiters, -1 );
+
+    if (status == STATUS_NOT_IMPLEMENTED && !infinite && timeout->QuadPart < 0)
+    {
+        /* don't restart a relative timeout from scratch in the server */
+        get_monotonic_time( &now );
+        remaining->QuadPart = -(((LONGLONG)end.tv_sec - now.tv_sec) * TICKSPERSEC +
+                                (end.tv_nsec - now.tv_nsec) / 100);
+        if (remaining->QuadPart > 0) remaining->QuadPart = 0;
+    }
+    return status;
+}
+
+#else  /* __linux__ */
+
+static inline BOOL do_fast_sync(void)
+{
+    return FALSE;
+}
+
+static inline struct fast_sync_slot *get_fast_sync_slot( HANDLE handle, unsigned int *access )
+{
+    return NULL;
+}
+
+void fast_sync_remove_from_cache( HANDLE handle )
+{
+}
+
+static inline BOOL fast_sync_set_event( struct fast_sync_slot *slot, int value )
+{
+    return FALSE;
+}
+
+static inline BOOL fast_sync_release_semaphore( struct fast_sync_slot *slot, ULONG count,
+                                                ULONG *prev, NTSTATUS *status )
+{
+    return FALSE;
+}
+
+static inline NTSTATUS fast_sync_wait( DWORD count, const HANDLE *handles, BOOLEAN wait_any,
+                                       const LARGE_INTEGER *timeout, LARGE_INTEGER *remaining )
+{
+    if (timeout) *remaining = *timeout;
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif  /* __linux__ */
+
 /* creates a struct security_descriptor and contained information in one contiguous piece of memory */
 NTSTATUS alloc_object_attributes( const OBJECT_ATTRIBUTES *attr, struct object_attributes **ret,
                                   data_size_t *ret_len )
@@ -327,7 +755,14 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
  */
 NTSTATUS WINAPI NtReleaseSemaphore( HANDLE handle, ULONG count, PULONG previous )
 {
+    struct fast_sync_slot *slot;
+    unsigned int access;
     NTSTATUS ret;
+
+    if ((slot = get_fast_sync_slot( handle, &access )) && (access & SEMAPHORE_MODIFY_STATE) &&
+        fast_sync_release_semaphore( slot, count, previous, &ret ))
+        return ret;
+
     SERVER_START_REQ( release_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -404,10 +839,16 @@ NTSTATUS WINAPI NtOpenEvent( HANDLE *handle, ACCESS_MASK access, const OBJECT_AT
  */
 NTSTATUS WINAPI NtSetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
 {
+    struct fast_sync_slot *slot;
+    unsigned int access;
     NTSTATUS ret;
 
     /* FIXME: set NumberOfThreadsReleased */
 
+    if ((slot = get_fast_sync_slot( handle, &access )) && (access & EVENT_MODIFY_STATE) &&
+        fast_sync_set_event( slot, 1 ))
+        return STATUS_SUCCESS;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -423,11 +864,17 @@ NTSTATUS WINAPI NtSetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
  */
 NTSTATUS WINAPI NtResetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
 {
+    struct fast_sync_slot *slot;
+    unsigned int access;
     NTSTATUS ret;
 
     /* resetting an event can't release any thread... */
     if (NumberOfThreadsReleased) *NumberOfThreadsReleased = 0;
 
+    if ((slot = get_fast_sync_slot( handle, &access )) && (access & EVENT_MODIFY_STATE) &&
+        fast_sync_set_event( slot, 0 ))
+        return STATUS_SUCCESS;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -1084,9 +1531,19 @@ static NTSTATUS wait_objects( DWORD count, const HANDLE *handles,
 {
     select_op_t select_op;
     UINT i, flags = SELECT_INTERRUPTIBLE;
+    LARGE_INTEGER remaining;
+    NTSTATUS ret;
 
     if (!count || count > MAXIMUM_WAIT_OBJECTS) return STATUS_INVALID_PARAMETER_1;
 
+    /* alertable waits need the server to deliver user APCs */
+    if (!alertable)
+    {
+        if ((ret = fast_sync_wait( count, handles, wait_any, timeout, &remaining )) != STATUS_NOT_IMPLEMENTED)
+            return ret;
+        if (timeout) timeout = &remaining;
+    }
+
     if (alertable) flags |= SELECT_ALERTABLE;
     select_op.wait.op = wait_any ? SELECT_WAIT : SELECT_WAIT_ALL;
     for (i = 0; i < count; i++) select_op.wait.handles[i] = wine_server_obj_handle( handles[i] );
@@ -1402,31 +1859,38 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE CompletionPort, PULONG_PTR Completi
 NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE port, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
                                         ULONG *written, LARGE_INTEGER *timeout, BOOLEAN alertable )
 {
-    NTSTATUS ret;
-    ULONG i = 0;
+    struct completion_msg msgs[64];
+    NTSTATUS ret = STATUS_SUCCESS;
+    ULONG i = 0, j, size, nb;
 
     TRACE("%p %p %u %p %p %u\n", port, info, count, written, timeout, alertable);
 
     for (;;)
     {
+        /* retrieve as many queued completions as possible in each request */
         while (i < count)
         {
-            SERVER_START_REQ( remove_completion )
+            nb = min( count - i, ARRAY_SIZE(msgs) );
+            size = 0;
+            SERVER_START_REQ( remove_completions )
             {
                 req->handle = wine_server_obj_handle( port );
+                wine_server_set_reply( req, msgs, nb * sizeof(msgs[0]) );
                 if (!(ret = wine_server_call( req )))
-                {
-                    info[i].CompletionKey             = reply->ckey;
-                    info[i].CompletionValue           = reply->cvalue;
-                    info[i].IoStatusBlock.Information = reply->information;
-                    info[i].IoStatusBlock.u.Status    = reply->status;
-                }
+                    size = wine_server_reply_size( reply ) / sizeof(msgs[0]);
             }
             SERVER_END_REQ;
 
             if (ret != STATUS_SUCCESS) break;
 
-            ++i;
+            for (j = 0; j < size; j++, i++)
+            {
+                info[i].CompletionKey             = msgs[j].ckey;
+                info[i].CompletionValue           = msgs[j].cvalue;
+                info[i].IoStatusBlock.Information = msgs[j].information;
+                info[i].IoStatusBlock.u.Status    = msgs[j].status;
+            }
+            if (size < nb) break;  /* the queue is empty */
         }
 
         if (i || ret != STATUS_PENDING)
@@ -3625,6 +3625,75 @@ static void test_file_id_information(void)
     CloseHandle( h );
 }
 
+static void test_query_attributes_cache(void)
+{
+    static const WCHAR prefixW[] = {'a','t','t',0};
+    WCHAR temp_path[MAX_PATH], name[MAX_PATH], new_name[MAX_PATH];
+    FILE_NETWORK_OPEN_INFORMATION info;
+    FILE_ATTRIBUTE_TAG_INFORMATION tag;
+    FILE_BASIC_INFORMATION basic;
+    UNICODE_STRING nameW, new_nameW;
+    OBJECT_ATTRIBUTES attr;
+    IO_STATUS_BLOCK io;
+    NTSTATUS status;
+    DWORD written;
+    HANDLE h;
+    BOOL ret;
+
+    GetTempPathW( MAX_PATH, temp_path );
+    GetTempFileNameW( temp_path, prefixW, 0, name );
+    lstrcpyW( new_name, name );
+    new_name[lstrlenW(new_name) - 1] = 'x';
+    pRtlDosPathNameToNtPathName_U( name, &nameW, NULL, NULL );
+    pRtlDosPathNameToNtPathName_U( new_name, &new_nameW, NULL, NULL );
+    InitializeObjectAttributes( &attr, &nameW, OBJ_CASE_INSENSITIVE, 0, NULL );
+
+    status = pNtQueryFullAttributesFile( &attr, &info );
+    ok( status == STATUS_SUCCESS, "query failed %x\n", status );
+    ok( !info.EndOfFile.QuadPart, "got size %s\n", wine_dbgstr_longlong(info.EndOfFile.QuadPart) );
+
+    /* the file information is up to date after a write */
+    h = CreateFileW( name, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, 0 );
+    ok( h != INVALID_HANDLE_VALUE, "CreateFile failed %u\n", GetLastError() );
+    WriteFile( h, "data", 4, &written, NULL );
+    status = pNtQueryFullAttributesFile( &attr, &info );
+    ok( status == STATUS_SUCCESS, "query failed %x\n", status );
+    ok( info.EndOfFile.QuadPart == 4, "got size %s\n", wine_dbgstr_longlong(info.EndOfFile.QuadPart) );
+
+    status = pNtQueryInformationFile( h, &io, &tag, sizeof(tag), FileAttributeTagInformation );
+    ok( status == STATUS_SUCCESS, "FileAttributeTagInformation failed %x\n", status );
+    status = pNtQueryInformationFile( h, &io, &basic, sizeof(basic), FileBasicInformation );
+    ok( status == STATUS_SUCCESS, "FileBasicInformation failed %x\n", status );
+    ok( tag.FileAttributes == basic.FileAttributes, "got attributes %x / %x\n",
+        tag.FileAttributes, basic.FileAttributes );
+    ok( !tag.ReparseTag, "got reparse tag %x\n", tag.ReparseTag );
+    CloseHandle( h );
+
+    /* renames and deletions are visible right away */
+    ret = MoveFileW( name, new_name );
+    ok( ret, "MoveFile failed %u\n", GetLastError() );
+    status = pNtQueryAttributesFile( &attr, &basic );
+    ok( status == STATUS_OBJECT_NAME_NOT_FOUND, "query old name returned %x\n", status );
+    attr.ObjectName = &new_nameW;
+    status = pNtQueryAttributesFile( &attr, &basic );
+    ok( status == STATUS_SUCCESS, "query new name failed %x\n", status );
+
+    ret = DeleteFileW( new_name );
+    ok( ret, "DeleteFile failed %u\n", GetLastError() );
+    status = pNtQueryAttributesFile( &attr, &basic );
+    ok( status == STATUS_OBJECT_NAME_NOT_FOUND, "query deleted file returned %x\n", status );
+
+    ret = CreateDirectoryW( new_name, NULL );
+    ok( ret, "CreateDirectory failed %u\n", GetLastError() );
+    status = pNtQueryAttributesFile( &attr, &basic );
+    ok( status == STATUS_SUCCESS, "query directory failed %x\n", status );
+    ok( basic.FileAttributes & FILE_ATTRIBUTE_DIRECTORY, "got attributes %x\n", basic.FileAttributes );
+    RemoveDirectoryW( new_name );
+
+    pRtlFreeUnicodeString( &nameW );
+    pRtlFreeUnicodeString( &new_nameW );
+}
+
 static void test_file_access_information(void)
 {
     FILE_ACCESS_INFORMATION info;
@@ -4825,6 +4894,7 @@ START_TEST(file)
     test_file_completion_information();
     test_file_id_information();
     test_file_access_information();
+    test_query_attributes_cache();
     test_file_mode();
     test_query_volume_information_file();
     test_query_attribute_information_file();
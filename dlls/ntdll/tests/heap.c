@@ -0,0 +1,330 @@
+/*
+ * Unit test suite for ntdll heap functions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "ntdll_test.h"
+
+static NTSTATUS (WINAPI *pRtlQueryHeapInformation)(HANDLE,HEAP_INFORMATION_CLASS,void*,SIZE_T,SIZE_T*);
+static NTSTATUS (WINAPI *pRtlSetHeapInformation)(HANDLE,HEAP_INFORMATION_CLASS,void*,SIZE_T);
+
+#define NB_THREADS 4
+#define NB_BLOCKS  256
+
+static HANDLE thread_heap;
+static void *thread_blocks[NB_THREADS][NB_BLOCKS];
+
+static BOOL enable_lfh( HANDLE heap )
+{
+    ULONG info = 2;
+    NTSTATUS status;
+    SIZE_T size;
+
+    status = pRtlSetHeapInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    if (status) return FALSE;
+    info = 0xdeadbeef;
+    status = pRtlQueryHeapInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), &size );
+    ok( !status, "RtlQueryHeapInformation failed %x\n", status );
+    ok( info == 2, "got %u\n", info );
+    return TRUE;
+}
+
+static void test_lfh_enable(void)
+{
+    ULONG info;
+    NTSTATUS status;
+    HANDLE heap;
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed %u\n", GetLastError() );
+    info = 2;
+    status = pRtlSetHeapInformation( heap, HeapCompatibilityInformation, &info, 0 );
+    ok( status == STATUS_BUFFER_TOO_SMALL, "got %x\n", status );
+    ok( enable_lfh( heap ), "failed to enable the low fragmentation heap\n" );
+    ok( enable_lfh( heap ), "failed to enable the low fragmentation heap again\n" );
+    HeapDestroy( heap );
+
+    heap = HeapCreate( HEAP_NO_SERIALIZE, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed %u\n", GetLastError() );
+    info = 2;
+    status = pRtlSetHeapInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( status != STATUS_SUCCESS, "low fragmentation heap enabled with HEAP_NO_SERIALIZE\n" );
+    HeapDestroy( heap );
+}
+
+static void test_lfh_blocks(void)
+{
+    BYTE *ptrs[64], *ptr;
+    SIZE_T i, j, size;
+    HANDLE heap;
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed %u\n", GetLastError() );
+    if (!enable_lfh( heap ))
+    {
+        skip( "low fragmentation heap not supported\n" );
+        HeapDestroy( heap );
+        return;
+    }
+
+    for (size = 0; size < 0x5000; size += size / 8 + 1)
+    {
+        for (i = 0; i < ARRAY_SIZE(ptrs); i++)
+        {
+            ptrs[i] = HeapAlloc( heap, HEAP_ZERO_MEMORY, size );
+            ok( ptrs[i] != NULL, "HeapAlloc %lu failed\n", size );
+            ok( !((ULONG_PTR)ptrs[i] % (2 * sizeof(void *))), "%p is not aligned\n", ptrs[i] );
+            ok( HeapSize( heap, 0, ptrs[i] ) == size, "got size %lu for %lu\n",
+                HeapSize( heap, 0, ptrs[i] ), size );
+            for (j = 0; j < size; j++) if (ptrs[i][j]) break;
+            ok( j == size, "block of size %lu not zeroed at %lu\n", size, j );
+            memset( ptrs[i], i, size );
+        }
+        for (i = 0; i < ARRAY_SIZE(ptrs); i++)
+        {
+            ok( HeapValidate( heap, 0, ptrs[i] ), "HeapValidate failed for %p\n", ptrs[i] );
+            ptr = HeapReAlloc( heap, HEAP_ZERO_MEMORY, ptrs[i], size * 2 + 1 );
+            ok( ptr != NULL, "HeapReAlloc %lu failed\n", size * 2 + 1 );
+            for (j = 0; j < size; j++) if (ptr[j] != (BYTE)i) break;
+            ok( j == size, "block of size %lu changed at %lu\n", size, j );
+            for (j = size; j < size * 2 + 1; j++) if (ptr[j]) break;
+            ok( j == size * 2 + 1, "block of size %lu not zeroed at %lu\n", size * 2 + 1, j );
+            ok( HeapFree( heap, 0, ptr ), "HeapFree failed\n" );
+        }
+    }
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+    HeapDestroy( heap );
+}
+
+static DWORD WINAPI lfh_thread( void *arg )
+{
+    void **blocks = thread_blocks[(ULONG_PTR)arg];
+    void *local[16];
+    unsigned int i, j;
+
+    for (i = 0; i < 1000; i++)
+    {
+        for (j = 0; j < ARRAY_SIZE(local); j++)
+        {
+            local[j] = HeapAlloc( thread_heap, 0, (i * 7 + j * 13) % 600 );
+            ok( local[j] != NULL, "HeapAlloc failed\n" );
+        }
+        for (j = 0; j < ARRAY_SIZE(local); j++) HeapFree( thread_heap, 0, local[j] );
+    }
+    /* blocks freed by the main thread after the thread has exited */
+    for (i = 0; i < NB_BLOCKS; i++)
+    {
+        blocks[i] = HeapAlloc( thread_heap, 0, i );
+        memset( blocks[i], 0x55, i );
+    }
+    return 0;
+}
+
+static void test_lfh_threads(void)
+{
+    HANDLE threads[NB_THREADS];
+    unsigned int i, j;
+    BYTE *ptr;
+
+    thread_heap = HeapCreate( 0, 0, 0 );
+    ok( thread_heap != NULL, "HeapCreate failed %u\n", GetLastError() );
+    if (!enable_lfh( thread_heap ))
+    {
+        skip( "low fragmentation heap not supported\n" );
+        HeapDestroy( thread_heap );
+        return;
+    }
+
+    for (i = 0; i < NB_THREADS; i++)
+        threads[i] = CreateThread( NULL, 0, lfh_thread, (void *)(ULONG_PTR)i, 0, NULL );
+    WaitForMultipleObjects( NB_THREADS, threads, TRUE, INFINITE );
+
+    for (i = 0; i < NB_THREADS; i++)
+    {
+        CloseHandle( threads[i] );
+        for (j = 0; j < NB_BLOCKS; j++)
+        {
+            ptr = thread_blocks[i][j];
+            ok( HeapSize( thread_heap, 0, ptr ) == j, "got size %lu\n", HeapSize( thread_heap, 0, ptr ));
+            ok( !j || (ptr[0] == 0x55 && ptr[j - 1] == 0x55), "block %u of thread %u corrupted\n", j, i );
+            ok( HeapFree( thread_heap, 0, ptr ), "HeapFree failed\n" );
+        }
+    }
+
+    /* the groups of the exited threads get reused */
+    for (j = 0; j < NB_BLOCKS; j++) thread_blocks[0][j] = HeapAlloc( thread_heap, 0, j );
+    for (j = 0; j < NB_BLOCKS; j++) ok( HeapFree( thread_heap, 0, thread_blocks[0][j] ), "HeapFree failed\n" );
+
+    ok( HeapValidate( thread_heap, 0, NULL ), "HeapValidate failed\n" );
+    HeapDestroy( thread_heap );
+}
+
+static unsigned int count_busy_blocks( HANDLE heap )
+{
+    PROCESS_HEAP_ENTRY entry;
+    unsigned int count = 0;
+
+    HeapLock( heap );
+    entry.lpData = NULL;
+    while (HeapWalk( heap, &entry )) if (entry.wFlags & PROCESS_HEAP_ENTRY_BUSY) count++;
+    HeapUnlock( heap );
+    return count;
+}
+
+static void test_lfh_create_destroy(void)
+{
+    unsigned int i, j, before, after;
+    void *ptrs[16];
+    HANDLE heap;
+
+    before = count_busy_blocks( GetProcessHeap() );
+    for (i = 0; i < 500; i++)
+    {
+        heap = HeapCreate( 0, 0, 0 );
+        ok( heap != NULL, "HeapCreate failed %u\n", GetLastError() );
+        if (!enable_lfh( heap ))
+        {
+            skip( "low fragmentation heap not supported\n" );
+            HeapDestroy( heap );
+            return;
+        }
+        for (j = 0; j < ARRAY_SIZE(ptrs); j++)
+        {
+            ptrs[j] = HeapAlloc( heap, 0, j * 8 );
+            ok( ptrs[j] != NULL, "HeapAlloc failed\n" );
+        }
+        for (j = 0; j < ARRAY_SIZE(ptrs); j += 2) ok( HeapFree( heap, 0, ptrs[j] ), "HeapFree failed\n" );
+        ok( HeapDestroy( heap ), "HeapDestroy failed\n" );
+    }
+    /* the thread caches of the destroyed heaps don't accumulate in the process heap */
+    after = count_busy_blocks( GetProcessHeap() );
+    ok( after < before + 16, "process heap grew from %u to %u blocks\n", before, after );
+}
+
+static DWORD WINAPI terminated_thread( void *arg )
+{
+    HANDLE event = arg;
+    unsigned int i;
+
+    for (i = 0; i < NB_BLOCKS; i++)
+    {
+        thread_blocks[0][i] = HeapAlloc( thread_heap, 0, i );
+        memset( thread_blocks[0][i], 0x55, i );
+    }
+    SetEvent( event );
+    Sleep( INFINITE );
+    return 0;
+}
+
+static void test_lfh_terminated_thread(void)
+{
+    HANDLE thread, event;
+    unsigned int i;
+    BYTE *ptr;
+
+    thread_heap = HeapCreate( 0, 0, 0 );
+    ok( thread_heap != NULL, "HeapCreate failed %u\n", GetLastError() );
+    if (!enable_lfh( thread_heap ))
+    {
+        skip( "low fragmentation heap not supported\n" );
+        HeapDestroy( thread_heap );
+        return;
+    }
+
+    event = CreateEventA( NULL, FALSE, FALSE, NULL );
+    thread = CreateThread( NULL, 0, terminated_thread, event, 0, NULL );
+    WaitForSingleObject( event, INFINITE );
+    TerminateThread( thread, 0 );
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+    CloseHandle( event );
+
+    for (i = 0; i < NB_BLOCKS; i++)
+    {
+        ptr = thread_blocks[0][i];
+        ok( HeapSize( thread_heap, 0, ptr ) == i, "got size %lu\n", HeapSize( thread_heap, 0, ptr ));
+        ok( !i || (ptr[0] == 0x55 && ptr[i - 1] == 0x55), "block %u corrupted\n", i );
+        ok( HeapFree( thread_heap, 0, ptr ), "HeapFree failed\n" );
+    }
+    for (i = 0; i < NB_BLOCKS; i++) thread_blocks[0][i] = HeapAlloc( thread_heap, 0, i );
+    for (i = 0; i < NB_BLOCKS; i++) ok( HeapFree( thread_heap, 0, thread_blocks[0][i] ), "HeapFree failed\n" );
+
+    ok( HeapValidate( thread_heap, 0, NULL ), "HeapValidate failed\n" );
+    HeapDestroy( thread_heap );
+}
+
+static DWORD WINAPI benchmark_thread( void *arg )
+{
+    HANDLE heap = arg;
+    void *ptrs[64];
+    unsigned int i, j;
+
+    for (i = 0; i < 2000; i++)
+    {
+        for (j = 0; j < ARRAY_SIZE(ptrs); j++) ptrs[j] = HeapAlloc( heap, 0, 16 + (j * 24) % 512 );
+        for (j = 0; j < ARRAY_SIZE(ptrs); j++) HeapFree( heap, 0, ptrs[j] );
+    }
+    return 0;
+}
+
+static DWORD run_benchmark( BOOL lfh )
+{
+    HANDLE threads[NB_THREADS], heap;
+    DWORD start, i;
+
+    heap = HeapCreate( 0, 0, 0 );
+    if (lfh && !enable_lfh( heap ))
+    {
+        HeapDestroy( heap );
+        return 0;
+    }
+    start = GetTickCount();
+    for (i = 0; i < NB_THREADS; i++) threads[i] = CreateThread( NULL, 0, benchmark_thread, heap, 0, NULL );
+    WaitForMultipleObjects( NB_THREADS, threads, TRUE, INFINITE );
+    for (i = 0; i < NB_THREADS; i++) CloseHandle( threads[i] );
+    start = GetTickCount() - start;
+    HeapDestroy( heap );
+    return start;
+}
+
+static void test_lfh_benchmark(void)
+{
+    DWORD standard = run_benchmark( FALSE );
+    DWORD lfh = run_benchmark( TRUE );
+
+    trace( "%u threads allocating and freeing blocks: standard heap %u ms, low fragmentation heap %u ms\n",
+           NB_THREADS, standard, lfh );
+}
+
+START_TEST(heap)
+{
+    HMODULE hntdll = GetModuleHandleA( "ntdll.dll" );
+
+    pRtlQueryHeapInformation = (void *)GetProcAddress( hntdll, "RtlQueryHeapInformation" );
+    pRtlSetHeapInformation = (void *)GetProcAddress( hntdll, "RtlSetHeapInformation" );
+    if (!pRtlQueryHeapInformation || !pRtlSetHeapInformation)
+    {
+        win_skip( "RtlSetHeapInformation is not available\n" );
+        return;
+    }
+
+    test_lfh_enable();
+    test_lfh_blocks();
+    test_lfh_threads();
+    test_lfh_create_destroy();
+    test_lfh_terminated_thread();
+    test_lfh_benchmark();
+}
@@ -1638,6 +1638,161 @@ static void test_event(void)
     pNtClose(Event2);
 }
 
+struct wait_thread_params
+{
+    HANDLE handle;
+    DWORD timeout;
+    DWORD result;
+    DWORD elapsed;
+};
+
+static DWORD WINAPI wait_thread( void *arg )
+{
+    struct wait_thread_params *params = arg;
+    DWORD start = GetTickCount();
+
+    params->result = WaitForSingleObject( params->handle, params->timeout );
+    params->elapsed = GetTickCount() - start;
+    return 0;
+}
+
+static void fast_sync_child( void )
+{
+    HANDLE event, semaphore;
+    DWORD ret;
+
+    event = OpenEventA( EVENT_ALL_ACCESS, FALSE, "WineTestFastSyncEvent" );
+    ok( event != NULL, "OpenEvent failed %u\n", GetLastError() );
+    semaphore = OpenSemaphoreA( SEMAPHORE_ALL_ACCESS, FALSE, "WineTestFastSyncSemaphore" );
+    ok( semaphore != NULL, "OpenSemaphore failed %u\n", GetLastError() );
+
+    ret = ReleaseSemaphore( semaphore, 2, NULL );
+    ok( ret, "ReleaseSemaphore failed %u\n", GetLastError() );
+    ret = WaitForSingleObject( event, 5000 );
+    ok( ret == WAIT_OBJECT_0, "got %u\n", ret );
+
+    CloseHandle( event );
+    CloseHandle( semaphore );
+}
+
+/* with WINEFASTSYNC set, events and semaphores are waited upon without the server */
+static void test_fast_sync(char **argv)
+{
+    struct wait_thread_params params[3];
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION pi;
+    HANDLE event, semaphore, threads[3], objs[2];
+    char cmdline[MAX_PATH];
+    DWORD ret, start;
+    LONG prev;
+    int i, count;
+
+    /* signaling across processes */
+    event = CreateEventA( NULL, FALSE, FALSE, "WineTestFastSyncEvent" );
+    ok( event != NULL, "CreateEvent failed %u\n", GetLastError() );
+    semaphore = CreateSemaphoreA( NULL, 0, 2, "WineTestFastSyncSemaphore" );
+    ok( semaphore != NULL, "CreateSemaphore failed %u\n", GetLastError() );
+
+    sprintf( cmdline, "\"%s\" om fast_sync_child", argv[0] );
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi );
+    ok( ret, "CreateProcess failed %u\n", GetLastError() );
+    ret = WaitForSingleObject( semaphore, 5000 );
+    ok( ret == WAIT_OBJECT_0, "got %u\n", ret );
+    ret = WaitForSingleObject( semaphore, 5000 );
+    ok( ret == WAIT_OBJECT_0, "got %u\n", ret );
+    ret = WaitForSingleObject( semaphore, 0 );
+    ok( ret == WAIT_TIMEOUT, "got %u\n", ret );
+    SetEvent( event );
+    winetest_wait_child_process( pi.hProcess );
+    CloseHandle( pi.hProcess );
+    CloseHandle( pi.hThread );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_TIMEOUT, "got %u\n", ret );
+
+    ret = ReleaseSemaphore( semaphore, 3, &prev );
+    ok( !ret && GetLastError() == ERROR_TOO_MANY_POSTS, "got %u / %u\n", ret, GetLastError() );
+    CloseHandle( semaphore );
+
+    /* timeouts */
+    start = GetTickCount();
+    ret = WaitForSingleObject( event, 100 );
+    ok( ret == WAIT_TIMEOUT, "got %u\n", ret );
+    ok( GetTickCount() - start >= 80, "waited only %u ms\n", GetTickCount() - start );
+
+    /* pulsing a manual-reset event releases all the waiters */
+    CloseHandle( event );
+    event = CreateEventA( NULL, TRUE, FALSE, NULL );
+    for (i = 0; i < 3; i++)
+    {
+        params[i].handle = event;
+        params[i].timeout = 5000;
+        threads[i] = CreateThread( NULL, 0, wait_thread, &params[i], 0, NULL );
+    }
+    Sleep( 200 );
+    PulseEvent( event );
+    ret = WaitForMultipleObjects( 3, threads, TRUE, 10000 );
+    ok( ret == WAIT_OBJECT_0, "got %u\n", ret );
+    for (i = 0; i < 3; i++)
+    {
+        ok( params[i].result == WAIT_OBJECT_0, "%u: got %u\n", i, params[i].result );
+        CloseHandle( threads[i] );
+    }
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_TIMEOUT, "got %u\n", ret );
+    CloseHandle( event );
+
+    /* pulsing an auto-reset event releases a single one */
+    event = CreateEventA( NULL, FALSE, FALSE, NULL );
+    for (i = 0; i < 2; i++)
+    {
+        params[i].handle = event;
+        params[i].timeout = 1000;
+        threads[i] = CreateThread( NULL, 0, wait_thread, &params[i], 0, NULL );
+    }
+    Sleep( 200 );
+    PulseEvent( event );
+    ret = WaitForMultipleObjects( 2, threads, TRUE, 10000 );
+    ok( ret == WAIT_OBJECT_0, "got %u\n", ret );
+    for (i = count = 0; i < 2; i++)
+    {
+        if (params[i].result == WAIT_OBJECT_0) count++;
+        else ok( params[i].result == WAIT_TIMEOUT, "%u: got %u\n", i, params[i].result );
+        CloseHandle( threads[i] );
+    }
+    ok( count == 1, "%u threads released\n", count );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_TIMEOUT, "got %u\n", ret );
+
+    /* a wait on a mixed set of objects makes a blocked waiter go through the server */
+    params[0].handle = event;
+    params[0].timeout = 5000;
+    threads[0] = CreateThread( NULL, 0, wait_thread, &params[0], 0, NULL );
+    Sleep( 100 );
+    objs[0] = event;
+    objs[1] = threads[0];
+    ret = WaitForMultipleObjects( 2, objs, FALSE, 100 );
+    ok( ret == WAIT_TIMEOUT, "got %u\n", ret );
+    SetEvent( event );
+    ret = WaitForSingleObject( threads[0], 5000 );
+    ok( ret == WAIT_OBJECT_0, "got %u\n", ret );
+    ok( params[0].result == WAIT_OBJECT_0, "got %u\n", params[0].result );
+    CloseHandle( threads[0] );
+
+    /* and the time it already waited counts against its timeout */
+    params[0].timeout = 400;
+    threads[0] = CreateThread( NULL, 0, wait_thread, &params[0], 0, NULL );
+    Sleep( 300 );
+    objs[1] = threads[0];
+    ret = WaitForMultipleObjects( 2, objs, FALSE, 50 );
+    ok( ret == WAIT_TIMEOUT, "got %u\n", ret );
+    ret = WaitForSingleObject( threads[0], 5000 );
+    ok( ret == WAIT_OBJECT_0, "got %u\n", ret );
+    ok( params[0].result == WAIT_TIMEOUT, "got %u\n", params[0].result );
+    ok( params[0].elapsed < 650, "waited %u ms\n", params[0].elapsed );
+    CloseHandle( threads[0] );
+    CloseHandle( event );
+}
+
 static const WCHAR keyed_nameW[] = {'\\','B','a','s','e','N','a','m','e','d','O','b','j','e','c','t','s',
                                     '\\','W','i','n','e','T','e','s','t','E','v','e','n','t',0};
 
@@ -2117,6 +2272,15 @@ START_TEST(om)
 {
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
     HMODULE hkernel32 = GetModuleHandleA("kernel32.dll");
+    char **argv;
+    int argc;
+
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 3 && !strcmp( argv[2], "fast_sync_child" ))
+    {
+        fast_sync_child();
+        return;
+    }
 
     if (!hntdll)
     {
@@ -2180,6 +2344,7 @@ START_TEST(om)
     test_query_object();
     test_type_mismatch();
     test_event();
+    test_fast_sync( argv );
     test_mutant();
     test_keyed_events();
     test_null_device();
@@ -336,6 +336,86 @@ static void test_RtlQueryRegistryValues(void)
     pRtlFreeHeap(GetProcessHeap(), 0, QueryTable);
 }
 
+#define NB_ENUM_VALUES 40
+
+static ULONG enum_value_size( ULONG index )
+{
+    /* some values don't fit in the buffers used for the first try */
+    return (index % 5) ? index + 1 : 1000 + index;
+}
+
+static NTSTATUS WINAPI enum_values_routine( PCWSTR name, ULONG type, PVOID data, ULONG len,
+                                            PVOID context, PVOID entry )
+{
+    ULONG *index = context, i;
+    WCHAR expect[4];
+
+    expect[0] = 'v';
+    expect[1] = '0' + *index / 10;
+    expect[2] = '0' + *index % 10;
+    expect[3] = 0;
+    ok( !lstrcmpW( name, expect ), "%u: got name %s\n", *index, wine_dbgstr_w(name) );
+    ok( type == REG_BINARY, "%u: got type %u\n", *index, type );
+    ok( len == enum_value_size( *index ), "%u: got len %u\n", *index, len );
+    for (i = 0; i < len; i++) if (((BYTE *)data)[i] != (BYTE)*index) break;
+    ok( i == len, "%u: wrong data at %u\n", *index, i );
+    (*index)++;
+    return STATUS_SUCCESS;
+}
+
+static void test_RtlQueryRegistryValues_enum(void)
+{
+    static const WCHAR valuesW[] = {'V','a','l','u','e','s',0};
+    RTL_QUERY_REGISTRY_TABLE table[2];
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING str;
+    HANDLE root, key;
+    NTSTATUS status;
+    WCHAR name[4];
+    BYTE data[1100];
+    ULONG i, index;
+
+    InitializeObjectAttributes( &attr, &winetestpath, 0, 0, 0 );
+    status = pNtOpenKey( &root, KEY_ALL_ACCESS, &attr );
+    ok( status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08x\n", status );
+    pRtlInitUnicodeString( &str, valuesW );
+    InitializeObjectAttributes( &attr, &str, 0, root, 0 );
+    status = pNtCreateKey( &key, KEY_ALL_ACCESS, &attr, 0, NULL, 0, NULL );
+    ok( status == STATUS_SUCCESS, "NtCreateKey failed: 0x%08x\n", status );
+
+    name[0] = 'v';
+    name[3] = 0;
+    for (i = 0; i < NB_ENUM_VALUES; i++)
+    {
+        name[1] = '0' + i / 10;
+        name[2] = '0' + i % 10;
+        memset( data, i, enum_value_size( i ));
+        pRtlInitUnicodeString( &str, name );
+        status = pNtSetValueKey( key, &str, 0, REG_BINARY, data, enum_value_size( i ));
+        ok( status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08x\n", status );
+    }
+
+    memset( table, 0, sizeof(table) );
+    table[0].QueryRoutine = enum_values_routine;
+    index = 0;
+    status = pRtlQueryRegistryValues( RTL_REGISTRY_HANDLE, (PCWSTR)key, table, &index, NULL );
+    ok( status == STATUS_SUCCESS, "RtlQueryRegistryValues failed: 0x%08x\n", status );
+    ok( index == NB_ENUM_VALUES, "got %u values\n", index );
+
+    /* name still holds the last value */
+    pRtlInitUnicodeString( &str, name );
+    status = pNtDeleteValueKey( key, &str );
+    ok( status == STATUS_SUCCESS, "NtDeleteValueKey failed: 0x%08x\n", status );
+    index = 0;
+    status = pRtlQueryRegistryValues( RTL_REGISTRY_HANDLE, (PCWSTR)key, table, &index, NULL );
+    ok( status == STATUS_SUCCESS, "RtlQueryRegistryValues failed: 0x%08x\n", status );
+    ok( index == NB_ENUM_VALUES - 1, "got %u values\n", index );
+
+    pNtDeleteKey( key );
+    pNtClose( key );
+    pNtClose( root );
+}
+
 static void test_NtOpenKey(void)
 {
     HANDLE key;
@@ -838,6 +918,67 @@ static void test_NtQueryValueKey(void)
     pNtClose(key);
 }
 
+static HANDLE benchmark_key;
+static LONG benchmark_stop;
+
+static DWORD WINAPI benchmark_thread( void *arg )
+{
+    char buffer[64];
+    UNICODE_STRING name;
+    NTSTATUS status = STATUS_SUCCESS;
+    DWORD len, count = 0;
+
+    pRtlCreateUnicodeStringFromAsciiz( &name, "deletetest" );
+    while (!benchmark_stop)
+    {
+        status = pNtQueryValueKey( benchmark_key, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len );
+        if (status) break;
+        count++;
+    }
+    ok( !status, "NtQueryValueKey failed: 0x%08x\n", status );
+    pRtlFreeUnicodeString( &name );
+    return count;
+}
+
+/* measure the number of registry requests per second the server handles with concurrent clients;
+ * this is mostly useful to compare a default wineserver with one started with --threads */
+static void test_query_value_benchmark(void)
+{
+    HANDLE threads[8];
+    OBJECT_ATTRIBUTES attr;
+    NTSTATUS status;
+    DWORD i, n, start, count, total;
+
+    if (!winetest_interactive)
+    {
+        skip( "registry benchmark, set WINETEST_INTERACTIVE to run it\n" );
+        return;
+    }
+
+    InitializeObjectAttributes( &attr, &winetestpath, 0, 0, 0 );
+    status = pNtOpenKey( &benchmark_key, KEY_READ, &attr );
+    ok( status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08x\n", status );
+
+    for (n = 1; n <= ARRAY_SIZE(threads); n *= 2)
+    {
+        benchmark_stop = 0;
+        for (i = 0; i < n; i++) threads[i] = CreateThread( NULL, 0, benchmark_thread, NULL, 0, NULL );
+        start = GetTickCount();
+        Sleep( 2000 );
+        InterlockedExchange( &benchmark_stop, 1 );
+        WaitForMultipleObjects( n, threads, TRUE, INFINITE );
+        start = GetTickCount() - start;
+        for (i = total = 0; i < n; i++)
+        {
+            GetExitCodeThread( threads[i], &count );
+            total += count;
+            CloseHandle( threads[i] );
+        }
+        trace( "%u client threads: %u requests/sec\n", n, MulDiv( total, 1000, start ));
+    }
+    pNtClose( benchmark_key );
+}
+
 static void test_NtDeleteKey(void)
 {
     NTSTATUS status;
@@ -2030,6 +2171,7 @@ START_TEST(reg)
     test_RtlCheckRegistryKey();
     test_RtlOpenCurrentUser();
     test_RtlQueryRegistryValues();
+    test_RtlQueryRegistryValues_enum();
     test_RtlpNtQueryValueKey();
     test_NtFlushKey();
     test_NtQueryKey();
@@ -2038,6 +2180,7 @@ START_TEST(reg)
     test_long_value_name();
     test_notify();
     test_RtlCreateRegistryKey();
+    test_query_value_benchmark();
     test_NtDeleteKey();
     test_symlinks();
     test_redirection();
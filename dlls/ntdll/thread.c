@@ -306,6 +306,8 @@ void abort_thread( int status )
  */
 void exit_thread( int status )
 {
+    if (ntdll_get_thread_data()->request_shm)
+        munmap( ntdll_get_thread_data()->request_shm, REQUEST_SHM_SIZE );
     close( ntdll_get_thread_data()->wait_fd[0] );
     close( ntdll_get_thread_data()->wait_fd[1] );
     close( ntdll_get_thread_data()->reply_fd );
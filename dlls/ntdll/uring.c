@@ -0,0 +1,530 @@
+/*
+ * Asynchronous file I/O through io_uring
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Overlapped reads and writes on regular files are normally performed
+ * synchronously by the calling thread. When WINEIOURING is set in the
+ * environment, they are instead submitted to an io_uring instance, so that
+ * many requests can be in flight at the same time. A reaper thread, started
+ * on demand and exiting once nothing is in flight, waits for completions,
+ * fills the IO_STATUS_BLOCK, signals the event and posts the completion port
+ * packet. Requests that can't be submitted fall back to the synchronous path.
+ *
+ * The server doesn't know about these requests, so they are only used when
+ * the caller waits on an event rather than on the file handle, and the
+ * completion port is looked up when submitting since the handle may be
+ * closed by then. NtCancelIoFile and NtCancelIoFileEx cancel them through
+ * the ring.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#define NONAMELESSUNION
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+#include "wine/list.h"
+#include "wine/server.h"
+#include "wine/debug.h"
+#include "ntdll_misc.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(file);
+
+#if defined(__linux__) && !defined(__NR_io_uring_setup) && \
+    (defined(__i386__) || defined(__x86_64__) || defined(__arm__) || defined(__aarch64__))
+# define __NR_io_uring_setup 425
+# define __NR_io_uring_enter 426
+#endif
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && defined(HAVE_SYS_MMAN_H) && defined(HAVE_SYS_UIO_H)
+
+/* kernel interface, see linux/io_uring.h */
+
+struct uring_sqring_offsets
+{
+    unsigned int head;
+    unsigned int tail;
+    unsigned int ring_mask;
+    unsigned int ring_entries;
+    unsigned int flags;
+    unsigned int dropped;
+    unsigned int array;
+    unsigned int resv1;
+    ULONGLONG    resv2;
+};
+
+struct uring_cqring_offsets
+{
+    unsigned int head;
+    unsigned int tail;
+    unsigned int ring_mask;
+    unsigned int ring_entries;
+    unsigned int overflow;
+    unsigned int cqes;
+    unsigned int flags;
+    unsigned int resv1;
+    ULONGLONG    resv2;
+};
+
+struct uring_params
+{
+    unsigned int sq_entries;
+    unsigned int cq_entries;
+    unsigned int flags;
+    unsigned int sq_thread_cpu;
+    unsigned int sq_thread_idle;
+    unsigned int features;
+    unsigned int wq_fd;
+    unsigned int resv[3];
+    struct uring_sqring_offsets sq_off;
+    struct uring_cqring_offsets cq_off;
+};
+
+struct uring_sqe
+{
+    BYTE         opcode;
+    BYTE         flags;
+    WORD         ioprio;
+    int          fd;
+    ULONGLONG    off;
+    ULONGLONG    addr;
+    unsigned int len;
+    unsigned int rw_flags;
+    ULONGLONG    user_data;
+    ULONGLONG    pad[3];
+};
+
+struct uring_cqe
+{
+    ULONGLONG    user_data;
+    int          res;
+    unsigned int flags;
+};
+
+#define IORING_OP_READV          1
+#define IORING_OP_WRITEV         2
+#define IORING_OP_ASYNC_CANCEL   14
+#define IORING_ENTER_GETEVENTS   1
+#define IORING_OFF_SQ_RING       0
+#define IORING_OFF_CQ_RING       0x8000000
+#define IORING_OFF_SQES          0x10000000
+
+#define URING_ENTRIES  256
+
+/* an I/O request in flight */
+struct uring_request
+{
+    struct list      entry;    /* entry in the list of requests in flight */
+    HANDLE           handle;   /* file handle, for cancellation */
+    DWORD            tid;      /* id of the submitting thread */
+    HANDLE           event;    /* event to signal on completion */
+    IO_STATUS_BLOCK *io;       /* I/O status block of the caller */
+    HANDLE           port;     /* completion port to post to, 0 if none */
+    ULONG_PTR        ckey;     /* completion key */
+    ULONG_PTR        cvalue;   /* completion value */
+    int              fd;       /* private copy of the Unix fd */
+    BOOL             write;    /* is it a write request? */
+    off_t            offset;   /* file offset */
+    struct iovec     iov;      /* data buffer */
+};
+
+static struct
+{
+    int               fd;          /* io_uring file descriptor */
+    unsigned int     *sq_head;     /* submission queue head, updated by the kernel */
+    unsigned int     *sq_tail;     /* submission queue tail */
+    unsigned int      sq_mask;     /* submission queue index mask */
+    unsigned int     *sq_array;    /* submission queue indices */
+    struct uring_sqe *sqes;        /* submission queue entries */
+    unsigned int     *cq_head;     /* completion queue head */
+    unsigned int     *cq_tail;     /* completion queue tail, updated by the kernel */
+    unsigned int      cq_mask;     /* completion queue index mask */
+    unsigned int      cq_entries;  /* completion queue size */
+    struct uring_cqe *cqes;        /* completion queue entries */
+} ring;
+
+static int uring_enabled = -1;   /* is io_uring enabled? */
+static LONG uring_inflight;      /* number of entries not reaped yet, cancellations included */
+static struct list uring_requests = LIST_INIT( uring_requests );
+static BOOL reaper_running;      /* is the reaper thread running? */
+
+static RTL_CRITICAL_SECTION uring_section;
+static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
+{
+    0, 0, &uring_section,
+    { &critsect_debug.ProcessLocksList, &critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": uring_section") }
+};
+static RTL_CRITICAL_SECTION uring_section = { &critsect_debug, -1, 0, 0, 0, 0 };
+
+static inline int io_uring_setup( unsigned int entries, struct uring_params *params )
+{
+    return syscall( __NR_io_uring_setup, entries, params );
+}
+
+static inline int io_uring_enter( unsigned int to_submit, unsigned int min_complete, unsigned int flags )
+{
+    return syscall( __NR_io_uring_enter, ring.fd, to_submit, min_complete, flags, NULL, 0 );
+}
+
+/* create the ring; must be called with uring_section held */
+static BOOL init_uring(void)
+{
+    const char *env = getenv( "WINEIOURING" );
+    struct uring_params params;
+    char *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size, sqes_size;
+    void *sqes;
+    int fd;
+
+    if (!env || !atoi( env )) return FALSE;
+
+    memset( &params, 0, sizeof(params) );
+    if ((fd = io_uring_setup( URING_ENTRIES, &params )) == -1)
+    {
+        WARN( "io_uring not available, errno %d\n", errno );
+        return FALSE;
+    }
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct uring_cqe);
+    sqes_size = params.sq_entries * sizeof(struct uring_sqe);
+
+    sq_ptr = mmap( NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+    if (sq_ptr == MAP_FAILED) goto failed;
+    cq_ptr = mmap( NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+    if (cq_ptr == MAP_FAILED)
+    {
+        munmap( sq_ptr, sq_size );
+        goto failed;
+    }
+    sqes = mmap( NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+    if (sqes == MAP_FAILED)
+    {
+        munmap( cq_ptr, cq_size );
+        munmap( sq_ptr, sq_size );
+        goto failed;
+    }
+
+    ring.fd         = fd;
+    ring.sq_head    = (unsigned int *)(sq_ptr + params.sq_off.head);
+    ring.sq_tail    = (unsigned int *)(sq_ptr + params.sq_off.tail);
+    ring.sq_mask    = *(unsigned int *)(sq_ptr + params.sq_off.ring_mask);
+    ring.sq_array   = (unsigned int *)(sq_ptr + params.sq_off.array);
+    ring.sqes       = sqes;
+    ring.cq_head    = (unsigned int *)(cq_ptr + params.cq_off.head);
+    ring.cq_tail    = (unsigned int *)(cq_ptr + params.cq_off.tail);
+    ring.cq_mask    = *(unsigned int *)(cq_ptr + params.cq_off.ring_mask);
+    ring.cq_entries = params.cq_entries;
+    ring.cqes       = (struct uring_cqe *)(cq_ptr + params.cq_off.cqes);
+    TRACE( "using io_uring with %u/%u entries\n", params.sq_entries, params.cq_entries );
+    return TRUE;
+
+failed:
+    WARN( "failed to map io_uring, errno %d\n", errno );
+    close( fd );
+    return FALSE;
+}
+
+/* complete a request once the kernel is done with it */
+static void complete_request( struct uring_request *req, int res )
+{
+    NTSTATUS status;
+    ULONG total = 0;
+    ssize_t ret;
+
+    /* The kernel stops at the first page it can't write to, which may only need to
+     * be committed or have its write watches reset. Read the rest like the
+     * synchronous path does; this also finds out whether a short read hit the end
+     * of the file. */
+    if (!req->write && (res == -EFAULT || (res >= 0 && (size_t)res < req->iov.iov_len)))
+    {
+        total = max( res, 0 );
+        while (total < req->iov.iov_len)
+        {
+            ret = virtual_locked_pread( req->fd, (char *)req->iov.iov_base + total,
+                                        req->iov.iov_len - total, req->offset + total );
+            if (ret == -1)
+            {
+                if (errno == EINTR) continue;
+                if (!total) res = -errno;
+                break;
+            }
+            if (!ret) break;
+            total += ret;
+        }
+        if (total) res = total;
+    }
+
+    if (res >= 0)
+    {
+        total = res;
+        status = (total || !req->iov.iov_len || req->write) ? STATUS_SUCCESS : STATUS_END_OF_FILE;
+    }
+    else if (res == -ECANCELED || res == -EINTR) status = STATUS_CANCELLED;
+    else if (res == -EFAULT) status = req->write ? STATUS_INVALID_USER_BUFFER : STATUS_ACCESS_VIOLATION;
+    else
+    {
+        errno = -res;
+        status = FILE_GetNtStatus();
+    }
+    close( req->fd );
+
+    TRACE( "%s %p offset %s done: status %08x total %u\n", req->write ? "write" : "read",
+           req->handle, wine_dbgstr_longlong( req->offset ), status, total );
+
+    req->io->Information = total;
+    req->io->u.Status = status;
+    if (req->event) NtSetEvent( req->event, NULL );
+    if (req->port)
+    {
+        NtSetIoCompletion( req->port, req->ckey, req->cvalue, status, total );
+        NtClose( req->port );
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, req );
+}
+
+/* thread reaping the completions, exits when no request is in flight */
+static void CALLBACK uring_reaper_proc( void *arg )
+{
+    struct uring_request *req;
+    unsigned int head;
+    int res;
+
+    for (;;)
+    {
+        head = *ring.cq_head;
+        if (head == *(volatile unsigned int *)ring.cq_tail)
+        {
+            RtlEnterCriticalSection( &uring_section );
+            if (!uring_inflight)
+            {
+                reaper_running = FALSE;
+                RtlLeaveCriticalSection( &uring_section );
+                break;
+            }
+            RtlLeaveCriticalSection( &uring_section );
+            io_uring_enter( 0, 1, IORING_ENTER_GETEVENTS );
+            continue;
+        }
+
+        req = (struct uring_request *)(ULONG_PTR)ring.cqes[head & ring.cq_mask].user_data;
+        res = ring.cqes[head & ring.cq_mask].res;
+        interlocked_xchg( (int *)ring.cq_head, head + 1 );
+
+        /* cancellation entries have no request */
+        if (req)
+        {
+            RtlEnterCriticalSection( &uring_section );
+            list_remove( &req->entry );
+            RtlLeaveCriticalSection( &uring_section );
+            complete_request( req, res );
+        }
+        interlocked_xchg_add( &uring_inflight, -1 );
+    }
+    RtlExitUserThread( 0 );
+}
+
+/* queue a submission entry and submit it; must be called with uring_section held */
+static BOOL submit_sqe( BYTE opcode, int fd, ULONGLONG offset, ULONG_PTR addr, unsigned int len,
+                        ULONG_PTR user_data )
+{
+    struct uring_sqe *sqe;
+    unsigned int tail, index;
+
+    if (uring_inflight >= (LONG)ring.cq_entries) return FALSE;  /* the completion queue could overflow */
+    tail = *ring.sq_tail;
+    if (tail - *(volatile unsigned int *)ring.sq_head > ring.sq_mask) return FALSE;
+
+    index = tail & ring.sq_mask;
+    sqe = &ring.sqes[index];
+    memset( sqe, 0, sizeof(*sqe) );
+    sqe->opcode    = opcode;
+    sqe->fd        = fd;
+    sqe->off       = offset;
+    sqe->addr      = addr;
+    sqe->len       = len;
+    sqe->user_data = user_data;
+    ring.sq_array[index] = index;
+    interlocked_xchg( (int *)ring.sq_tail, tail + 1 );
+
+    if (io_uring_enter( 1, 0, 0 ) != 1)
+    {
+        WARN( "submission failed, errno %d\n", errno );
+        *ring.sq_tail = tail;  /* the kernel didn't consume it */
+        return FALSE;
+    }
+    interlocked_xchg_add( &uring_inflight, 1 );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           uring_submit_rw
+ *
+ * Submit an overlapped read or write on a regular file.
+ * Return STATUS_PENDING if submitted, otherwise the caller must perform
+ * the I/O synchronously.
+ */
+NTSTATUS uring_submit_rw( HANDLE handle, int unix_fd, HANDLE event, IO_STATUS_BLOCK *io,
+                          ULONG_PTR cvalue, void *buffer, ULONG length, LONGLONG offset, BOOL write )
+{
+    struct uring_request *req;
+    HANDLE thread, port = 0;
+    ULONG_PTR ckey = 0;
+
+    /* without an event the caller may wait on the file handle, whose state is kept by the server */
+    if (!uring_enabled || !event) return STATUS_NOT_SUPPORTED;
+
+    if (uring_enabled == -1)
+    {
+        RtlEnterCriticalSection( &uring_section );
+        if (uring_enabled == -1) uring_enabled = init_uring();
+        RtlLeaveCriticalSection( &uring_section );
+        if (!uring_enabled) return STATUS_NOT_SUPPORTED;
+    }
+
+    /* the handle may be closed before the request completes, so get the port now */
+    if (cvalue)
+    {
+        SERVER_START_REQ( get_fd_completion )
+        {
+            req->handle = wine_server_obj_handle( handle );
+            if (!wine_server_call( req ))
+            {
+                port = wine_server_ptr_handle( reply->port );
+                ckey = reply->ckey;
+            }
+        }
+        SERVER_END_REQ;
+    }
+
+    if (!(req = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*req) ))) goto failed;
+    /* same for the Unix fd */
+    if ((req->fd = dup( unix_fd )) == -1)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, req );
+        goto failed;
+    }
+    req->handle       = handle;
+    req->tid          = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    req->event        = event;
+    req->io           = io;
+    req->port         = port;
+    req->ckey         = ckey;
+    req->cvalue       = cvalue;
+    req->write        = write;
+    req->offset       = offset;
+    req->iov.iov_base = buffer;
+    req->iov.iov_len  = length;
+
+    RtlEnterCriticalSection( &uring_section );
+
+    if (!reaper_running)
+    {
+        if (RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                 uring_reaper_proc, NULL, &thread, NULL )) goto failed_locked;
+        reaper_running = TRUE;
+        NtClose( thread );
+    }
+
+    /* the request may complete as soon as it is submitted */
+    io->u.Status = STATUS_PENDING;
+    io->Information = 0;
+    NtResetEvent( event, NULL );
+
+    list_add_tail( &uring_requests, &req->entry );
+    if (!submit_sqe( write ? IORING_OP_WRITEV : IORING_OP_READV, req->fd, offset,
+                     (ULONG_PTR)&req->iov, 1, (ULONG_PTR)req ))
+    {
+        list_remove( &req->entry );
+        goto failed_locked;
+    }
+    RtlLeaveCriticalSection( &uring_section );
+    return STATUS_PENDING;
+
+failed_locked:
+    RtlLeaveCriticalSection( &uring_section );
+    close( req->fd );
+    RtlFreeHeap( GetProcessHeap(), 0, req );
+failed:
+    if (port) NtClose( port );
+    return STATUS_NOT_SUPPORTED;
+}
+
+/***********************************************************************
+ *           uring_cancel
+ *
+ * Cancel the requests in flight on a file, either those of the current
+ * thread or the one using the given I/O status block.
+ * Return TRUE if a cancellation was submitted.
+ */
+BOOL uring_cancel( HANDLE handle, IO_STATUS_BLOCK *io, BOOL only_thread )
+{
+    struct uring_request *req;
+    DWORD tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    BOOL ret = FALSE;
+
+    if (uring_enabled != 1) return FALSE;
+
+    RtlEnterCriticalSection( &uring_section );
+    LIST_FOR_EACH_ENTRY( req, &uring_requests, struct uring_request, entry )
+    {
+        if (req->handle != handle) continue;
+        if (only_thread && req->tid != tid) continue;
+        if (io && req->io != io) continue;
+        /* the request completes with -ECANCELED if it hasn't started yet */
+        if (submit_sqe( IORING_OP_ASYNC_CANCEL, -1, 0, (ULONG_PTR)req, 0, 0 )) ret = TRUE;
+    }
+    RtlLeaveCriticalSection( &uring_section );
+    return ret;
+}
+
+#else  /* __linux__ && __NR_io_uring_setup */
+
+NTSTATUS uring_submit_rw( HANDLE handle, int unix_fd, HANDLE event, IO_STATUS_BLOCK *io,
+                          ULONG_PTR cvalue, void *buffer, ULONG length, LONGLONG offset, BOOL write )
+{
+    return STATUS_NOT_SUPPORTED;
+}
+
+BOOL uring_cancel( HANDLE handle, IO_STATUS_BLOCK *io, BOOL only_thread )
+{
+    return FALSE;
+}
+
+#endif  /* __linux__ && __NR_io_uring_setup */
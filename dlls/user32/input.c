@@ -455,7 +455,7 @@ SHORT WINAPI DECLSPEC_HOTPATCH GetAsyncKeyState( INT key )
  */
 DWORD WINAPI GetQueueStatus( UINT flags )
 {
-    DWORD ret;
+    DWORD ret, wake_bits, changed_bits;
 
     if (flags & ~(QS_ALLINPUT | QS_ALLPOSTMESSAGE | QS_SMRESULT))
     {
@@ -465,6 +465,9 @@ DWORD WINAPI GetQueueStatus( UINT flags )
 
     check_for_events( flags );
 
+    /* the changed bits are a subset of the wake bits, so there is nothing to clear */
+    if (get_shared_queue_bits( &wake_bits, &changed_bits ) && !(wake_bits & flags)) return 0;
+
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = flags;
@@ -481,10 +484,12 @@ DWORD WINAPI GetQueueStatus( UINT flags )
  */
 BOOL WINAPI GetInputState(void)
 {
-    DWORD ret;
+    DWORD ret, wake_bits, changed_bits;
 
     check_for_events( QS_INPUT );
 
+    if (get_shared_queue_bits( &wake_bits, &changed_bits )) return wake_bits & (QS_KEY | QS_MOUSEBUTTON);
+
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = 0;
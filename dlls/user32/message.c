@@ -2740,6 +2740,111 @@ static inline void call_sendmsg_callback( SENDASYNCPROC callback, HWND hwnd, UIN
 }
 
 
+/* maximum time in ms between get_message requests when the queue looks empty,
+ * so that the server doesn't consider the thread as hung */
+#define QUEUE_SHM_MAX_SKIP_TIME 100
+
+static const volatile struct queue_shm_slot *queue_shm_slots;
+static BOOL queue_shm_disabled;  /* the server doesn't share the queue state */
+
+/***********************************************************************
+ *           map_queue_shm
+ *
+ * Map the shared memory region holding the state of the server queues.
+ */
+static const volatile struct queue_shm_slot *map_queue_shm(void)
+{
+    HANDLE handle = 0, mapping;
+    NTSTATUS status;
+    void *ptr;
+
+    if (queue_shm_slots) return queue_shm_slots;
+    if (queue_shm_disabled) return NULL;
+
+    SERVER_START_REQ( get_queue_shm_region )
+    {
+        if (!(status = wine_server_call( req ))) handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+    if (status == STATUS_NOT_IMPLEMENTED) queue_shm_disabled = TRUE;
+    if (!handle) return NULL;
+
+    if ((mapping = CreateFileMappingW( handle, NULL, PAGE_READONLY, 0, 0, NULL )))
+    {
+        if ((ptr = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 )) &&
+            InterlockedCompareExchangePointer( (void **)&queue_shm_slots, ptr, NULL ))
+            UnmapViewOfFile( ptr );  /* another thread got there first */
+        CloseHandle( mapping );
+    }
+    CloseHandle( handle );
+    return queue_shm_slots;
+}
+
+
+/***********************************************************************
+ *           get_server_queue_handle
+ *
+ * Get a handle to the server message queue for the current thread.
+ */
+static HANDLE get_server_queue_handle(void)
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    unsigned int slot = QUEUE_SHM_NO_SLOT;
+    HANDLE ret;
+
+    if (!(ret = thread_info->server_queue))
+    {
+        SERVER_START_REQ( get_msg_queue )
+        {
+            wine_server_call( req );
+            ret = wine_server_ptr_handle( reply->handle );
+            slot = reply->shm_slot;
+        }
+        SERVER_END_REQ;
+        thread_info->server_queue = ret;
+        if (!ret) ERR( "Cannot get server thread queue\n" );
+        else if (slot != QUEUE_SHM_NO_SLOT && map_queue_shm()) thread_info->queue_shm = slot + 1;
+    }
+    return ret;
+}
+
+
+/***********************************************************************
+ *           get_shared_queue_bits
+ *
+ * Read the bits of the current thread queue from the shared memory state.
+ * Return FALSE if the thread has no queue or the state isn't shared.
+ */
+BOOL get_shared_queue_bits( DWORD *wake_bits, DWORD *changed_bits )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+
+    if (!thread_info->queue_shm) return FALSE;
+    *wake_bits = queue_shm_slots[thread_info->queue_shm - 1].wake_bits;
+    *changed_bits = queue_shm_slots[thread_info->queue_shm - 1].changed_bits;
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           is_queue_empty
+ *
+ * Check from the shared queue state whether a get_message request would
+ * find no message, so that we can avoid the server call.
+ */
+static BOOL is_queue_empty( HWND hwnd, UINT flags )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    UINT filter = flags >> 16;
+
+    if (!thread_info->queue_shm) return FALSE;
+    if (hwnd == (HWND)-1) return FALSE;  /* the server signals the idle event */
+    if (GetTickCount() - thread_info->last_get_msg > QUEUE_SHM_MAX_SKIP_TIME) return FALSE;
+    if (!filter) filter = QS_ALLINPUT;
+    return !(queue_shm_slots[thread_info->queue_shm - 1].wake_bits & (filter | QS_SENDMESSAGE));
+}
+
+
 /***********************************************************************
  *           peek_message
  *
@@ -2756,11 +2861,12 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
     void *buffer;
     size_t buffer_size = 256;
 
-    if (!(buffer = HeapAlloc( GetProcessHeap(), 0, buffer_size ))) return FALSE;
-
     if (!first && !last) last = ~0;
     if (hwnd == HWND_BROADCAST) hwnd = HWND_TOPMOST;
 
+    if (is_queue_empty( hwnd, flags )) return FALSE;
+    if (!(buffer = HeapAlloc( GetProcessHeap(), 0, buffer_size ))) return FALSE;
+
     for (;;)
     {
         NTSTATUS res;
@@ -2797,6 +2903,8 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
         }
         SERVER_END_REQ;
 
+        thread_info->last_get_msg = GetTickCount();
+
         if (res)
         {
             HeapFree( GetProcessHeap(), 0, buffer );
@@ -2804,6 +2912,8 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
             {
                 thread_info->wake_mask = changed_mask & (QS_SENDMESSAGE | QS_SMRESULT);
                 thread_info->changed_mask = changed_mask;
+                /* fetch the shared queue slot so that the next calls can skip the server */
+                if (!thread_info->server_queue && map_queue_shm()) get_server_queue_handle();
             }
             if (res != STATUS_BUFFER_OVERFLOW) return FALSE;
             if (!(buffer = HeapAlloc( GetProcessHeap(), 0, buffer_size ))) return FALSE;
@@ -2994,31 +3104,6 @@ static inline void process_sent_messages(void)
 }
 
 
-/***********************************************************************
- *           get_server_queue_handle
- *
- * Get a handle to the server message queue for the current thread.
- */
-static HANDLE get_server_queue_handle(void)
-{
-    struct user_thread_info *thread_info = get_user_thread_info();
-    HANDLE ret;
-
-    if (!(ret = thread_info->server_queue))
-    {
-        SERVER_START_REQ( get_msg_queue )
-        {
-            wine_server_call( req );
-            ret = wine_server_ptr_handle( reply->handle );
-        }
-        SERVER_END_REQ;
-        thread_info->server_queue = ret;
-        if (!ret) ERR( "Cannot get server thread queue\n" );
-    }
-    return ret;
-}
-
-
 /***********************************************************************
  *           wait_message_reply
  *
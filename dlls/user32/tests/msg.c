@@ -12411,6 +12411,101 @@ static void test_PeekMessage3(void)
     flush_events();
 }
 
+struct queue_thread_params
+{
+    DWORD  tid;
+    HWND   hwnd;
+    LRESULT result;
+};
+
+static DWORD CALLBACK queue_post_thread(void *arg)
+{
+    struct queue_thread_params *params = arg;
+    BOOL ret;
+
+    ret = PostThreadMessageA(params->tid, WM_USER, 1, 2);
+    ok(ret, "PostThreadMessage failed, error %u\n", GetLastError());
+    return 0;
+}
+
+static DWORD CALLBACK queue_send_thread(void *arg)
+{
+    struct queue_thread_params *params = arg;
+
+    params->result = SendMessageA(params->hwnd, WM_USER + 1, 0, 41);
+    return 0;
+}
+
+static LRESULT WINAPI queue_wnd_proc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam)
+{
+    if (message == WM_USER + 1) return lparam + 1;
+    return DefWindowProcA(hwnd, message, wparam, lparam);
+}
+
+/* with WINESHAREDQUEUE set for wineserver, the empty queue checks are answered
+ * from the shared queue state, which must see messages from other threads */
+static void test_PeekMessage_other_thread(void)
+{
+    struct queue_thread_params params;
+    WNDCLASSA cls = { 0 };
+    HANDLE thread;
+    DWORD status, tid;
+    HWND hwnd;
+    BOOL ret;
+    MSG msg;
+    int i;
+
+    cls.lpfnWndProc = queue_wnd_proc;
+    cls.hInstance = GetModuleHandleA(NULL);
+    cls.lpszClassName = "queue_test_class";
+    ret = RegisterClassA(&cls);
+    ok(ret, "RegisterClass failed, error %u\n", GetLastError());
+
+    hwnd = CreateWindowA("queue_test_class", NULL, WS_POPUP, 0, 0, 10, 10, NULL, NULL, NULL, NULL);
+    ok(hwnd != NULL, "CreateWindow failed, error %u\n", GetLastError());
+    flush_events();
+
+    params.tid = GetCurrentThreadId();
+    params.hwnd = hwnd;
+
+    for (i = 0; i < 10; i++)
+    {
+        ret = PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE);
+        ok(!ret, "%d: got message %04x\n", i, msg.message);
+        status = GetQueueStatus(QS_POSTMESSAGE | QS_SENDMESSAGE);
+        ok(!status, "%d: got status %08x\n", i, status);
+
+        thread = CreateThread(NULL, 0, queue_post_thread, &params, 0, &tid);
+        ok(thread != NULL, "CreateThread failed, error %u\n", GetLastError());
+        WaitForSingleObject(thread, INFINITE);
+        CloseHandle(thread);
+
+        status = GetQueueStatus(QS_POSTMESSAGE);
+        ok(status == MAKELONG(QS_POSTMESSAGE, QS_POSTMESSAGE), "%d: got status %08x\n", i, status);
+        ret = PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE | PM_QS_PAINT);
+        ok(!ret, "%d: got message %04x\n", i, msg.message);
+        ret = PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE | PM_QS_POSTMESSAGE);
+        ok(ret, "%d: PeekMessage failed\n", i);
+        ok(msg.message == WM_USER && msg.wParam == 1 && msg.lParam == 2,
+           "%d: got message %04x %lx %lx\n", i, msg.message, msg.wParam, msg.lParam);
+        ret = PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE);
+        ok(!ret, "%d: got message %04x\n", i, msg.message);
+
+        params.result = 0;
+        thread = CreateThread(NULL, 0, queue_send_thread, &params, 0, &tid);
+        ok(thread != NULL, "CreateThread failed, error %u\n", GetLastError());
+        while (MsgWaitForMultipleObjects(1, &thread, FALSE, 5000, QS_SENDMESSAGE) == WAIT_OBJECT_0 + 1)
+            PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE);
+        status = WaitForSingleObject(thread, 0);
+        ok(status == WAIT_OBJECT_0, "%d: thread didn't finish\n", i);
+        ok(params.result == 42, "%d: got result %ld\n", i, params.result);
+        CloseHandle(thread);
+    }
+
+    DestroyWindow(hwnd);
+    UnregisterClassA("queue_test_class", GetModuleHandleA(NULL));
+}
+
 static INT_PTR CALLBACK wm_quit_dlg_proc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
 {
     struct recvd_message msg;
@@ -17612,6 +17707,7 @@ START_TEST(msg)
     test_PeekMessage();
     test_PeekMessage2();
     test_PeekMessage3();
+    test_PeekMessage_other_thread();
     test_WaitForInputIdle( test_argv[0] );
     test_scrollwindowex();
     test_messages();
@@ -9468,6 +9468,111 @@ static void test_window_from_point(const char *argv0)
     DestroyWindow(hwnd);
 }
 
+static void other_process_window_proc(HWND parent)
+{
+    HANDLE start_event, end_event;
+    HWND child;
+    int x = 10;
+    MSG msg;
+
+    start_event = OpenEventA(EVENT_ALL_ACCESS, FALSE, "test_opw_start");
+    ok(start_event != 0, "OpenEvent failed\n");
+    end_event = OpenEventA(EVENT_ALL_ACCESS, FALSE, "test_opw_end");
+    ok(end_event != 0, "OpenEvent failed\n");
+
+    child = CreateWindowExA(WS_EX_NOPARENTNOTIFY, "static", "static", WS_CHILD,
+                            10, 20, 100, 50, parent, (HMENU)123, NULL, NULL);
+    ok(child != 0, "CreateWindowEx failed\n");
+    SetEvent(start_event);
+
+    /* keep updating the window while the parent process reads its state */
+    while (WaitForSingleObject(end_event, 0) == WAIT_TIMEOUT)
+    {
+        x = (x == 10) ? 30 : 10;
+        SetWindowPos(child, 0, x, 20, 0, 0, SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE);
+        while (PeekMessageA(&msg, 0, 0, 0, PM_REMOVE)) DispatchMessageA(&msg);
+    }
+
+    DestroyWindow(child);
+    CloseHandle(start_event);
+    CloseHandle(end_event);
+}
+
+/* with WINESHAREDWINDOWS set for wineserver, the state of windows of other
+ * processes is read from shared memory, including while it is being updated */
+static void test_other_process_window(const char *argv0)
+{
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char cmd[MAX_PATH];
+    HANDLE start_event, end_event;
+    RECT rect, client;
+    DWORD pid, tid;
+    HWND hwnd, child, res;
+    LONG_PTR id;
+    LONG style;
+    int i;
+
+    hwnd = CreateWindowExA(0, "MainWindowClass", NULL, WS_POPUP, 100, 100, 200, 100, 0, 0, NULL, NULL);
+    ok(hwnd != 0, "CreateWindowEx failed\n");
+
+    start_event = CreateEventA(NULL, FALSE, FALSE, "test_opw_start");
+    ok(start_event != 0, "CreateEvent failed\n");
+    end_event = CreateEventA(NULL, FALSE, FALSE, "test_opw_end");
+    ok(end_event != 0, "CreateEvent failed\n");
+
+    sprintf(cmd, "%s win other_process_window %p\n", argv0, hwnd);
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    ok(CreateProcessA(NULL, cmd, NULL, NULL, FALSE, 0, NULL, NULL,
+                &startup, &info), "CreateProcess failed.\n");
+    ok(wait_for_event(start_event, 1000), "didn't get start_event\n");
+
+    child = GetWindow(hwnd, GW_CHILD);
+    ok(child != 0, "no child window\n");
+
+    ok(IsWindow(child), "IsWindow failed\n");
+    tid = GetWindowThreadProcessId(child, &pid);
+    ok(tid == info.dwThreadId, "got tid %x expected %x\n", tid, info.dwThreadId);
+    ok(pid == info.dwProcessId, "got pid %x expected %x\n", pid, info.dwProcessId);
+    res = GetParent(child);
+    ok(res == hwnd, "GetParent returned %p expected %p\n", res, hwnd);
+    if (pGetAncestor)
+    {
+        res = pGetAncestor(child, GA_PARENT);
+        ok(res == hwnd, "GetAncestor returned %p expected %p\n", res, hwnd);
+    }
+    style = GetWindowLongA(child, GWL_STYLE);
+    ok((style & (WS_CHILD | WS_VISIBLE)) == WS_CHILD, "got style %08x\n", style);
+    style = GetWindowLongA(child, GWL_EXSTYLE);
+    ok(style & WS_EX_NOPARENTNOTIFY, "got ex style %08x\n", style);
+    id = GetWindowLongPtrA(child, GWLP_ID);
+    ok(id == 123, "got id %ld\n", id);
+
+    for (i = 0; i < 1000; i++)
+    {
+        GetWindowRect(child, &rect);
+        ok(rect.right - rect.left == 100 && rect.bottom - rect.top == 50,
+           "%d: got window rect %s\n", i, wine_dbgstr_rect(&rect));
+        ok(rect.top == 120 && (rect.left == 110 || rect.left == 130),
+           "%d: got window rect %s\n", i, wine_dbgstr_rect(&rect));
+        GetClientRect(child, &client);
+        ok(client.right == 100 && client.bottom == 50, "%d: got client rect %s\n", i, wine_dbgstr_rect(&client));
+        if (rect.right - rect.left != 100 || rect.top != 120) break;
+    }
+
+    SetEvent(end_event);
+    winetest_wait_child_process(info.hProcess);
+    ok(!IsWindow(child), "window still exists\n");
+
+    CloseHandle(start_event);
+    CloseHandle(end_event);
+    CloseHandle(info.hProcess);
+    CloseHandle(info.hThread);
+
+    DestroyWindow(hwnd);
+}
+
 static void test_map_points(void)
 {
     BOOL ret;
@@ -11771,6 +11876,15 @@ START_TEST(win)
         return;
     }
 
+    if (argc==4 && !strcmp(argv[2], "other_process_window"))
+    {
+        HWND hwnd;
+
+        sscanf(argv[3], "%p", &hwnd);
+        other_process_window_proc(hwnd);
+        return;
+    }
+
     if (argc==3 && !strcmp(argv[2], "winproc_limit"))
     {
         test_winproc_limit();
@@ -11815,6 +11929,7 @@ START_TEST(win)
     /* Add the tests below this line */
     test_child_window_from_point();
     test_window_from_point(argv[0]);
+    test_other_process_window(argv[0]);
     test_thick_child_size(hwndMain);
     test_fullscreen();
     test_hwnd_message();
@@ -56,6 +56,8 @@ static CRITICAL_SECTION_DEBUG critsect_debug =
 };
 static CRITICAL_SECTION surfaces_section = { &critsect_debug, -1, 0, 0, 0, 0 };
 
+static const volatile struct window_shm_slot *window_shm_slots;
+
 /**********************************************************************/
 
 /* helper for Get/SetWindowLong */
@@ -697,6 +699,149 @@ UINT win_set_flags( HWND hwnd, UINT set_mask, UINT clear_mask )
 }
 
 
+/***********************************************************************
+ *           map_window_shm
+ *
+ * Map the shared memory region holding the state of the server windows.
+ */
+static const volatile struct window_shm_slot *map_window_shm(void)
+{
+    static BOOL disabled;
+    HANDLE handle = 0, mapping;
+    void *ptr;
+
+    if (window_shm_slots || disabled) return window_shm_slots;
+
+    SERVER_START_REQ( get_window_shm_region )
+    {
+        if (!wine_server_call( req )) handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+    if (!handle)
+    {
+        disabled = TRUE;
+        return NULL;
+    }
+
+    if ((mapping = CreateFileMappingW( handle, NULL, PAGE_READONLY, 0, 0, NULL )))
+    {
+        if ((ptr = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 )) &&
+            InterlockedCompareExchangePointer( (void **)&window_shm_slots, ptr, NULL ))
+            UnmapViewOfFile( ptr );  /* another thread got there first */
+        CloseHandle( mapping );
+    }
+    CloseHandle( handle );
+    if (!window_shm_slots) disabled = TRUE;
+    return window_shm_slots;
+}
+
+
+/* full memory barrier; the slots are mapped read-only, so the interlocked
+ * operation is done on a local variable instead */
+static inline void window_shm_barrier(void)
+{
+    LONG dummy = 0;
+    InterlockedExchange( &dummy, 0 );
+}
+
+
+/***********************************************************************
+ *           get_shared_window_info
+ *
+ * Read the state of a window from the shared memory region. Return FALSE
+ * if it isn't available, in which case the server needs to be queried.
+ */
+static BOOL get_shared_window_info( HWND hwnd, struct window_shm_slot *info )
+{
+    const volatile struct window_shm_slot *slot;
+    user_handle_t handle = wine_server_user_handle( hwnd );
+    WORD generation = HIWORD( handle );
+    UINT index = USER_HANDLE_TO_INDEX( hwnd ), seq;
+
+    if (index >= NB_USER_HANDLES || !map_window_shm()) return FALSE;
+
+    /* if the server is updating the slot, ask it directly instead of waiting */
+    slot = &window_shm_slots[index];
+    seq = slot->seq;
+    if (seq & 1) return FALSE;
+    window_shm_barrier();
+    memcpy( info, (const void *)slot, sizeof(*info) );
+    window_shm_barrier();
+    if (slot->seq != seq) return FALSE;
+    if (!info->handle) return FALSE;
+    if (generation && generation != 0xffff && info->handle != handle) return FALSE;
+    return TRUE;
+}
+
+
+static inline RECT shared_rect( const rectangle_t *rect )
+{
+    RECT ret;
+    SetRect( &ret, rect->left, rect->top, rect->right, rect->bottom );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           get_shared_window_rects
+ *
+ * Compute the window rectangles from the shared memory state, if possible
+ * without DPI scaling, using the same rules as get_window_rectangles.
+ */
+static BOOL get_shared_window_rects( HWND hwnd, enum coords_relative relative,
+                                     RECT *rectWindow, RECT *rectClient )
+{
+    struct window_shm_slot info, parent;
+    RECT window_rect, client_rect, parent_rect;
+
+    if (!get_shared_window_info( hwnd, &info )) return FALSE;
+    if (info.dpi != get_thread_dpi()) return FALSE;
+
+    window_rect = shared_rect( &info.window_rect );
+    client_rect = shared_rect( &info.client_rect );
+    switch (relative)
+    {
+    case COORDS_CLIENT:
+        OffsetRect( &window_rect, -info.client_rect.left, -info.client_rect.top );
+        OffsetRect( &client_rect, -info.client_rect.left, -info.client_rect.top );
+        parent_rect = shared_rect( &info.client_rect );
+        if (info.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &parent_rect, &window_rect );
+        break;
+    case COORDS_WINDOW:
+        OffsetRect( &window_rect, -info.window_rect.left, -info.window_rect.top );
+        OffsetRect( &client_rect, -info.window_rect.left, -info.window_rect.top );
+        parent_rect = shared_rect( &info.window_rect );
+        if (info.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &parent_rect, &client_rect );
+        break;
+    case COORDS_PARENT:
+        if (!info.parent) break;
+        if (!get_shared_window_info( wine_server_ptr_handle( info.parent ), &parent )) return FALSE;
+        if (parent.ex_style & WS_EX_LAYOUTRTL)
+        {
+            parent_rect = shared_rect( &parent.client_rect );
+            mirror_rect( &parent_rect, &window_rect );
+            mirror_rect( &parent_rect, &client_rect );
+        }
+        break;
+    case COORDS_SCREEN:
+        while (info.parent)
+        {
+            if (!get_shared_window_info( wine_server_ptr_handle( info.parent ), &parent )) return FALSE;
+            if (!parent.parent) break;  /* desktop window */
+            OffsetRect( &window_rect, parent.client_rect.left, parent.client_rect.top );
+            OffsetRect( &client_rect, parent.client_rect.left, parent.client_rect.top );
+            info = parent;
+        }
+        break;
+    default:
+        return FALSE;
+    }
+    if (rectWindow) *rectWindow = window_rect;
+    if (rectClient) *rectClient = client_rect;
+    return TRUE;
+}
+
+
 /***********************************************************************
  *           WIN_GetFullHandle
  *
@@ -726,6 +871,10 @@ HWND WIN_GetFullHandle( HWND hwnd )
     }
     else  /* may belong to another process */
     {
+        struct window_shm_slot info;
+
+        if (get_shared_window_info( hwnd, &info )) return wine_server_ptr_handle( info.handle );
+
         SERVER_START_REQ( get_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -932,6 +1081,8 @@ BOOL WIN_GetRectangles( HWND hwnd, enum coords_relative relative, RECT *rectWind
     }
 
 other_process:
+    if (get_shared_window_rects( hwnd, relative, rectWindow, rectClient )) return TRUE;
+
     SERVER_START_REQ( get_window_rectangles )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -2347,11 +2498,24 @@ static LONG_PTR WIN_GetWindowLong( HWND hwnd, INT offset, UINT size, BOOL unicod
 
     if (wndPtr == WND_OTHER_PROCESS)
     {
+        struct window_shm_slot info;
+
         if (offset == GWLP_WNDPROC)
         {
             SetLastError( ERROR_ACCESS_DENIED );
             return 0;
         }
+        if (offset < 0 && get_shared_window_info( hwnd, &info ))
+        {
+            switch(offset)
+            {
+            case GWL_STYLE:      return info.style;
+            case GWL_EXSTYLE:    return info.ex_style;
+            case GWLP_ID:        return info.id;
+            case GWLP_HINSTANCE: return (ULONG_PTR)wine_server_get_ptr( info.instance );
+            case GWLP_USERDATA:  return info.user_data;
+            }
+        }
         SERVER_START_REQ( set_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -2996,6 +3160,7 @@ INT WINAPI GetWindowTextLengthW( HWND hwnd )
  */
 BOOL WINAPI IsWindow( HWND hwnd )
 {
+    struct window_shm_slot info;
     WND *ptr;
     BOOL ret;
 
@@ -3009,6 +3174,8 @@ BOOL WINAPI IsWindow( HWND hwnd )
     }
 
     /* check other processes */
+    if (get_shared_window_info( hwnd, &info )) return TRUE;
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -3024,6 +3191,7 @@ BOOL WINAPI IsWindow( HWND hwnd )
  */
 DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
 {
+    struct window_shm_slot info;
     WND *ptr;
     DWORD tid = 0;
 
@@ -3043,6 +3211,12 @@ DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
     }
 
     /* check other processes */
+    if (ptr == WND_OTHER_PROCESS && get_shared_window_info( hwnd, &info ))
+    {
+        if (process) *process = info.pid;
+        return info.tid;
+    }
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -3073,7 +3247,17 @@ HWND WINAPI GetParent( HWND hwnd )
     if (wndPtr == WND_DESKTOP) return 0;
     if (wndPtr == WND_OTHER_PROCESS)
     {
-        LONG style = GetWindowLongW( hwnd, GWL_STYLE );
+        struct window_shm_slot info;
+        LONG style;
+
+        if (get_shared_window_info( hwnd, &info ))
+        {
+            if (info.style & WS_POPUP) return wine_server_ptr_handle( info.owner );
+            if (info.style & WS_CHILD) return wine_server_ptr_handle( info.parent );
+            return 0;
+        }
+
+        style = GetWindowLongW( hwnd, GWL_STYLE );
         if (style & (WS_POPUP | WS_CHILD))
         {
             SERVER_START_REQ( get_window_tree )
@@ -3122,6 +3306,10 @@ HWND WINAPI GetAncestor( HWND hwnd, UINT type )
         }
         else /* need to query the server */
         {
+            struct window_shm_slot info;
+
+            if (get_shared_window_info( hwnd, &info )) return wine_server_ptr_handle( info.parent );
+
             SERVER_START_REQ( get_window_tree )
             {
                 req->handle = wine_server_user_handle( hwnd );
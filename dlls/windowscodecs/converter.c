@@ -21,6 +21,13 @@
 
 #include <stdarg.h>
 #include <math.h>
+#include <string.h>
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
 
 #define COBJMACROS
 
@@ -133,6 +140,280 @@ static void to_sRGB(BYTE *bgr)
 }
 #endif
 
+/* smallest linear value that is converted to each 8-bit sRGB value */
+static float srgb_thresholds[256];
+
+/* color * 255 / alpha, colors with a 0 or 255 alpha are left alone */
+static BYTE unpremultiply_table[256][256];
+
+static BOOL WINAPI init_tables(INIT_ONCE *once, void *param, void **context)
+{
+    UINT i, j, lo, hi, mid;
+    float f;
+
+    /* the conversion is monotonic, so find the boundaries by bisecting the
+     * bit patterns of the positive floats, which are ordered like their values */
+    for (i = 1; i < 256; i++)
+    {
+        f = 0.0f;
+        memcpy(&lo, &f, sizeof(lo));
+        f = 1.0f;
+        memcpy(&hi, &f, sizeof(hi));
+        while (lo < hi)
+        {
+            mid = lo + (hi - lo) / 2;
+            memcpy(&f, &mid, sizeof(f));
+            if (floorf(to_sRGB_component(f) * 255.0f + 0.51f) >= i) hi = mid;
+            else lo = mid + 1;
+        }
+        memcpy(&srgb_thresholds[i], &lo, sizeof(lo));
+    }
+
+    for (i = 0; i < 256; i++)
+        for (j = 0; j < 256; j++)
+            unpremultiply_table[i][j] = (i == 0 || i == 255) ? j : j * 255 / i;
+
+    return TRUE;
+}
+
+static void init_conversion_tables(void)
+{
+    static INIT_ONCE init_once = INIT_ONCE_STATIC_INIT;
+
+    InitOnceExecuteOnce(&init_once, init_tables, NULL, NULL);
+}
+
+/* same as floorf(to_sRGB_component(f) * 255.0f + 0.51f), init_conversion_tables() must have been called */
+static inline BYTE linear_to_sRGB_byte(float f)
+{
+    UINT step, ret = 0;
+
+    if (!(f >= 0.0f && f <= 1.0f)) return (BYTE)floorf(to_sRGB_component(f) * 255.0f + 0.51f);
+
+    for (step = 128; step; step /= 2)
+        if (f >= srgb_thresholds[ret + step]) ret += step;
+    return ret;
+}
+
+#ifdef USE_SSE2
+
+static inline __m128i __attribute__((target("sse2"))) swap_red_blue_sse2(__m128i pixels)
+{
+    __m128i rb = _mm_and_si128(pixels, _mm_set1_epi32(0x00ff00ff));
+
+    rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+    return _mm_or_si128(_mm_and_si128(pixels, _mm_set1_epi32(0xff00ff00)), rb);
+}
+
+static UINT __attribute__((target("sse2"))) convert_row_24bpp_to_32bpp_sse2(const BYTE *src,
+    BYTE *dst, UINT width, BOOL swap)
+{
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    UINT x;
+
+    /* 16 bytes are loaded for 4 pixels, so stop before reading past the row */
+    for (x = 0; x + 6 <= width; x += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 3 * x));
+        __m128i p01 = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+        __m128i p23 = _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+
+        v = _mm_unpacklo_epi64(p01, p23);
+        if (swap) v = swap_red_blue_sse2(v);
+        _mm_storeu_si128((__m128i *)(dst + 4 * x), _mm_or_si128(v, alpha));
+    }
+    return x;
+}
+
+static UINT __attribute__((target("sse2"))) convert_row_32bpp_to_24bpp_sse2(const BYTE *src,
+    BYTE *dst, UINT width, BOOL swap)
+{
+    const __m128i mask = _mm_set_epi32(0, 0, 0, 0x00ffffff);
+    UINT x;
+
+    /* 16 bytes are stored for 4 pixels, the extra ones are overwritten by the next ones */
+    for (x = 0; x + 6 <= width; x += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 4 * x)), ret;
+
+        if (swap) v = swap_red_blue_sse2(v);
+        ret = _mm_and_si128(v, mask);
+        ret = _mm_or_si128(ret, _mm_srli_si128(_mm_and_si128(v, _mm_slli_si128(mask, 4)), 1));
+        ret = _mm_or_si128(ret, _mm_srli_si128(_mm_and_si128(v, _mm_slli_si128(mask, 8)), 2));
+        ret = _mm_or_si128(ret, _mm_srli_si128(_mm_and_si128(v, _mm_slli_si128(mask, 12)), 3));
+        _mm_storeu_si128((__m128i *)(dst + 3 * x), ret);
+    }
+    return x;
+}
+
+static UINT __attribute__((target("sse2"))) set_alpha_row_sse2(BYTE *bits, UINT width)
+{
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    UINT x;
+
+    for (x = 0; x + 4 <= width; x += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bits + 4 * x));
+        _mm_storeu_si128((__m128i *)(bits + 4 * x), _mm_or_si128(v, alpha));
+    }
+    return x;
+}
+
+static UINT __attribute__((target("sse2"))) swap_red_blue_row_sse2(BYTE *bits, UINT width)
+{
+    UINT x;
+
+    for (x = 0; x + 4 <= width; x += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bits + 4 * x));
+        _mm_storeu_si128((__m128i *)(bits + 4 * x), swap_red_blue_sse2(v));
+    }
+    return x;
+}
+
+/* multiply two pixels unpacked to 16 bits by their alpha, and divide by 255 */
+static inline __m128i __attribute__((target("sse2"))) premultiply_sse2(__m128i pixels)
+{
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, 0xff), 0xff);
+
+    alpha = _mm_and_si128(alpha, _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1));
+    alpha = _mm_or_si128(alpha, _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+    pixels = _mm_mullo_epi16(pixels, alpha);
+    /* (x + 1 + (x >> 8)) >> 8 is x / 255 for any product of two bytes */
+    pixels = _mm_add_epi16(pixels, _mm_add_epi16(_mm_srli_epi16(pixels, 8), _mm_set1_epi16(1)));
+    return _mm_srli_epi16(pixels, 8);
+}
+
+static UINT __attribute__((target("sse2"))) premultiply_row_sse2(BYTE *bits, UINT width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    UINT x;
+
+    for (x = 0; x + 4 <= width; x += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bits + 4 * x));
+        __m128i lo = premultiply_sse2(_mm_unpacklo_epi8(v, zero));
+        __m128i hi = premultiply_sse2(_mm_unpackhi_epi8(v, zero));
+
+        _mm_storeu_si128((__m128i *)(bits + 4 * x), _mm_packus_epi16(lo, hi));
+    }
+    return x;
+}
+
+#endif
+
+/* convert a row of 24bpp pixels to opaque 32bpp ones, optionally swapping red and blue */
+static void convert_row_24bpp_to_32bpp(const BYTE *src, BYTE *dst, UINT width, BOOL swap)
+{
+    UINT x = 0;
+
+#ifdef USE_SSE2
+    if (sse2_supported()) x = convert_row_24bpp_to_32bpp_sse2(src, dst, width, swap);
+#endif
+    for (src += 3 * x, dst += 4 * x; x < width; x++, src += 3, dst += 4)
+    {
+        dst[0] = src[swap ? 2 : 0];
+        dst[1] = src[1];
+        dst[2] = src[swap ? 0 : 2];
+        dst[3] = 0xff;
+    }
+}
+
+/* convert a row of 32bpp pixels to 24bpp ones, optionally swapping red and blue */
+static void convert_row_32bpp_to_24bpp(const BYTE *src, BYTE *dst, UINT width, BOOL swap)
+{
+    UINT x = 0;
+
+#ifdef USE_SSE2
+    if (sse2_supported()) x = convert_row_32bpp_to_24bpp_sse2(src, dst, width, swap);
+#endif
+    for (src += 4 * x, dst += 3 * x; x < width; x++, src += 4, dst += 3)
+    {
+        dst[0] = src[swap ? 2 : 0];
+        dst[1] = src[1];
+        dst[2] = src[swap ? 0 : 2];
+    }
+}
+
+/* make the 32bpp pixels of a rectangle opaque */
+static void set_alpha_32bpp(BYTE *bits, UINT width, UINT height, UINT stride)
+{
+    UINT x, y;
+
+    for (y = 0; y < height; y++, bits += stride)
+    {
+        x = 0;
+#ifdef USE_SSE2
+        if (sse2_supported()) x = set_alpha_row_sse2(bits, width);
+#endif
+        for (; x < width; x++) bits[4 * x + 3] = 0xff;
+    }
+}
+
+/* same as reverse_bgr8(4, ...) */
+static void swap_red_blue_32bpp(BYTE *bits, UINT width, UINT height, UINT stride)
+{
+    UINT x, y;
+    BYTE tmp;
+
+    for (y = 0; y < height; y++, bits += stride)
+    {
+        x = 0;
+#ifdef USE_SSE2
+        if (sse2_supported()) x = swap_red_blue_row_sse2(bits, width);
+#endif
+        for (; x < width; x++)
+        {
+            tmp = bits[4 * x];
+            bits[4 * x] = bits[4 * x + 2];
+            bits[4 * x + 2] = tmp;
+        }
+    }
+}
+
+static void premultiply_32bpp(BYTE *bits, UINT width, UINT height, UINT stride)
+{
+    UINT x, y;
+    BYTE alpha;
+
+    for (y = 0; y < height; y++, bits += stride)
+    {
+        x = 0;
+#ifdef USE_SSE2
+        if (sse2_supported()) x = premultiply_row_sse2(bits, width);
+#endif
+        for (; x < width; x++)
+        {
+            alpha = bits[4 * x + 3];
+            if (alpha != 255)
+            {
+                bits[4 * x] = bits[4 * x] * alpha / 255;
+                bits[4 * x + 1] = bits[4 * x + 1] * alpha / 255;
+                bits[4 * x + 2] = bits[4 * x + 2] * alpha / 255;
+            }
+        }
+    }
+}
+
+static void unpremultiply_32bpp(BYTE *bits, UINT width, UINT height, UINT stride)
+{
+    const BYTE *table;
+    UINT x, y;
+
+    init_conversion_tables();
+
+    for (y = 0; y < height; y++, bits += stride)
+    {
+        for (x = 0; x < width; x++)
+        {
+            table = unpremultiply_table[bits[4 * x + 3]];
+            bits[4 * x] = table[bits[4 * x]];
+            bits[4 * x + 1] = table[bits[4 * x + 1]];
+            bits[4 * x + 2] = table[bits[4 * x + 2]];
+        }
+    }
+}
+
 static inline FormatConverter *impl_from_IWICFormatConverter(IWICFormatConverter *iface)
 {
     return CONTAINING_RECORD(iface, FormatConverter, IWICFormatConverter_iface);
@@ -619,13 +900,11 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
         if (prc)
         {
             HRESULT res;
-            INT x, y;
+            INT y;
             BYTE *srcdata;
             UINT srcstride, srcdatasize;
             const BYTE *srcrow;
-            const BYTE *srcpixel;
             BYTE *dstrow;
-            BYTE *dstpixel;
 
             srcstride = 3 * prc->Width;
             srcdatasize = srcstride * prc->Height;
@@ -640,14 +919,7 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
                 srcrow = srcdata;
                 dstrow = pbBuffer;
                 for (y=0; y<prc->Height; y++) {
-                    srcpixel=srcrow;
-                    dstpixel=dstrow;
-                    for (x=0; x<prc->Width; x++) {
-                        *dstpixel++=*srcpixel++; /* blue */
-                        *dstpixel++=*srcpixel++; /* green */
-                        *dstpixel++=*srcpixel++; /* red */
-                        *dstpixel++=255; /* alpha */
-                    }
+                    convert_row_24bpp_to_32bpp(srcrow, dstrow, prc->Width, FALSE);
                     srcrow += srcstride;
                     dstrow += cbStride;
                 }
@@ -662,14 +934,11 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
         if (prc)
         {
             HRESULT res;
-            INT x, y;
+            INT y;
             BYTE *srcdata;
             UINT srcstride, srcdatasize;
             const BYTE *srcrow;
-            const BYTE *srcpixel;
             BYTE *dstrow;
-            BYTE *dstpixel;
-            BYTE tmppixel[3];
 
             srcstride = 3 * prc->Width;
             srcdatasize = srcstride * prc->Height;
@@ -684,18 +953,7 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
                 srcrow = srcdata;
                 dstrow = pbBuffer;
                 for (y=0; y<prc->Height; y++) {
-                    srcpixel=srcrow;
-                    dstpixel=dstrow;
-                    for (x=0; x<prc->Width; x++) {
-                        tmppixel[0]=*srcpixel++; /* red */
-                        tmppixel[1]=*srcpixel++; /* green */
-                        tmppixel[2]=*srcpixel++; /* blue */
-
-                        *dstpixel++=tmppixel[2]; /* blue */
-                        *dstpixel++=tmppixel[1]; /* green */
-                        *dstpixel++=tmppixel[0]; /* red */
-                        *dstpixel++=255; /* alpha */
-                    }
+                    convert_row_24bpp_to_32bpp(srcrow, dstrow, prc->Width, TRUE);
                     srcrow += srcstride;
                     dstrow += cbStride;
                 }
@@ -710,15 +968,11 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
         if (prc)
         {
             HRESULT res;
-            INT x, y;
 
             res = IWICBitmapSource_CopyPixels(This->source, prc, cbStride, cbBufferSize, pbBuffer);
             if (FAILED(res)) return res;
 
-            /* set all alpha values to 255 */
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                    pbBuffer[cbStride*y+4*x+3] = 0xff;
+            set_alpha_32bpp(pbBuffer, prc->Width, prc->Height, cbStride);
         }
         return S_OK;
     case format_32bppBGRA:
@@ -729,22 +983,11 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
         if (prc)
         {
             HRESULT res;
-            INT x, y;
 
             res = IWICBitmapSource_CopyPixels(This->source, prc, cbStride, cbBufferSize, pbBuffer);
             if (FAILED(res)) return res;
 
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                {
-                    BYTE alpha = pbBuffer[cbStride*y+4*x+3];
-                    if (alpha != 0 && alpha != 255)
-                    {
-                        pbBuffer[cbStride*y+4*x] = pbBuffer[cbStride*y+4*x] * 255 / alpha;
-                        pbBuffer[cbStride*y+4*x+1] = pbBuffer[cbStride*y+4*x+1] * 255 / alpha;
-                        pbBuffer[cbStride*y+4*x+2] = pbBuffer[cbStride*y+4*x+2] * 255 / alpha;
-                    }
-                }
+            unpremultiply_32bpp(pbBuffer, prc->Width, prc->Height, cbStride);
         }
         return S_OK;
     case format_48bppRGB:
@@ -872,15 +1115,10 @@ static HRESULT copypixels_to_32bppRGBA(struct FormatConverter *This, const WICRe
     case format_32bppRGB:
         if (prc)
         {
-            INT x, y;
-
             hr = IWICBitmapSource_CopyPixels(This->source, prc, cbStride, cbBufferSize, pbBuffer);
             if (FAILED(hr)) return hr;
 
-            /* set all alpha values to 255 */
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                    pbBuffer[cbStride*y+4*x+3] = 0xff;
+            set_alpha_32bpp(pbBuffer, prc->Width, prc->Height, cbStride);
         }
         return S_OK;
 
@@ -892,29 +1130,17 @@ static HRESULT copypixels_to_32bppRGBA(struct FormatConverter *This, const WICRe
     case format_32bppPRGBA:
         if (prc)
         {
-            INT x, y;
-
             hr = IWICBitmapSource_CopyPixels(This->source, prc, cbStride, cbBufferSize, pbBuffer);
             if (FAILED(hr)) return hr;
 
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                {
-                    BYTE alpha = pbBuffer[cbStride*y+4*x+3];
-                    if (alpha != 0 && alpha != 255)
-                    {
-                        pbBuffer[cbStride*y+4*x] = pbBuffer[cbStride*y+4*x] * 255 / alpha;
-                        pbBuffer[cbStride*y+4*x+1] = pbBuffer[cbStride*y+4*x+1] * 255 / alpha;
-                        pbBuffer[cbStride*y+4*x+2] = pbBuffer[cbStride*y+4*x+2] * 255 / alpha;
-                    }
-                }
+            unpremultiply_32bpp(pbBuffer, prc->Width, prc->Height, cbStride);
         }
         return S_OK;
 
     default:
         hr = copypixels_to_32bppBGRA(This, prc, cbStride, cbBufferSize, pbBuffer, source_format);
         if (SUCCEEDED(hr) && prc)
-              reverse_bgr8(4, pbBuffer, prc->Width, prc->Height, cbStride);
+            swap_red_blue_32bpp(pbBuffer, prc->Width, prc->Height, cbStride);
         return hr;
     }
 }
@@ -965,21 +1191,7 @@ static HRESULT copypixels_to_32bppPBGRA(struct FormatConverter *This, const WICR
     default:
         hr = copypixels_to_32bppBGRA(This, prc, cbStride, cbBufferSize, pbBuffer, source_format);
         if (SUCCEEDED(hr) && prc)
-        {
-            INT x, y;
-
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                {
-                    BYTE alpha = pbBuffer[cbStride*y+4*x+3];
-                    if (alpha != 255)
-                    {
-                        pbBuffer[cbStride*y+4*x] = pbBuffer[cbStride*y+4*x] * alpha / 255;
-                        pbBuffer[cbStride*y+4*x+1] = pbBuffer[cbStride*y+4*x+1] * alpha / 255;
-                        pbBuffer[cbStride*y+4*x+2] = pbBuffer[cbStride*y+4*x+2] * alpha / 255;
-                    }
-                }
-        }
+            premultiply_32bpp(pbBuffer, prc->Width, prc->Height, cbStride);
         return hr;
     }
 }
@@ -998,21 +1210,7 @@ static HRESULT copypixels_to_32bppPRGBA(struct FormatConverter *This, const WICR
     default:
         hr = copypixels_to_32bppRGBA(This, prc, cbStride, cbBufferSize, pbBuffer, source_format);
         if (SUCCEEDED(hr) && prc)
-        {
-            INT x, y;
-
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                {
-                    BYTE alpha = pbBuffer[cbStride*y+4*x+3];
-                    if (alpha != 255)
-                    {
-                        pbBuffer[cbStride*y+4*x] = pbBuffer[cbStride*y+4*x] * alpha / 255;
-                        pbBuffer[cbStride*y+4*x+1] = pbBuffer[cbStride*y+4*x+1] * alpha / 255;
-                        pbBuffer[cbStride*y+4*x+2] = pbBuffer[cbStride*y+4*x+2] * alpha / 255;
-                    }
-                }
-        }
+            premultiply_32bpp(pbBuffer, prc->Width, prc->Height, cbStride);
         return hr;
     }
 }
@@ -1040,13 +1238,11 @@ static HRESULT copypixels_to_24bppBGR(struct FormatConverter *This, const WICRec
         if (prc)
         {
             HRESULT res;
-            INT x, y;
+            INT y;
             BYTE *srcdata;
             UINT srcstride, srcdatasize;
             const BYTE *srcrow;
-            const BYTE *srcpixel;
             BYTE *dstrow;
-            BYTE *dstpixel;
 
             srcstride = 4 * prc->Width;
             srcdatasize = srcstride * prc->Height;
@@ -1061,14 +1257,7 @@ static HRESULT copypixels_to_24bppBGR(struct FormatConverter *This, const WICRec
                 srcrow = srcdata;
                 dstrow = pbBuffer;
                 for (y=0; y<prc->Height; y++) {
-                    srcpixel=srcrow;
-                    dstpixel=dstrow;
-                    for (x=0; x<prc->Width; x++) {
-                        *dstpixel++=*srcpixel++; /* blue */
-                        *dstpixel++=*srcpixel++; /* green */
-                        *dstpixel++=*srcpixel++; /* red */
-                        srcpixel++; /* alpha */
-                    }
+                    convert_row_32bpp_to_24bpp(srcrow, dstrow, prc->Width, FALSE);
                     srcrow += srcstride;
                     dstrow += cbStride;
                 }
@@ -1099,6 +1288,8 @@ static HRESULT copypixels_to_24bppBGR(struct FormatConverter *This, const WICRec
                 INT x, y;
                 BYTE *src = srcdata, *dst = pbBuffer;
 
+                init_conversion_tables();
+
                 for (y = 0; y < prc->Height; y++)
                 {
                     float *gray_float = (float *)src;
@@ -1106,7 +1297,7 @@ static HRESULT copypixels_to_24bppBGR(struct FormatConverter *This, const WICRec
 
                     for (x = 0; x < prc->Width; x++)
                     {
-                        BYTE gray = (BYTE)floorf(to_sRGB_component(gray_float[x]) * 255.0f + 0.51f);
+                        BYTE gray = linear_to_sRGB_byte(gray_float[x]);
                         *bgr++ = gray;
                         *bgr++ = gray;
                         *bgr++ = gray;
@@ -1193,14 +1384,11 @@ static HRESULT copypixels_to_24bppRGB(struct FormatConverter *This, const WICRec
         if (prc)
         {
             HRESULT res;
-            INT x, y;
+            INT y;
             BYTE *srcdata;
             UINT srcstride, srcdatasize;
             const BYTE *srcrow;
-            const BYTE *srcpixel;
             BYTE *dstrow;
-            BYTE *dstpixel;
-            BYTE tmppixel[3];
 
             srcstride = 4 * prc->Width;
             srcdatasize = srcstride * prc->Height;
@@ -1215,18 +1403,7 @@ static HRESULT copypixels_to_24bppRGB(struct FormatConverter *This, const WICRec
                 srcrow = srcdata;
                 dstrow = pbBuffer;
                 for (y=0; y<prc->Height; y++) {
-                    srcpixel=srcrow;
-                    dstpixel=dstrow;
-                    for (x=0; x<prc->Width; x++) {
-                        tmppixel[0]=*srcpixel++; /* blue */
-                        tmppixel[1]=*srcpixel++; /* green */
-                        tmppixel[2]=*srcpixel++; /* red */
-                        srcpixel++; /* alpha */
-
-                        *dstpixel++=tmppixel[2]; /* red */
-                        *dstpixel++=tmppixel[1]; /* green */
-                        *dstpixel++=tmppixel[0]; /* blue */
-                    }
+                    convert_row_32bpp_to_24bpp(srcrow, dstrow, prc->Width, TRUE);
                     srcrow += srcstride;
                     dstrow += cbStride;
                 }
@@ -1319,13 +1496,15 @@ static HRESULT copypixels_to_8bppGray(struct FormatConverter *This, const WICRec
                 INT x, y;
                 BYTE *src = srcdata, *dst = pbBuffer;
 
+                init_conversion_tables();
+
                 for (y=0; y < prc->Height; y++)
                 {
                     float *srcpixel = (float*)src;
                     BYTE *dstpixel = dst;
 
                     for (x=0; x < prc->Width; x++)
-                        *dstpixel++ = (BYTE)floorf(to_sRGB_component(*srcpixel++) * 255.0f + 0.51f);
+                        *dstpixel++ = linear_to_sRGB_byte(*srcpixel++);
 
                     src += srcstride;
                     dst += cbStride;
@@ -1353,6 +1532,8 @@ static HRESULT copypixels_to_8bppGray(struct FormatConverter *This, const WICRec
         INT x, y;
         BYTE *src = srcdata, *dst = pbBuffer;
 
+        init_conversion_tables();
+
         for (y = 0; y < prc->Height; y++)
         {
             BYTE *bgr = src;
@@ -1361,8 +1542,7 @@ static HRESULT copypixels_to_8bppGray(struct FormatConverter *This, const WICRec
             {
                 float gray = (bgr[2] * 0.2126f + bgr[1] * 0.7152f + bgr[0] * 0.0722f) / 255.0f;
 
-                gray = to_sRGB_component(gray) * 255.0f;
-                dst[x] = (BYTE)floorf(gray + 0.51f);
+                dst[x] = linear_to_sRGB_byte(gray);
                 bgr += 3;
             }
             src += srcstride;
@@ -1407,11 +1587,34 @@ static UINT rgb_to_palette_index(BYTE bgr[3], WICColor *colors, UINT count)
     return best_index;
 }
 
+/* direct mapped cache of the palette entries that were found for recent colors */
+#define PALETTE_CACHE_SIZE 4096
+
+struct palette_cache
+{
+    DWORD color[PALETTE_CACHE_SIZE]; /* BGR value with bit 24 set, 0 for unused entries */
+    BYTE index[PALETTE_CACHE_SIZE];
+};
+
+static inline BYTE get_palette_index(struct palette_cache *cache, BYTE bgr[3], WICColor *colors, UINT count)
+{
+    DWORD color = 0x1000000 | (bgr[2] << 16) | (bgr[1] << 8) | bgr[0];
+    UINT hash = (color ^ (color >> 12)) % PALETTE_CACHE_SIZE;
+
+    if (cache->color[hash] != color)
+    {
+        cache->color[hash] = color;
+        cache->index[hash] = rgb_to_palette_index(bgr, colors, count);
+    }
+    return cache->index[hash];
+}
+
 static HRESULT copypixels_to_8bppIndexed(struct FormatConverter *This, const WICRect *prc,
     UINT cbStride, UINT cbBufferSize, BYTE *pbBuffer, enum pixelformat source_format)
 {
     HRESULT hr;
     BYTE *srcdata;
+    struct palette_cache *cache;
     WICColor colors[256];
     UINT srcstride, srcdatasize, count;
 
@@ -1437,6 +1640,12 @@ static HRESULT copypixels_to_8bppIndexed(struct FormatConverter *This, const WIC
     srcdata = HeapAlloc(GetProcessHeap(), 0, srcdatasize);
     if (!srcdata) return E_OUTOFMEMORY;
 
+    if (!(cache = heap_alloc_zero(sizeof(*cache))))
+    {
+        HeapFree(GetProcessHeap(), 0, srcdata);
+        return E_OUTOFMEMORY;
+    }
+
     hr = copypixels_to_24bppBGR(This, prc, srcstride, srcdatasize, srcdata, source_format);
     if (SUCCEEDED(hr) && prc)
     {
@@ -1449,7 +1658,7 @@ static HRESULT copypixels_to_8bppIndexed(struct FormatConverter *This, const WIC
 
             for (x = 0; x < prc->Width; x++)
             {
-                dst[x] = rgb_to_palette_index(bgr, colors, count);
+                dst[x] = get_palette_index(cache, bgr, colors, count);
                 bgr += 3;
             }
             src += srcstride;
@@ -1457,6 +1666,7 @@ static HRESULT copypixels_to_8bppIndexed(struct FormatConverter *This, const WIC
         }
     }
 
+    heap_free(cache);
     HeapFree(GetProcessHeap(), 0, srcdata);
     return hr;
 }
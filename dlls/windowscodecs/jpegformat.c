@@ -69,6 +69,7 @@ static const WCHAR wszJpegYCrCbSubsampling[] = {'J','p','e','g','Y','C','r','C',
 static const WCHAR wszSuppressApp0[] = {'S','u','p','p','r','e','s','s','A','p','p','0',0};
 
 #define MAKE_FUNCPTR(f) static typeof(f) * p##f
+MAKE_FUNCPTR(jpeg_abort_decompress);
 MAKE_FUNCPTR(jpeg_CreateCompress);
 MAKE_FUNCPTR(jpeg_CreateDecompress);
 MAKE_FUNCPTR(jpeg_destroy_compress);
@@ -94,6 +95,7 @@ static void *load_libjpeg(void)
         return NULL; \
     }
 
+        LOAD_FUNCPTR(jpeg_abort_decompress);
         LOAD_FUNCPTR(jpeg_CreateCompress);
         LOAD_FUNCPTR(jpeg_CreateDecompress);
         LOAD_FUNCPTR(jpeg_destroy_compress);
@@ -148,6 +150,7 @@ typedef struct {
     IWICBitmapDecoder IWICBitmapDecoder_iface;
     IWICBitmapFrameDecode IWICBitmapFrameDecode_iface;
     IWICMetadataBlockReader IWICMetadataBlockReader_iface;
+    IWICBitmapSourceTransform IWICBitmapSourceTransform_iface;
     LONG ref;
     BOOL initialized;
     BOOL cinfo_initialized;
@@ -156,8 +159,11 @@ typedef struct {
     struct jpeg_error_mgr jerr;
     struct jpeg_source_mgr source_mgr;
     BYTE source_buffer[1024];
+    ULONGLONG stream_pos; /* stream offset following the data given to libjpeg */
     UINT bpp, stride;
-    BYTE *image_data;
+    UINT scale; /* DCT scaling denominator of the current decompression */
+    BYTE *image_data; /* decoded scanlines, starting at data_first */
+    UINT data_first, data_rows; /* first scanline held, and rows allocated */
     CRITICAL_SECTION lock;
 } JpegDecoder;
 
@@ -181,6 +187,11 @@ static inline JpegDecoder *impl_from_IWICMetadataBlockReader(IWICMetadataBlockRe
     return CONTAINING_RECORD(iface, JpegDecoder, IWICMetadataBlockReader_iface);
 }
 
+static inline JpegDecoder *impl_from_IWICBitmapSourceTransform(IWICBitmapSourceTransform *iface)
+{
+    return CONTAINING_RECORD(iface, JpegDecoder, IWICBitmapSourceTransform_iface);
+}
+
 static HRESULT WINAPI JpegDecoder_QueryInterface(IWICBitmapDecoder *iface, REFIID iid,
     void **ppv)
 {
@@ -270,6 +281,7 @@ static jpeg_boolean source_mgr_fill_input_buffer(j_decompress_ptr cinfo)
     }
     else
     {
+        This->stream_pos += bytesread;
         This->source_mgr.next_input_byte = This->source_buffer;
         This->source_mgr.bytes_in_buffer = bytesread;
         return TRUE;
@@ -285,6 +297,7 @@ static void source_mgr_skip_input_data(j_decompress_ptr cinfo, long num_bytes)
     {
         seek.QuadPart = num_bytes - This->source_mgr.bytes_in_buffer;
         IStream_Seek(This->stream, seek, STREAM_SEEK_CUR, NULL);
+        This->stream_pos += seek.QuadPart;
         This->source_mgr.bytes_in_buffer = 0;
     }
     else if (num_bytes > 0)
@@ -298,6 +311,174 @@ static void source_mgr_term_source(j_decompress_ptr cinfo)
 {
 }
 
+/* Scanlines are only decoded when CopyPixels needs them, and only the rows
+ * from the top of the last requested rectangle are kept, so that callers
+ * reading an image a few scanlines at a time don't need a buffer for the
+ * whole image. Going back to an earlier row restarts the decompression.
+ * The stream may be moved by the caller between two calls, so the position
+ * libjpeg is at is restored before resuming. */
+
+static BOOL start_decompress(JpegDecoder *This)
+{
+    This->cinfo.scale_num = 1;
+    This->cinfo.scale_denom = This->scale;
+    if (!pjpeg_start_decompress(&This->cinfo)) return FALSE;
+
+    if (This->cinfo.out_color_space == JCS_GRAYSCALE) This->bpp = 8;
+    else if (This->cinfo.out_color_space == JCS_CMYK) This->bpp = 32;
+    else This->bpp = 24;
+
+    This->stride = (This->bpp * This->cinfo.output_width + 7) / 8;
+    This->data_first = 0;
+    This->data_rows = 0;
+    heap_free(This->image_data);
+    This->image_data = NULL;
+    return TRUE;
+}
+
+/* restart the decompression from the beginning of the stream, must be called with the lock held */
+static HRESULT restart_decompress(JpegDecoder *This, UINT scale)
+{
+    J_COLOR_SPACE color_space = This->cinfo.out_color_space;
+    LARGE_INTEGER seek;
+    jmp_buf jmpbuf;
+
+    TRACE("(%p,%u)\n", This, scale);
+
+    This->cinfo.client_data = jmpbuf;
+
+    if (setjmp(jmpbuf)) return E_FAIL;
+
+    pjpeg_abort_decompress(&This->cinfo);
+
+    seek.QuadPart = 0;
+    IStream_Seek(This->stream, seek, STREAM_SEEK_SET, NULL);
+    This->stream_pos = 0;
+    This->source_mgr.bytes_in_buffer = 0;
+
+    if (pjpeg_read_header(&This->cinfo, TRUE) != JPEG_HEADER_OK) return E_FAIL;
+
+    This->cinfo.out_color_space = color_space;
+    This->scale = scale;
+    return start_decompress(This) ? S_OK : E_FAIL;
+}
+
+/* decode the scanlines up to last at the given scale, keeping those from first on;
+ * must be called with the lock held */
+static HRESULT read_scanlines(JpegDecoder *This, UINT scale, UINT first, UINT last)
+{
+    jmp_buf jmpbuf;
+    JSAMPROW out_rows[4];
+    UINT cur, count, i;
+    HRESULT hr;
+
+    if ((scale != This->scale || first < This->data_first) &&
+        FAILED(hr = restart_decompress(This, scale)))
+    {
+        This->data_first = ~0u; /* try again on the next call */
+        return hr;
+    }
+
+    cur = This->cinfo.output_scanline;
+    if (first > This->data_first && first < cur)
+    {
+        memmove(This->image_data, This->image_data + (first - This->data_first) * This->stride,
+            (cur - first) * This->stride);
+        This->data_first = first;
+    }
+
+    This->cinfo.client_data = jmpbuf;
+
+    if (setjmp(jmpbuf))
+    {
+        This->data_first = ~0u;
+        return E_FAIL;
+    }
+
+    if (This->cinfo.output_scanline < last)
+    {
+        LARGE_INTEGER seek;
+
+        seek.QuadPart = This->stream_pos;
+        IStream_Seek(This->stream, seek, STREAM_SEEK_SET, NULL);
+    }
+
+    while ((cur = This->cinfo.output_scanline) < last)
+    {
+        BYTE *rows;
+
+        /* rows above the rectangle are discarded as soon as they are decoded */
+        if (cur <= first) This->data_first = cur;
+
+        count = min(last - cur, ARRAY_SIZE(out_rows));
+        if (cur + count - This->data_first > This->data_rows)
+        {
+            UINT new_rows = cur + count - This->data_first;
+
+            if (!(rows = heap_realloc(This->image_data, new_rows * This->stride))) return E_OUTOFMEMORY;
+            This->image_data = rows;
+            This->data_rows = new_rows;
+        }
+
+        rows = This->image_data + (cur - This->data_first) * This->stride;
+        for (i = 0; i < count; i++) out_rows[i] = rows + i * This->stride;
+
+        if (!(count = pjpeg_read_scanlines(&This->cinfo, out_rows, count)))
+        {
+            ERR("read_scanlines failed\n");
+            This->data_first = ~0u;
+            return E_FAIL;
+        }
+
+        if (This->bpp == 24)
+        {
+            /* libjpeg gives us RGB data and we want BGR, so byteswap the data */
+            reverse_bgr8(3, rows, This->cinfo.output_width, count, This->stride);
+        }
+
+        if (This->cinfo.out_color_space == JCS_CMYK && This->cinfo.saw_Adobe_marker)
+        {
+            /* Adobe JPEG's have inverted CMYK data. */
+            for (i = 0; i < count * This->stride; i++)
+                rows[i] ^= 0xff;
+        }
+    }
+
+    return S_OK;
+}
+
+/* copy pixels of the image decoded at the given scale, must be called with the lock held */
+static HRESULT copy_scanlines(JpegDecoder *This, UINT scale, const WICRect *prc,
+    UINT stride, UINT size, BYTE *buffer)
+{
+    UINT width = (This->cinfo.image_width + scale - 1) / scale;
+    UINT height = (This->cinfo.image_height + scale - 1) / scale;
+    WICRect rect;
+    HRESULT hr;
+
+    if (prc)
+    {
+        if (prc->X < 0 || prc->Y < 0 || prc->Width <= 0 || prc->Height <= 0 ||
+            prc->X + prc->Width > width || prc->Y + prc->Height > height)
+            return E_INVALIDARG;
+        rect = *prc;
+    }
+    else
+    {
+        rect.X = 0;
+        rect.Y = 0;
+        rect.Width = width;
+        rect.Height = height;
+    }
+
+    if (FAILED(hr = read_scanlines(This, scale, rect.Y, rect.Y + rect.Height))) return hr;
+
+    rect.Y -= This->data_first;
+    return copy_pixels(This->bpp, This->image_data, This->cinfo.output_width,
+        This->cinfo.output_scanline - This->data_first, This->stride,
+        &rect, stride, size, buffer);
+}
+
 static HRESULT WINAPI JpegDecoder_Initialize(IWICBitmapDecoder *iface, IStream *pIStream,
     WICDecodeOptions cacheOptions)
 {
@@ -305,7 +486,6 @@ static HRESULT WINAPI JpegDecoder_Initialize(IWICBitmapDecoder *iface, IStream *
     int ret;
     LARGE_INTEGER seek;
     jmp_buf jmpbuf;
-    UINT data_size, i;
 
     TRACE("(%p,%p,%u)\n", iface, pIStream, cacheOptions);
 
@@ -341,6 +521,7 @@ static HRESULT WINAPI JpegDecoder_Initialize(IWICBitmapDecoder *iface, IStream *
 
     seek.QuadPart = 0;
     IStream_Seek(This->stream, seek, STREAM_SEEK_SET, NULL);
+    This->stream_pos = 0;
 
     This->source_mgr.bytes_in_buffer = 0;
     This->source_mgr.init_source = source_mgr_init_source;
@@ -378,62 +559,14 @@ static HRESULT WINAPI JpegDecoder_Initialize(IWICBitmapDecoder *iface, IStream *
         return E_FAIL;
     }
 
-    if (!pjpeg_start_decompress(&This->cinfo))
+    This->scale = 1;
+    if (!start_decompress(This))
     {
         ERR("jpeg_start_decompress failed\n");
         LeaveCriticalSection(&This->lock);
         return E_FAIL;
     }
 
-    if (This->cinfo.out_color_space == JCS_GRAYSCALE) This->bpp = 8;
-    else if (This->cinfo.out_color_space == JCS_CMYK) This->bpp = 32;
-    else This->bpp = 24;
-
-    This->stride = (This->bpp * This->cinfo.output_width + 7) / 8;
-    data_size = This->stride * This->cinfo.output_height;
-
-    This->image_data = heap_alloc(data_size);
-    if (!This->image_data)
-    {
-        LeaveCriticalSection(&This->lock);
-        return E_OUTOFMEMORY;
-    }
-
-    while (This->cinfo.output_scanline < This->cinfo.output_height)
-    {
-        UINT first_scanline = This->cinfo.output_scanline;
-        UINT max_rows;
-        JSAMPROW out_rows[4];
-        JDIMENSION ret;
-
-        max_rows = min(This->cinfo.output_height-first_scanline, 4);
-        for (i=0; i<max_rows; i++)
-            out_rows[i] = This->image_data + This->stride * (first_scanline+i);
-
-        ret = pjpeg_read_scanlines(&This->cinfo, out_rows, max_rows);
-        if (ret == 0)
-        {
-            ERR("read_scanlines failed\n");
-            LeaveCriticalSection(&This->lock);
-            return E_FAIL;
-        }
-    }
-
-    if (This->bpp == 24)
-    {
-        /* libjpeg gives us RGB data and we want BGR, so byteswap the data */
-        reverse_bgr8(3, This->image_data,
-            This->cinfo.output_width, This->cinfo.output_height,
-            This->stride);
-    }
-
-    if (This->cinfo.out_color_space == JCS_CMYK && This->cinfo.saw_Adobe_marker)
-    {
-        /* Adobe JPEG's have inverted CMYK data. */
-        for (i=0; i<data_size; i++)
-            This->image_data[i] ^= 0xff;
-    }
-
     This->initialized = TRUE;
 
     LeaveCriticalSection(&This->lock);
@@ -553,6 +686,10 @@ static HRESULT WINAPI JpegDecoder_Frame_QueryInterface(IWICBitmapFrameDecode *if
     {
         *ppv = &This->IWICBitmapFrameDecode_iface;
     }
+    else if (IsEqualIID(&IID_IWICBitmapSourceTransform, iid))
+    {
+        *ppv = &This->IWICBitmapSourceTransform_iface;
+    }
     else
     {
         *ppv = NULL;
@@ -579,8 +716,8 @@ static HRESULT WINAPI JpegDecoder_Frame_GetSize(IWICBitmapFrameDecode *iface,
     UINT *puiWidth, UINT *puiHeight)
 {
     JpegDecoder *This = impl_from_IWICBitmapFrameDecode(iface);
-    *puiWidth = This->cinfo.output_width;
-    *puiHeight = This->cinfo.output_height;
+    *puiWidth = This->cinfo.image_width;
+    *puiHeight = This->cinfo.image_height;
     TRACE("(%p)->(%u,%u)\n", iface, *puiWidth, *puiHeight);
     return S_OK;
 }
@@ -643,12 +780,15 @@ static HRESULT WINAPI JpegDecoder_Frame_CopyPixels(IWICBitmapFrameDecode *iface,
     const WICRect *prc, UINT cbStride, UINT cbBufferSize, BYTE *pbBuffer)
 {
     JpegDecoder *This = impl_from_IWICBitmapFrameDecode(iface);
+    HRESULT hr;
 
     TRACE("(%p,%s,%u,%u,%p)\n", iface, debug_wic_rect(prc), cbStride, cbBufferSize, pbBuffer);
 
-    return copy_pixels(This->bpp, This->image_data,
-        This->cinfo.output_width, This->cinfo.output_height, This->stride,
-        prc, cbStride, cbBufferSize, pbBuffer);
+    EnterCriticalSection(&This->lock);
+    hr = copy_scanlines(This, 1, prc, cbStride, cbBufferSize, pbBuffer);
+    LeaveCriticalSection(&This->lock);
+
+    return hr;
 }
 
 static HRESULT WINAPI JpegDecoder_Frame_GetMetadataQueryReader(IWICBitmapFrameDecode *iface,
@@ -759,6 +899,123 @@ static const IWICMetadataBlockReaderVtbl JpegDecoder_Block_Vtbl = {
     JpegDecoder_Block_GetEnumerator,
 };
 
+static HRESULT WINAPI JpegDecoder_Transform_QueryInterface(IWICBitmapSourceTransform *iface, REFIID iid,
+    void **ppv)
+{
+    JpegDecoder *This = impl_from_IWICBitmapSourceTransform(iface);
+    return IWICBitmapFrameDecode_QueryInterface(&This->IWICBitmapFrameDecode_iface, iid, ppv);
+}
+
+static ULONG WINAPI JpegDecoder_Transform_AddRef(IWICBitmapSourceTransform *iface)
+{
+    JpegDecoder *This = impl_from_IWICBitmapSourceTransform(iface);
+    return IWICBitmapDecoder_AddRef(&This->IWICBitmapDecoder_iface);
+}
+
+static ULONG WINAPI JpegDecoder_Transform_Release(IWICBitmapSourceTransform *iface)
+{
+    JpegDecoder *This = impl_from_IWICBitmapSourceTransform(iface);
+    return IWICBitmapDecoder_Release(&This->IWICBitmapDecoder_iface);
+}
+
+/* libjpeg can decode at 1/2, 1/4 and 1/8 of the size by only using part of the DCT coefficients */
+static UINT get_scale_for_size(JpegDecoder *This, UINT width, UINT height)
+{
+    UINT scale;
+
+    for (scale = 1; scale <= 8; scale *= 2)
+        if (width == (This->cinfo.image_width + scale - 1) / scale &&
+            height == (This->cinfo.image_height + scale - 1) / scale)
+            return scale;
+    return 0;
+}
+
+static HRESULT WINAPI JpegDecoder_Transform_CopyPixels(IWICBitmapSourceTransform *iface,
+    const WICRect *prc, UINT width, UINT height, WICPixelFormatGUID *format,
+    WICBitmapTransformOptions transform, UINT stride, UINT size, BYTE *buffer)
+{
+    JpegDecoder *This = impl_from_IWICBitmapSourceTransform(iface);
+    WICPixelFormatGUID native_format;
+    UINT scale;
+    HRESULT hr;
+
+    TRACE("(%p,%s,%u,%u,%s,%u,%u,%u,%p)\n", iface, debug_wic_rect(prc), width, height,
+        debugstr_guid(format), transform, stride, size, buffer);
+
+    if (transform != WICBitmapTransformRotate0)
+    {
+        FIXME("unsupported transform %#x\n", transform);
+        return E_NOTIMPL;
+    }
+
+    IWICBitmapFrameDecode_GetPixelFormat(&This->IWICBitmapFrameDecode_iface, &native_format);
+    if (format && !IsEqualGUID(format, &native_format))
+        return WINCODEC_ERR_UNSUPPORTEDPIXELFORMAT;
+
+    if (!(scale = get_scale_for_size(This, width, height)))
+        return E_INVALIDARG;
+
+    EnterCriticalSection(&This->lock);
+    hr = copy_scanlines(This, scale, prc, stride, size, buffer);
+    LeaveCriticalSection(&This->lock);
+
+    return hr;
+}
+
+static HRESULT WINAPI JpegDecoder_Transform_GetClosestSize(IWICBitmapSourceTransform *iface,
+    UINT *width, UINT *height)
+{
+    JpegDecoder *This = impl_from_IWICBitmapSourceTransform(iface);
+    UINT scale;
+
+    TRACE("(%p,%p,%p)\n", iface, width, height);
+
+    if (!width || !height) return E_INVALIDARG;
+
+    /* the smallest size that is still at least as large as the requested one */
+    for (scale = 8; scale > 1; scale /= 2)
+        if ((This->cinfo.image_width + scale - 1) / scale >= *width &&
+            (This->cinfo.image_height + scale - 1) / scale >= *height)
+            break;
+
+    *width = (This->cinfo.image_width + scale - 1) / scale;
+    *height = (This->cinfo.image_height + scale - 1) / scale;
+    return S_OK;
+}
+
+static HRESULT WINAPI JpegDecoder_Transform_GetClosestPixelFormat(IWICBitmapSourceTransform *iface,
+    WICPixelFormatGUID *format)
+{
+    JpegDecoder *This = impl_from_IWICBitmapSourceTransform(iface);
+
+    TRACE("(%p,%p)\n", iface, format);
+
+    if (!format) return E_INVALIDARG;
+
+    return IWICBitmapFrameDecode_GetPixelFormat(&This->IWICBitmapFrameDecode_iface, format);
+}
+
+static HRESULT WINAPI JpegDecoder_Transform_DoesSupportTransform(IWICBitmapSourceTransform *iface,
+    WICBitmapTransformOptions transform, BOOL *supported)
+{
+    TRACE("(%p,%u,%p)\n", iface, transform, supported);
+
+    if (!supported) return E_INVALIDARG;
+
+    *supported = (transform == WICBitmapTransformRotate0);
+    return S_OK;
+}
+
+static const IWICBitmapSourceTransformVtbl JpegDecoder_Transform_Vtbl = {
+    JpegDecoder_Transform_QueryInterface,
+    JpegDecoder_Transform_AddRef,
+    JpegDecoder_Transform_Release,
+    JpegDecoder_Transform_CopyPixels,
+    JpegDecoder_Transform_GetClosestSize,
+    JpegDecoder_Transform_GetClosestPixelFormat,
+    JpegDecoder_Transform_DoesSupportTransform
+};
+
 HRESULT JpegDecoder_CreateInstance(REFIID iid, void** ppv)
 {
     JpegDecoder *This;
@@ -780,11 +1037,15 @@ HRESULT JpegDecoder_CreateInstance(REFIID iid, void** ppv)
     This->IWICBitmapDecoder_iface.lpVtbl = &JpegDecoder_Vtbl;
     This->IWICBitmapFrameDecode_iface.lpVtbl = &JpegDecoder_Frame_Vtbl;
     This->IWICMetadataBlockReader_iface.lpVtbl = &JpegDecoder_Block_Vtbl;
+    This->IWICBitmapSourceTransform_iface.lpVtbl = &JpegDecoder_Transform_Vtbl;
     This->ref = 1;
     This->initialized = FALSE;
     This->cinfo_initialized = FALSE;
     This->stream = NULL;
+    This->stream_pos = 0;
+    This->scale = 1;
     This->image_data = NULL;
+    This->data_first = This->data_rows = 0;
     InitializeCriticalSection(&This->lock);
     This->lock.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": JpegDecoder.lock");
 
@@ -228,6 +228,20 @@ void reverse_bgr8(UINT bytesperpixel, LPBYTE bits, UINT width, UINT height, INT
     }
 }
 
+BOOL sse2_supported(void)
+{
+#if defined(__x86_64__)
+    return TRUE;
+#elif defined(__i386__)
+    static int supported = -1;
+
+    if (supported == -1) supported = IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+    return supported;
+#else
+    return FALSE;
+#endif
+}
+
 HRESULT get_pixelformat_bpp(const GUID *pixelformat, UINT *bpp)
 {
     HRESULT hr;
@@ -19,6 +19,13 @@
 #include "config.h"
 
 #include <stdarg.h>
+#include <math.h>
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
 
 #define COBJMACROS
 
@@ -32,6 +39,19 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(wincodecs);
 
+/* Weights are 14-bit fixed point. Horizontally filtered values keep 6 bits of
+ * fraction so that they fit in 16 bits, including the overshoot of the cubic
+ * filter, and the vertical pass can multiply two rows at a time with SSE2. */
+#define WEIGHT_BITS 14
+#define ROW_BITS    6
+
+struct filter_table
+{
+    UINT taps;      /* number of source pixels contributing to each destination pixel */
+    UINT *start;    /* first contributing source pixel of each destination pixel */
+    SHORT *weights; /* taps weights for each destination pixel */
+};
+
 typedef struct BitmapScaler {
     IWICBitmapScaler IWICBitmapScaler_iface;
     LONG ref;
@@ -42,9 +62,24 @@ typedef struct BitmapScaler {
     UINT bpp;
     void (*fn_get_required_source_rect)(struct BitmapScaler*,UINT,UINT,WICRect*);
     void (*fn_copy_scanline)(struct BitmapScaler*,UINT,UINT,UINT,BYTE**,UINT,UINT,BYTE*);
+    struct filter_table filter_x, filter_y; /* used by the filtering modes */
+    UINT channels;
+    BOOL premultiply; /* straight alpha is premultiplied around the filters */
+    SHORT *rows; /* horizontally filtered source rows, ring of filter_y.taps entries */
+    INT *row_index; /* source row held in each entry of the ring, or -1 */
+    UINT rows_x, rows_width; /* destination columns covered by the ring */
     CRITICAL_SECTION lock; /* must be held when initialized */
 } BitmapScaler;
 
+static void free_filter_table(struct filter_table *table)
+{
+    HeapFree(GetProcessHeap(), 0, table->start);
+    HeapFree(GetProcessHeap(), 0, table->weights);
+    table->start = NULL;
+    table->weights = NULL;
+    table->taps = 0;
+}
+
 static inline BitmapScaler *impl_from_IWICBitmapScaler(IWICBitmapScaler *iface)
 {
     return CONTAINING_RECORD(iface, BitmapScaler, IWICBitmapScaler_iface);
@@ -96,6 +131,10 @@ static ULONG WINAPI BitmapScaler_Release(IWICBitmapScaler *iface)
         This->lock.DebugInfo->Spare[0] = 0;
         DeleteCriticalSection(&This->lock);
         if (This->source) IWICBitmapSource_Release(This->source);
+        free_filter_table(&This->filter_x);
+        free_filter_table(&This->filter_y);
+        HeapFree(GetProcessHeap(), 0, This->rows);
+        HeapFree(GetProcessHeap(), 0, This->row_index);
         HeapFree(GetProcessHeap(), 0, This);
     }
 
@@ -193,6 +232,303 @@ static void NearestNeighbor_CopyScanline(BitmapScaler *This,
     }
 }
 
+static double filter_linear(double x)
+{
+    x = fabs(x);
+    return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+/* Catmull-Rom spline */
+static double filter_cubic(double x)
+{
+    x = fabs(x);
+    if (x < 1.0) return (1.5 * x - 2.5) * x * x + 1.0;
+    if (x < 2.0) return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+    return 0.0;
+}
+
+/* compute the contribution of the source pixels to each destination pixel along one axis */
+static HRESULT init_filter_table(struct filter_table *table, WICBitmapInterpolationMode mode,
+    UINT src_size, UINT dst_size)
+{
+    double scale = (double)src_size / dst_size;
+    double filter_scale = max(scale, 1.0);
+    double support, center, lo, hi, sum, *tmp;
+    int first, last, i, start, largest, total;
+    UINT x, j;
+
+    switch (mode)
+    {
+    case WICBitmapInterpolationModeLinear:
+        support = filter_scale;
+        break;
+    case WICBitmapInterpolationModeCubic:
+        support = 2.0 * filter_scale;
+        break;
+    default: /* Fant: each destination pixel averages the source area it covers */
+        support = (scale + 1.0) / 2.0;
+        break;
+    }
+
+    table->taps = min(src_size, (UINT)ceil(2.0 * support) + 1);
+    table->start = HeapAlloc(GetProcessHeap(), 0, dst_size * sizeof(*table->start));
+    table->weights = HeapAlloc(GetProcessHeap(), 0, dst_size * table->taps * sizeof(*table->weights));
+    tmp = HeapAlloc(GetProcessHeap(), 0, table->taps * sizeof(*tmp));
+    if (!table->start || !table->weights || !tmp)
+    {
+        free_filter_table(table);
+        HeapFree(GetProcessHeap(), 0, tmp);
+        return E_OUTOFMEMORY;
+    }
+
+    for (x = 0; x < dst_size; x++)
+    {
+        center = (x + 0.5) * scale - 0.5;
+        lo = x * scale;
+        hi = (x + 1) * scale;
+        if (mode == WICBitmapInterpolationModeLinear || mode == WICBitmapInterpolationModeCubic)
+        {
+            first = ceil(center - support);
+            last = floor(center + support);
+        }
+        else
+        {
+            first = floor(lo);
+            last = ceil(hi) - 1;
+        }
+
+        /* pixels outside of the source are replaced by the nearest edge pixel */
+        start = min(max(first, 0), (int)(src_size - table->taps));
+        memset(tmp, 0, table->taps * sizeof(*tmp));
+        for (i = first; i <= last; i++)
+        {
+            double w;
+
+            if (mode == WICBitmapInterpolationModeLinear)
+                w = filter_linear((i - center) / filter_scale);
+            else if (mode == WICBitmapInterpolationModeCubic)
+                w = filter_cubic((i - center) / filter_scale);
+            else
+                w = min(hi, i + 1) - max(lo, i);
+            tmp[min(max(i, 0), (int)src_size - 1) - start] += w;
+        }
+
+        for (j = 0, sum = 0.0; j < table->taps; j++) sum += tmp[j];
+        for (j = 0, total = 0, largest = 0; j < table->taps; j++)
+        {
+            table->weights[x * table->taps + j] = floor(tmp[j] / sum * (1 << WEIGHT_BITS) + 0.5);
+            total += table->weights[x * table->taps + j];
+            if (tmp[j] > tmp[largest]) largest = j;
+        }
+        /* make sure the weights add up to exactly 1 */
+        table->weights[x * table->taps + largest] += (1 << WEIGHT_BITS) - total;
+        table->start[x] = start;
+    }
+
+    HeapFree(GetProcessHeap(), 0, tmp);
+    return S_OK;
+}
+
+/* filter a source row horizontally into a ring entry */
+static void filter_row(const BitmapScaler *This, const BYTE *src, UINT src_x, UINT dst_x, UINT dst_width,
+    SHORT *dst)
+{
+    const struct filter_table *table = &This->filter_x;
+    UINT channels = This->channels, x, c, i;
+
+    for (x = 0; x < dst_width; x++)
+    {
+        const SHORT *weights = table->weights + (dst_x + x) * table->taps;
+        const BYTE *pixel = src + (table->start[dst_x + x] - src_x) * channels;
+
+        for (c = 0; c < channels; c++, dst++)
+        {
+            int sum = 0;
+
+            for (i = 0; i < table->taps; i++) sum += weights[i] * pixel[i * channels + c];
+            sum = (sum + (1 << (WEIGHT_BITS - ROW_BITS - 1))) >> (WEIGHT_BITS - ROW_BITS);
+            *dst = min(max(sum, -32768), 32767);
+        }
+    }
+}
+
+/* Filtering straight alpha pixels would let the color of transparent pixels
+ * bleed into their neighbours, so the filters work on premultiplied values. */
+static void premultiply_row(BYTE *bits, UINT width)
+{
+    UINT x, c;
+
+    for (x = 0; x < width; x++, bits += 4)
+        for (c = 0; c < 3; c++) bits[c] = (bits[c] * bits[3] + 127) / 255;
+}
+
+static void unpremultiply_row(BYTE *bits, UINT width)
+{
+    UINT x, c;
+
+    for (x = 0; x < width; x++, bits += 4)
+    {
+        if (bits[3] == 255) continue;
+        for (c = 0; c < 3; c++)
+            bits[c] = bits[3] ? min((bits[c] * 255 + bits[3] / 2) / bits[3], 255) : 0;
+    }
+}
+
+static inline BYTE clamp_filtered(int value)
+{
+    value >>= WEIGHT_BITS + ROW_BITS;
+    return min(max(value, 0), 255);
+}
+
+#ifdef USE_SSE2
+
+/* vertical pass, processing eight values and two rows per multiply */
+static UINT __attribute__((target("sse2"))) filter_column_sse2(const SHORT **rows, const SHORT *weights,
+    UINT taps, UINT count, BYTE *dst)
+{
+    __m128i round = _mm_set1_epi32(1 << (WEIGHT_BITS + ROW_BITS - 1));
+    UINT i, k;
+
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        __m128i lo = round, hi = round;
+
+        for (k = 0; k < taps; k += 2)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(rows[k] + i));
+            __m128i b = k + 1 < taps ? _mm_loadu_si128((const __m128i *)(rows[k + 1] + i)) : _mm_setzero_si128();
+            __m128i w = _mm_set1_epi32((k + 1 < taps ? (UINT)(USHORT)weights[k + 1] << 16 : 0) | (USHORT)weights[k]);
+
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+        lo = _mm_srai_epi32(lo, WEIGHT_BITS + ROW_BITS);
+        hi = _mm_srai_epi32(hi, WEIGHT_BITS + ROW_BITS);
+        lo = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(lo, lo));
+    }
+    return i;
+}
+
+#endif
+
+/* vertical pass, combining the ring entries into a destination row */
+static void filter_column(const SHORT **rows, const SHORT *weights, UINT taps, UINT count, BYTE *dst)
+{
+    UINT i = 0, k;
+
+#ifdef USE_SSE2
+    if (sse2_supported()) i = filter_column_sse2(rows, weights, taps, count, dst);
+#endif
+    for (; i < count; i++)
+    {
+        int sum = 1 << (WEIGHT_BITS + ROW_BITS - 1);
+
+        for (k = 0; k < taps; k++) sum += weights[k] * rows[k][i];
+        dst[i] = clamp_filtered(sum);
+    }
+}
+
+/* Source rows are filtered horizontally once and kept in a ring buffer, so
+ * that callers copying one scanline at a time from top to bottom only get
+ * each source row requested once from the upstream source. */
+static HRESULT Filter_CopyPixels(BitmapScaler *This, const WICRect *rc, UINT stride, BYTE *buffer)
+{
+    UINT taps = This->filter_y.taps, count = rc->Width * This->channels;
+    UINT src_x = This->filter_x.start[rc->X];
+    UINT src_width = This->filter_x.start[rc->X + rc->Width - 1] + This->filter_x.taps - src_x;
+    UINT src_stride = src_width * This->channels;
+    const SHORT *rows[64], **row_ptrs = rows;
+    BYTE *src_bits;
+    HRESULT hr = S_OK;
+    INT y, first, i, j;
+    UINT k;
+
+    if (!This->rows || This->rows_x != rc->X || This->rows_width != rc->Width)
+    {
+        SHORT *new_rows;
+
+        if (This->rows)
+            new_rows = HeapReAlloc(GetProcessHeap(), 0, This->rows, taps * count * sizeof(SHORT));
+        else
+            new_rows = HeapAlloc(GetProcessHeap(), 0, taps * count * sizeof(SHORT));
+        if (!new_rows) return E_OUTOFMEMORY;
+        This->rows = new_rows;
+        This->rows_x = rc->X;
+        This->rows_width = rc->Width;
+        for (k = 0; k < taps; k++) This->row_index[k] = -1;
+    }
+
+    if (taps > ARRAY_SIZE(rows) && !(row_ptrs = HeapAlloc(GetProcessHeap(), 0, taps * sizeof(*row_ptrs))))
+        return E_OUTOFMEMORY;
+    if (!(src_bits = HeapAlloc(GetProcessHeap(), 0, taps * src_stride)))
+    {
+        if (row_ptrs != rows) HeapFree(GetProcessHeap(), 0, row_ptrs);
+        return E_OUTOFMEMORY;
+    }
+
+    for (y = 0; y < rc->Height && SUCCEEDED(hr); y++)
+    {
+        first = This->filter_y.start[rc->Y + y];
+
+        for (i = first; i < first + (INT)taps && SUCCEEDED(hr); i = j)
+        {
+            WICRect src_rect;
+
+            if (This->row_index[i % taps] == i)
+            {
+                j = i + 1;
+                continue;
+            }
+            /* request all the consecutive missing rows at once */
+            for (j = i + 1; j < first + (INT)taps; j++)
+                if (This->row_index[j % taps] == j) break;
+
+            src_rect.X = src_x;
+            src_rect.Y = i;
+            src_rect.Width = src_width;
+            src_rect.Height = j - i;
+            hr = IWICBitmapSource_CopyPixels(This->source, &src_rect, src_stride,
+                src_stride * src_rect.Height, src_bits);
+            for (k = 0; SUCCEEDED(hr) && k < src_rect.Height; k++)
+            {
+                if (This->premultiply) premultiply_row(src_bits + k * src_stride, src_width);
+                filter_row(This, src_bits + k * src_stride, src_x, rc->X, rc->Width,
+                    This->rows + ((i + k) % taps) * count);
+                This->row_index[(i + k) % taps] = i + k;
+            }
+        }
+        if (FAILED(hr)) break;
+
+        for (k = 0; k < taps; k++) row_ptrs[k] = This->rows + ((first + k) % taps) * count;
+        filter_column(row_ptrs, This->filter_y.weights + (rc->Y + y) * taps, taps, count,
+            buffer + y * stride);
+        if (This->premultiply) unpremultiply_row(buffer + y * stride, rc->Width);
+    }
+
+    /* a failed request may have left rows half processed */
+    if (FAILED(hr)) for (k = 0; k < taps; k++) This->row_index[k] = -1;
+
+    HeapFree(GetProcessHeap(), 0, src_bits);
+    if (row_ptrs != rows) HeapFree(GetProcessHeap(), 0, row_ptrs);
+    return hr;
+}
+
+/* return the number of channels of the formats that can be filtered, 0 for the other ones */
+static UINT get_filter_channels(const WICPixelFormatGUID *format)
+{
+    if (IsEqualGUID(format, &GUID_WICPixelFormat8bppGray)) return 1;
+    if (IsEqualGUID(format, &GUID_WICPixelFormat24bppBGR) ||
+        IsEqualGUID(format, &GUID_WICPixelFormat24bppRGB)) return 3;
+    if (IsEqualGUID(format, &GUID_WICPixelFormat32bppBGR) ||
+        IsEqualGUID(format, &GUID_WICPixelFormat32bppRGB) ||
+        IsEqualGUID(format, &GUID_WICPixelFormat32bppBGRA) ||
+        IsEqualGUID(format, &GUID_WICPixelFormat32bppPBGRA) ||
+        IsEqualGUID(format, &GUID_WICPixelFormat32bppRGBA) ||
+        IsEqualGUID(format, &GUID_WICPixelFormat32bppPRGBA)) return 4;
+    return 0;
+}
+
 static HRESULT WINAPI BitmapScaler_CopyPixels(IWICBitmapScaler *iface,
     const WICRect *prc, UINT cbStride, UINT cbBufferSize, BYTE *pbBuffer)
 {
@@ -247,6 +583,12 @@ static HRESULT WINAPI BitmapScaler_CopyPixels(IWICBitmapScaler *iface,
         goto end;
     }
 
+    if (This->channels)
+    {
+        hr = Filter_CopyPixels(This, &dest_rect, cbStride, pbBuffer);
+        goto end;
+    }
+
     /* MSDN recommends calling CopyPixels once for each scanline from top to
      * bottom, and claims codecs optimize for this. Ideally, when called in this
      * way, we should avoid requesting a scanline from the source more than
@@ -302,11 +644,161 @@ end:
     return hr;
 }
 
+/* A source reading a codec frame at a reduced size through its
+ * IWICBitmapSourceTransform, used so that the decoder can skip the detail that
+ * the scaler would throw away, for instance with the DCT scaling of JPEG. */
+typedef struct ScaledSource {
+    IWICBitmapSource IWICBitmapSource_iface;
+    LONG ref;
+    IWICBitmapSource *source;
+    IWICBitmapSourceTransform *transform;
+    UINT width, height;
+} ScaledSource;
+
+static inline ScaledSource *impl_from_IWICBitmapSource(IWICBitmapSource *iface)
+{
+    return CONTAINING_RECORD(iface, ScaledSource, IWICBitmapSource_iface);
+}
+
+static HRESULT WINAPI ScaledSource_QueryInterface(IWICBitmapSource *iface, REFIID iid, void **ppv)
+{
+    ScaledSource *This = impl_from_IWICBitmapSource(iface);
+    TRACE("(%p,%s,%p)\n", iface, debugstr_guid(iid), ppv);
+
+    if (!ppv) return E_INVALIDARG;
+
+    if (IsEqualIID(&IID_IUnknown, iid) ||
+        IsEqualIID(&IID_IWICBitmapSource, iid))
+    {
+        *ppv = &This->IWICBitmapSource_iface;
+    }
+    else
+    {
+        *ppv = NULL;
+        return E_NOINTERFACE;
+    }
+
+    IUnknown_AddRef((IUnknown*)*ppv);
+    return S_OK;
+}
+
+static ULONG WINAPI ScaledSource_AddRef(IWICBitmapSource *iface)
+{
+    ScaledSource *This = impl_from_IWICBitmapSource(iface);
+    ULONG ref = InterlockedIncrement(&This->ref);
+
+    TRACE("(%p) refcount=%u\n", iface, ref);
+
+    return ref;
+}
+
+static ULONG WINAPI ScaledSource_Release(IWICBitmapSource *iface)
+{
+    ScaledSource *This = impl_from_IWICBitmapSource(iface);
+    ULONG ref = InterlockedDecrement(&This->ref);
+
+    TRACE("(%p) refcount=%u\n", iface, ref);
+
+    if (ref == 0)
+    {
+        IWICBitmapSourceTransform_Release(This->transform);
+        IWICBitmapSource_Release(This->source);
+        HeapFree(GetProcessHeap(), 0, This);
+    }
+
+    return ref;
+}
+
+static HRESULT WINAPI ScaledSource_GetSize(IWICBitmapSource *iface, UINT *width, UINT *height)
+{
+    ScaledSource *This = impl_from_IWICBitmapSource(iface);
+
+    if (!width || !height) return E_INVALIDARG;
+
+    *width = This->width;
+    *height = This->height;
+    return S_OK;
+}
+
+static HRESULT WINAPI ScaledSource_GetPixelFormat(IWICBitmapSource *iface, WICPixelFormatGUID *format)
+{
+    ScaledSource *This = impl_from_IWICBitmapSource(iface);
+    return IWICBitmapSource_GetPixelFormat(This->source, format);
+}
+
+static HRESULT WINAPI ScaledSource_GetResolution(IWICBitmapSource *iface, double *dpix, double *dpiy)
+{
+    ScaledSource *This = impl_from_IWICBitmapSource(iface);
+    return IWICBitmapSource_GetResolution(This->source, dpix, dpiy);
+}
+
+static HRESULT WINAPI ScaledSource_CopyPalette(IWICBitmapSource *iface, IWICPalette *palette)
+{
+    ScaledSource *This = impl_from_IWICBitmapSource(iface);
+    return IWICBitmapSource_CopyPalette(This->source, palette);
+}
+
+static HRESULT WINAPI ScaledSource_CopyPixels(IWICBitmapSource *iface, const WICRect *rc,
+    UINT stride, UINT size, BYTE *buffer)
+{
+    ScaledSource *This = impl_from_IWICBitmapSource(iface);
+    return IWICBitmapSourceTransform_CopyPixels(This->transform, rc, This->width, This->height,
+        NULL, WICBitmapTransformRotate0, stride, size, buffer);
+}
+
+static const IWICBitmapSourceVtbl ScaledSource_Vtbl = {
+    ScaledSource_QueryInterface,
+    ScaledSource_AddRef,
+    ScaledSource_Release,
+    ScaledSource_GetSize,
+    ScaledSource_GetPixelFormat,
+    ScaledSource_GetResolution,
+    ScaledSource_CopyPalette,
+    ScaledSource_CopyPixels
+};
+
+/* return the source itself, or a reduced size version of it when the codec supports it */
+static HRESULT get_scaled_source(IWICBitmapSource *source, UINT width, UINT height, IWICBitmapSource **ret)
+{
+    IWICBitmapSourceTransform *transform;
+    ScaledSource *scaled;
+    UINT src_width, src_height;
+    BOOL supported;
+
+    *ret = source;
+    IWICBitmapSource_AddRef(source);
+
+    if (FAILED(IWICBitmapSource_QueryInterface(source, &IID_IWICBitmapSourceTransform, (void **)&transform)))
+        return S_OK;
+
+    if (FAILED(IWICBitmapSource_GetSize(source, &src_width, &src_height)) ||
+        FAILED(IWICBitmapSourceTransform_GetClosestSize(transform, &width, &height)) ||
+        FAILED(IWICBitmapSourceTransform_DoesSupportTransform(transform, WICBitmapTransformRotate0, &supported)) ||
+        !supported || width >= src_width || height >= src_height ||
+        !(scaled = HeapAlloc(GetProcessHeap(), 0, sizeof(*scaled))))
+    {
+        IWICBitmapSourceTransform_Release(transform);
+        return S_OK;
+    }
+
+    TRACE("reading %p at %ux%u instead of %ux%u\n", source, width, height, src_width, src_height);
+
+    scaled->IWICBitmapSource_iface.lpVtbl = &ScaledSource_Vtbl;
+    scaled->ref = 1;
+    scaled->source = source; /* keeps the reference taken above */
+    scaled->transform = transform;
+    scaled->width = width;
+    scaled->height = height;
+    *ret = &scaled->IWICBitmapSource_iface;
+    return S_OK;
+}
+
 static HRESULT WINAPI BitmapScaler_Initialize(IWICBitmapScaler *iface,
     IWICBitmapSource *pISource, UINT uiWidth, UINT uiHeight,
     WICBitmapInterpolationMode mode)
 {
     BitmapScaler *This = impl_from_IWICBitmapScaler(iface);
+    IWICBitmapSource *source = NULL;
     HRESULT hr;
     GUID src_pixelformat;
 
@@ -327,10 +819,13 @@ static HRESULT WINAPI BitmapScaler_Initialize(IWICBitmapScaler *iface,
     This->height = uiHeight;
     This->mode = mode;
 
-    hr = IWICBitmapSource_GetSize(pISource, &This->src_width, &This->src_height);
+    hr = get_scaled_source(pISource, uiWidth, uiHeight, &source);
+
+    if (SUCCEEDED(hr))
+        hr = IWICBitmapSource_GetSize(source, &This->src_width, &This->src_height);
 
     if (SUCCEEDED(hr))
-        hr = IWICBitmapSource_GetPixelFormat(pISource, &src_pixelformat);
+        hr = IWICBitmapSource_GetPixelFormat(source, &src_pixelformat);
 
     if (SUCCEEDED(hr))
     {
@@ -341,28 +836,61 @@ static HRESULT WINAPI BitmapScaler_Initialize(IWICBitmapScaler *iface,
     {
         switch (mode)
         {
+        case WICBitmapInterpolationModeLinear:
+        case WICBitmapInterpolationModeCubic:
+        case WICBitmapInterpolationModeFant:
+            /* other formats are scaled with the nearest neighbor, in their own format */
+            if (!(This->channels = get_filter_channels(&src_pixelformat)))
+                FIXME("mode %i not supported for format %s\n", mode, debugstr_guid(&src_pixelformat));
+            This->premultiply = IsEqualGUID(&src_pixelformat, &GUID_WICPixelFormat32bppBGRA) ||
+                                IsEqualGUID(&src_pixelformat, &GUID_WICPixelFormat32bppRGBA);
+            break;
+        case WICBitmapInterpolationModeNearestNeighbor:
+            break;
         default:
             FIXME("unsupported mode %i\n", mode);
-            /* fall-through */
-        case WICBitmapInterpolationModeNearestNeighbor:
-            if ((This->bpp % 8) == 0)
-            {
-                IWICBitmapSource_AddRef(pISource);
-                This->source = pISource;
-            }
-            else
-            {
-                hr = WICConvertBitmapSource(&GUID_WICPixelFormat32bppBGRA,
-                    pISource, &This->source);
-                This->bpp = 32;
-            }
-            This->fn_get_required_source_rect = NearestNeighbor_GetRequiredSourceRect;
-            This->fn_copy_scanline = NearestNeighbor_CopyScanline;
             break;
         }
     }
 
+    if (SUCCEEDED(hr) && This->channels)
+    {
+        IWICBitmapSource_AddRef(source);
+        This->source = source;
+        hr = init_filter_table(&This->filter_x, mode, This->src_width, This->width);
+        if (SUCCEEDED(hr))
+            hr = init_filter_table(&This->filter_y, mode, This->src_height, This->height);
+        if (SUCCEEDED(hr) && !(This->row_index = HeapAlloc(GetProcessHeap(), 0,
+                This->filter_y.taps * sizeof(*This->row_index))))
+            hr = E_OUTOFMEMORY;
+        if (FAILED(hr))
+        {
+            free_filter_table(&This->filter_x);
+            free_filter_table(&This->filter_y);
+            IWICBitmapSource_Release(This->source);
+            This->source = NULL;
+            This->channels = 0;
+        }
+    }
+    else if (SUCCEEDED(hr))
+    {
+        if ((This->bpp % 8) == 0)
+        {
+            IWICBitmapSource_AddRef(source);
+            This->source = source;
+        }
+        else
+        {
+            hr = WICConvertBitmapSource(&GUID_WICPixelFormat32bppBGRA,
+                source, &This->source);
+            This->bpp = 32;
+        }
+        This->fn_get_required_source_rect = NearestNeighbor_GetRequiredSourceRect;
+        This->fn_copy_scanline = NearestNeighbor_CopyScanline;
+    }
+
 end:
+    if (source) IWICBitmapSource_Release(source);
     LeaveCriticalSection(&This->lock);
 
     return hr;
@@ -396,6 +924,13 @@ HRESULT BitmapScaler_Create(IWICBitmapScaler **scaler)
     This->src_height = 0;
     This->mode = 0;
     This->bpp = 0;
+    memset(&This->filter_x, 0, sizeof(This->filter_x));
+    memset(&This->filter_y, 0, sizeof(This->filter_y));
+    This->channels = 0;
+    This->premultiply = FALSE;
+    This->rows = NULL;
+    This->row_index = NULL;
+    This->rows_x = This->rows_width = 0;
     InitializeCriticalSection(&This->lock);
     This->lock.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": BitmapScaler.lock");
 
@@ -1245,6 +1245,153 @@ static void test_bitmap_scaler(void)
     IWICBitmap_Release(bitmap);
 }
 
+static void test_bitmap_scaler_filters(void)
+{
+    static const WICBitmapInterpolationMode modes[] =
+    {
+        WICBitmapInterpolationModeLinear,
+        WICBitmapInterpolationModeCubic,
+        WICBitmapInterpolationModeFant,
+    };
+    static const struct { UINT width, height; } sizes[] = { { 5, 3 }, { 16, 12 }, { 1, 1 } };
+    static BYTE ramp[2] = { 0, 255 };
+    BYTE uniform[8 * 8 * 3], full[16 * 12 * 3], line[16 * 3], gray[4];
+    IWICBitmap *bitmap, *ramp_bitmap;
+    IWICBitmapScaler *scaler;
+    WICRect rc;
+    HRESULT hr;
+    UINT i, j, y;
+
+    for (i = 0; i < sizeof(uniform); i += 3)
+    {
+        uniform[i] = 0x12;
+        uniform[i + 1] = 0x80;
+        uniform[i + 2] = 0xfe;
+    }
+    hr = IWICImagingFactory_CreateBitmapFromMemory(factory, 8, 8, &GUID_WICPixelFormat24bppBGR,
+                                                   8 * 3, sizeof(uniform), uniform, &bitmap);
+    ok(hr == S_OK, "Failed to create a bitmap, hr %#x.\n", hr);
+    hr = IWICImagingFactory_CreateBitmapFromMemory(factory, 2, 1, &GUID_WICPixelFormat8bppGray,
+                                                   2, sizeof(ramp), ramp, &ramp_bitmap);
+    ok(hr == S_OK, "Failed to create a bitmap, hr %#x.\n", hr);
+
+    for (i = 0; i < ARRAY_SIZE(modes); i++)
+    {
+        for (j = 0; j < ARRAY_SIZE(sizes); j++)
+        {
+            UINT count = sizes[j].width * sizes[j].height * 3, stride = sizes[j].width * 3;
+
+            hr = IWICImagingFactory_CreateBitmapScaler(factory, &scaler);
+            ok(hr == S_OK, "Failed to create a scaler, hr %#x.\n", hr);
+            hr = IWICBitmapScaler_Initialize(scaler, (IWICBitmapSource *)bitmap, sizes[j].width,
+                                             sizes[j].height, modes[i]);
+            ok(hr == S_OK, "mode %u: failed to initialize, hr %#x.\n", modes[i], hr);
+
+            /* a uniform image stays uniform */
+            memset(full, 0xcc, sizeof(full));
+            hr = IWICBitmapScaler_CopyPixels(scaler, NULL, stride, sizeof(full), full);
+            ok(hr == S_OK, "mode %u: failed to copy pixels, hr %#x.\n", modes[i], hr);
+            for (y = 0; y < count; y++)
+                if (full[y] != uniform[y % 3]) break;
+            ok(y == count, "mode %u, %ux%u: got %#x at %u.\n", modes[i], sizes[j].width, sizes[j].height,
+               full[y], y);
+
+            /* scanlines copied one at a time match the whole image */
+            for (y = 0; y < sizes[j].height; y++)
+            {
+                rc.X = 0;
+                rc.Y = y;
+                rc.Width = sizes[j].width;
+                rc.Height = 1;
+                hr = IWICBitmapScaler_CopyPixels(scaler, &rc, stride, stride, line);
+                ok(hr == S_OK, "mode %u: failed to copy line %u, hr %#x.\n", modes[i], y, hr);
+                ok(!memcmp(line, full + y * stride, stride), "mode %u: line %u differs.\n", modes[i], y);
+            }
+            IWICBitmapScaler_Release(scaler);
+        }
+
+        /* stretching a ramp gives intermediate values */
+        hr = IWICImagingFactory_CreateBitmapScaler(factory, &scaler);
+        ok(hr == S_OK, "Failed to create a scaler, hr %#x.\n", hr);
+        hr = IWICBitmapScaler_Initialize(scaler, (IWICBitmapSource *)ramp_bitmap, 4, 1, modes[i]);
+        ok(hr == S_OK, "mode %u: failed to initialize, hr %#x.\n", modes[i], hr);
+        hr = IWICBitmapScaler_CopyPixels(scaler, NULL, 4, sizeof(gray), gray);
+        ok(hr == S_OK, "mode %u: failed to copy pixels, hr %#x.\n", modes[i], hr);
+        ok(gray[0] < 0x40 && gray[3] > 0xc0, "mode %u: got %#x, %#x.\n", modes[i], gray[0], gray[3]);
+        ok(gray[0] <= gray[1] && gray[1] <= gray[2] && gray[2] <= gray[3],
+           "mode %u: got %#x %#x %#x %#x.\n", modes[i], gray[0], gray[1], gray[2], gray[3]);
+        if (modes[i] != WICBitmapInterpolationModeFant)
+            ok(gray[1] > 0x10 && gray[1] < 0xf0, "mode %u: got %#x.\n", modes[i], gray[1]);
+        IWICBitmapScaler_Release(scaler);
+    }
+
+    IWICBitmap_Release(ramp_bitmap);
+    IWICBitmap_Release(bitmap);
+}
+
+static void test_bitmap_scaler_alpha(void)
+{
+    static const WICBitmapInterpolationMode modes[] =
+    {
+        WICBitmapInterpolationModeLinear,
+        WICBitmapInterpolationModeCubic,
+        WICBitmapInterpolationModeFant,
+    };
+    /* an opaque red pixel next to a transparent green one */
+    static BYTE bgra[2 * 4] = { 0x00, 0x00, 0xff, 0xff, 0x00, 0xff, 0x00, 0x00 };
+    static WORD gray16[2] = { 0x0000, 0xffff };
+    BYTE pixels[4 * 4];
+    WORD gray[4];
+    IWICBitmap *bitmap, *gray_bitmap;
+    IWICBitmapScaler *scaler;
+    WICPixelFormatGUID format;
+    HRESULT hr;
+    UINT i, x;
+
+    hr = IWICImagingFactory_CreateBitmapFromMemory(factory, 2, 1, &GUID_WICPixelFormat32bppBGRA,
+                                                   sizeof(bgra), sizeof(bgra), bgra, &bitmap);
+    ok(hr == S_OK, "Failed to create a bitmap, hr %#x.\n", hr);
+    hr = IWICImagingFactory_CreateBitmapFromMemory(factory, 2, 1, &GUID_WICPixelFormat16bppGray,
+                                                   sizeof(gray16), sizeof(gray16), (BYTE *)gray16, &gray_bitmap);
+    ok(hr == S_OK, "Failed to create a bitmap, hr %#x.\n", hr);
+
+    for (i = 0; i < ARRAY_SIZE(modes); i++)
+    {
+        /* the color of transparent pixels doesn't bleed into the visible ones */
+        hr = IWICImagingFactory_CreateBitmapScaler(factory, &scaler);
+        ok(hr == S_OK, "Failed to create a scaler, hr %#x.\n", hr);
+        hr = IWICBitmapScaler_Initialize(scaler, (IWICBitmapSource *)bitmap, 4, 1, modes[i]);
+        ok(hr == S_OK, "mode %u: failed to initialize, hr %#x.\n", modes[i], hr);
+        hr = IWICBitmapScaler_CopyPixels(scaler, NULL, sizeof(pixels), sizeof(pixels), pixels);
+        ok(hr == S_OK, "mode %u: failed to copy pixels, hr %#x.\n", modes[i], hr);
+        ok(pixels[3] > 0xc0 && pixels[15] < 0x40, "mode %u: got alpha %#x, %#x.\n", modes[i], pixels[3], pixels[15]);
+        for (x = 0; x < 4; x++)
+        {
+            if (!pixels[x * 4 + 3]) continue;
+            ok(pixels[x * 4 + 1] <= 1 && pixels[x * 4 + 2] >= 0xfe, "mode %u: got pixel %u %02x%02x%02x%02x.\n",
+               modes[i], x, pixels[x * 4 + 3], pixels[x * 4 + 2], pixels[x * 4 + 1], pixels[x * 4]);
+        }
+        IWICBitmapScaler_Release(scaler);
+
+        /* formats that can't be filtered are still scaled in their own format */
+        hr = IWICImagingFactory_CreateBitmapScaler(factory, &scaler);
+        ok(hr == S_OK, "Failed to create a scaler, hr %#x.\n", hr);
+        hr = IWICBitmapScaler_Initialize(scaler, (IWICBitmapSource *)gray_bitmap, 4, 1, modes[i]);
+        ok(hr == S_OK, "mode %u: failed to initialize, hr %#x.\n", modes[i], hr);
+        hr = IWICBitmapScaler_GetPixelFormat(scaler, &format);
+        ok(hr == S_OK, "mode %u: failed to get pixel format, hr %#x.\n", modes[i], hr);
+        ok(IsEqualGUID(&format, &GUID_WICPixelFormat16bppGray), "mode %u: got format %s.\n",
+           modes[i], wine_dbgstr_guid(&format));
+        hr = IWICBitmapScaler_CopyPixels(scaler, NULL, sizeof(gray), sizeof(gray), (BYTE *)gray);
+        ok(hr == S_OK, "mode %u: failed to copy pixels, hr %#x.\n", modes[i], hr);
+        ok(!gray[0] && gray[3] == 0xffff, "mode %u: got %#x, %#x.\n", modes[i], gray[0], gray[3]);
+        IWICBitmapScaler_Release(scaler);
+    }
+
+    IWICBitmap_Release(gray_bitmap);
+    IWICBitmap_Release(bitmap);
+}
+
 START_TEST(bitmap)
 {
     HRESULT hr;
@@ -1262,6 +1409,8 @@ START_TEST(bitmap)
     test_CreateBitmapFromHBITMAP();
     test_clipper();
     test_bitmap_scaler();
+    test_bitmap_scaler_filters();
+    test_bitmap_scaler_alpha();
 
     IWICImagingFactory_Release(factory);
 
@@ -1767,6 +1767,103 @@ static void test_converter_8bppIndexed(void)
     DeleteTestBitmap(src_obj);
 }
 
+static IWICBitmapSource *convert_bits(const WICPixelFormatGUID *src_format, UINT width, UINT height,
+    UINT stride, BYTE *bits, const WICPixelFormatGUID *dst_format)
+{
+    IWICBitmapSource *converted;
+    IWICBitmap *bitmap;
+    HRESULT hr;
+
+    hr = IWICImagingFactory_CreateBitmapFromMemory(factory, width, height, src_format,
+        stride, stride * height, bits, &bitmap);
+    ok(hr == S_OK, "CreateBitmapFromMemory error %#x\n", hr);
+    hr = WICConvertBitmapSource(dst_format, (IWICBitmapSource *)bitmap, &converted);
+    ok(hr == S_OK, "WICConvertBitmapSource error %#x\n", hr);
+    IWICBitmap_Release(bitmap);
+    return hr == S_OK ? converted : NULL;
+}
+
+static void test_converter_rows(void)
+{
+    BYTE src[37 * 4], dst[37 * 4], expect[37 * 4];
+    IWICBitmapSource *converted;
+    UINT width, x, i;
+    HRESULT hr;
+
+    /* the odd widths make sure that the pixels after the vectorized part are converted too */
+    for (width = 1; width <= 37; width++)
+    {
+        for (i = 0; i < sizeof(src); i++) src[i] = i * 7 + width;
+
+        for (x = 0; x < width; x++)
+        {
+            expect[4 * x] = src[3 * x];
+            expect[4 * x + 1] = src[3 * x + 1];
+            expect[4 * x + 2] = src[3 * x + 2];
+            expect[4 * x + 3] = 0xff;
+        }
+        converted = convert_bits(&GUID_WICPixelFormat24bppBGR, width, 1, width * 3, src, &GUID_WICPixelFormat32bppBGRA);
+        if (!converted) continue;
+        hr = IWICBitmapSource_CopyPixels(converted, NULL, width * 4, width * 4, dst);
+        ok(hr == S_OK, "CopyPixels error %#x\n", hr);
+        ok(!memcmp(dst, expect, width * 4), "24bppBGR -> 32bppBGRA: wrong data for width %u\n", width);
+        IWICBitmapSource_Release(converted);
+
+        for (x = 0; x < width; x++)
+        {
+            expect[4 * x] = src[3 * x + 2];
+            expect[4 * x + 2] = src[3 * x];
+        }
+        converted = convert_bits(&GUID_WICPixelFormat24bppRGB, width, 1, width * 3, src, &GUID_WICPixelFormat32bppBGRA);
+        if (!converted) continue;
+        hr = IWICBitmapSource_CopyPixels(converted, NULL, width * 4, width * 4, dst);
+        ok(hr == S_OK, "CopyPixels error %#x\n", hr);
+        ok(!memcmp(dst, expect, width * 4), "24bppRGB -> 32bppBGRA: wrong data for width %u\n", width);
+        IWICBitmapSource_Release(converted);
+
+        for (x = 0; x < width; x++)
+        {
+            expect[4 * x] = src[4 * x];
+            expect[4 * x + 1] = src[4 * x + 1];
+            expect[4 * x + 2] = src[4 * x + 2];
+            expect[4 * x + 3] = 0xff;
+        }
+        converted = convert_bits(&GUID_WICPixelFormat32bppBGR, width, 1, width * 4, src, &GUID_WICPixelFormat32bppBGRA);
+        if (!converted) continue;
+        hr = IWICBitmapSource_CopyPixels(converted, NULL, width * 4, width * 4, dst);
+        ok(hr == S_OK, "CopyPixels error %#x\n", hr);
+        ok(!memcmp(dst, expect, width * 4), "32bppBGR -> 32bppBGRA: wrong data for width %u\n", width);
+        IWICBitmapSource_Release(converted);
+
+        memset(dst, 0xcc, sizeof(dst));
+        for (x = 0; x < width; x++)
+        {
+            expect[3 * x] = src[4 * x];
+            expect[3 * x + 1] = src[4 * x + 1];
+            expect[3 * x + 2] = src[4 * x + 2];
+        }
+        memset(expect + width * 3, 0xcc, sizeof(expect) - width * 3);
+        converted = convert_bits(&GUID_WICPixelFormat32bppBGRA, width, 1, width * 4, src, &GUID_WICPixelFormat24bppBGR);
+        if (!converted) continue;
+        hr = IWICBitmapSource_CopyPixels(converted, NULL, width * 3, width * 3, dst);
+        ok(hr == S_OK, "CopyPixels error %#x\n", hr);
+        ok(!memcmp(dst, expect, sizeof(dst)), "32bppBGRA -> 24bppBGR: wrong data for width %u\n", width);
+        IWICBitmapSource_Release(converted);
+
+        for (x = 0; x < width; x++)
+        {
+            expect[3 * x] = src[4 * x + 2];
+            expect[3 * x + 2] = src[4 * x];
+        }
+        converted = convert_bits(&GUID_WICPixelFormat32bppBGRA, width, 1, width * 4, src, &GUID_WICPixelFormat24bppRGB);
+        if (!converted) continue;
+        hr = IWICBitmapSource_CopyPixels(converted, NULL, width * 3, width * 3, dst);
+        ok(hr == S_OK, "CopyPixels error %#x\n", hr);
+        ok(!memcmp(dst, expect, sizeof(dst)), "32bppBGRA -> 24bppRGB: wrong data for width %u\n", width);
+        IWICBitmapSource_Release(converted);
+    }
+}
+
 START_TEST(converter)
 {
     HRESULT hr;
@@ -1818,6 +1915,7 @@ START_TEST(converter)
     test_invalid_conversion();
     test_default_converter();
     test_converter_8bppIndexed();
+    test_converter_rows();
 
     test_encoder(&testdata_BlackWhite, &CLSID_WICPngEncoder,
                  &testdata_BlackWhite, &CLSID_WICPngDecoder, "PNG encoder BlackWhite");
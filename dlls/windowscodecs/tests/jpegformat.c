@@ -134,12 +134,222 @@ static void test_decode_adobe_cmyk(void)
     IWICBitmapDecoder_Release(decoder);
 }
 
+static IStream *create_jpeg_stream(UINT width, UINT height, const BYTE *bits, UINT stride)
+{
+    WICPixelFormatGUID format = GUID_WICPixelFormat24bppBGR;
+    IWICBitmapFrameEncode *frameencode;
+    IWICBitmapEncoder *encoder;
+    IStream *stream;
+    LARGE_INTEGER pos;
+    HRESULT hr;
+
+    hr = CoCreateInstance(&CLSID_WICJpegEncoder, NULL, CLSCTX_INPROC_SERVER,
+        &IID_IWICBitmapEncoder, (void **)&encoder);
+    ok(hr == S_OK, "CoCreateInstance failed, hr=%x\n", hr);
+    if (FAILED(hr)) return NULL;
+
+    hr = CreateStreamOnHGlobal(NULL, TRUE, &stream);
+    ok(hr == S_OK, "CreateStreamOnHGlobal failed, hr=%x\n", hr);
+    hr = IWICBitmapEncoder_Initialize(encoder, stream, WICBitmapEncoderNoCache);
+    ok(hr == S_OK, "Initialize failed, hr=%x\n", hr);
+    hr = IWICBitmapEncoder_CreateNewFrame(encoder, &frameencode, NULL);
+    ok(hr == S_OK, "CreateNewFrame failed, hr=%x\n", hr);
+    hr = IWICBitmapFrameEncode_Initialize(frameencode, NULL);
+    ok(hr == S_OK, "Initialize failed, hr=%x\n", hr);
+    hr = IWICBitmapFrameEncode_SetSize(frameencode, width, height);
+    ok(hr == S_OK, "SetSize failed, hr=%x\n", hr);
+    hr = IWICBitmapFrameEncode_SetPixelFormat(frameencode, &format);
+    ok(hr == S_OK, "SetPixelFormat failed, hr=%x\n", hr);
+    ok(IsEqualGUID(&format, &GUID_WICPixelFormat24bppBGR), "unexpected pixel format %s\n",
+        wine_dbgstr_guid(&format));
+    hr = IWICBitmapFrameEncode_WritePixels(frameencode, height, stride, stride * height, (BYTE *)bits);
+    ok(hr == S_OK, "WritePixels failed, hr=%x\n", hr);
+    hr = IWICBitmapFrameEncode_Commit(frameencode);
+    ok(hr == S_OK, "Commit failed, hr=%x\n", hr);
+    hr = IWICBitmapEncoder_Commit(encoder);
+    ok(hr == S_OK, "Commit failed, hr=%x\n", hr);
+    IWICBitmapFrameEncode_Release(frameencode);
+    IWICBitmapEncoder_Release(encoder);
+
+    pos.QuadPart = 0;
+    IStream_Seek(stream, pos, STREAM_SEEK_SET, NULL);
+    return stream;
+}
+
+static void test_decode_rect(void)
+{
+    static const UINT width = 64, height = 40, stride = 64 * 3;
+    BYTE bits[64 * 40 * 3], full[64 * 40 * 3], row[64 * 3], scaled[64 * 40 * 3];
+    IWICBitmapSourceTransform *transform;
+    IWICBitmapFrameDecode *framedecode;
+    IWICBitmapDecoder *decoder;
+    WICPixelFormatGUID format;
+    UINT x, y, w, h, i;
+    IStream *stream;
+    BOOL supported;
+    WICRect rc;
+    HRESULT hr;
+
+    for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++)
+        {
+            bits[y * stride + x * 3] = x * 4;
+            bits[y * stride + x * 3 + 1] = y * 6;
+            bits[y * stride + x * 3 + 2] = 0x80;
+        }
+
+    if (!(stream = create_jpeg_stream(width, height, bits, stride))) return;
+
+    hr = CoCreateInstance(&CLSID_WICJpegDecoder, NULL, CLSCTX_INPROC_SERVER,
+        &IID_IWICBitmapDecoder, (void **)&decoder);
+    ok(hr == S_OK, "CoCreateInstance failed, hr=%x\n", hr);
+    hr = IWICBitmapDecoder_Initialize(decoder, stream, WICDecodeMetadataCacheOnLoad);
+    ok(hr == S_OK, "Initialize failed, hr=%x\n", hr);
+    hr = IWICBitmapDecoder_GetFrame(decoder, 0, &framedecode);
+    ok(hr == S_OK, "GetFrame failed, hr=%x\n", hr);
+
+    hr = IWICBitmapFrameDecode_GetSize(framedecode, &w, &h);
+    ok(hr == S_OK, "GetSize failed, hr=%x\n", hr);
+    ok(w == width && h == height, "got %ux%u\n", w, h);
+
+    hr = IWICBitmapFrameDecode_CopyPixels(framedecode, NULL, stride, sizeof(full), full);
+    ok(hr == S_OK, "CopyPixels failed, hr=%x\n", hr);
+
+    /* rows requested one at a time, in any order, match the full decode */
+    for (i = 0; i < height; i++)
+    {
+        y = (i & 1) ? height - 1 - i / 2 : i / 2;
+        rc.X = 5;
+        rc.Y = y;
+        rc.Width = width - 10;
+        rc.Height = 1;
+        hr = IWICBitmapFrameDecode_CopyPixels(framedecode, &rc, stride, sizeof(row), row);
+        ok(hr == S_OK, "CopyPixels failed, hr=%x\n", hr);
+        ok(!memcmp(row, full + y * stride + 5 * 3, (width - 10) * 3), "row %u differs\n", y);
+    }
+
+    rc.X = 0;
+    rc.Y = height - 1;
+    rc.Width = width;
+    rc.Height = 2;
+    hr = IWICBitmapFrameDecode_CopyPixels(framedecode, &rc, stride, sizeof(scaled), scaled);
+    ok(hr == E_INVALIDARG, "got %#x\n", hr);
+
+    hr = IWICBitmapFrameDecode_QueryInterface(framedecode, &IID_IWICBitmapSourceTransform, (void **)&transform);
+    ok(hr == S_OK, "QueryInterface failed, hr=%x\n", hr);
+    if (hr == S_OK)
+    {
+        hr = IWICBitmapSourceTransform_DoesSupportTransform(transform, WICBitmapTransformRotate0, &supported);
+        ok(hr == S_OK, "DoesSupportTransform failed, hr=%x\n", hr);
+        ok(supported, "Rotate0 is not supported\n");
+
+        hr = IWICBitmapSourceTransform_GetClosestPixelFormat(transform, &format);
+        ok(hr == S_OK, "GetClosestPixelFormat failed, hr=%x\n", hr);
+        ok(IsEqualGUID(&format, &GUID_WICPixelFormat24bppBGR), "unexpected pixel format %s\n",
+            wine_dbgstr_guid(&format));
+
+        w = 16;
+        h = 10;
+        hr = IWICBitmapSourceTransform_GetClosestSize(transform, &w, &h);
+        ok(hr == S_OK, "GetClosestSize failed, hr=%x\n", hr);
+        ok(w >= 16 && h >= 10 && w <= width && h <= height, "got %ux%u\n", w, h);
+
+        hr = IWICBitmapSourceTransform_CopyPixels(transform, NULL, w, h, NULL,
+            WICBitmapTransformRotate0, w * 3, sizeof(scaled), scaled);
+        ok(hr == S_OK, "CopyPixels failed, hr=%x\n", hr);
+        if (hr == S_OK)
+        {
+            /* each pixel is close to the average of the block it covers */
+            for (y = 0; y < h; y++)
+                for (x = 0; x < w; x++)
+                {
+                    UINT sx = x * width / w + width / w / 2, sy = y * height / h + height / h / 2;
+                    for (i = 0; i < 3; i++)
+                        ok(abs(scaled[y * w * 3 + x * 3 + i] - full[sy * stride + sx * 3 + i]) <= 16,
+                            "pixel %u,%u channel %u: got %u, expected about %u\n", x, y, i,
+                            scaled[y * w * 3 + x * 3 + i], full[sy * stride + sx * 3 + i]);
+                }
+        }
+
+        /* a scaled decode does not disturb the full size one */
+        hr = IWICBitmapFrameDecode_CopyPixels(framedecode, NULL, stride, sizeof(scaled), scaled);
+        ok(hr == S_OK, "CopyPixels failed, hr=%x\n", hr);
+        ok(!memcmp(scaled, full, sizeof(full)), "image data differs\n");
+
+        IWICBitmapSourceTransform_Release(transform);
+    }
+
+    IWICBitmapFrameDecode_Release(framedecode);
+    IWICBitmapDecoder_Release(decoder);
+    IStream_Release(stream);
+}
+
+static IWICBitmapFrameDecode *decode_jpeg_stream(IStream *stream, IWICBitmapDecoder **decoder)
+{
+    IWICBitmapFrameDecode *framedecode;
+    HRESULT hr;
+
+    hr = CoCreateInstance(&CLSID_WICJpegDecoder, NULL, CLSCTX_INPROC_SERVER,
+        &IID_IWICBitmapDecoder, (void **)decoder);
+    ok(hr == S_OK, "CoCreateInstance failed, hr=%x\n", hr);
+    hr = IWICBitmapDecoder_Initialize(*decoder, stream, WICDecodeMetadataCacheOnLoad);
+    ok(hr == S_OK, "Initialize failed, hr=%x\n", hr);
+    hr = IWICBitmapDecoder_GetFrame(*decoder, 0, &framedecode);
+    ok(hr == S_OK, "GetFrame failed, hr=%x\n", hr);
+    return framedecode;
+}
+
+static void test_decode_stream(void)
+{
+    static const UINT width = 256, height = 64, stride = 256 * 3;
+    static BYTE bits[256 * 64 * 3], full[256 * 64 * 3], part[256 * 64 * 3];
+    IWICBitmapFrameDecode *framedecode;
+    IWICBitmapDecoder *decoder;
+    IStream *stream;
+    LARGE_INTEGER pos;
+    WICRect rc;
+    HRESULT hr;
+    UINT i;
+
+    /* noise doesn't compress well, so the data spans many reads from the stream */
+    for (i = 0; i < sizeof(bits); i++) bits[i] = (i * 2654435761u) >> 24;
+
+    if (!(stream = create_jpeg_stream(width, height, bits, stride))) return;
+
+    framedecode = decode_jpeg_stream(stream, &decoder);
+    hr = IWICBitmapFrameDecode_CopyPixels(framedecode, NULL, stride, sizeof(full), full);
+    ok(hr == S_OK, "CopyPixels failed, hr=%x\n", hr);
+    IWICBitmapFrameDecode_Release(framedecode);
+    IWICBitmapDecoder_Release(decoder);
+
+    /* the decoder doesn't depend on the stream position left by the caller */
+    framedecode = decode_jpeg_stream(stream, &decoder);
+    for (i = 0; i < height; i += 16)
+    {
+        pos.QuadPart = (i & 16) ? 0 : 100;
+        IStream_Seek(stream, pos, STREAM_SEEK_SET, NULL);
+
+        rc.X = 0;
+        rc.Y = i;
+        rc.Width = width;
+        rc.Height = 16;
+        hr = IWICBitmapFrameDecode_CopyPixels(framedecode, &rc, stride, sizeof(part) - i * stride, part + i * stride);
+        ok(hr == S_OK, "CopyPixels failed, hr=%x\n", hr);
+    }
+    ok(!memcmp(part, full, sizeof(full)), "image data differs\n");
+    IWICBitmapFrameDecode_Release(framedecode);
+    IWICBitmapDecoder_Release(decoder);
+
+    IStream_Release(stream);
+}
 
 START_TEST(jpegformat)
 {
     CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
 
     test_decode_adobe_cmyk();
+    test_decode_rect();
+    test_decode_stream();
 
     CoUninitialize();
 }
@@ -61,9 +61,15 @@
 #ifdef HAVE_SYS_WAIT_H
 # include <sys/wait.h>
 #endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
 #ifdef HAVE_SYS_UIO_H
 # include <sys/uio.h>
 #endif
+#ifdef __linux__
+# include <sys/sendfile.h>
+#endif
 #ifdef HAVE_SYS_SOCKET_H
 #include <sys/socket.h>
 #endif
@@ -535,6 +541,7 @@ struct ws2_transmitfile_async
     TRANSMIT_FILE_BUFFERS buffers;
     DWORD                 flags;
     LARGE_INTEGER         offset;
+    BOOL                  use_sendfile;
     struct ws2_async      write;
 };
 
@@ -2958,6 +2965,65 @@ static NTSTATUS WS2_ReadFile(HANDLE hFile, PIO_STATUS_BLOCK io_status, char* buf
     return status;
 }
 
+#define WS2_SENDFILE_CHUNK (1 << 20)
+
+/***********************************************************************
+ *     WS2_transmitfile_sendfile        (INTERNAL)
+ *
+ * Send the next part of the file directly from its Unix file descriptor,
+ * without going through a user space buffer.
+ * Returns STATUS_NOT_SUPPORTED if the data has to be read and sent instead.
+ */
+static NTSTATUS WS2_transmitfile_sendfile( int fd, struct ws2_transmitfile_async *wsa )
+{
+#ifdef __linux__
+    IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
+    DWORD count = WS2_SENDFILE_CHUNK;
+    off_t offset, *poffset = NULL;
+    struct stat st;
+    ssize_t ret;
+    int file_fd, err;
+
+    if (wsa->file_bytes != 0)
+        count = min(count, wsa->file_bytes - wsa->file_read);
+    if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+    {
+        offset = wsa->offset.QuadPart;
+        if (offset != wsa->offset.QuadPart) return STATUS_NOT_SUPPORTED;
+        poffset = &offset;
+    }
+
+    if (wine_server_handle_to_fd( wsa->file, FILE_READ_DATA, &file_fd, NULL ))
+        return STATUS_NOT_SUPPORTED;
+    if (fstat( file_fd, &st ) == -1 || !S_ISREG(st.st_mode))
+    {
+        wine_server_release_fd( wsa->file, file_fd );
+        return STATUS_NOT_SUPPORTED;
+    }
+    while ((ret = sendfile( fd, file_fd, poffset, count )) == -1 && errno == EINTR);
+    err = errno;
+    wine_server_release_fd( wsa->file, file_fd );
+
+    if (ret == -1)
+    {
+        if (err == EAGAIN) return STATUS_PENDING;
+        if (err == EINVAL || err == ENOSYS) return STATUS_NOT_SUPPORTED;
+        errno = err;
+        return wsaErrStatus();
+    }
+    if (!ret) return STATUS_END_OF_FILE;
+
+    if (poffset) wsa->offset.QuadPart += ret;
+    if (iosb) iosb->Information += ret;
+    wsa->file_read += ret;
+    if (wsa->file_bytes != 0 && wsa->file_read >= wsa->file_bytes)
+        return STATUS_END_OF_FILE;
+    return STATUS_PENDING;
+#else
+    return STATUS_NOT_SUPPORTED;
+#endif
+}
+
 /***********************************************************************
  *     WS2_transmitfile_getbuffer       (INTERNAL)
  *
@@ -2980,6 +3046,19 @@ static NTSTATUS WS2_transmitfile_getbuffer( int fd, struct ws2_transmitfile_asyn
         return STATUS_PENDING;
     }
 
+    /* send the main file without copying it if possible */
+    if (wsa->file && wsa->use_sendfile)
+    {
+        NTSTATUS status = WS2_transmitfile_sendfile( fd, wsa );
+
+        if (status == STATUS_END_OF_FILE)
+            wsa->file = NULL; /* continue on to the footer */
+        else if (status == STATUS_NOT_SUPPORTED)
+            wsa->use_sendfile = FALSE;
+        else
+            return status;
+    }
+
     /* process the main file */
     if (wsa->file)
     {
@@ -3040,7 +3119,7 @@ static NTSTATUS WS2_transmitfile_base( int fd, struct ws2_transmitfile_async *ws
     NTSTATUS status;
 
     status = WS2_transmitfile_getbuffer( fd, wsa );
-    if (status == STATUS_PENDING)
+    if (status == STATUS_PENDING && wsa->write.first_iovec < wsa->write.n_iovecs)
     {
         IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
         int n;
@@ -3144,6 +3223,7 @@ static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD
     wsa->bytes_per_send        = bytes_per_send;
     wsa->flags                 = flags;
     wsa->offset.QuadPart       = FILE_USE_FILE_POINTER_POSITION;
+    wsa->use_sendfile          = (h != NULL);
     wsa->write.hSocket         = SOCKET2HANDLE(s);
     wsa->write.addr            = NULL;
     wsa->write.addrlen.val     = 0;
@@ -9083,6 +9083,75 @@ cleanup:
     closesocket(server);
 }
 
+#define TRANSMIT_THROUGHPUT_SIZE (8 * 1024 * 1024)
+
+static DWORD WINAPI transmit_throughput_recv( void *arg )
+{
+    SOCKET dest = *(SOCKET *)arg;
+    static char buf[65536];
+    DWORD total = 0, i, mismatch = 0;
+    int n;
+
+    while (total < TRANSMIT_THROUGHPUT_SIZE && (n = recv( dest, buf, sizeof(buf), 0 )) > 0)
+    {
+        for (i = 0; i < n; i++) if (buf[i] != (char)((total + i) / 1021)) mismatch++;
+        total += n;
+    }
+    ok( total == TRANSMIT_THROUGHPUT_SIZE, "received %u bytes\n", total );
+    ok( !mismatch, "%u bytes differ\n", mismatch );
+    return 0;
+}
+
+static void test_TransmitFile_throughput(void)
+{
+    GUID transmitFileGuid = WSAID_TRANSMITFILE;
+    LPFN_TRANSMITFILE pTransmitFile = NULL;
+    char path[MAX_PATH], temp[MAX_PATH];
+    SOCKET src, dest;
+    DWORD num_bytes, i, start, elapsed;
+    HANDLE file, thread;
+    char *data;
+    BOOL bret;
+
+    if (tcp_socketpair( &src, &dest ))
+    {
+        skip( "failed to create sockets\n" );
+        return;
+    }
+    if (WSAIoctl( src, SIO_GET_EXTENSION_FUNCTION_POINTER, &transmitFileGuid, sizeof(transmitFileGuid),
+                  &pTransmitFile, sizeof(pTransmitFile), &num_bytes, NULL, NULL ))
+    {
+        skip( "TransmitFile not available\n" );
+        goto done;
+    }
+
+    GetTempPathA( MAX_PATH, temp );
+    GetTempFileNameA( temp, "tfs", 0, path );
+    file = CreateFileA( path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                        FILE_FLAG_DELETE_ON_CLOSE, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile failed %u\n", GetLastError() );
+    data = HeapAlloc( GetProcessHeap(), 0, TRANSMIT_THROUGHPUT_SIZE );
+    for (i = 0; i < TRANSMIT_THROUGHPUT_SIZE; i++) data[i] = i / 1021;
+    bret = WriteFile( file, data, TRANSMIT_THROUGHPUT_SIZE, &num_bytes, NULL );
+    ok( bret && num_bytes == TRANSMIT_THROUGHPUT_SIZE, "WriteFile failed %u\n", GetLastError() );
+    HeapFree( GetProcessHeap(), 0, data );
+    SetFilePointer( file, 0, NULL, FILE_BEGIN );
+
+    thread = CreateThread( NULL, 0, transmit_throughput_recv, &dest, 0, NULL );
+    start = GetTickCount();
+    bret = pTransmitFile( src, file, 0, 0, NULL, NULL, 0 );
+    ok( bret, "TransmitFile failed %u\n", WSAGetLastError() );
+    WaitForSingleObject( thread, INFINITE );
+    elapsed = GetTickCount() - start;
+    CloseHandle( thread );
+    trace( "TransmitFile sent %u bytes in %u ms\n", TRANSMIT_THROUGHPUT_SIZE, elapsed );
+
+    CloseHandle( file );
+done:
+    closesocket( src );
+    closesocket( dest );
+}
+
 static void test_getpeername(void)
 {
     SOCKET sock;
@@ -11578,6 +11647,7 @@ START_TEST( sock )
 
     test_ipv6only();
     test_TransmitFile();
+    test_TransmitFile_throughput();
     test_GetAddrInfoW();
     test_GetAddrInfoExW();
     test_getaddrinfo();
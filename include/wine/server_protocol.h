@@ -725,6 +725,77 @@ struct rawinput_device
 };
 
 
+struct fast_sync_slot
+{
+    int            state;
+    int            waiters;
+    unsigned int   type;
+    unsigned int   max;
+    int            pulsed;
+};
+enum fast_sync_type
+{
+    FAST_SYNC_NONE,
+    FAST_SYNC_MANUAL_EVENT,
+    FAST_SYNC_AUTO_EVENT,
+    FAST_SYNC_SEMAPHORE
+};
+#define FAST_SYNC_VALUE_MASK  0x7fffffff
+#define FAST_SYNC_SERVER_WAIT 0x80000000
+#define FAST_SYNC_EVENT_SIGNALED 0x00000001
+#define FAST_SYNC_EVENT_PULSE    0x00000002
+#define FAST_SYNC_MAX_SLOTS   65536
+#define FAST_SYNC_NO_SLOT     (~0u)
+
+
+struct queue_shm_slot
+{
+    unsigned int   wake_bits;
+    unsigned int   changed_bits;
+};
+#define QUEUE_SHM_MAX_SLOTS   65536
+#define QUEUE_SHM_NO_SLOT     (~0u)
+
+
+struct window_shm_slot
+{
+    unsigned int   seq;
+    user_handle_t  handle;
+    user_handle_t  parent;
+    user_handle_t  owner;
+    unsigned int   style;
+    unsigned int   ex_style;
+    unsigned int   id;
+    unsigned int   dpi;
+    thread_id_t    tid;
+    process_id_t   pid;
+    mod_handle_t   instance;
+    lparam_t       user_data;
+    rectangle_t    window_rect;
+    rectangle_t    client_rect;
+};
+#define WINDOW_SHM_MAX_SLOTS  ((LAST_USER_HANDLE - FIRST_USER_HANDLE + 1) >> 1)
+
+
+struct request_shm
+{
+    int                     state;
+    int                     __pad;
+    struct request_max_size header;
+
+};
+enum request_shm_state
+{
+    REQUEST_SHM_IDLE,
+    REQUEST_SHM_PENDING,
+    REQUEST_SHM_WAITING,
+    REQUEST_SHM_DONE,
+    REQUEST_SHM_CLOSED
+};
+#define REQUEST_SHM_SIZE      0x4000
+#define REQUEST_SHM_DATA_SIZE (REQUEST_SHM_SIZE - sizeof(struct request_shm))
+
+
 
 
 
@@ -3014,8 +3085,22 @@ struct get_msg_queue_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
+    unsigned int shm_slot;
+};
+
+
+
+struct get_queue_shm_region_request
+{
+    struct request_header __header;
     char __pad_12[4];
 };
+struct get_queue_shm_region_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    data_size_t  size;
+};
 
 
 
@@ -3577,6 +3662,20 @@ struct set_window_info_reply
 
 
 
+struct get_window_shm_region_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_window_shm_region_reply
+{
+    struct reply_header __header;
+    obj_handle_t   handle;
+    data_size_t    size;
+};
+
+
+
 struct set_parent_request
 {
     struct request_header __header;
@@ -5344,6 +5443,28 @@ struct remove_completion_reply
 };
 
 
+struct completion_msg
+{
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+    unsigned int  status;
+    int           __pad;
+};
+
+
+struct remove_completions_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct remove_completions_reply
+{
+    struct reply_header __header;
+    /* VARARG(msgs,completion_msgs); */
+};
+
+
 
 struct query_completion_request
 {
@@ -5390,6 +5511,21 @@ struct add_fd_completion_reply
 
 
 
+struct get_fd_completion_request
+{
+    struct request_header __header;
+    obj_handle_t   handle;
+};
+struct get_fd_completion_reply
+{
+    struct reply_header __header;
+    obj_handle_t   port;
+    char __pad_12[4];
+    apc_param_t    ckey;
+};
+
+
+
 struct set_fd_completion_mode_request
 {
     struct request_header __header;
@@ -5665,6 +5801,95 @@ struct terminate_job_reply
 };
 
 
+
+struct get_fast_sync_region_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_fast_sync_region_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    data_size_t  size;
+};
+
+
+
+struct get_fast_sync_slot_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_fast_sync_slot_reply
+{
+    struct reply_header __header;
+    unsigned int index;
+    unsigned int access;
+};
+
+
+
+struct batch_request
+{
+    struct request_header __header;
+    /* VARARG(requests,bytes); */
+    char __pad_12[4];
+};
+struct batch_reply
+{
+    struct reply_header __header;
+    unsigned int count;
+    /* VARARG(replies,bytes); */
+    char __pad_12[4];
+};
+
+
+
+struct get_request_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_request_shm_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    char __pad_12[4];
+};
+
+
+#define REQUEST_STATS_BUCKETS 8
+
+struct request_stats
+{
+    char          name[32];
+    unsigned int  count;
+    unsigned int  max_time;
+    mem_size_t    total_time;
+    mem_size_t    bytes_in;
+    mem_size_t    bytes_out;
+    unsigned int  histogram[REQUEST_STATS_BUCKETS];
+};
+
+
+struct get_server_stats_request
+{
+    struct request_header __header;
+    int          reset;
+};
+struct get_server_stats_reply
+{
+    struct reply_header __header;
+    mem_size_t   elapsed;
+    mem_size_t   loops;
+    mem_size_t   events;
+    mem_size_t   timeouts;
+    mem_size_t   wait_time;
+    /* VARARG(stats,request_stats); */
+};
+
+
 enum request
 {
     REQ_new_process,
@@ -5801,6 +6026,7 @@ enum request
     REQ_empty_atom_table,
     REQ_init_atom_table,
     REQ_get_msg_queue,
+    REQ_get_queue_shm_region,
     REQ_set_queue_fd,
     REQ_set_queue_mask,
     REQ_get_queue_status,
@@ -5832,6 +6058,7 @@ enum request
     REQ_set_window_owner,
     REQ_get_window_info,
     REQ_set_window_info,
+    REQ_get_window_shm_region,
     REQ_set_parent,
     REQ_get_window_parents,
     REQ_get_window_children,
@@ -5937,9 +6164,11 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_remove_completions,
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
+    REQ_get_fd_completion,
     REQ_set_fd_completion_mode,
     REQ_set_fd_disp_info,
     REQ_set_fd_name_info,
@@ -5958,6 +6187,11 @@ enum request
     REQ_set_job_limits,
     REQ_set_job_completion_port,
     REQ_terminate_job,
+    REQ_get_fast_sync_region,
+    REQ_get_fast_sync_slot,
+    REQ_batch,
+    REQ_get_request_shm,
+    REQ_get_server_stats,
     REQ_NB_REQUESTS
 };
 
@@ -6099,6 +6333,7 @@ union generic_request
     struct empty_atom_table_request empty_atom_table_request;
     struct init_atom_table_request init_atom_table_request;
     struct get_msg_queue_request get_msg_queue_request;
+    struct get_queue_shm_region_request get_queue_shm_region_request;
     struct set_queue_fd_request set_queue_fd_request;
     struct set_queue_mask_request set_queue_mask_request;
     struct get_queue_status_request get_queue_status_request;
@@ -6130,6 +6365,7 @@ union generic_request
     struct set_window_owner_request set_window_owner_request;
     struct get_window_info_request get_window_info_request;
     struct set_window_info_request set_window_info_request;
+    struct get_window_shm_region_request get_window_shm_region_request;
     struct set_parent_request set_parent_request;
     struct get_window_parents_request get_window_parents_request;
     struct get_window_children_request get_window_children_request;
@@ -6235,9 +6471,11 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct remove_completions_request remove_completions_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
+    struct get_fd_completion_request get_fd_completion_request;
     struct set_fd_completion_mode_request set_fd_completion_mode_request;
     struct set_fd_disp_info_request set_fd_disp_info_request;
     struct set_fd_name_info_request set_fd_name_info_request;
@@ -6256,6 +6494,11 @@ union generic_request
     struct set_job_limits_request set_job_limits_request;
     struct set_job_completion_port_request set_job_completion_port_request;
     struct terminate_job_request terminate_job_request;
+    struct get_fast_sync_region_request get_fast_sync_region_request;
+    struct get_fast_sync_slot_request get_fast_sync_slot_request;
+    struct batch_request batch_request;
+    struct get_request_shm_request get_request_shm_request;
+    struct get_server_stats_request get_server_stats_request;
 };
 union generic_reply
 {
@@ -6395,6 +6638,7 @@ union generic_reply
     struct empty_atom_table_reply empty_atom_table_reply;
     struct init_atom_table_reply init_atom_table_reply;
     struct get_msg_queue_reply get_msg_queue_reply;
+    struct get_queue_shm_region_reply get_queue_shm_region_reply;
     struct set_queue_fd_reply set_queue_fd_reply;
     struct set_queue_mask_reply set_queue_mask_reply;
     struct get_queue_status_reply get_queue_status_reply;
@@ -6426,6 +6670,7 @@ union generic_reply
     struct set_window_owner_reply set_window_owner_reply;
     struct get_window_info_reply get_window_info_reply;
     struct set_window_info_reply set_window_info_reply;
+    struct get_window_shm_region_reply get_window_shm_region_reply;
     struct set_parent_reply set_parent_reply;
     struct get_window_parents_reply get_window_parents_reply;
     struct get_window_children_reply get_window_children_reply;
@@ -6531,9 +6776,11 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct remove_completions_reply remove_completions_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
+    struct get_fd_completion_reply get_fd_completion_reply;
     struct set_fd_completion_mode_reply set_fd_completion_mode_reply;
     struct set_fd_disp_info_reply set_fd_disp_info_reply;
     struct set_fd_name_info_reply set_fd_name_info_reply;
@@ -6552,8 +6799,13 @@ union generic_reply
     struct set_job_limits_reply set_job_limits_reply;
     struct set_job_completion_port_reply set_job_completion_port_reply;
     struct terminate_job_reply terminate_job_reply;
+    struct get_fast_sync_region_reply get_fast_sync_region_reply;
+    struct get_fast_sync_slot_reply get_fast_sync_slot_reply;
+    struct batch_reply batch_reply;
+    struct get_request_shm_reply get_request_shm_reply;
+    struct get_server_stats_reply get_server_stats_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 572
+#define SERVER_PROTOCOL_VERSION 581
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
@@ -0,0 +1,117 @@
+/*
+ * Display the wineserver performance counters
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winbase.h"
+#include "winternl.h"
+#include "wine/server.h"
+#include "wine/unicode.h"
+
+#define MAX_REQUESTS 1024
+
+/* sort by decreasing total service time */
+static int compare_stats( const void *p1, const void *p2 )
+{
+    const struct request_stats *s1 = p1, *s2 = p2;
+
+    if (s1->total_time > s2->total_time) return -1;
+    if (s1->total_time < s2->total_time) return 1;
+    return strcmp( s1->name, s2->name );
+}
+
+static void usage(void)
+{
+    printf( "Usage: wineserverstat [/reset]\n\n" );
+    printf( "Display the time spent by wineserver in each request type since it was\n" );
+    printf( "started, or since the counters were last reset.\n\n" );
+    printf( "  /reset   Reset the counters after displaying them\n" );
+}
+
+int __cdecl wmain( int argc, WCHAR *argv[] )
+{
+    static const WCHAR resetW[] = {'r','e','s','e','t',0};
+    struct request_stats *stats;
+    unsigned __int64 elapsed = 0, loops = 0, events = 0, timeouts = 0, wait_time = 0;
+    unsigned int i, j, count = 0;
+    BOOL reset = FALSE;
+    NTSTATUS status;
+
+    for (i = 1; i < argc; i++)
+    {
+        if ((argv[i][0] == '/' || argv[i][0] == '-') && !strcmpiW( argv[i] + 1, resetW )) reset = TRUE;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (!(stats = HeapAlloc( GetProcessHeap(), 0, MAX_REQUESTS * sizeof(*stats) ))) return 1;
+
+    SERVER_START_REQ( get_server_stats )
+    {
+        req->reset = reset;
+        wine_server_set_reply( req, stats, MAX_REQUESTS * sizeof(*stats) );
+        if (!(status = wine_server_call( req )))
+        {
+            count     = wine_server_reply_size( reply ) / sizeof(*stats);
+            elapsed   = reply->elapsed;
+            loops     = reply->loops;
+            events    = reply->events;
+            timeouts  = reply->timeouts;
+            wait_time = reply->wait_time;
+        }
+    }
+    SERVER_END_REQ;
+
+    if (status)
+    {
+        fprintf( stderr, "wineserverstat: failed to retrieve the counters, status %08x\n", status );
+        HeapFree( GetProcessHeap(), 0, stats );
+        return 1;
+    }
+
+    printf( "%.3f s elapsed, %.3f s waiting for events\n", elapsed / 1e9, wait_time / 1e9 );
+    printf( "main loop: %.0f iterations, %.0f events, %.0f timeouts\n\n",
+            (double)loops, (double)events, (double)timeouts );
+
+    qsort( stats, count, sizeof(*stats), compare_stats );
+
+    printf( "%-32s %10s %11s %9s %9s %10s %10s   latency histogram (<1us <4us <16us <64us <256us <1ms <4ms >=4ms)\n",
+            "request", "count", "total (ms)", "avg (us)", "max (us)", "in (KB)", "out (KB)" );
+    for (i = 0; i < count; i++)
+    {
+        if (!stats[i].count) continue;
+        printf( "%-32.32s %10u %11.3f %9.3f %9.3f %10.0f %10.0f  ", stats[i].name, stats[i].count,
+                stats[i].total_time / 1e6, stats[i].total_time / 1e3 / stats[i].count,
+                stats[i].max_time / 1e3, stats[i].bytes_in / 1024.0, stats[i].bytes_out / 1024.0 );
+        for (j = 0; j < REQUEST_STATS_BUCKETS; j++) printf( " %u", stats[i].histogram[j] );
+        printf( "\n" );
+    }
+
+    HeapFree( GetProcessHeap(), 0, stats );
+    return 0;
+}
@@ -0,0 +1,286 @@
+/*
+ * Client-side synchronization objects shared memory
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * When WINEFASTSYNC is set in the environment, events and semaphores keep
+ * their state in a slot of a shared memory region that is mapped by every
+ * client process. Clients update the state with atomic operations and sleep
+ * on it with futexes, so that uncontended signal/wait pairs never need a
+ * server round trip.
+ *
+ * As long as a server-side thread is queued on the object (for instance in a
+ * wait that mixes it with non-sync objects), the FAST_SYNC_SERVER_WAIT flag
+ * is set in the state word, and clients fall back to regular requests for
+ * that object. Since clients only ever modify the state with a compare and
+ * exchange that includes the flag, this guarantees that the server sees a
+ * stable state between the signaled() and satisfied() calls of a wait.
+ *
+ * The value bits of an event above the signaled one count the pulses. Client
+ * threads that see the count change while they wait take one of the releases
+ * that the PulseEvent left in the slot, so that they don't miss it even though
+ * the event is never observed as signaled.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#include <unistd.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "handle.h"
+#include "thread.h"
+#include "request.h"
+
+#define FAST_SYNC_REGION_SIZE  (FAST_SYNC_MAX_SLOTS * sizeof(struct fast_sync_slot))
+
+static int fast_sync_enabled = -1;            /* is the fast sync mode enabled? */
+static struct fast_sync_slot *fast_sync_slots; /* server view of the shared region */
+static struct file *fast_sync_file;           /* file object backing the region */
+static unsigned int *free_slots;              /* stack of free slot indices */
+static unsigned int nb_free_slots;            /* number of entries in free_slots */
+static unsigned int next_slot;                /* first never allocated slot */
+
+#ifdef __linux__
+static inline void futex_wake_all( int *addr )
+{
+    syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */, INT_MAX, NULL, 0, 0 );
+}
+#endif
+
+/* create the shared region on first use */
+static int init_fast_sync(void)
+{
+#if defined(__linux__) && defined(HAVE_SYS_MMAN_H)
+    int fd;
+    void *ptr;
+
+    if (fast_sync_enabled != -1) return fast_sync_enabled;
+
+    fast_sync_enabled = 0;
+    if (!getenv( "WINEFASTSYNC" ) || !atoi( getenv( "WINEFASTSYNC" ))) return 0;
+
+    if ((fd = create_temp_file( FAST_SYNC_REGION_SIZE )) == -1) return 0;
+    ptr = mmap( NULL, FAST_SYNC_REGION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if (ptr == MAP_FAILED)
+    {
+        close( fd );
+        return 0;
+    }
+    if (!(fast_sync_file = create_file_for_fd( fd, FILE_GENERIC_READ | FILE_GENERIC_WRITE, 0 )))
+    {
+        munmap( ptr, FAST_SYNC_REGION_SIZE );
+        return 0;
+    }
+    make_object_static( (struct object *)fast_sync_file );
+    fast_sync_slots = ptr;
+    fast_sync_enabled = 1;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/* allocate a slot for a new object, return FAST_SYNC_NO_SLOT if not possible */
+unsigned int alloc_fast_sync_slot( enum fast_sync_type type, int state, unsigned int max )
+{
+    struct fast_sync_slot *slot;
+    unsigned int index;
+
+    if (!init_fast_sync()) return FAST_SYNC_NO_SLOT;
+
+    if (nb_free_slots) index = free_slots[--nb_free_slots];
+    else if (next_slot < FAST_SYNC_MAX_SLOTS) index = next_slot++;
+    else return FAST_SYNC_NO_SLOT;
+
+    slot = &fast_sync_slots[index];
+    slot->type    = type;
+    slot->max     = max;
+    slot->waiters = 0;
+    slot->pulsed  = 0;
+    slot->state   = state;
+    return index;
+}
+
+/* release the slot of a destroyed object */
+void free_fast_sync_slot( unsigned int index )
+{
+    static unsigned int free_slots_size;
+
+    assert( index < next_slot );
+    fast_sync_slots[index].type = FAST_SYNC_NONE;
+    fast_sync_slots[index].state = 0;
+
+    if (nb_free_slots == free_slots_size)
+    {
+        unsigned int new_size = max( free_slots_size * 2, 256 );
+        unsigned int *new_slots = realloc( free_slots, new_size * sizeof(*free_slots) );
+        if (!new_slots) return;  /* leak the slot */
+        free_slots = new_slots;
+        free_slots_size = new_size;
+    }
+    free_slots[nb_free_slots++] = index;
+}
+
+/* retrieve the current value of a slot, without the flags */
+int get_fast_sync_value( unsigned int index )
+{
+    return fast_sync_slots[index].state & FAST_SYNC_VALUE_MASK;
+}
+
+/* atomically replace the value of a slot if it is still equal to old; return the previous value */
+int cmpxchg_fast_sync_value( unsigned int index, int value, int old )
+{
+    int *state = &fast_sync_slots[index].state;
+    int cur, prev;
+
+    for (cur = *state;; cur = prev)
+    {
+        if ((cur & FAST_SYNC_VALUE_MASK) != old) break;
+        prev = interlocked_cmpxchg( state, (cur & FAST_SYNC_SERVER_WAIT) | value, cur );
+        if (prev == cur) break;
+    }
+    return cur & FAST_SYNC_VALUE_MASK;
+}
+
+/* set the value of a slot, waking up client waiters if it becomes signaled */
+void set_fast_sync_value( unsigned int index, int value )
+{
+    int *state = &fast_sync_slots[index].state;
+    int cur, prev;
+
+    for (cur = *state;; cur = prev)
+    {
+        prev = interlocked_cmpxchg( state, (cur & FAST_SYNC_SERVER_WAIT) | value, cur );
+        if (prev == cur) break;
+    }
+    if (value) wake_fast_sync_waiters( index );
+}
+
+/* set the signaled bit of an event slot, keeping the pulse count */
+void set_fast_sync_event( unsigned int index, int signaled )
+{
+    int *state = &fast_sync_slots[index].state;
+    int cur, prev, new;
+
+    for (cur = *state;; cur = prev)
+    {
+        new = signaled ? cur | FAST_SYNC_EVENT_SIGNALED : cur & ~FAST_SYNC_EVENT_SIGNALED;
+        if (new == cur) return;
+        if ((prev = interlocked_cmpxchg( state, new, cur )) == cur) break;
+    }
+    if (signaled) wake_fast_sync_waiters( index );
+}
+
+/* retrieve the number of client threads waiting on a slot */
+static int get_fast_sync_waiters( struct fast_sync_slot *slot )
+{
+    /* the count is maintained by the clients, so it can't be trusted: a thread
+     * can only wait once on a given object, so it is bounded by the thread count */
+    int waiters = *(volatile int *)&slot->waiters;
+
+    if (waiters <= 0) return 0;
+    if ((unsigned int)waiters > get_thread_count()) return get_thread_count();
+    return waiters;
+}
+
+/* reset a pulsed event, releasing the client threads that were waiting on it */
+void pulse_fast_sync_event( unsigned int index, int manual_reset )
+{
+    struct fast_sync_slot *slot = &fast_sync_slots[index];
+    int cur, prev, new, waiters;
+
+    for (cur = slot->state;; cur = prev)
+    {
+        waiters = get_fast_sync_waiters( slot );
+        /* an auto-reset event is not signaled anymore if a thread was already released */
+        if (manual_reset) slot->pulsed = waiters;
+        else slot->pulsed = (cur & FAST_SYNC_EVENT_SIGNALED) && waiters;
+        new = (cur & FAST_SYNC_SERVER_WAIT) |
+              ((cur + FAST_SYNC_EVENT_PULSE) & FAST_SYNC_VALUE_MASK & ~FAST_SYNC_EVENT_SIGNALED);
+        if ((prev = interlocked_cmpxchg( &slot->state, new, cur )) == cur) break;
+    }
+    wake_fast_sync_waiters( index );
+}
+
+/* wake up the client threads sleeping on a slot */
+void wake_fast_sync_waiters( unsigned int index )
+{
+#ifdef __linux__
+    if (fast_sync_slots[index].waiters) futex_wake_all( &fast_sync_slots[index].state );
+#endif
+}
+
+/* update the server wait flag when the wait queue of the object changes */
+void set_fast_sync_server_wait( unsigned int index, int waiting )
+{
+    int *state = &fast_sync_slots[index].state;
+    int cur, prev;
+
+    for (cur = *state;; cur = prev)
+    {
+        int new = waiting ? cur | FAST_SYNC_SERVER_WAIT : cur & FAST_SYNC_VALUE_MASK;
+        if (new == cur) return;
+        if ((prev = interlocked_cmpxchg( state, new, cur )) == cur) break;
+    }
+    /* clients sleeping on the old state need to notice the flag */
+    wake_fast_sync_waiters( index );
+}
+
+/* retrieve a handle to the shared region */
+DECL_HANDLER(get_fast_sync_region)
+{
+    if (!init_fast_sync())
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    reply->handle = alloc_handle( current->process, fast_sync_file,
+                                  FILE_READ_DATA | FILE_WRITE_DATA, 0 );
+    reply->size = FAST_SYNC_REGION_SIZE;
+}
+
+/* retrieve the slot used by an event or semaphore */
+DECL_HANDLER(get_fast_sync_slot)
+{
+    struct object *obj;
+
+    reply->index = FAST_SYNC_NO_SLOT;
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+
+    if ((reply->index = get_event_fast_sync( obj )) == FAST_SYNC_NO_SLOT)
+        reply->index = get_semaphore_fast_sync( obj );
+    if (reply->index != FAST_SYNC_NO_SLOT)
+        reply->access = get_handle_access( current->process, req->handle );
+    release_object( obj );
+}
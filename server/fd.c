@@ -359,13 +359,19 @@ static file_pos_t max_unix_offset = OFF_T_MAX;
 
 struct timeout_user
 {
-    struct list           entry;      /* entry in sorted timeout list */
+    struct list           entry;      /* entry in expired timeouts list */
+    unsigned int          index;      /* index in the timeout heap, TIMEOUT_EXPIRED if expired */
     timeout_t             when;       /* timeout expiry (absolute time) */
     timeout_callback      callback;   /* callback function */
     void                 *private;    /* callback private data */
 };
 
-static struct list timeout_list = LIST_INIT(timeout_list);   /* sorted timeouts list */
+#define TIMEOUT_EXPIRED (~0u)
+
+/* pending timeouts are kept in a binary min-heap ordered by expiry time */
+static struct timeout_user **timeout_heap;
+static unsigned int timeout_count;   /* number of pending timeouts */
+static unsigned int timeout_size;    /* allocated size of the heap */
 timeout_t current_time;
 
 static inline void set_current_time(void)
@@ -376,35 +382,114 @@ static inline void set_current_time(void)
     current_time = (timeout_t)now.tv_sec * TICKS_PER_SEC + now.tv_usec * 10 + ticks_1601_to_1970;
 }
 
+struct main_loop_stats main_loop_stats;
+
+/* account for a wait for events of the main loop */
+static inline void update_main_loop_stats( unsigned __int64 start, int events )
+{
+    main_loop_stats.loops++;
+    if (events > 0) main_loop_stats.events += events;
+    main_loop_stats.wait_time += get_perf_time() - start;
+}
+
+static inline void set_heap_entry( unsigned int index, struct timeout_user *user )
+{
+    timeout_heap[index] = user;
+    user->index = index;
+}
+
+/* move a heap entry up towards the root until the heap is ordered */
+static void timeout_heap_up( unsigned int index )
+{
+    struct timeout_user *user = timeout_heap[index];
+
+    while (index)
+    {
+        unsigned int parent = (index - 1) / 2;
+        if (timeout_heap[parent]->when <= user->when) break;
+        set_heap_entry( index, timeout_heap[parent] );
+        index = parent;
+    }
+    set_heap_entry( index, user );
+}
+
+/* move a heap entry down towards the leaves until the heap is ordered */
+static void timeout_heap_down( unsigned int index )
+{
+    struct timeout_user *user = timeout_heap[index];
+
+    for (;;)
+    {
+        unsigned int child = 2 * index + 1;
+
+        if (child >= timeout_count) break;
+        if (child + 1 < timeout_count && timeout_heap[child + 1]->when < timeout_heap[child]->when)
+            child++;
+        if (user->when <= timeout_heap[child]->when) break;
+        set_heap_entry( index, timeout_heap[child] );
+        index = child;
+    }
+    set_heap_entry( index, user );
+}
+
+/* remove an entry from the heap */
+static void timeout_heap_remove( struct timeout_user *user )
+{
+    unsigned int index = user->index;
+    struct timeout_user *last = timeout_heap[--timeout_count];
+
+    user->index = TIMEOUT_EXPIRED;
+    if (last == user) return;
+    set_heap_entry( index, last );
+    if (index && timeout_heap[(index - 1) / 2]->when > last->when) timeout_heap_up( index );
+    else timeout_heap_down( index );
+}
+
 /* add a timeout user */
 struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, void *private )
 {
     struct timeout_user *user;
-    struct list *ptr;
+
+    if (timeout_count == timeout_size)
+    {
+        unsigned int new_size = max( timeout_size * 2, 64 );
+        struct timeout_user **new_heap = realloc( timeout_heap, new_size * sizeof(*new_heap) );
+
+        if (!new_heap)
+        {
+            set_error( STATUS_NO_MEMORY );
+            return NULL;
+        }
+        timeout_heap = new_heap;
+        timeout_size = new_size;
+    }
 
     if (!(user = mem_alloc( sizeof(*user) ))) return NULL;
     user->when     = (when > 0) ? when : current_time - when;
     user->callback = func;
     user->private  = private;
 
-    /* Now insert it in the linked list */
+    /* Now insert it in the heap */
 
-    LIST_FOR_EACH( ptr, &timeout_list )
-    {
-        struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-        if (timeout->when >= user->when) break;
-    }
-    list_add_before( ptr, &user->entry );
+    timeout_heap[timeout_count] = user;
+    timeout_heap_up( timeout_count++ );
     return user;
 }
 
 /* remove a timeout user */
 void remove_timeout_user( struct timeout_user *user )
 {
-    list_remove( &user->entry );
+    if (user->index == TIMEOUT_EXPIRED) list_remove( &user->entry );
+    else timeout_heap_remove( user );
     free( user );
 }
 
+/* return the number of pending timeouts */
+unsigned int get_timeout_count(void)
+{
+    return timeout_count;
+}
+
 /* return a text description of a timeout for debugging purposes */
 const char *get_timeout_str( timeout_t timeout )
 {
@@ -520,6 +605,7 @@ static inline void remove_epoll_user( struct fd *fd, int user )
 static inline void main_loop_epoll(void)
 {
     int i, ret, timeout;
+    unsigned __int64 start;
     struct epoll_event events[128];
 
     assert( POLLIN == EPOLLIN );
@@ -536,8 +622,12 @@ static inline void main_loop_epoll(void)
         if (!active_users) break;  /* last user removed by a timeout */
         if (epoll_fd == -1) break;  /* an error occurred with epoll */
 
+        start = get_perf_time();
+        release_server_lock();
         ret = epoll_wait( epoll_fd, events, ARRAY_SIZE( events ), timeout );
+        acquire_server_lock();
         set_current_time();
+        update_main_loop_stats( start, ret );
 
         /* put the events into the pollfd array first, like poll does */
         for (i = 0; i < ret; i++)
@@ -630,6 +720,7 @@ static inline void remove_epoll_user( struct fd *fd, int user )
 static inline void main_loop_epoll(void)
 {
     int i, ret, timeout;
+    unsigned __int64 start;
     struct kevent events[128];
 
     if (kqueue_fd == -1) return;
@@ -641,6 +732,8 @@ static inline void main_loop_epoll(void)
         if (!active_users) break;  /* last user removed by a timeout */
         if (kqueue_fd == -1) break;  /* an error occurred with kqueue */
 
+        start = get_perf_time();
+        release_server_lock();
         if (timeout != -1)
         {
             struct timespec ts;
@@ -650,8 +743,10 @@ static inline void main_loop_epoll(void)
             ret = kevent( kqueue_fd, NULL, 0, events, ARRAY_SIZE( events ), &ts );
         }
         else ret = kevent( kqueue_fd, NULL, 0, events, ARRAY_SIZE( events ), NULL );
+        acquire_server_lock();
 
         set_current_time();
+        update_main_loop_stats( start, ret );
 
         /* put the events into the pollfd array first, like poll does */
         for (i = 0; i < ret; i++)
@@ -733,6 +828,7 @@ static inline void remove_epoll_user( struct fd *fd, int user )
 static inline void main_loop_epoll(void)
 {
     int i, nget, ret, timeout;
+    unsigned __int64 start;
     port_event_t events[128];
 
     if (port_fd == -1) return;
@@ -745,6 +841,8 @@ static inline void main_loop_epoll(void)
         if (!active_users) break;  /* last user removed by a timeout */
         if (port_fd == -1) break;  /* an error occurred with event completion */
 
+        start = get_perf_time();
+        release_server_lock();
         if (timeout != -1)
         {
             struct timespec ts;
@@ -754,10 +852,12 @@ static inline void main_loop_epoll(void)
             ret = port_getn( port_fd, events, ARRAY_SIZE( events ), &nget, &ts );
         }
         else ret = port_getn( port_fd, events, ARRAY_SIZE( events ), &nget, NULL );
+        acquire_server_lock();
 
 	if (ret == -1) break;  /* an error occurred with event completion */
 
         set_current_time();
+        update_main_loop_stats( start, nget );
 
         /* put the events into the pollfd array first, like poll does */
         for (i = 0; i < nget; i++)
@@ -847,23 +947,19 @@ static void remove_poll_user( struct fd *fd, int user )
 /* process pending timeouts and return the time until the next timeout, in milliseconds */
 static int get_next_timeout(void)
 {
-    if (!list_empty( &timeout_list ))
+    if (timeout_count)
     {
         struct list expired_list, *ptr;
 
-        /* first remove all expired timers from the list */
+        /* first remove all expired timers from the heap */
 
         list_init( &expired_list );
-        while ((ptr = list_head( &timeout_list )) != NULL)
+        while (timeout_count && timeout_heap[0]->when <= current_time)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
+            struct timeout_user *timeout = timeout_heap[0];
 
-            if (timeout->when <= current_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
+            timeout_heap_remove( timeout );
+            list_add_tail( &expired_list, &timeout->entry );
         }
 
         /* now call the callback for all the removed timers */
@@ -874,11 +970,12 @@ static int get_next_timeout(void)
             list_remove( &timeout->entry );
             timeout->callback( timeout->private );
             free( timeout );
+            main_loop_stats.timeouts++;
         }
 
-        if ((ptr = list_head( &timeout_list )) != NULL)
+        if (timeout_count)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
+            struct timeout_user *timeout = timeout_heap[0];
             int diff = (timeout->when - current_time + 9999) / 10000;
             if (diff < 0) diff = 0;
             return diff;
@@ -891,9 +988,11 @@ static int get_next_timeout(void)
 void main_loop(void)
 {
     int i, ret, timeout;
+    unsigned __int64 start;
 
     set_current_time();
     server_start_time = current_time;
+    reset_server_stats();
 
     main_loop_epoll();
     /* fall through to normal poll loop */
@@ -904,8 +1003,12 @@ void main_loop(void)
 
         if (!active_users) break;  /* last user removed by a timeout */
 
+        start = get_perf_time();
+        release_server_lock();
         ret = poll( pollfd, nb_users, timeout );
+        acquire_server_lock();
         set_current_time();
+        update_main_loop_stats( start, ret );
 
         if (ret > 0)
         {
@@ -1879,6 +1982,16 @@ struct fd *open_fd( struct fd *root, const char *name, int flags, mode_t *mode,
             }
             ftruncate( fd->unix_fd, 0 );
         }
+#ifdef HAVE_POSIX_FADVISE
+        /* let the kernel adjust its read-ahead to the announced access pattern */
+        if (S_ISREG(st.st_mode))
+        {
+            if (options & FILE_SEQUENTIAL_ONLY)
+                posix_fadvise( fd->unix_fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+            else if (options & FILE_RANDOM_ACCESS)
+                posix_fadvise( fd->unix_fd, 0, 0, POSIX_FADV_RANDOM );
+        }
+#endif
     }
     else  /* special file */
     {
@@ -2642,6 +2755,21 @@ DECL_HANDLER(add_fd_completion)
     }
 }
 
+/* get a handle to the completion port associated with an fd */
+DECL_HANDLER(get_fd_completion)
+{
+    struct fd *fd = get_handle_fd_obj( current->process, req->handle, 0 );
+    if (fd)
+    {
+        if (fd->completion)
+        {
+            reply->port = alloc_handle( current->process, fd->completion, IO_COMPLETION_MODIFY_STATE, 0 );
+            reply->ckey = fd->comp_key;
+        }
+        release_object( fd );
+    }
+}
+
 /* set fd completion information */
 DECL_HANDLER(set_fd_completion_mode)
 {
@@ -125,6 +125,18 @@ extern void remove_process_locks( struct process *process );
 
 static inline struct fd *get_obj_fd( struct object *obj ) { return obj->ops->get_fd( obj ); }
 
+/* main loop performance counters */
+
+struct main_loop_stats
+{
+    unsigned __int64 loops;      /* main loop iterations */
+    unsigned __int64 events;     /* fd events dispatched */
+    unsigned __int64 timeouts;   /* expired timeouts processed */
+    unsigned __int64 wait_time;  /* time spent waiting for events, in nanoseconds */
+};
+
+extern struct main_loop_stats main_loop_stats;
+
 /* timeout functions */
 
 struct timeout_user;
@@ -137,6 +149,7 @@ typedef void (*timeout_callback)( void *private );
 extern struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, void *private );
 extern void remove_timeout_user( struct timeout_user *user );
 extern const char *get_timeout_str( timeout_t timeout );
+extern unsigned int get_timeout_count(void);
 
 /* file functions */
 
@@ -157,6 +170,7 @@ extern struct mapping *get_mapping_obj( struct process *process, obj_handle_t ha
 extern struct file *get_mapping_file( struct process *process, client_ptr_t base,
                                       unsigned int access, unsigned int sharing );
 extern void free_mapped_views( struct process *process );
+extern int create_temp_file( file_pos_t size );
 extern int get_page_size(void);
 
 /* device functions */
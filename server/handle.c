@@ -42,7 +42,27 @@
 struct handle_entry
 {
     struct object *ptr;       /* object */
-    unsigned int   access;    /* access rights */
+    unsigned int   access;    /* access rights, or index of the next free entry if ptr is NULL */
+};
+
+/* The entries are stored in fixed-size blocks that are referenced from directory pages,
+ * which are themselves referenced from a small array in the table. Neither the blocks
+ * nor the directory pages ever move once allocated, so an entry pointer stays valid for
+ * the lifetime of the table, and a lookup is a couple of indirections without any lock. */
+
+#define MAX_HANDLE_ENTRIES  0x00ffffff
+
+#define HANDLE_BLOCK_SHIFT  8
+#define HANDLE_BLOCK_SIZE   (1 << HANDLE_BLOCK_SHIFT)      /* entries per block */
+#define HANDLE_DIR_SHIFT    8
+#define HANDLE_DIR_SIZE     (1 << HANDLE_DIR_SHIFT)        /* blocks per directory page */
+#define HANDLE_TOP_SIZE     ((MAX_HANDLE_ENTRIES >> (HANDLE_BLOCK_SHIFT + HANDLE_DIR_SHIFT)) + 1)
+
+#define NO_FREE_ENTRY       (~0u)
+
+struct handle_dir
+{
+    struct handle_entry *blocks[HANDLE_DIR_SIZE];
 };
 
 struct handle_table
@@ -51,8 +71,8 @@ struct handle_table
     struct process      *process;     /* process owning this table */
     int                  count;       /* number of allocated entries */
     int                  last;        /* last used entry */
-    int                  free;        /* first entry that may be free */
-    struct handle_entry *entries;     /* handle entries */
+    unsigned int         free;        /* head of the list of free entries below last */
+    struct handle_dir   *dirs[HANDLE_TOP_SIZE];  /* directory pages */
 };
 
 static struct handle_table *global_table;
@@ -63,8 +83,6 @@ static struct handle_table *global_table;
 #define RESERVED_CLOSE_PROTECT (HANDLE_FLAG_PROTECT_FROM_CLOSE << RESERVED_SHIFT)
 #define RESERVED_ALL           (RESERVED_INHERIT | RESERVED_CLOSE_PROTECT)
 
-#define MIN_HANDLE_ENTRIES  32
-#define MAX_HANDLE_ENTRIES  0x00ffffff
 
 
 /* handle to table index conversion */
@@ -79,6 +97,13 @@ static inline int handle_to_index( obj_handle_t handle )
     return (handle >> 2) - 1;
 }
 
+/* return the entry for a given index; the block containing it must have been allocated */
+static inline struct handle_entry *table_entry( const struct handle_table *table, unsigned int index )
+{
+    struct handle_dir *dir = table->dirs[index >> (HANDLE_BLOCK_SHIFT + HANDLE_DIR_SHIFT)];
+    return &dir->blocks[(index >> HANDLE_BLOCK_SHIFT) & (HANDLE_DIR_SIZE - 1)][index & (HANDLE_BLOCK_SIZE - 1)];
+}
+
 /* global handle conversion */
 
 #define HANDLE_OBFUSCATOR 0x544a4def
@@ -149,9 +174,9 @@ static void handle_table_dump( struct object *obj, int verbose )
     fprintf( stderr, "Handle table last=%d count=%d process=%p\n",
              table->last, table->count, table->process );
     if (!verbose) return;
-    entry = table->entries;
-    for (i = 0; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
+        entry = table_entry( table, i );
         if (!entry->ptr) continue;
         fprintf( stderr, "    %04x: %p %08x ",
                  index_to_handle(i), entry->ptr, entry->access );
@@ -163,7 +188,7 @@ static void handle_table_dump( struct object *obj, int verbose )
 /* destroy a handle table */
 static void handle_table_destroy( struct object *obj )
 {
-    int i;
+    int i, j;
     struct handle_table *table = (struct handle_table *)obj;
     struct handle_entry *entry;
 
@@ -172,20 +197,28 @@ static void handle_table_destroy( struct object *obj )
     /* first notify all objects that handles are being closed */
     if (table->process)
     {
-        for (i = 0, entry = table->entries; i <= table->last; i++, entry++)
+        for (i = 0; i <= table->last; i++)
         {
-            struct object *obj = entry->ptr;
+            struct object *obj = table_entry( table, i )->ptr;
             if (obj) obj->ops->close_handle( obj, table->process, index_to_handle(i) );
         }
     }
 
-    for (i = 0, entry = table->entries; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
-        struct object *obj = entry->ptr;
+        struct object *obj;
+        entry = table_entry( table, i );
+        obj = entry->ptr;
         entry->ptr = NULL;
         if (obj) release_object_from_handle( obj );
     }
-    free( table->entries );
+
+    for (i = 0; i < HANDLE_TOP_SIZE; i++)
+    {
+        if (!table->dirs[i]) continue;
+        for (j = 0; j < HANDLE_DIR_SIZE; j++) free( table->dirs[i]->blocks[j] );
+        free( table->dirs[i] );
+    }
 }
 
 /* close all the process handles and free the handle table */
@@ -197,58 +230,74 @@ void close_process_handles( struct process *process )
     if (table) release_object( table );
 }
 
+/* allocate the entry blocks up to the specified entry count */
+static int grow_handle_table( struct handle_table *table, int count )
+{
+    struct handle_dir *dir;
+    struct handle_entry *block;
+    unsigned int index;
+
+    if (count > MAX_HANDLE_ENTRIES) count = MAX_HANDLE_ENTRIES;
+    while (table->count < count)
+    {
+        index = table->count >> (HANDLE_BLOCK_SHIFT + HANDLE_DIR_SHIFT);
+        if (!(dir = table->dirs[index]))
+        {
+            if (!(dir = mem_alloc( sizeof(*dir) ))) return 0;
+            memset( dir, 0, sizeof(*dir) );
+            table->dirs[index] = dir;
+        }
+        if (!(block = mem_alloc( HANDLE_BLOCK_SIZE * sizeof(*block) ))) return 0;
+        memset( block, 0, HANDLE_BLOCK_SIZE * sizeof(*block) );
+        /* the block must be fully initialized before it becomes reachable */
+        dir->blocks[(table->count >> HANDLE_BLOCK_SHIFT) & (HANDLE_DIR_SIZE - 1)] = block;
+        table->count += HANDLE_BLOCK_SIZE;
+    }
+    return 1;
+}
+
 /* allocate a new handle table */
 struct handle_table *alloc_handle_table( struct process *process, int count )
 {
     struct handle_table *table;
 
-    if (count < MIN_HANDLE_ENTRIES) count = MIN_HANDLE_ENTRIES;
     if (!(table = alloc_object( &handle_table_ops )))
         return NULL;
     table->process = process;
-    table->count   = count;
+    table->count   = 0;
     table->last    = -1;
-    table->free    = 0;
-    if ((table->entries = mem_alloc( count * sizeof(*table->entries) ))) return table;
+    table->free    = NO_FREE_ENTRY;
+    memset( table->dirs, 0, sizeof(table->dirs) );
+    if (grow_handle_table( table, max( count, 1 ))) return table;
     release_object( table );
     return NULL;
 }
 
-/* grow a handle table */
-static int grow_handle_table( struct handle_table *table )
+/* allocate a free entry in the handle table */
+static obj_handle_t alloc_entry( struct handle_table *table, void *obj, unsigned int access )
 {
-    struct handle_entry *new_entries;
-    int count = min( table->count * 2, MAX_HANDLE_ENTRIES );
+    struct handle_entry *entry;
+    unsigned int index;
 
-    if (count == table->count ||
-        !(new_entries = realloc( table->entries, count * sizeof(struct handle_entry) )))
+    if ((index = table->free) != NO_FREE_ENTRY)
     {
-        set_error( STATUS_INSUFFICIENT_RESOURCES );
-        return 0;
+        entry = table_entry( table, index );
+        table->free = entry->access;
     }
-    table->entries = new_entries;
-    table->count   = count;
-    return 1;
-}
-
-/* allocate the first free entry in the handle table */
-static obj_handle_t alloc_entry( struct handle_table *table, void *obj, unsigned int access )
-{
-    struct handle_entry *entry = table->entries + table->free;
-    int i;
-
-    for (i = table->free; i <= table->last; i++, entry++) if (!entry->ptr) goto found;
-    if (i >= table->count)
+    else
     {
-        if (!grow_handle_table( table )) return 0;
-        entry = table->entries + i;  /* the entries may have moved */
+        index = table->last + 1;
+        if (index >= MAX_HANDLE_ENTRIES || (index >= table->count && !grow_handle_table( table, index + 1 )))
+        {
+            set_error( STATUS_INSUFFICIENT_RESOURCES );
+            return 0;
+        }
+        entry = table_entry( table, index );
+        table->last = index;
     }
-    table->last = i;
- found:
-    table->free = i + 1;
-    entry->ptr    = grab_object_for_handle( obj );
     entry->access = access;
-    return index_to_handle(i);
+    entry->ptr    = grab_object_for_handle( obj );
+    return index_to_handle(index);
 }
 
 /* allocate a handle for an object, incrementing its refcount */
@@ -326,59 +375,42 @@ static struct handle_entry *get_handle( struct process *process, obj_handle_t ha
     index = handle_to_index( handle );
     if (index < 0) return NULL;
     if (index > table->last) return NULL;
-    entry = table->entries + index;
+    entry = table_entry( table, index );
     if (!entry->ptr) return NULL;
     return entry;
 }
 
-/* attempt to shrink a table */
-static void shrink_handle_table( struct handle_table *table )
-{
-    struct handle_entry *entry = table->entries + table->last;
-    struct handle_entry *new_entries;
-    int count = table->count;
-
-    while (table->last >= 0)
-    {
-        if (entry->ptr) break;
-        table->last--;
-        entry--;
-    }
-    if (table->last >= count / 4) return;  /* no need to shrink */
-    if (count < MIN_HANDLE_ENTRIES * 2) return;  /* too small to shrink */
-    count /= 2;
-    if (!(new_entries = realloc( table->entries, count * sizeof(*new_entries) ))) return;
-    table->count   = count;
-    table->entries = new_entries;
-}
-
 /* copy the handle table of the parent process */
 /* return 1 if OK, 0 on error */
 struct handle_table *copy_handle_table( struct process *process, struct process *parent )
 {
     struct handle_table *parent_table = parent->handles;
     struct handle_table *table;
+    struct handle_entry *ptr;
     int i;
 
     assert( parent_table );
     assert( parent_table->obj.ops == &handle_table_ops );
 
-    if (!(table = alloc_handle_table( process, parent_table->count )))
+    if (!(table = alloc_handle_table( process, parent_table->last + 1 )))
         return NULL;
 
-    if ((table->last = parent_table->last) >= 0)
+    for (i = 0; i <= parent_table->last; i++)
     {
-        struct handle_entry *ptr = table->entries;
-        memcpy( ptr, parent_table->entries, (table->last + 1) * sizeof(struct handle_entry) );
-        for (i = 0; i <= table->last; i++, ptr++)
-        {
-            if (!ptr->ptr) continue;
-            if (ptr->access & RESERVED_INHERIT) grab_object_for_handle( ptr->ptr );
-            else ptr->ptr = NULL; /* don't inherit this entry */
-        }
+        ptr = table_entry( parent_table, i );
+        if (!ptr->ptr || !(ptr->access & RESERVED_INHERIT)) continue;  /* don't inherit this entry */
+        *table_entry( table, i ) = *ptr;
+        grab_object_for_handle( ptr->ptr );
+        table->last = i;
+    }
+    /* chain the holes so that the lowest ones get reused first */
+    for (i = table->last; i >= 0; i--)
+    {
+        ptr = table_entry( table, i );
+        if (ptr->ptr) continue;
+        ptr->access = table->free;
+        table->free = i;
     }
-    /* attempt to shrink the table */
-    shrink_handle_table( table );
     return table;
 }
 
@@ -393,10 +425,15 @@ unsigned int close_handle( struct process *process, obj_handle_t handle )
     if (entry->access & RESERVED_CLOSE_PROTECT) return STATUS_HANDLE_NOT_CLOSABLE;
     obj = entry->ptr;
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
+    if (handle_is_global(handle))
+    {
+        table = global_table;
+        handle = handle_global_to_local( handle );
+    }
+    else table = process->handles;
     entry->ptr = NULL;
-    table = handle_is_global(handle) ? global_table : process->handles;
-    if (entry < table->entries + table->free) table->free = entry - table->entries;
-    if (entry == table->entries + table->last) shrink_handle_table( table );
+    entry->access = table->free;
+    table->free = handle_to_index( handle );
     release_object_from_handle( obj );
     return STATUS_SUCCESS;
 }
@@ -476,8 +513,9 @@ obj_handle_t find_inherited_handle( struct process *process, const struct object
 
     if (!table) return 0;
 
-    for (i = 0, ptr = table->entries; i <= table->last; i++, ptr++)
+    for (i = 0; i <= table->last; i++)
     {
+        ptr = table_entry( table, i );
         if (!ptr->ptr) continue;
         if (ptr->ptr->ops != ops) continue;
         if (ptr->access & RESERVED_INHERIT) return index_to_handle(i);
@@ -496,8 +534,9 @@ obj_handle_t enumerate_handles( struct process *process, const struct object_ops
 
     if (!table) return 0;
 
-    for (i = *index, entry = &table->entries[i]; i <= table->last; i++, entry++)
+    for (i = *index; (int)i <= table->last; i++)
     {
+        entry = table_entry( table, i );
         if (!entry->ptr) continue;
         if (entry->ptr->ops != ops) continue;
         *index = i + 1;
@@ -794,8 +833,9 @@ static int enum_handles( struct process *process, void *user )
     if (!table)
         return 0;
 
-    for (i = 0, entry = table->entries; i <= table->last; i++, entry++)
+    for (i = 0; (int)i <= table->last; i++)
     {
+        entry = table_entry( table, i );
         if (!entry->ptr) continue;
         if (!info->handle)
         {
@@ -41,6 +41,7 @@
 /* command-line options */
 int debug_level = 0;
 int foreground = 0;
+int worker_threads = 0;
 timeout_t master_socket_timeout = 3 * -TICKS_PER_SEC;  /* master socket timeout, default is 3 seconds */
 const char *server_argv0;
 
@@ -55,6 +56,7 @@ static void usage( FILE *fh )
     fprintf(fh, "   -h,    --help            display this help message\n");
     fprintf(fh, "   -k[n], --kill[=n]        kill the current wineserver, optionally with signal n\n");
     fprintf(fh, "   -p[n], --persistent[=n]  make server persistent, optionally for n seconds\n");
+    fprintf(fh, "   -t[n], --threads[=n]     handle read-only requests on n threads, default one per CPU\n");
     fprintf(fh, "   -v,    --version         display version information and exit\n");
     fprintf(fh, "   -w,    --wait            wait until the current wineserver terminates\n");
     fprintf(fh, "\n");
@@ -71,6 +73,7 @@ static void parse_args( int argc, char *argv[] )
         {"help",        0, NULL, 'h'},
         {"kill",        2, NULL, 'k'},
         {"persistent",  2, NULL, 'p'},
+        {"threads",     2, NULL, 't'},
         {"version",     0, NULL, 'v'},
         {"wait",        0, NULL, 'w'},
         { NULL,         0, NULL, 0}
@@ -78,7 +81,7 @@ static void parse_args( int argc, char *argv[] )
 
     server_argv0 = argv[0];
 
-    while ((optc = getopt_long( argc, argv, "d::fhk::p::vw", long_options, NULL )) != -1)
+    while ((optc = getopt_long( argc, argv, "d::fhk::p::t::vw", long_options, NULL )) != -1)
     {
         switch(optc)
         {
@@ -107,6 +110,12 @@ static void parse_args( int argc, char *argv[] )
                 else
                     master_socket_timeout = TIMEOUT_INFINITE;
                 break;
+            case 't':
+                if (optarg && isdigit(*optarg))
+                    worker_threads = atoi( optarg );
+                else
+                    worker_threads = sysconf( _SC_NPROCESSORS_ONLN );
+                break;
             case 'v':
                 fprintf( stderr, "%s\n", wine_get_build_id());
                 exit(0);
@@ -145,6 +154,7 @@ int main( int argc, char *argv[] )
     init_signals();
     init_directories();
     init_registry();
+    init_worker_threads();
     main_loop();
     return 0;
 }
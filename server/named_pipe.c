@@ -24,10 +24,18 @@
 #include "wine/port.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#ifdef HAVE_SYS_IOCTL_H
+#include <sys/ioctl.h>
+#endif
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -52,6 +60,8 @@ struct pipe_message
     struct async        *async;      /* async of pending write */
 };
 
+#define PIPE_FLUSH_POLL_INTERVAL (-10 * TICKS_PER_SEC / 1000)  /* 10 ms */
+
 struct pipe_end
 {
     struct object        obj;        /* object header */
@@ -63,6 +73,8 @@ struct pipe_end
     process_id_t         client_pid; /* process that created the client */
     process_id_t         server_pid; /* process that created the server */
     data_size_t          buffer_size;/* size of buffered data that doesn't block caller */
+    int                  is_socket;  /* data is transferred through a Unix socket pair */
+    struct timeout_user *flush_poll; /* timer checking if the written socket data has been read */
     struct list          message_queue;
     struct async_queue   read_q;     /* read queue */
     struct async_queue   write_q;    /* write queue */
@@ -143,6 +155,7 @@ static int pipe_end_read( struct fd *fd, struct async *async, file_pos_t pos );
 static int pipe_end_write( struct fd *fd, struct async *async_data, file_pos_t pos );
 static int pipe_end_flush( struct fd *fd, struct async *async );
 static void pipe_end_get_volume_info( struct fd *fd, unsigned int info_class );
+static void pipe_end_queue_async( struct fd *fd, struct async *async, int type, int count );
 static void pipe_end_reselect_async( struct fd *fd, struct async_queue *queue );
 static void pipe_end_get_file_info( struct fd *fd, obj_handle_t handle, unsigned int info_class );
 
@@ -184,7 +197,7 @@ static const struct fd_ops pipe_server_fd_ops =
     pipe_end_get_file_info,       /* get_file_info */
     pipe_end_get_volume_info,     /* get_volume_info */
     pipe_server_ioctl,            /* ioctl */
-    no_fd_queue_async,            /* queue_async */
+    pipe_end_queue_async,         /* queue_async */
     pipe_end_reselect_async       /* reselect_async */
 };
 
@@ -225,7 +238,7 @@ static const struct fd_ops pipe_client_fd_ops =
     pipe_end_get_file_info,       /* get_file_info */
     pipe_end_get_volume_info,     /* get_volume_info */
     pipe_client_ioctl,            /* ioctl */
-    no_fd_queue_async,            /* queue_async */
+    pipe_end_queue_async,         /* queue_async */
     pipe_end_reselect_async       /* reselect_async */
 };
 
@@ -378,6 +391,45 @@ static void free_message( struct pipe_message *message )
     free( message );
 }
 
+/* are byte mode pipes allowed to transfer their data through Unix sockets? */
+static int pipe_sockets_enabled(void)
+{
+    static int enabled = -1;
+
+    if (enabled == -1)
+    {
+        const char *env = getenv( "WINEPIPESOCKETS" );
+        enabled = env && atoi( env );
+    }
+    return enabled;
+}
+
+/* replace the fd of a server end, either by a Unix socket or by a pseudo fd if unix_fd is -1 */
+static int set_pipe_server_unix_fd( struct pipe_server *server, int unix_fd )
+{
+    struct pipe_end *pipe_end = &server->pipe_end;
+    struct fd *fd, *old_fd = pipe_end->fd;
+
+    if (unix_fd != -1) fd = create_anonymous_fd( &pipe_server_fd_ops, unix_fd, &pipe_end->obj, server->options );
+    else fd = alloc_pseudo_fd( &pipe_server_fd_ops, &pipe_end->obj, server->options );
+    if (!fd) return 0;
+
+    /* the client side may cache the Unix fd, but must not cache the pseudo fd
+     * of a listening pipe since it would never see the socket of the next connection */
+    if (unix_fd != -1) allow_fd_caching( fd );
+    set_fd_signaled( fd, 1 );
+    /* other processes may still have the old socket in their fd cache; make sure they can't
+     * use it to talk to the previous client, and that they notice they need to get a new fd */
+    if (pipe_end->is_socket) shutdown( get_unix_fd( old_fd ), SHUT_RDWR );
+    fd_copy_completion( old_fd, fd );
+    fd_async_wake_up( old_fd, ASYNC_TYPE_READ, STATUS_PIPE_BROKEN );
+    fd_async_wake_up( old_fd, ASYNC_TYPE_WRITE, STATUS_PIPE_BROKEN );
+    pipe_end->fd = fd;
+    pipe_end->is_socket = (unix_fd != -1);
+    release_object( old_fd );
+    return 1;
+}
+
 static void pipe_end_disconnect( struct pipe_end *pipe_end, unsigned int status )
 {
     struct pipe_end *connection = pipe_end->connection;
@@ -388,6 +440,11 @@ static void pipe_end_disconnect( struct pipe_end *pipe_end, unsigned int status
 
     pipe_end->state = status == STATUS_PIPE_DISCONNECTED
         ? FILE_PIPE_DISCONNECTED_STATE : FILE_PIPE_CLOSING_STATE;
+    if (pipe_end->flush_poll)
+    {
+        remove_timeout_user( pipe_end->flush_poll );
+        pipe_end->flush_poll = NULL;
+    }
     fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_WAIT, status );
     async_wake_up( &pipe_end->read_q, status );
     LIST_FOR_EACH_ENTRY_SAFE( message, next, &pipe_end->message_queue, struct pipe_message, entry )
@@ -398,6 +455,11 @@ static void pipe_end_disconnect( struct pipe_end *pipe_end, unsigned int status
         async_terminate( async, status );
         release_object( async );
     }
+    /* a disconnected server end goes back to server-side data transfers until
+     * the next connection, the client keeps its socket until it is closed */
+    if (status == STATUS_PIPE_DISCONNECTED && pipe_end->is_socket &&
+        pipe_end->obj.ops == &pipe_server_ops)
+        set_pipe_server_unix_fd( (struct pipe_server *)pipe_end, -1 );
     if (status == STATUS_PIPE_DISCONNECTED) set_fd_signaled( pipe_end->fd, 0 );
 
     if (connection)
@@ -491,7 +553,7 @@ static void named_pipe_device_destroy( struct object *obj )
 {
     struct named_pipe_device *device = (struct named_pipe_device*)obj;
     assert( obj->ops == &named_pipe_device_ops );
-    free( device->pipes );
+    free_namespace( device->pipes );
 }
 
 struct object *create_named_pipe_device( struct object *root, const struct unicode_str *name )
@@ -537,6 +599,28 @@ static void named_pipe_device_file_destroy( struct object *obj )
     release_object( file->device );
 }
 
+/* amount of data written to a socket pipe end that its connection hasn't read yet */
+static int get_socket_unread_size( struct pipe_end *pipe_end )
+{
+    int size = 0;
+
+    if (!pipe_end->connection) return 0;
+    if (ioctl( get_unix_fd( pipe_end->connection->fd ), FIONREAD, &size ) == -1) return 0;
+    return size;
+}
+
+/* there is no notification when the reader consumes socket data, so poll until it's gone */
+static void check_socket_flushed( void *private )
+{
+    struct pipe_end *pipe_end = private;
+
+    pipe_end->flush_poll = NULL;
+    if (get_socket_unread_size( pipe_end ))
+        pipe_end->flush_poll = add_timeout_user( PIPE_FLUSH_POLL_INTERVAL, check_socket_flushed, pipe_end );
+    else
+        fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_WAIT, STATUS_SUCCESS );
+}
+
 static int pipe_end_flush( struct fd *fd, struct async *async )
 {
     struct pipe_end *pipe_end = get_fd_user( fd );
@@ -547,6 +631,19 @@ static int pipe_end_flush( struct fd *fd, struct async *async )
         return 0;
     }
 
+    if (pipe_end->is_socket)
+    {
+        if (get_socket_unread_size( pipe_end ))
+        {
+            fd_queue_async( pipe_end->fd, async, ASYNC_TYPE_WAIT );
+            if (!pipe_end->flush_poll)
+                pipe_end->flush_poll = add_timeout_user( PIPE_FLUSH_POLL_INTERVAL,
+                                                         check_socket_flushed, pipe_end );
+            set_error( STATUS_PENDING );
+        }
+        return 1;
+    }
+
     if (pipe_end->connection && !list_empty( &pipe_end->connection->message_queue ))
     {
         fd_queue_async( pipe_end->fd, async, ASYNC_TYPE_WAIT );
@@ -899,12 +996,27 @@ static int pipe_end_write( struct fd *fd, struct async *async, file_pos_t pos )
     return 1;
 }
 
+static void pipe_end_queue_async( struct fd *fd, struct async *async, int type, int count )
+{
+    struct pipe_end *pipe_end = get_fd_user( fd );
+
+    /* only socket transfers are done directly by the client */
+    if (pipe_end->is_socket) default_fd_queue_async( fd, async, type, count );
+    else no_fd_queue_async( fd, async, type, count );
+}
+
 static void pipe_end_reselect_async( struct fd *fd, struct async_queue *queue )
 {
     struct pipe_end *pipe_end = get_fd_user( fd );
 
     if (ignore_reselect) return;
 
+    if (pipe_end->is_socket)
+    {
+        default_fd_reselect_async( fd, queue );
+        return;
+    }
+
     if (&pipe_end->write_q == queue)
         reselect_write_queue( pipe_end );
     else if (&pipe_end->read_q == queue)
@@ -923,6 +1035,7 @@ static int pipe_end_peek( struct pipe_end *pipe_end )
     struct pipe_message *message;
     data_size_t avail = 0;
     data_size_t message_length = 0;
+    int unix_fd = -1;
 
     if (reply_size < offsetof( FILE_PIPE_PEEK_BUFFER, Data ))
     {
@@ -931,12 +1044,25 @@ static int pipe_end_peek( struct pipe_end *pipe_end )
     }
     reply_size -= offsetof( FILE_PIPE_PEEK_BUFFER, Data );
 
+    if (pipe_end->is_socket)
+    {
+        int size = 0;
+
+        unix_fd = get_unix_fd( pipe_end->fd );
+        if (ioctl( unix_fd, FIONREAD, &size ) != -1 && size > 0) avail = size;
+    }
+    else
+    {
+        LIST_FOR_EACH_ENTRY( message, &pipe_end->message_queue, struct pipe_message, entry )
+            avail += message->iosb->in_size - message->read_pos;
+    }
+
     switch (pipe_end->state)
     {
     case FILE_PIPE_CONNECTED_STATE:
         break;
     case FILE_PIPE_CLOSING_STATE:
-        if (!list_empty( &pipe_end->message_queue )) break;
+        if (avail) break;
         set_error( STATUS_PIPE_BROKEN );
         return 0;
     default:
@@ -944,8 +1070,6 @@ static int pipe_end_peek( struct pipe_end *pipe_end )
         return 0;
     }
 
-    LIST_FOR_EACH_ENTRY( message, &pipe_end->message_queue, struct pipe_message, entry )
-        avail += message->iosb->in_size - message->read_pos;
     reply_size = min( reply_size, avail );
 
     if (avail && pipe_end->pipe->message_mode)
@@ -961,7 +1085,12 @@ static int pipe_end_peek( struct pipe_end *pipe_end )
     buffer->NumberOfMessages  = 0;  /* FIXME */
     buffer->MessageLength     = message_length;
 
-    if (reply_size)
+    if (reply_size && unix_fd != -1)
+    {
+        int ret = recv( unix_fd, buffer->Data, reply_size, MSG_PEEK | MSG_DONTWAIT );
+        if (ret < (int)reply_size) memset( buffer->Data + max( ret, 0 ), 0, reply_size - max( ret, 0 ));
+    }
+    else if (reply_size)
     {
         data_size_t write_pos = 0, writing;
         LIST_FOR_EACH_ENTRY( message, &pipe_end->message_queue, struct pipe_message, entry )
@@ -1142,6 +1271,8 @@ static void init_pipe_end( struct pipe_end *pipe_end, struct named_pipe *pipe,
     pipe_end->flags = pipe_flags;
     pipe_end->connection = NULL;
     pipe_end->buffer_size = buffer_size;
+    pipe_end->is_socket = 0;
+    pipe_end->flush_poll = NULL;
     init_async_queue( &pipe_end->read_q );
     init_async_queue( &pipe_end->write_q );
     list_init( &pipe_end->message_queue );
@@ -1168,24 +1299,34 @@ static struct pipe_server *create_pipe_server( struct named_pipe *pipe, unsigned
         release_object( server );
         return NULL;
     }
-    allow_fd_caching( server->pipe_end.fd );
+    /* the pseudo fd is replaced by a socket when connecting in socket mode */
+    if (pipe->message_mode || !pipe_sockets_enabled()) allow_fd_caching( server->pipe_end.fd );
     set_fd_signaled( server->pipe_end.fd, 1 );
     return server;
 }
 
-static struct pipe_end *create_pipe_client( struct named_pipe *pipe, data_size_t buffer_size, unsigned int options )
+static struct pipe_end *create_pipe_client( struct named_pipe *pipe, data_size_t buffer_size,
+                                            unsigned int options, int unix_fd )
 {
     struct pipe_end *client;
 
     client = alloc_object( &pipe_client_ops );
     if (!client)
+    {
+        if (unix_fd != -1) close( unix_fd );
         return NULL;
+    }
 
     init_pipe_end( client, pipe, 0, buffer_size );
     client->state = FILE_PIPE_CONNECTED_STATE;
     client->client_pid = get_process_id( current->process );
 
-    client->fd = alloc_pseudo_fd( &pipe_client_fd_ops, &client->obj, options );
+    if (unix_fd != -1)
+    {
+        client->fd = create_anonymous_fd( &pipe_client_fd_ops, unix_fd, &client->obj, options );
+        client->is_socket = 1;
+    }
+    else client->fd = alloc_pseudo_fd( &pipe_client_fd_ops, &client->obj, options );
     if (!client->fd)
     {
         release_object( client );
@@ -1239,6 +1380,7 @@ static struct object *named_pipe_open_file( struct object *obj, unsigned int acc
     struct pipe_server *server;
     struct pipe_end *client;
     unsigned int pipe_sharing;
+    int fds[2] = { -1, -1 };
 
     if (!(server = find_available_server( pipe )))
     {
@@ -1255,7 +1397,23 @@ static struct object *named_pipe_open_file( struct object *obj, unsigned int acc
         return NULL;
     }
 
-    if ((client = create_pipe_client( pipe, pipe->outsize, options )))
+    /* in socket mode the data of byte mode pipes is exchanged directly between the clients */
+    if (!pipe->message_mode && pipe_sockets_enabled())
+    {
+        if (!socketpair( PF_UNIX, SOCK_STREAM, 0, fds ))
+        {
+            fcntl( fds[0], F_SETFL, O_NONBLOCK );
+            fcntl( fds[1], F_SETFL, O_NONBLOCK );
+            if (!set_pipe_server_unix_fd( server, fds[0] ))
+            {
+                close( fds[1] );
+                fds[1] = -1;
+            }
+        }
+        else fds[1] = -1;
+    }
+
+    if ((client = create_pipe_client( pipe, pipe->outsize, options, fds[1] )))
     {
         async_wake_up( &server->listen_q, STATUS_SUCCESS );
         server->pipe_end.state = FILE_PIPE_CONNECTED_STATE;
@@ -1264,6 +1422,7 @@ static struct object *named_pipe_open_file( struct object *obj, unsigned int acc
         server->pipe_end.client_pid = client->client_pid;
         client->server_pid = server->pipe_end.server_pid;
     }
+    else if (server->pipe_end.is_socket) set_pipe_server_unix_fd( server, -1 );
     release_object( server );
     return &client->obj;
 }
@@ -45,10 +45,16 @@
 
 struct namespace
 {
+    struct list         entry;           /* entry in list of all namespaces */
     unsigned int        hash_size;       /* size of hash table */
-    struct list         names[1];        /* array of hash entry lists */
+    unsigned int        count;           /* number of names in the hash table */
+    struct list        *names;           /* array of hash entry lists */
 };
 
+#define NAMESPACE_MAX_LOAD 2  /* average chain length that triggers a rehash */
+
+static struct list namespace_list = LIST_INIT(namespace_list);
+
 
 #ifdef DEBUG_OBJECTS
 static struct list object_list = LIST_INIT(object_list);
@@ -127,19 +133,51 @@ void *memdup( const void *data, size_t len )
 
 /*****************************************************************/
 
-static int get_name_hash( const struct namespace *namespace, const WCHAR *name, data_size_t len )
+/* case-insensitive FNV-1a hash of an object name */
+static unsigned int get_name_hash( const struct namespace *namespace, const WCHAR *name, data_size_t len )
 {
-    WCHAR hash = 0;
+    unsigned int hash = 2166136261u;
     len /= sizeof(WCHAR);
-    while (len--) hash ^= tolowerW(*name++);
+    while (len--)
+    {
+        hash ^= tolowerW(*name++);
+        hash *= 16777619;
+    }
     return hash % namespace->hash_size;
 }
 
+/* grow the hash table once the chains get too long */
+static void grow_namespace( struct namespace *namespace )
+{
+    unsigned int i, old_size = namespace->hash_size, new_size;
+    struct list *new_names, *old_names = namespace->names;
+    struct object_name *ptr, *next;
+
+    new_size = old_size * 4 + 1;
+    if (!(new_names = malloc( new_size * sizeof(*new_names) ))) return;
+    for (i = 0; i < new_size; i++) list_init( &new_names[i] );
+
+    namespace->names = new_names;
+    namespace->hash_size = new_size;
+    for (i = 0; i < old_size; i++)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( ptr, next, &old_names[i], struct object_name, entry )
+        {
+            list_remove( &ptr->entry );
+            list_add_tail( &new_names[get_name_hash( namespace, ptr->name, ptr->len )], &ptr->entry );
+        }
+    }
+    free( old_names );
+}
+
 void namespace_add( struct namespace *namespace, struct object_name *ptr )
 {
-    int hash = get_name_hash( namespace, ptr->name, ptr->len );
+    unsigned int hash;
 
+    if (++namespace->count > namespace->hash_size * NAMESPACE_MAX_LOAD) grow_namespace( namespace );
+    hash = get_name_hash( namespace, ptr->name, ptr->len );
     list_add_head( &namespace->names[hash], &ptr->entry );
+    ptr->namespace = namespace;
 }
 
 /* allocate a name for an object */
@@ -151,6 +189,7 @@ static struct object_name *alloc_name( const struct unicode_str *name )
     {
         ptr->len = name->len;
         ptr->parent = NULL;
+        ptr->namespace = NULL;
         memcpy( ptr->name, name->str, name->len );
     }
     return ptr;
@@ -411,7 +450,9 @@ struct object *grab_object( void *ptr )
 {
     struct object *obj = (struct object *)ptr;
     assert( obj->refcount < INT_MAX );
-    obj->refcount++;
+    /* worker threads may grab objects concurrently, see init_worker_threads() */
+    if (worker_threads) interlocked_xchg_add( (int *)&obj->refcount, 1 );
+    else obj->refcount++;
     return obj;
 }
 
@@ -420,7 +461,7 @@ void release_object( void *ptr )
 {
     struct object *obj = (struct object *)ptr;
     assert( obj->refcount );
-    if (!--obj->refcount)
+    if (worker_threads ? interlocked_xchg_add( (int *)&obj->refcount, -1 ) == 1 : !--obj->refcount)
     {
         assert( !obj->handle_count );
         /* if the refcount is 0, nobody can be in the wait queue */
@@ -483,15 +524,57 @@ struct namespace *create_namespace( unsigned int hash_size )
     struct namespace *namespace;
     unsigned int i;
 
-    namespace = mem_alloc( sizeof(*namespace) + (hash_size - 1) * sizeof(namespace->names[0]) );
-    if (namespace)
+    if (!(namespace = mem_alloc( sizeof(*namespace) ))) return NULL;
+    if (!(namespace->names = mem_alloc( hash_size * sizeof(namespace->names[0]) )))
     {
-        namespace->hash_size      = hash_size;
-        for (i = 0; i < hash_size; i++) list_init( &namespace->names[i] );
+        free( namespace );
+        return NULL;
     }
+    namespace->hash_size      = hash_size;
+    namespace->count          = 0;
+    for (i = 0; i < hash_size; i++) list_init( &namespace->names[i] );
+    list_add_tail( &namespace_list, &namespace->entry );
     return namespace;
 }
 
+/* free a namespace; it must not contain any names */
+void free_namespace( struct namespace *namespace )
+{
+    if (!namespace) return;
+    list_remove( &namespace->entry );
+    free( namespace->names );
+    free( namespace );
+}
+
+/* dump the chain length statistics of all namespaces */
+void dump_namespaces(void)
+{
+    static const unsigned int limits[] = { 0, 1, 2, 4, 8, 16 };
+    unsigned int histogram[ARRAY_SIZE(limits) + 1] = { 0 };
+    unsigned int i, j, len, nb_namespaces = 0, nb_buckets = 0, nb_names = 0, max_len = 0;
+    const struct namespace *namespace;
+
+    LIST_FOR_EACH_ENTRY( namespace, &namespace_list, const struct namespace, entry )
+    {
+        nb_namespaces++;
+        nb_buckets += namespace->hash_size;
+        for (i = 0; i < namespace->hash_size; i++)
+        {
+            len = list_count( &namespace->names[i] );
+            nb_names += len;
+            max_len = max( max_len, len );
+            for (j = 0; j < ARRAY_SIZE(limits) && len > limits[j]; j++) ;
+            histogram[j]++;
+        }
+    }
+    fprintf( stderr, "wineserver: %u namespaces, %u names in %u buckets, longest chain %u\n",
+             nb_namespaces, nb_names, nb_buckets, max_len );
+    fprintf( stderr, "wineserver: chain lengths:" );
+    for (j = 0; j < ARRAY_SIZE(limits); j++)
+        fprintf( stderr, " <=%u:%u", limits[j], histogram[j] );
+    fprintf( stderr, " >%u:%u\n", limits[j - 1], histogram[j] );
+}
+
 /* functions for unimplemented/default object operations */
 
 struct object_type *no_get_type( struct object *obj )
@@ -683,6 +766,7 @@ int no_link_name( struct object *obj, struct object_name *name, struct object *p
 void default_unlink_name( struct object *obj, struct object_name *name )
 {
     list_remove( &name->entry );
+    if (name->namespace) name->namespace->count--;
 }
 
 struct object *no_open_file( struct object *obj, unsigned int access, unsigned int sharing,
@@ -28,6 +28,10 @@
 #ifdef HAVE_POLL_H
 # include <poll.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#include <unistd.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -140,6 +144,7 @@ struct msg_queue
     struct thread_input   *input;           /* thread input descriptor */
     struct hook_table     *hooks;           /* hook table */
     timeout_t              last_get_msg;    /* time of last get message call */
+    unsigned int           shm_slot;        /* slot of the queue state in the shared region */
 };
 
 struct hotkey
@@ -268,6 +273,97 @@ static struct thread_input *create_thread_input( struct thread *thread )
     return input;
 }
 
+/*
+ * When WINESHAREDQUEUE is set in the environment, the wake and changed bits
+ * of each queue are mirrored in a slot of a shared memory region that clients
+ * map read-only, so that they can find out that a queue is empty without a
+ * server round trip.
+ */
+
+#define QUEUE_SHM_REGION_SIZE  (QUEUE_SHM_MAX_SLOTS * sizeof(struct queue_shm_slot))
+
+static int queue_shm_enabled = -1;            /* is the shared queue state enabled? */
+static struct queue_shm_slot *queue_shm_slots; /* server view of the shared region */
+static struct file *queue_shm_file;           /* file object backing the region */
+static unsigned int *queue_shm_free;          /* stack of free slot indices */
+static unsigned int queue_shm_nb_free;        /* number of entries in queue_shm_free */
+static unsigned int queue_shm_next;           /* first never allocated slot */
+
+/* create the shared region on first use */
+static int init_queue_shm(void)
+{
+#ifdef HAVE_SYS_MMAN_H
+    int fd;
+    void *ptr;
+
+    if (queue_shm_enabled != -1) return queue_shm_enabled;
+
+    queue_shm_enabled = 0;
+    if (!getenv( "WINESHAREDQUEUE" ) || !atoi( getenv( "WINESHAREDQUEUE" ))) return 0;
+
+    if ((fd = create_temp_file( QUEUE_SHM_REGION_SIZE )) == -1) return 0;
+    ptr = mmap( NULL, QUEUE_SHM_REGION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if (ptr == MAP_FAILED)
+    {
+        close( fd );
+        return 0;
+    }
+    if (!(queue_shm_file = create_file_for_fd( fd, FILE_GENERIC_READ, 0 )))
+    {
+        munmap( ptr, QUEUE_SHM_REGION_SIZE );
+        return 0;
+    }
+    make_object_static( (struct object *)queue_shm_file );
+    queue_shm_slots = ptr;
+    queue_shm_enabled = 1;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/* allocate a shared slot for a new queue, return QUEUE_SHM_NO_SLOT if not possible */
+static unsigned int alloc_queue_shm_slot(void)
+{
+    unsigned int index;
+
+    if (!init_queue_shm()) return QUEUE_SHM_NO_SLOT;
+
+    if (queue_shm_nb_free) index = queue_shm_free[--queue_shm_nb_free];
+    else if (queue_shm_next < QUEUE_SHM_MAX_SLOTS) index = queue_shm_next++;
+    else return QUEUE_SHM_NO_SLOT;
+
+    queue_shm_slots[index].wake_bits = 0;
+    queue_shm_slots[index].changed_bits = 0;
+    return index;
+}
+
+/* release the shared slot of a destroyed queue */
+static void free_queue_shm_slot( unsigned int index )
+{
+    static unsigned int free_size;
+
+    if (index == QUEUE_SHM_NO_SLOT) return;
+
+    if (queue_shm_nb_free == free_size)
+    {
+        unsigned int new_size = max( free_size * 2, 256 );
+        unsigned int *new_free = realloc( queue_shm_free, new_size * sizeof(*queue_shm_free) );
+        if (!new_free) return;  /* leak the slot */
+        queue_shm_free = new_free;
+        free_size = new_size;
+    }
+    queue_shm_free[queue_shm_nb_free++] = index;
+}
+
+/* publish the queue bits to the shared slot */
+static inline void update_queue_shm( struct msg_queue *queue )
+{
+    if (queue->shm_slot == QUEUE_SHM_NO_SLOT) return;
+    queue_shm_slots[queue->shm_slot].wake_bits = queue->wake_bits;
+    queue_shm_slots[queue->shm_slot].changed_bits = queue->changed_bits;
+}
+
 /* create a message queue object */
 static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_input *input )
 {
@@ -298,6 +394,7 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         queue->input           = (struct thread_input *)grab_object( input );
         queue->hooks           = NULL;
         queue->last_get_msg    = current_time;
+        queue->shm_slot        = alloc_queue_shm_slot();
         list_init( &queue->send_result );
         list_init( &queue->callback_result );
         list_init( &queue->pending_timers );
@@ -451,6 +548,7 @@ static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
 {
     queue->wake_bits |= bits;
     queue->changed_bits |= bits;
+    update_queue_shm( queue );
     if (is_signaled( queue )) wake_up( &queue->obj, 0 );
 }
 
@@ -459,6 +557,7 @@ static inline void clear_queue_bits( struct msg_queue *queue, unsigned int bits
 {
     queue->wake_bits &= ~bits;
     queue->changed_bits &= ~bits;
+    update_queue_shm( queue );
 }
 
 /* check whether msg is a keyboard message */
@@ -1006,6 +1105,7 @@ static void msg_queue_destroy( struct object *obj )
     release_object( queue->input );
     if (queue->hooks) release_object( queue->hooks );
     if (queue->fd) release_object( queue->fd );
+    free_queue_shm_slot( queue->shm_slot );
 }
 
 static void msg_queue_poll_event( struct fd *fd, int event )
@@ -2177,7 +2277,25 @@ DECL_HANDLER(get_msg_queue)
     struct msg_queue *queue = get_current_queue();
 
     reply->handle = 0;
-    if (queue) reply->handle = alloc_handle( current->process, queue, SYNCHRONIZE, 0 );
+    reply->shm_slot = QUEUE_SHM_NO_SLOT;
+    if (queue)
+    {
+        reply->handle = alloc_handle( current->process, queue, SYNCHRONIZE, 0 );
+        reply->shm_slot = queue->shm_slot;
+    }
+}
+
+
+/* retrieve a handle to the shared message queues region */
+DECL_HANDLER(get_queue_shm_region)
+{
+    if (!init_queue_shm())
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    reply->handle = alloc_handle( current->process, queue_shm_file, FILE_READ_DATA, 0 );
+    reply->size = QUEUE_SHM_REGION_SIZE;
 }
 
 
@@ -2236,6 +2354,7 @@ DECL_HANDLER(get_queue_status)
         reply->wake_bits    = queue->wake_bits;
         reply->changed_bits = queue->changed_bits;
         queue->changed_bits &= ~req->clear_bits;
+        update_queue_shm( queue );
     }
     else reply->wake_bits = reply->changed_bits = 0;
 }
@@ -2412,6 +2531,7 @@ DECL_HANDLER(get_message)
     }
     if (filter & QS_INPUT) queue->changed_bits &= ~QS_INPUT;
     if (filter & QS_PAINT) queue->changed_bits &= ~QS_PAINT;
+    update_queue_shm( queue );
 
     /* then check for posted messages */
     if ((filter & QS_POSTMESSAGE) &&
@@ -30,11 +30,18 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -118,6 +125,7 @@ static const WCHAR symlink_value[] = {'S','y','m','b','o','l','i','c','L','i','n
 static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_value) };
 
 static void set_periodic_save_timer(void);
+static void make_dirty( struct key *key );
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
 
 /* information about where to save a registry branch */
@@ -125,8 +133,18 @@ struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    char        *journal_path;     /* journal of the changes since the last full save */
+    char        *old_journal_path; /* journal being merged by a compaction */
+    FILE        *journal;          /* journal file, NULL if changes can't be journaled */
+    int          full_save;        /* the next save needs to rewrite the whole branch */
+    pid_t        compact_pid;      /* compaction process, if any */
 };
 
+#define JOURNAL_MIN_COMPACT_SIZE (1024 * 1024)  /* minimum journal size before compaction */
+static const char journal_header[] = "WINE REGISTRY Version 2\n";
+static const char journal_commit[] = ";commit\n";
+static int journal_disabled;  /* don't journal changes while replaying a journal */
+
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
@@ -142,6 +160,7 @@ struct file_load_info
     int         line;     /* current input line */
     WCHAR      *tmp;      /* temp buffer to use while parsing input */
     size_t      tmplen;   /* length of temp buffer */
+    int         journal;  /* is this a journal file? */
 };
 
 
@@ -255,6 +274,20 @@ static void dump_value( const struct key_value *value, FILE *f )
     fputc( '\n', f );
 }
 
+/* dump the name line of a key to a text file */
+static void dump_key_name( const struct key *key, const struct key *base, FILE *f )
+{
+    fprintf( f, "\n[" );
+    if (key != base) dump_path( key, base, f );
+    fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
+}
+
+/* dump the modification time of a key to a text file */
+static void dump_key_time( const struct key *key, FILE *f )
+{
+    fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
+}
+
 /* save a registry and all its subkeys to a text file */
 static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
 {
@@ -265,10 +298,8 @@ static void save_subkeys( const struct key *key, const struct key *base, FILE *f
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
     {
-        fprintf( f, "\n[" );
-        if (key != base) dump_path( key, base, f );
-        fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
-        fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
+        dump_key_name( key, base, f );
+        dump_key_time( key, f );
         if (key->class)
         {
             fprintf( f, "#class=\"" );
@@ -294,6 +325,105 @@ static void dump_operation( const struct key *key, const struct key_value *value
     else fprintf( stderr, "\n" );
 }
 
+/*
+ * Changes to the saved branches are appended to a journal file in the same
+ * text format, so that periodic saves only need to flush the journal. Value
+ * and key deletions are recorded as '"name"=-' and '#delete' lines, and the
+ * records are only valid up to the last ';commit' line. Once the journal gets
+ * too large, the whole branch is saved by a child process and the journal is
+ * discarded.
+ */
+
+/* return the save branch containing a key */
+static struct save_branch_info *get_save_branch( const struct key *key )
+{
+    int i;
+
+    for ( ; key; key = key->parent)
+        for (i = 0; i < save_branch_count; i++)
+            if (save_branch_info[i].key == key) return &save_branch_info[i];
+    return NULL;
+}
+
+/* start a journal record for a key; return the journal file or NULL if no journaling is needed */
+static FILE *start_journal_record( const struct key *key )
+{
+    struct save_branch_info *info;
+
+    if (journal_disabled || (key->flags & KEY_VOLATILE)) return NULL;
+    if (!(info = get_save_branch( key )) || !info->journal || info->full_save) return NULL;
+    dump_key_name( key, info->key, info->journal );
+    return info->journal;
+}
+
+/* record the modification time of a key in the journal */
+static void journal_key_time( const struct key *key )
+{
+    FILE *f;
+
+    if ((f = start_journal_record( key ))) dump_key_time( key, f );
+}
+
+/* record the creation of a key in the journal */
+static void journal_create_key( const struct key *key )
+{
+    FILE *f;
+
+    if (!(f = start_journal_record( key ))) return;
+    if (key->class)
+    {
+        fprintf( f, "#class=\"" );
+        dump_strW( key->class, key->classlen / sizeof(WCHAR), f, "\"\"" );
+        fprintf( f, "\"\n" );
+    }
+    if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
+    dump_key_time( key, f );
+}
+
+/* record the deletion of a key in the journal */
+static void journal_delete_key( const struct key *key )
+{
+    FILE *f;
+
+    if ((f = start_journal_record( key ))) fputs( "#delete\n", f );
+}
+
+/* record the modification of a value in the journal */
+static void journal_set_value( const struct key *key, const struct key_value *value )
+{
+    FILE *f;
+
+    if (!(f = start_journal_record( key ))) return;
+    dump_value( value, f );
+    dump_key_time( key, f );
+}
+
+/* record the deletion of a value in the journal; the key time is updated right after */
+static void journal_delete_value( const struct key *key, const struct key_value *value )
+{
+    FILE *f;
+
+    if (!(f = start_journal_record( key ))) return;
+    if (value->namelen)
+    {
+        fputc( '\"', f );
+        dump_strW( value->name, value->namelen / sizeof(WCHAR), f, "\"\"" );
+        fprintf( f, "\"=-\n" );
+    }
+    else fprintf( f, "@=-\n" );
+    fprintf( f, "#time=%x%08x\n", (unsigned int)(current_time >> 32), (unsigned int)current_time );
+}
+
+/* changes to a branch can't be journaled, it will be saved entirely */
+static void journal_full_save( struct key *key )
+{
+    struct save_branch_info *info;
+
+    if ((key->flags & KEY_VOLATILE) || !(info = get_save_branch( key ))) return;
+    info->full_save = 1;
+    make_dirty( info->key );
+}
+
 static void key_dump( struct object *obj, int verbose )
 {
     struct key *key = (struct key *)obj;
@@ -829,6 +959,8 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
         if (!(key->class = memdup( class->str, key->classlen ))) key->classlen = 0;
     }
     touch_key( key->parent, REG_NOTIFY_CHANGE_NAME );
+    journal_create_key( key );
+    journal_key_time( key->parent );
     grab_object( key );
     return key;
 }
@@ -1012,8 +1144,10 @@ static int delete_key( struct key *key, int recurse )
     }
 
     if (debug_level > 1) dump_operation( key, NULL, "Delete" );
+    journal_delete_key( key );
     free_subkey( parent, index );
     touch_key( parent, REG_NOTIFY_CHANGE_NAME );
+    journal_key_time( parent );
     return 0;
 }
 
@@ -1139,6 +1273,7 @@ static void set_value( struct key *key, const struct unicode_str *name,
     value->len   = len;
     value->data  = ptr;
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
+    journal_set_value( key, value );
     if (debug_level > 1) dump_operation( key, value, "Set" );
 }
 
@@ -1225,6 +1360,7 @@ static void delete_value( struct key *key, const struct unicode_str *name )
         return;
     }
     if (debug_level > 1) dump_operation( key, value, "Delete" );
+    journal_delete_value( key, value );
     free( value->name );
     free( value->data );
     for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
@@ -1451,7 +1587,8 @@ static int load_key_option( struct key *key, const char *buffer, struct file_loa
             else if (*p >= 'a' && *p <= 'f') modif = (modif << 4) | (*p - 'a' + 10);
             else break;
         }
-        update_key_time( key, modif );
+        if (info->journal) key->modif = modif;
+        else update_key_time( key, modif );
     }
     if (!strncmp( buffer, "#class=", 7 ))
     {
@@ -1465,6 +1602,7 @@ static int load_key_option( struct key *key, const char *buffer, struct file_loa
         key->classlen = len;
     }
     if (!strncmp( buffer, "#link", 5 )) key->flags |= KEY_SYMLINK;
+    if (info->journal && !strncmp( buffer, "#delete", 7 ) && key->parent) delete_key( key, 1 );
     /* ignore unknown options */
     return 1;
 }
@@ -1536,6 +1674,15 @@ static int load_value( struct key *key, const char *buffer, struct file_load_inf
     struct key_value *value;
 
     if (!(value = parse_value_name( key, buffer, &len, info ))) return 0;
+    if (info->journal && buffer[len] == '-')
+    {
+        struct unicode_str name;
+
+        name.str = value->name;
+        name.len = value->namelen;
+        delete_value( key, &name );
+        return 1;
+    }
     if (!(res = get_data_type( buffer + len, &type, &parse_type ))) goto error;
     buffer += len + res;
 
@@ -1623,7 +1770,7 @@ static int get_prefix_len( struct key *key, const char *name, struct file_load_i
 
 /* load all the keys from the input file */
 /* prefix_len is the number of key name prefixes to skip, or -1 for autodetection */
-static void load_keys( struct key *key, const char *filename, FILE *f, int prefix_len )
+static void load_keys( struct key *key, const char *filename, FILE *f, int prefix_len, int journal )
 {
     struct key *subkey = NULL;
     struct file_load_info info;
@@ -1635,6 +1782,7 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
     info.len    = 4;
     info.tmplen = 4;
     info.line   = 0;
+    info.journal = journal;
     if (!(info.buffer = mem_alloc( info.len ))) return;
     if (!(info.tmp = mem_alloc( info.tmplen )))
     {
@@ -1693,6 +1841,291 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
     free( info.tmp );
 }
 
+/* binary cache of the initial registry files
+ *
+ * Parsing the text files is the most expensive part of the server startup, so
+ * every time a branch is loaded or saved, a snapshot of the key tree is also
+ * written to a "<file>.cache" file that can be mapped and loaded in one pass.
+ * The text file remains the reference: the cache is only used if the size,
+ * inode and modification time recorded in its header match the text file. */
+
+#define REG_CACHE_MAGIC   0x43474552  /* "REGC" */
+#define REG_CACHE_VERSION 1
+#define REG_CACHE_MAX_DEPTH 512
+
+struct reg_cache_header
+{
+    unsigned int  magic;        /* REG_CACHE_MAGIC */
+    unsigned int  version;      /* REG_CACHE_VERSION */
+    unsigned int  prefix_type;  /* prefix type at the time the cache was written */
+    unsigned int  reserved;
+    file_pos_t    file_size;    /* size of the text file */
+    file_pos_t    file_ino;     /* inode of the text file */
+    timeout_t     file_mtime;   /* modification time of the text file */
+};
+
+/* followed by the name and the class, then the values and the subkeys */
+struct reg_cache_key
+{
+    timeout_t     modif;        /* last modification time */
+    unsigned int  namelen;      /* length of key name */
+    unsigned int  classlen;     /* length of class name */
+    unsigned int  flags;        /* KEY_SYMLINK */
+    unsigned int  nb_values;    /* number of values */
+    unsigned int  nb_subkeys;   /* number of non-volatile subkeys */
+    unsigned int  reserved;
+};
+
+/* followed by the name and the data */
+struct reg_cache_value
+{
+    unsigned int  namelen;      /* length of value name */
+    unsigned int  type;         /* value type */
+    unsigned int  len;          /* value data length in bytes */
+    unsigned int  reserved;
+};
+
+struct reg_cache_reader
+{
+    const char   *ptr;          /* current position in the mapping */
+    const char   *end;          /* end of the mapping */
+};
+
+/* fill the cache header from the status of the text file */
+static void get_reg_cache_header( struct reg_cache_header *header, const struct stat *st )
+{
+    memset( header, 0, sizeof(*header) );
+    header->magic       = REG_CACHE_MAGIC;
+    header->version     = REG_CACHE_VERSION;
+    header->prefix_type = prefix_type;
+    header->file_size   = st->st_size;
+    header->file_ino    = st->st_ino;
+    header->file_mtime  = (timeout_t)st->st_mtime * TICKS_PER_SEC;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    header->file_mtime += st->st_mtim.tv_nsec / 100;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    header->file_mtime += st->st_mtimespec.tv_nsec / 100;
+#endif
+}
+
+/* build the name of the cache file of a registry file */
+static char *get_reg_cache_path( const char *path, const char *ext )
+{
+    char *ret = malloc( strlen( path ) + strlen( ext ) + 1 );
+
+    if (ret) sprintf( ret, "%s%s", path, ext );
+    return ret;
+}
+
+/* write a block of data to the cache, padded to 8 bytes */
+static void write_reg_cache_data( const void *data, size_t len, FILE *f )
+{
+    static const char padding[8];
+
+    fwrite( data, 1, len, f );
+    fwrite( padding, 1, -len & 7, f );
+}
+
+/* write a key and its non-volatile subkeys to the cache */
+static void save_reg_cache_key( const struct key *key, FILE *f )
+{
+    struct reg_cache_key rec;
+    struct reg_cache_value val;
+    int i;
+
+    memset( &rec, 0, sizeof(rec) );
+    rec.modif     = key->modif;
+    rec.namelen   = key->namelen;
+    rec.classlen  = key->classlen;
+    rec.flags     = key->flags & KEY_SYMLINK;
+    rec.nb_values = key->last_value + 1;
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) rec.nb_subkeys++;
+
+    write_reg_cache_data( &rec, sizeof(rec), f );
+    write_reg_cache_data( key->name, key->namelen, f );
+    write_reg_cache_data( key->class, key->classlen, f );
+
+    for (i = 0; i <= key->last_value; i++)
+    {
+        memset( &val, 0, sizeof(val) );
+        val.namelen = key->values[i].namelen;
+        val.type    = key->values[i].type;
+        val.len     = key->values[i].len;
+        write_reg_cache_data( &val, sizeof(val), f );
+        write_reg_cache_data( key->values[i].name, val.namelen, f );
+        write_reg_cache_data( key->values[i].data, val.len, f );
+    }
+
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) save_reg_cache_key( key->subkeys[i], f );
+}
+
+/* write the cache of a registry file that has just been loaded or saved */
+static void save_reg_cache( struct key *key, const char *path )
+{
+    struct reg_cache_header header;
+    struct stat st;
+    char *cache, *tmp;
+    int fd, ret = 0;
+    FILE *f;
+
+    if (stat( path, &st ) == -1) return;
+    if (!(cache = get_reg_cache_path( path, ".cache" ))) return;
+    if (!(tmp = malloc( strlen( cache ) + 20 )))
+    {
+        free( cache );
+        return;
+    }
+    sprintf( tmp, "%s.%lx.tmp", cache, (long)getpid() );
+
+    if ((fd = open( tmp, O_CREAT | O_TRUNC | O_WRONLY, 0666 )) != -1)
+    {
+        if ((f = fdopen( fd, "w" )))
+        {
+            get_reg_cache_header( &header, &st );
+            fwrite( &header, sizeof(header), 1, f );
+            save_reg_cache_key( key, f );
+            ret = !ferror( f );
+            if (fclose( f )) ret = 0;
+        }
+        else close( fd );
+        if (ret) ret = !rename( tmp, cache );
+        if (!ret) unlink( tmp );
+    }
+    if (!ret) unlink( cache );  /* don't leave a stale cache behind */
+    free( tmp );
+    free( cache );
+}
+
+/* get a block of data from the cache mapping */
+static const void *read_reg_cache_data( struct reg_cache_reader *reader, size_t len )
+{
+    const char *ret = reader->ptr;
+
+    len = (len + 7) & ~7;
+    if (len > reader->end - reader->ptr) return NULL;
+    reader->ptr += len;
+    return ret;
+}
+
+/* load a key from the cache, either into key or as a new subkey of parent;
+ * if both are NULL, the data is only validated */
+static int load_reg_cache_key( struct reg_cache_reader *reader, struct key *parent, struct key *key,
+                               unsigned int depth )
+{
+    const struct reg_cache_key *rec;
+    const struct reg_cache_value *val;
+    struct key_value *value;
+    struct unicode_str name;
+    const void *class, *data;
+    unsigned int i;
+    int index;
+
+    if (depth > REG_CACHE_MAX_DEPTH) return 0;
+    if (!(rec = read_reg_cache_data( reader, sizeof(*rec) ))) return 0;
+    if (rec->namelen > MAX_NAME_LEN * sizeof(WCHAR) || (rec->namelen & 1)) return 0;
+    if (rec->classlen > 0xfffe || (rec->classlen & 1)) return 0;
+    if (!(name.str = read_reg_cache_data( reader, rec->namelen ))) return 0;
+    if (!(class = read_reg_cache_data( reader, rec->classlen ))) return 0;
+    name.len = rec->namelen;
+
+    if (parent)
+    {
+        if (!(key = find_subkey( parent, &name, &index )) &&
+            !(key = alloc_subkey( parent, &name, index, rec->modif ))) return 0;
+        key->modif = rec->modif;
+    }
+    if (key)
+    {
+        if (rec->classlen)
+        {
+            void *new_class = memdup( class, rec->classlen );
+            if (!new_class) return 0;
+            free( key->class );
+            key->class = new_class;
+            key->classlen = rec->classlen;
+        }
+        key->flags |= rec->flags & KEY_SYMLINK;
+    }
+
+    for (i = 0; i < rec->nb_values; i++)
+    {
+        if (!(val = read_reg_cache_data( reader, sizeof(*val) ))) return 0;
+        if (val->namelen > MAX_VALUE_LEN * sizeof(WCHAR) || (val->namelen & 1)) return 0;
+        if (!(name.str = read_reg_cache_data( reader, val->namelen ))) return 0;
+        if (!(data = read_reg_cache_data( reader, val->len ))) return 0;
+        name.len = val->namelen;
+        if (!key) continue;
+
+        if (!(value = find_value( key, &name, &index )) &&
+            !(value = insert_value( key, &name, index ))) return 0;
+        free( value->data );
+        value->data = NULL;
+        value->len  = 0;
+        value->type = val->type;
+        if (val->len)
+        {
+            if (!(value->data = memdup( data, val->len ))) return 0;
+            value->len = val->len;
+        }
+    }
+
+    for (i = 0; i < rec->nb_subkeys; i++)
+        if (!load_reg_cache_key( reader, key, NULL, depth + 1 )) return 0;
+    return 1;
+}
+
+/* load a registry file from its cache if it is still valid; return 1 on success */
+static int load_reg_cache( struct key *key, const char *path )
+{
+#ifdef HAVE_SYS_MMAN_H
+    struct reg_cache_header header;
+    struct reg_cache_reader reader;
+    struct stat st, cache_st;
+    char *cache;
+    void *ptr;
+    int fd, ret = 0;
+
+    if (stat( path, &st ) == -1) return 0;
+    if (!(cache = get_reg_cache_path( path, ".cache" ))) return 0;
+    fd = open( cache, O_RDONLY );
+    free( cache );
+    if (fd == -1) return 0;
+
+    if (fstat( fd, &cache_st ) == -1 || cache_st.st_size < sizeof(header) ||
+        (ptr = mmap( NULL, cache_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 )) == MAP_FAILED)
+    {
+        close( fd );
+        return 0;
+    }
+    close( fd );
+
+    get_reg_cache_header( &header, &st );
+    header.prefix_type = ((const struct reg_cache_header *)ptr)->prefix_type;
+    if (memcmp( ptr, &header, sizeof(header) )) goto done;
+    if (header.prefix_type != PREFIX_UNKNOWN && prefix_type != PREFIX_UNKNOWN &&
+        header.prefix_type != prefix_type) goto done;  /* let the text parser report the error */
+
+    /* validate everything first so that a corrupted cache doesn't leave a partial tree behind */
+    reader.ptr = (const char *)ptr + sizeof(header);
+    reader.end = (const char *)ptr + cache_st.st_size;
+    if (!load_reg_cache_key( &reader, NULL, NULL, 0 ) || reader.ptr != reader.end) goto done;
+
+    reader.ptr = (const char *)ptr + sizeof(header);
+    if (!(ret = load_reg_cache_key( &reader, NULL, key, 0 )))
+        fprintf( stderr, "wineserver: failed to load registry cache for %s\n", path );
+    else if (header.prefix_type != PREFIX_UNKNOWN)
+        prefix_type = header.prefix_type;
+
+done:
+    munmap( ptr, cache_st.st_size );
+    return ret;
+#else
+    return 0;
+#endif
+}
+
 /* load a part of the registry from a file */
 static void load_registry( struct key *key, obj_handle_t handle )
 {
@@ -1707,35 +2140,103 @@ static void load_registry( struct key *key, obj_handle_t handle )
         FILE *f = fdopen( fd, "r" );
         if (f)
         {
-            load_keys( key, NULL, f, -1 );
+            load_keys( key, NULL, f, -1, 0 );
             fclose( f );
         }
         else file_set_error();
     }
 }
 
+/* replay the committed part of a journal file */
+static void replay_journal( struct key *key, const char *path )
+{
+    char buffer[1024];
+    file_pos_t pos = 0, commit_pos = 0;
+    int line_start = 1;
+    size_t len;
+    FILE *f;
+
+    if (!(f = fopen( path, "r+" ))) return;
+
+    while (fgets( buffer, sizeof(buffer), f ))
+    {
+        len = strlen( buffer );
+        pos += len;
+        if (line_start && !strcmp( buffer, journal_commit )) commit_pos = pos;
+        line_start = (len && buffer[len - 1] == '\n');
+    }
+    /* the records following the last commit may be incomplete */
+    if (commit_pos < pos && ftruncate( fileno(f), commit_pos ) == -1)
+        fprintf( stderr, "wineserver: could not truncate registry journal %s: %s\n", path, strerror( errno ));
+    if (commit_pos)
+    {
+        rewind( f );
+        journal_disabled = 1;
+        load_keys( key, path, f, 0, 1 );
+        journal_disabled = 0;
+        clear_error();
+    }
+    fclose( f );
+}
+
+/* open the journal of a branch for appending */
+static void open_journal( struct save_branch_info *info, const char *mode )
+{
+    struct stat st;
+
+    if ((info->journal = fopen( info->journal_path, mode )) &&
+        !fstat( fileno(info->journal), &st ) && !st.st_size)
+        fputs( journal_header, info->journal );
+    if (!info->journal) journal_full_save( info->key );
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
+    struct save_branch_info *info;
+    size_t len = strlen( filename ) + sizeof(".journal.old");
+    int found = 1;
     FILE *f;
 
-    if ((f = fopen( filename, "r" )))
+    if (!load_reg_cache( key, filename ))
     {
-        load_keys( key, filename, f, 0 );
-        fclose( f );
-        if (get_error() == STATUS_NOT_REGISTRY_FILE)
+        if ((f = fopen( filename, "r" )))
         {
-            fprintf( stderr, "%s is not a valid registry file\n", filename );
-            return 1;
+            load_keys( key, filename, f, 0, 0 );
+            fclose( f );
+            if (get_error() == STATUS_NOT_REGISTRY_FILE)
+            {
+                fprintf( stderr, "%s is not a valid registry file\n", filename );
+                return 1;
+            }
+            save_reg_cache( key, filename );
         }
+        else found = 0;
     }
 
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
 
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
+    info = &save_branch_info[save_branch_count++];
+    info->path = filename;
+    info->key = (struct key *)grab_object( key );
+    info->journal = NULL;
+    info->full_save = 0;
+    info->compact_pid = 0;
     make_object_static( &key->obj );
-    return (f != NULL);
+
+    /* apply the changes that were not saved in the file yet */
+    info->journal_path = malloc( len );
+    info->old_journal_path = malloc( len );
+    if (info->journal_path && info->old_journal_path)
+    {
+        sprintf( info->journal_path, "%s.journal", filename );
+        sprintf( info->old_journal_path, "%s.journal.old", filename );
+        replay_journal( key, info->old_journal_path );
+        replay_journal( key, info->journal_path );
+        open_journal( info, "a" );
+    }
+    else journal_full_save( key );
+    return found;
 }
 
 static WCHAR *format_user_registry_path( const SID *sid, struct unicode_str *path )
@@ -1924,20 +2425,14 @@ static void save_registry( struct key *key, obj_handle_t handle )
     }
 }
 
-/* save a registry branch to a file */
-static int save_branch( struct key *key, const char *path )
+/* write a registry branch to a file */
+static int write_branch( struct key *key, const char *path )
 {
     struct stat st;
     char *p, *tmp = NULL;
     int fd, count = 0, ret = 0;
     FILE *f;
 
-    if (!(key->flags & KEY_DIRTY))
-    {
-        if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
-        return 1;
-    }
-
     /* test the file type */
 
     if ((fd = open( path, O_WRONLY )) != -1)
@@ -1991,13 +2486,149 @@ static int save_branch( struct key *key, const char *path )
         if (ret) ret = !rename( tmp, path );
         if (!ret) unlink( tmp );
     }
+    if (ret) save_reg_cache( key, path );
 
 done:
     free( tmp );
-    if (ret) make_clean( key );
     return ret;
 }
 
+/* return the size of the journal of a branch */
+static off_t get_journal_size( struct save_branch_info *info )
+{
+    struct stat st;
+
+    if (fflush( info->journal ) || fstat( fileno(info->journal), &st ) == -1) return -1;
+    return st.st_size;
+}
+
+/* wait for the compaction process of a branch to terminate */
+static void wait_compaction( struct save_branch_info *info )
+{
+    if (!info->compact_pid) return;
+    /* it may already have been reaped by the SIGCHLD handler */
+    while (waitpid( info->compact_pid, NULL, 0 ) == -1 && errno == EINTR);
+    info->compact_pid = 0;
+}
+
+/* save a registry branch to a file, and discard its journal */
+static int save_branch( struct save_branch_info *info )
+{
+    struct key *key = info->key;
+
+    if (!(key->flags & KEY_DIRTY))
+    {
+        if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
+        return 1;
+    }
+
+    /* a running compaction could overwrite the file with an older version */
+    wait_compaction( info );
+    if (!write_branch( key, info->path )) return 0;
+
+    make_clean( key );
+    info->full_save = 0;
+    if (info->journal)
+    {
+        fclose( info->journal );
+        open_journal( info, "w" );
+    }
+    if (info->old_journal_path) unlink( info->old_journal_path );
+    return 1;
+}
+
+/* move the journal of a branch aside before a compaction */
+static int rotate_journal( struct save_branch_info *info )
+{
+    char buffer[4096];
+    struct stat st;
+    FILE *in, *out;
+    size_t len;
+    int ret = 1;
+
+    if (stat( info->old_journal_path, &st ) == -1)
+    {
+        fclose( info->journal );
+        ret = !rename( info->journal_path, info->old_journal_path );
+        open_journal( info, ret ? "w" : "a" );
+        return ret;
+    }
+
+    /* a previous compaction failed, append the journal to the old one */
+    if (!(in = fopen( info->journal_path, "r" ))) return 0;
+    if (!(out = fopen( info->old_journal_path, "a" )))
+    {
+        fclose( in );
+        return 0;
+    }
+    fseek( in, sizeof(journal_header) - 1, SEEK_SET );
+    while ((len = fread( buffer, 1, sizeof(buffer), in ))) fwrite( buffer, 1, len, out );
+    if (ferror( in ) || fflush( out ) || fsync( fileno(out) )) ret = 0;
+    fclose( in );
+    fclose( out );
+    if (ret)
+    {
+        fclose( info->journal );
+        open_journal( info, "w" );
+    }
+    return ret;
+}
+
+/* save a whole branch in a child process, so that its journal can be discarded */
+static void compact_branch( struct save_branch_info *info )
+{
+    pid_t pid;
+
+    if (info->compact_pid && !kill( info->compact_pid, 0 )) return;  /* still running */
+    info->compact_pid = 0;
+
+    if (!rotate_journal( info )) return;
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", info->path );
+        dump_operation( info->key, NULL, "compacting" );
+    }
+
+    switch ((pid = fork()))
+    {
+    case 0:
+        if (write_branch( info->key, info->path )) unlink( info->old_journal_path );
+        _exit(0);
+    case -1:
+        if (write_branch( info->key, info->path )) unlink( info->old_journal_path );
+        break;
+    default:
+        info->compact_pid = pid;
+        break;
+    }
+}
+
+/* make the journaled changes of a branch persistent */
+static void commit_journal( struct save_branch_info *info )
+{
+    struct stat st;
+    off_t size;
+
+    if (!(info->key->flags & KEY_DIRTY)) return;
+
+    fputs( journal_commit, info->journal );
+    if (fflush( info->journal ) || fsync( fileno(info->journal) ))
+    {
+        fprintf( stderr, "wineserver: could not write registry journal %s: %s\n",
+                 info->journal_path, strerror( errno ));
+        fclose( info->journal );
+        info->journal = NULL;
+        journal_full_save( info->key );
+        return;
+    }
+    make_clean( info->key );
+
+    size = get_journal_size( info );
+    if (stat( info->path, &st ) == -1) st.st_size = 0;
+    if (size > max( JOURNAL_MIN_COMPACT_SIZE, st.st_size / 2 )) compact_branch( info );
+}
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
@@ -2006,7 +2637,12 @@ static void periodic_save( void *arg )
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
     for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    {
+        if (save_branch_info[i].journal && !save_branch_info[i].full_save)
+            commit_journal( &save_branch_info[i] );
+        else
+            save_branch( &save_branch_info[i] );
+    }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2026,12 +2662,27 @@ void flush_registry(void)
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        struct save_branch_info *info = &save_branch_info[i];
+
+        /* write the whole branch, so that the files are up to date while the server is not running */
+        if (info->journal)
         {
-            fprintf( stderr, "wineserver: could not save registry branch to %s",
-                     save_branch_info[i].path );
+            wait_compaction( info );
+            if (get_journal_size( info ) != sizeof(journal_header) - 1 ||
+                !access( info->old_journal_path, F_OK ))
+                make_dirty( info->key );
+        }
+        if (!save_branch( info ))
+        {
+            fprintf( stderr, "wineserver: could not save registry branch to %s", info->path );
             perror( " " );
         }
+        else if (info->journal)
+        {
+            fclose( info->journal );
+            info->journal = NULL;
+            unlink( info->journal_path );
+        }
     }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
 }
@@ -2230,6 +2881,7 @@ DECL_HANDLER(load_registry)
         if ((key = create_key( parent, &name, NULL, 0, KEY_WOW64_64KEY, 0, sd, &dummy )))
         {
             load_registry( key, req->file );
+            journal_full_save( key );
             release_object( key );
         }
         release_object( parent );
@@ -41,6 +41,12 @@
 #ifdef HAVE_SYS_WAIT_H
 # include <sys/wait.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
 #ifdef HAVE_SYS_UIO_H
 #include <sys/uio.h>
 #endif
@@ -51,6 +57,9 @@
 #ifdef HAVE_POLL_H
 #include <poll.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 #ifdef __APPLE__
 # include <mach/mach_time.h>
 #endif
@@ -64,6 +73,7 @@
 #include "wine/library.h"
 
 #include "file.h"
+#include "handle.h"
 #include "process.h"
 #include "thread.h"
 #include "security.h"
@@ -75,6 +85,9 @@
 #define SCM_RIGHTS 1
 #endif
 
+/* size of the per-thread buffer used for small request data */
+#define REQUEST_BUFFER_SIZE 4096
+
 /* path names for server master Unix socket */
 static const char * const server_socket_name = "socket";   /* name of the socket file */
 static const char * const server_lock_name = "lock";       /* name of the server lock file */
@@ -122,9 +135,58 @@ static const struct fd_ops master_socket_fd_ops =
     NULL                           /* reselect_async */
 };
 
+#ifdef HAVE_PTHREAD_H
+
+/* pipe used by the worker threads to wake up the main loop */
+struct worker_notify
+{
+    struct object        obj;        /* object header */
+    struct fd           *fd;         /* file descriptor of the pipe read side */
+    int                  pipe_write; /* unix fd of the pipe write side */
+};
+
+static void worker_notify_dump( struct object *obj, int verbose );
+static void worker_notify_destroy( struct object *obj );
+static void worker_notify_poll_event( struct fd *fd, int event );
+
+static const struct object_ops worker_notify_ops =
+{
+    sizeof(struct worker_notify),  /* size */
+    worker_notify_dump,            /* dump */
+    no_get_type,                   /* get_type */
+    no_add_queue,                  /* add_queue */
+    NULL,                          /* remove_queue */
+    NULL,                          /* signaled */
+    NULL,                          /* satisfied */
+    no_signal,                     /* signal */
+    no_get_fd,                     /* get_fd */
+    no_map_access,                 /* map_access */
+    default_get_sd,                /* get_sd */
+    default_set_sd,                /* set_sd */
+    no_lookup_name,                /* lookup_name */
+    no_link_name,                  /* link_name */
+    NULL,                          /* unlink_name */
+    no_open_file,                  /* open_file */
+    no_close_handle,               /* close_handle */
+    worker_notify_destroy          /* destroy */
+};
+
+static const struct fd_ops worker_notify_fd_ops =
+{
+    NULL,                          /* get_poll_events */
+    worker_notify_poll_event,      /* poll_event */
+    NULL,                          /* flush */
+    NULL,                          /* get_fd_type */
+    NULL,                          /* ioctl */
+    NULL,                          /* queue_async */
+    NULL                           /* reselect_async */
+};
+
+#endif  /* HAVE_PTHREAD_H */
+
 
-struct thread *current = NULL;  /* thread handling the current request */
-unsigned int global_error = 0;  /* global error code for when no thread is current */
+__thread struct thread *current = NULL;  /* thread handling the current request */
+__thread unsigned int global_error = 0;  /* global error code for when no thread is current */
 timeout_t server_start_time = 0;  /* server startup time */
 int server_dir_fd = -1;    /* file descriptor for the server dir */
 int config_dir_fd = -1;    /* file descriptor for the config dir */
@@ -250,65 +312,142 @@ void write_reply( struct thread *thread )
         fatal_protocol_error( thread, "reply write: %s\n", strerror( errno ));
 }
 
-/* send a reply to the current thread */
-static void send_reply( union generic_reply *reply )
+/* wake up a client thread sleeping on its shared request area */
+static inline void wake_request_shm( struct request_shm *shm )
 {
-    int ret;
+#ifdef __linux__
+    syscall( __NR_futex, &shm->state, 1 /* FUTEX_WAKE */, 1, NULL, 0, 0 );
+#endif
+}
+
+/* send a reply through the shared memory area of the current thread */
+static void send_shm_reply( union generic_reply *reply )
+{
+    struct request_shm *shm = current->request_shm;
+
+    memcpy( &shm->header, reply, sizeof(*reply) );
+    if (current->reply_size) memcpy( shm + 1, current->reply_data, current->reply_size );
+    free( current->reply_data );
+    current->reply_data = NULL;
+    current->shm_request = 0;
+    if (interlocked_xchg( &shm->state, REQUEST_SHM_DONE ) == REQUEST_SHM_WAITING)
+        wake_request_shm( shm );
+}
+
+/* result of sending a reply */
+enum reply_status
+{
+    REPLY_SENT,     /* the whole reply has been written */
+    REPLY_PENDING,  /* the pipe is full, the rest has to be written on POLLOUT */
+    REPLY_FAILED    /* the write failed */
+};
 
-    if (!current->reply_size)
+/* send a reply to the current thread; this doesn't change the main loop state,
+ * so that it can be called from a worker thread, see reply_sent() */
+static enum reply_status send_reply( union generic_reply *reply, int *ret )
+{
+    struct iovec vec[2];
+
+    if (current->shm_request)
     {
-        if ((ret = write( get_unix_fd( current->reply_fd ),
-                          reply, sizeof(*reply) )) != sizeof(*reply)) goto error;
+        send_shm_reply( reply );
+        return REPLY_SENT;
     }
-    else
-    {
-        struct iovec vec[2];
 
-        vec[0].iov_base = (void *)reply;
-        vec[0].iov_len  = sizeof(*reply);
-        vec[1].iov_base = current->reply_data;
-        vec[1].iov_len  = current->reply_size;
+    vec[0].iov_base = (void *)reply;
+    vec[0].iov_len  = sizeof(*reply);
+    vec[1].iov_base = current->reply_data;
+    vec[1].iov_len  = current->reply_size;
 
-        if ((ret = writev( get_unix_fd( current->reply_fd ), vec, 2 )) < sizeof(*reply)) goto error;
+    if ((*ret = writev( get_unix_fd( current->reply_fd ), vec, current->reply_size ? 2 : 1 ))
+        < (int)sizeof(*reply))
+        return REPLY_FAILED;
+
+    if ((current->reply_towrite = current->reply_size - (*ret - sizeof(*reply))))
+        return REPLY_PENDING;
 
-        if ((current->reply_towrite = current->reply_size - (ret - sizeof(*reply))))
-        {
-            /* couldn't write it all, wait for POLLOUT */
-            set_fd_events( current->reply_fd, POLLOUT );
-            set_fd_events( current->request_fd, 0 );
-            return;
-        }
-    }
     free( current->reply_data );
     current->reply_data = NULL;
-    return;
+    return REPLY_SENT;
+}
 
- error:
-    if (ret >= 0)
-        fatal_protocol_error( current, "partial write %d\n", ret );
-    else if (errno == EPIPE)
-        kill_thread( current, 0 );  /* normal death */
-    else
-        fatal_protocol_error( current, "reply write: %s\n", strerror( errno ));
+/* update the state of a thread once its reply has been sent */
+static void reply_sent( struct thread *thread, enum reply_status status, int ret, int err )
+{
+    switch (status)
+    {
+    case REPLY_SENT:
+        break;
+    case REPLY_PENDING:
+        /* couldn't write it all, wait for POLLOUT */
+        set_fd_events( thread->reply_fd, POLLOUT );
+        set_fd_events( thread->request_fd, 0 );
+        break;
+    case REPLY_FAILED:
+        if (ret >= 0)
+            fatal_protocol_error( thread, "partial write %d\n", ret );
+        else if (err == EPIPE)
+            kill_thread( thread, 0 );  /* normal death */
+        else
+            fatal_protocol_error( thread, "reply write: %s\n", strerror( err ));
+        break;
+    }
 }
 
-/* call a request handler */
-static void call_req_handler( struct thread *thread )
+/* per request type performance counters */
+static struct request_stats request_stats[REQ_NB_REQUESTS];
+static unsigned __int64 stats_start_time;
+
+/* account for a request in the performance counters */
+static void add_request_stats( enum request req, unsigned __int64 time, data_size_t in, data_size_t out )
 {
-    union generic_reply reply;
-    enum request req = thread->req.request_header.req;
+    struct request_stats *stats = &request_stats[req];
+    unsigned int bucket = 0;
+
+    while (bucket < REQUEST_STATS_BUCKETS - 1 && time >= (unsigned __int64)1000 << (2 * bucket)) bucket++;
+    stats->count++;
+    stats->total_time += time;
+    if (time > stats->max_time) stats->max_time = min( time, ~0u );
+    stats->bytes_in += sizeof(union generic_request) + in;
+    stats->bytes_out += sizeof(union generic_reply) + out;
+    stats->histogram[bucket]++;
+}
 
-    current = thread;
+/* account for a request started at a given time in the performance counters */
+static void update_request_stats( enum request req, unsigned __int64 start, data_size_t in, data_size_t out )
+{
+    add_request_stats( req, get_perf_time() - start, in, out );
+}
+
+/* run the handler of the request of the current thread */
+static void handle_request( enum request req, union generic_reply *reply )
+{
     current->reply_size = 0;
     clear_error();
-    memset( &reply, 0, sizeof(reply) );
+    memset( reply, 0, sizeof(*reply) );
 
     if (debug_level) trace_request();
 
     if (req < REQ_NB_REQUESTS)
-        req_handlers[req]( &current->req, &reply );
+        req_handlers[req]( &current->req, reply );
     else
         set_error( STATUS_NOT_IMPLEMENTED );
+}
+
+/* call a request handler */
+static void call_req_handler( struct thread *thread )
+{
+    union generic_reply reply;
+    enum request req = thread->req.request_header.req;
+    data_size_t in = thread->req.request_header.request_size;
+    unsigned __int64 start = get_perf_time();
+    enum reply_status status;
+    int ret = 0;
+
+    current = thread;
+    handle_request( req, &reply );
+
+    if (req < REQ_NB_REQUESTS) update_request_stats( req, start, in, current ? current->reply_size : 0 );
 
     if (current)
     {
@@ -317,7 +456,8 @@ static void call_req_handler( struct thread *thread )
             reply.reply_header.error = current->error;
             reply.reply_header.reply_size = current->reply_size;
             if (debug_level) trace_reply( req, &reply );
-            send_reply( &reply );
+            status = send_reply( &reply, &ret );
+            reply_sent( current, status, ret, errno );
         }
         else
         {
@@ -328,25 +468,483 @@ static void call_req_handler( struct thread *thread )
     current = NULL;
 }
 
+/* release the variable sized data once the request has been handled */
+static inline void free_req_data( struct thread *thread )
+{
+    if (thread->req_data != thread->req_buffer) free( thread->req_data );
+    thread->req_data = NULL;
+}
+
+#ifdef HAVE_PTHREAD_H
+
+/* Worker threads run the requests that only read the server state, while the main
+ * loop is waiting for events. The main thread owns server_lock exclusively the rest
+ * of the time, so the workers never see the state being modified, and they only
+ * modify the object reference counts, which are atomic when workers are running. */
+
+struct worker_request
+{
+    struct list          entry;      /* entry in the queued or done requests list */
+    struct thread       *thread;     /* thread that sent the request */
+    union generic_reply  reply;      /* reply sent to the thread */
+    enum request         req;        /* request code, REQ_NB_REQUESTS if not handled */
+    data_size_t          in;         /* request data size, for the stats */
+    data_size_t          out;        /* reply data size, for the stats */
+    unsigned __int64     time;       /* time spent handling the request */
+    enum reply_status    status;     /* result of sending the reply */
+    int                  ret;        /* return value of the reply write */
+    int                  err;        /* errno of the reply write */
+};
+
+static pthread_rwlock_t server_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_cond = PTHREAD_COND_INITIALIZER;
+static struct list worker_queue = LIST_INIT( worker_queue );  /* requests waiting for a worker */
+static struct list worker_done = LIST_INIT( worker_done );    /* requests handled by a worker */
+static struct worker_notify *worker_notify;
+
+/* requests that only read the server state; they must not block, pass file descriptors,
+ * change objects or handles, or need the main loop */
+static int is_worker_request( enum request req )
+{
+    switch (req)
+    {
+    case REQ_enum_key:
+    case REQ_get_key_value:
+    case REQ_enum_key_value:
+    case REQ_get_object_info:
+    case REQ_get_file_info:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void worker_notify_dump( struct object *obj, int verbose )
+{
+    struct worker_notify *notify = (struct worker_notify *)obj;
+    assert( obj->ops == &worker_notify_ops );
+    fprintf( stderr, "Worker notification pipe fd=%p\n", notify->fd );
+}
+
+static void worker_notify_destroy( struct object *obj )
+{
+    struct worker_notify *notify = (struct worker_notify *)obj;
+    assert( obj->ops == &worker_notify_ops );
+    if (notify->fd) release_object( notify->fd );
+    close( notify->pipe_write );
+}
+
+/* the handled requests are processed once the main loop owns the server lock again */
+static void worker_notify_poll_event( struct fd *fd, int event )
+{
+    char buffer[64];
+
+    while (read( get_unix_fd( fd ), buffer, sizeof(buffer) ) > 0);
+}
+
+/* handle a queued request on a worker thread */
+static void run_worker_request( struct worker_request *job )
+{
+    struct thread *thread = job->thread;
+    unsigned __int64 start = get_perf_time();
+
+    job->req = thread->req.request_header.req;
+    job->in = thread->req.request_header.request_size;
+
+    current = thread;
+    handle_request( job->req, &job->reply );
+
+    job->out = current->reply_size;
+    job->reply.reply_header.error = current->error;
+    job->reply.reply_header.reply_size = current->reply_size;
+    if (debug_level) trace_reply( job->req, &job->reply );
+    job->status = send_reply( &job->reply, &job->ret );
+    job->err = errno;
+    free_req_data( thread );
+    current = NULL;
+    job->time = get_perf_time() - start;
+}
+
+static void *worker_thread( void *arg )
+{
+    struct worker_request *job;
+    enum reply_status status;
+    char dummy = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock( &worker_mutex );
+        while (list_empty( &worker_queue )) pthread_cond_wait( &worker_cond, &worker_mutex );
+        job = LIST_ENTRY( list_head( &worker_queue ), struct worker_request, entry );
+        list_remove( &job->entry );
+        pthread_mutex_unlock( &worker_mutex );
+
+        pthread_rwlock_rdlock( &server_lock );
+        /* the thread may have been killed after the request was queued */
+        if (job->thread->state != TERMINATED) run_worker_request( job );
+        status = job->status;
+        /* queue it before releasing the lock, so that the main loop always sees it */
+        pthread_mutex_lock( &worker_mutex );
+        list_add_tail( &worker_done, &job->entry );
+        pthread_mutex_unlock( &worker_mutex );
+        pthread_rwlock_unlock( &server_lock );
+
+        /* the main loop needs to update the thread fd events */
+        if (status != REPLY_SENT) write( worker_notify->pipe_write, &dummy, 1 );
+    }
+    return NULL;
+}
+
+/* queue a request for the worker threads; return 0 if it must be handled by the main thread */
+static int queue_worker_request( struct thread *thread )
+{
+    struct worker_request *job;
+
+    if (!worker_threads || !thread->reply_fd) return 0;
+    if (!is_worker_request( thread->req.request_header.req )) return 0;
+    if (!(job = malloc( sizeof(*job) ))) return 0;
+
+    job->thread = (struct thread *)grab_object( thread );
+    job->req    = REQ_NB_REQUESTS;
+    job->status = REPLY_SENT;
+    pthread_mutex_lock( &worker_mutex );
+    list_add_tail( &worker_queue, &job->entry );
+    pthread_cond_signal( &worker_cond );
+    pthread_mutex_unlock( &worker_mutex );
+    return 1;
+}
+
+/* finish the requests handled by the workers; the main thread must own the server lock */
+static void flush_worker_requests(void)
+{
+    struct list done = LIST_INIT( done );
+    struct worker_request *job, *next;
+
+    pthread_mutex_lock( &worker_mutex );
+    list_move_tail( &done, &worker_done );
+    pthread_mutex_unlock( &worker_mutex );
+
+    LIST_FOR_EACH_ENTRY_SAFE( job, next, &done, struct worker_request, entry )
+    {
+        if (job->req < REQ_NB_REQUESTS)
+        {
+            add_request_stats( job->req, job->time, job->in, job->out );
+            reply_sent( job->thread, job->status, job->ret, job->err );
+        }
+        release_object( job->thread );
+        free( job );
+    }
+}
+
+/* start the worker threads; the main thread owns the server lock from now on */
+void init_worker_threads(void)
+{
+    struct worker_notify *notify;
+    sigset_t sigset, old_sigset;
+    pthread_t id;
+    int i, fd[2];
+
+    if (worker_threads <= 0) goto failed;
+    if (pipe( fd ) == -1) goto failed;
+    fcntl( fd[0], F_SETFL, O_NONBLOCK );
+    fcntl( fd[1], F_SETFL, O_NONBLOCK );
+    if (!(notify = alloc_object( &worker_notify_ops )))
+    {
+        close( fd[0] );
+        close( fd[1] );
+        goto failed;
+    }
+    notify->pipe_write = fd[1];
+    if (!(notify->fd = create_anonymous_fd( &worker_notify_fd_ops, fd[0], &notify->obj, 0 )))
+    {
+        release_object( notify );
+        goto failed;
+    }
+    set_fd_events( notify->fd, POLLIN );
+    make_object_static( &notify->obj );
+    worker_notify = notify;
+
+    pthread_rwlock_wrlock( &server_lock );
+
+    /* signals are handled by the main thread */
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_SETMASK, &sigset, &old_sigset );
+    for (i = 0; i < worker_threads; i++)
+    {
+        if (pthread_create( &id, NULL, worker_thread, NULL )) break;
+        pthread_detach( id );
+    }
+    pthread_sigmask( SIG_SETMASK, &old_sigset, NULL );
+
+    if (i)
+    {
+        if (debug_level) fprintf( stderr, "wineserver: started %d worker threads\n", i );
+        worker_threads = i;
+        return;
+    }
+    pthread_rwlock_unlock( &server_lock );
+
+failed:
+    worker_threads = 0;
+}
+
+/* let the worker threads run while the main loop waits for events */
+void release_server_lock(void)
+{
+    if (worker_threads) pthread_rwlock_unlock( &server_lock );
+}
+
+/* take back the server lock once the main loop has events to process */
+void acquire_server_lock(void)
+{
+    if (!worker_threads) return;
+    pthread_rwlock_wrlock( &server_lock );
+    flush_worker_requests();
+}
+
+#else  /* HAVE_PTHREAD_H */
+
+static inline int queue_worker_request( struct thread *thread )
+{
+    return 0;
+}
+
+void init_worker_threads(void)
+{
+    worker_threads = 0;
+}
+
+void release_server_lock(void)
+{
+}
+
+void acquire_server_lock(void)
+{
+}
+
+#endif  /* HAVE_PTHREAD_H */
+
+/* handle the request of a thread, on a worker thread if possible */
+static void dispatch_request( struct thread *thread )
+{
+    if (queue_worker_request( thread )) return;
+    call_req_handler( thread );
+    thread->shm_request = 0;
+    free_req_data( thread );
+}
+
+/* requests that can be part of a batch; they must not block, pass file descriptors
+ * or terminate the calling thread */
+static int is_batch_request( enum request req )
+{
+    switch (req)
+    {
+    case REQ_close_handle:
+    case REQ_open_key:
+    case REQ_enum_key:
+    case REQ_get_key_value:
+    case REQ_enum_key_value:
+    case REQ_unload_dll:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* execute several independent requests with a single server call */
+DECL_HANDLER(batch)
+{
+    union generic_request batch_req = current->req;
+    void *batch_data = current->req_data;
+    const char *ptr = get_req_data();
+    data_size_t left = get_req_data_size();
+    data_size_t max_size = get_reply_max_size(), size = 0;
+    unsigned int status = STATUS_SUCCESS, count = 0;
+    unsigned __int64 start;
+    char *replies = NULL;
+
+    if (max_size && !(replies = mem_alloc( max_size ))) return;
+
+    while (left)
+    {
+        union generic_reply sub_reply;
+        enum request sub_req;
+        data_size_t data_size, padded_size;
+
+        if (left < sizeof(current->req))
+        {
+            status = STATUS_INVALID_PARAMETER;
+            break;
+        }
+        memcpy( &current->req, ptr, sizeof(current->req) );
+        ptr += sizeof(current->req);
+        left -= sizeof(current->req);
+
+        sub_req = current->req.request_header.req;
+        data_size = current->req.request_header.request_size;
+        padded_size = (data_size + 7) & ~7;
+        if (padded_size > left || padded_size < data_size || !is_batch_request( sub_req ) ||
+            max_size - size < sizeof(sub_reply) ||
+            max_size - size - sizeof(sub_reply) < current->req.request_header.reply_size)
+        {
+            status = STATUS_INVALID_PARAMETER;
+            break;
+        }
+
+        current->req_data = (void *)ptr;
+        current->reply_size = 0;
+        clear_error();
+        memset( &sub_reply, 0, sizeof(sub_reply) );
+
+        if (debug_level) trace_request();
+        start = get_perf_time();
+        req_handlers[sub_req]( &current->req, &sub_reply );
+        update_request_stats( sub_req, start, data_size, current->reply_size );
+
+        sub_reply.reply_header.error = current->error;
+        sub_reply.reply_header.reply_size = current->reply_size;
+        if (debug_level) trace_reply( sub_req, &sub_reply );
+
+        memcpy( replies + size, &sub_reply, sizeof(sub_reply) );
+        size += sizeof(sub_reply);
+        if (current->reply_size) memcpy( replies + size, current->reply_data, current->reply_size );
+        size += current->reply_size;
+        free( current->reply_data );
+        current->reply_data = NULL;
+        current->reply_size = 0;
+
+        ptr += padded_size;
+        left -= padded_size;
+        count++;
+    }
+
+    current->req = batch_req;
+    current->req_data = batch_data;
+    set_error( status );
+    reply->count = count;
+    if (size) set_reply_data_ptr( replies, size );
+    else free( replies );
+}
+
+/* retrieve the server performance counters */
+DECL_HANDLER(get_server_stats)
+{
+    struct request_stats *stats;
+    data_size_t size = min( get_reply_max_size(), sizeof(request_stats) );
+    unsigned int i;
+
+    reply->elapsed   = get_perf_time() - stats_start_time;
+    reply->loops     = main_loop_stats.loops;
+    reply->events    = main_loop_stats.events;
+    reply->timeouts  = main_loop_stats.timeouts;
+    reply->wait_time = main_loop_stats.wait_time;
+
+    if ((stats = set_reply_data_size( size )))
+    {
+        memcpy( stats, request_stats, size );
+        for (i = 0; i < size / sizeof(*stats); i++)
+            snprintf( stats[i].name, sizeof(stats[i].name), "%s", get_request_name( i ));
+    }
+    if (req->reset) reset_server_stats();
+}
+
+/* handle a request posted in the shared memory area of a thread */
+static void read_shm_request( struct thread *thread )
+{
+    struct request_shm *shm = thread->request_shm;
+    data_size_t size;
+
+    /* the client can modify the area at any time, so everything is copied before being used */
+    memcpy( &thread->req, &shm->header, sizeof(thread->req) );
+    size = thread->req.request_header.request_size;
+    if (size > REQUEST_SHM_DATA_SIZE || thread->req.request_header.reply_size > REQUEST_SHM_DATA_SIZE)
+    {
+        fatal_protocol_error( thread, "bad sizes %u/%u for shared request %d\n", size,
+                              thread->req.request_header.reply_size, thread->req.request_header.req );
+        return;
+    }
+    if (size)
+    {
+        if (size <= REQUEST_BUFFER_SIZE) thread->req_data = thread->req_buffer;
+        else if (!(thread->req_data = malloc( size )))
+        {
+            fatal_protocol_error( thread, "no memory for %u bytes request %d\n",
+                                  size, thread->req.request_header.req );
+            return;
+        }
+        memcpy( thread->req_data, shm + 1, size );
+    }
+    thread->shm_request = 1;
+    dispatch_request( thread );
+}
+
 /* read a request from a thread */
 void read_request( struct thread *thread )
 {
     int ret;
 
+    if (!thread->req_buffer && !(thread->req_buffer = malloc( REQUEST_BUFFER_SIZE )))
+    {
+        fatal_protocol_error( thread, "no memory for request buffer\n" );
+        return;
+    }
+
+    if (!thread->req_toread && thread->request_shm &&
+        (thread->request_shm->state == REQUEST_SHM_PENDING ||
+         thread->request_shm->state == REQUEST_SHM_WAITING))
+    {
+        char doorbell;
+
+        /* the client only writes a single byte to the pipe to signal a shared request */
+        if ((ret = read( get_unix_fd( thread->request_fd ), &doorbell, 1 )) != 1) goto error;
+        read_shm_request( thread );
+        return;
+    }
+
     if (!thread->req_toread)  /* no pending request */
     {
-        if ((ret = read( get_unix_fd( thread->request_fd ), &thread->req,
-                         sizeof(thread->req) )) != sizeof(thread->req)) goto error;
-        if (!(thread->req_toread = thread->req.request_header.request_size))
+        struct iovec vec[2];
+        data_size_t size;
+
+
+        /* the client sends the header and the data with a single writev, so most of
+         * the time we can get both at once; it never sends a new request before it
+         * received the reply, so we can't read too much */
+        vec[0].iov_base = &thread->req;
+        vec[0].iov_len  = sizeof(thread->req);
+        vec[1].iov_base = thread->req_buffer;
+        vec[1].iov_len  = REQUEST_BUFFER_SIZE;
+        if ((ret = readv( get_unix_fd( thread->request_fd ), vec, 2 )) < (int)sizeof(thread->req))
+            goto error;
+        ret -= sizeof(thread->req);
+
+        if (!(size = thread->req.request_header.request_size))
         {
             /* no data, handle request at once */
-            call_req_handler( thread );
+            dispatch_request( thread );
             return;
         }
-        if (!(thread->req_data = malloc( thread->req_toread )))
+        if (ret > size)
         {
-            fatal_protocol_error( thread, "no memory for %u bytes request %d\n",
-                                  thread->req_toread, thread->req.request_header.req );
+            fatal_protocol_error( thread, "too much data %d for request %d\n",
+                                  ret, thread->req.request_header.req );
+            return;
+        }
+        if (size <= REQUEST_BUFFER_SIZE) thread->req_data = thread->req_buffer;
+        else
+        {
+            if (!(thread->req_data = malloc( size )))
+            {
+                fatal_protocol_error( thread, "no memory for %u bytes request %d\n",
+                                      size, thread->req.request_header.req );
+                return;
+            }
+            memcpy( thread->req_data, thread->req_buffer, ret );
+        }
+        if (!(thread->req_toread = size - ret))
+        {
+            dispatch_request( thread );
             return;
         }
     }
@@ -361,9 +959,7 @@ void read_request( struct thread *thread )
         if (ret <= 0) break;
         if (!(thread->req_toread -= ret))
         {
-            call_req_handler( thread );
-            free( thread->req_data );
-            thread->req_data = NULL;
+            dispatch_request( thread );
             return;
         }
     }
@@ -377,6 +973,58 @@ error:
         fatal_protocol_error( thread, "read: %s\n", strerror( errno ));
 }
 
+/* release the shared request area of a dead thread */
+void free_request_shm( struct thread *thread )
+{
+#ifdef HAVE_SYS_MMAN_H
+    if (!thread->request_shm) return;
+    if (interlocked_xchg( &thread->request_shm->state, REQUEST_SHM_CLOSED ) == REQUEST_SHM_WAITING)
+        wake_request_shm( thread->request_shm );
+    munmap( thread->request_shm, REQUEST_SHM_SIZE );
+    thread->request_shm = NULL;
+    thread->shm_request = 0;
+#endif
+}
+
+/* create the shared memory area used to pass requests of the current thread */
+DECL_HANDLER(get_request_shm)
+{
+#if defined(__linux__) && defined(HAVE_SYS_MMAN_H)
+    struct file *file;
+    void *ptr;
+    int fd;
+
+    if (current->request_shm)
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+    if ((fd = create_temp_file( REQUEST_SHM_SIZE )) == -1)
+    {
+        file_set_error();
+        return;
+    }
+    if ((ptr = mmap( NULL, REQUEST_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        close( fd );
+        return;
+    }
+    if (!(file = create_file_for_fd( fd, FILE_GENERIC_READ | FILE_GENERIC_WRITE, 0 )))
+    {
+        munmap( ptr, REQUEST_SHM_SIZE );
+        return;
+    }
+    if ((reply->handle = alloc_handle( current->process, file, FILE_READ_DATA | FILE_WRITE_DATA, 0 )))
+        current->request_shm = ptr;
+    else
+        munmap( ptr, REQUEST_SHM_SIZE );
+    release_object( file );
+#else
+    set_error( STATUS_NOT_SUPPORTED );
+#endif
+}
+
 /* receive a file descriptor on the process socket */
 int receive_fd( struct process *process )
 {
@@ -541,6 +1189,52 @@ unsigned int get_tick_count(void)
     return (current_time - server_start_time) / 10000;
 }
 
+/* get a monotonic time stamp in nanoseconds for the performance counters */
+unsigned __int64 get_perf_time(void)
+{
+#ifdef __APPLE__
+    static mach_timebase_info_data_t timebase;
+
+    if (!timebase.denom) mach_timebase_info( &timebase );
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#elif defined(HAVE_CLOCK_GETTIME)
+    struct timespec ts;
+
+    if (!clock_gettime( CLOCK_MONOTONIC, &ts ))
+        return ts.tv_sec * (unsigned __int64)1000000000 + ts.tv_nsec;
+#endif
+    return current_time * 100;
+}
+
+/* reset the performance counters */
+void reset_server_stats(void)
+{
+    memset( request_stats, 0, sizeof(request_stats) );
+    memset( &main_loop_stats, 0, sizeof(main_loop_stats) );
+    stats_start_time = get_perf_time();
+}
+
+/* dump the performance counters to stderr */
+void dump_server_stats(void)
+{
+    unsigned __int64 elapsed = get_perf_time() - stats_start_time;
+    unsigned int i;
+
+    fprintf( stderr, "wineserver: stats over %.3f s: %.0f loops, %.0f events, %.0f timeouts, %.3f s waiting\n",
+             elapsed / 1e9, (double)main_loop_stats.loops, (double)main_loop_stats.events,
+             (double)main_loop_stats.timeouts, main_loop_stats.wait_time / 1e9 );
+    fprintf( stderr, "%-32s %10s %12s %10s %10s\n", "request", "count", "total (us)", "avg (ns)", "max (us)" );
+    for (i = 0; i < REQ_NB_REQUESTS; i++)
+    {
+        const struct request_stats *stats = &request_stats[i];
+
+        if (!stats->count) continue;
+        fprintf( stderr, "%-32s %10u %12.0f %10u %10u\n", get_request_name( i ), stats->count,
+                 stats->total_time / 1e3, (unsigned int)(stats->total_time / stats->count),
+                 stats->max_time / 1000 );
+    }
+}
+
 static void master_socket_dump( struct object *obj, int verbose )
 {
     struct master_socket *sock = (struct master_socket *)obj;
@@ -54,7 +54,14 @@ extern int receive_fd( struct process *process );
 extern int send_client_fd( struct process *process, int fd, obj_handle_t handle );
 extern void read_request( struct thread *thread );
 extern void write_reply( struct thread *thread );
+extern void free_request_shm( struct thread *thread );
+extern void init_worker_threads(void);
+extern void release_server_lock(void);
+extern void acquire_server_lock(void);
 extern unsigned int get_tick_count(void);
+extern unsigned __int64 get_perf_time(void);
+extern void reset_server_stats(void);
+extern void dump_server_stats(void);
 extern void open_master_socket(void);
 extern void close_master_socket( timeout_t timeout );
 extern void shutdown_master_socket(void);
@@ -64,6 +71,7 @@ extern int server_dir_fd, config_dir_fd;
 
 extern void trace_request(void);
 extern void trace_reply( enum request req, const union generic_reply *reply );
+extern const char *get_request_name( enum request req );
 
 /* get the request vararg data */
 static inline const void *get_req_data(void)
@@ -246,6 +254,7 @@ DECL_HANDLER(set_atom_information);
 DECL_HANDLER(empty_atom_table);
 DECL_HANDLER(init_atom_table);
 DECL_HANDLER(get_msg_queue);
+DECL_HANDLER(get_queue_shm_region);
 DECL_HANDLER(set_queue_fd);
 DECL_HANDLER(set_queue_mask);
 DECL_HANDLER(get_queue_status);
@@ -277,6 +286,7 @@ DECL_HANDLER(get_desktop_window);
 DECL_HANDLER(set_window_owner);
 DECL_HANDLER(get_window_info);
 DECL_HANDLER(set_window_info);
+DECL_HANDLER(get_window_shm_region);
 DECL_HANDLER(set_parent);
 DECL_HANDLER(get_window_parents);
 DECL_HANDLER(get_window_children);
@@ -382,9 +392,11 @@ DECL_HANDLER(create_completion);
 DECL_HANDLER(open_completion);
 DECL_HANDLER(add_completion);
 DECL_HANDLER(remove_completion);
+DECL_HANDLER(remove_completions);
 DECL_HANDLER(query_completion);
 DECL_HANDLER(set_completion_info);
 DECL_HANDLER(add_fd_completion);
+DECL_HANDLER(get_fd_completion);
 DECL_HANDLER(set_fd_completion_mode);
 DECL_HANDLER(set_fd_disp_info);
 DECL_HANDLER(set_fd_name_info);
@@ -403,6 +415,11 @@ DECL_HANDLER(process_in_job);
 DECL_HANDLER(set_job_limits);
 DECL_HANDLER(set_job_completion_port);
 DECL_HANDLER(terminate_job);
+DECL_HANDLER(get_fast_sync_region);
+DECL_HANDLER(get_fast_sync_slot);
+DECL_HANDLER(batch);
+DECL_HANDLER(get_request_shm);
+DECL_HANDLER(get_server_stats);
 
 #ifdef WANT_REQUEST_HANDLERS
 
@@ -543,6 +560,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_empty_atom_table,
     (req_handler)req_init_atom_table,
     (req_handler)req_get_msg_queue,
+    (req_handler)req_get_queue_shm_region,
     (req_handler)req_set_queue_fd,
     (req_handler)req_set_queue_mask,
     (req_handler)req_get_queue_status,
@@ -574,6 +592,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_set_window_owner,
     (req_handler)req_get_window_info,
     (req_handler)req_set_window_info,
+    (req_handler)req_get_window_shm_region,
     (req_handler)req_set_parent,
     (req_handler)req_get_window_parents,
     (req_handler)req_get_window_children,
@@ -679,9 +698,11 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_open_completion,
     (req_handler)req_add_completion,
     (req_handler)req_remove_completion,
+    (req_handler)req_remove_completions,
     (req_handler)req_query_completion,
     (req_handler)req_set_completion_info,
     (req_handler)req_add_fd_completion,
+    (req_handler)req_get_fd_completion,
     (req_handler)req_set_fd_completion_mode,
     (req_handler)req_set_fd_disp_info,
     (req_handler)req_set_fd_name_info,
@@ -700,6 +721,11 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_set_job_limits,
     (req_handler)req_set_job_completion_port,
     (req_handler)req_terminate_job,
+    (req_handler)req_get_fast_sync_region,
+    (req_handler)req_get_fast_sync_slot,
+    (req_handler)req_batch,
+    (req_handler)req_get_request_shm,
+    (req_handler)req_get_server_stats,
 };
 
 C_ASSERT( sizeof(affinity_t) == 8 );
@@ -1511,7 +1537,12 @@ C_ASSERT( FIELD_OFFSET(struct init_atom_table_reply, table) == 8 );
 C_ASSERT( sizeof(struct init_atom_table_reply) == 16 );
 C_ASSERT( sizeof(struct get_msg_queue_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, shm_slot) == 12 );
 C_ASSERT( sizeof(struct get_msg_queue_reply) == 16 );
+C_ASSERT( sizeof(struct get_queue_shm_region_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_queue_shm_region_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_queue_shm_region_reply, size) == 12 );
+C_ASSERT( sizeof(struct get_queue_shm_region_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_queue_fd_request, handle) == 12 );
 C_ASSERT( sizeof(struct set_queue_fd_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_queue_mask_request, wake_mask) == 12 );
@@ -1714,6 +1745,10 @@ C_ASSERT( FIELD_OFFSET(struct set_window_info_reply, old_user_data) == 24 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_reply, old_extra_value) == 32 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_reply, old_id) == 40 );
 C_ASSERT( sizeof(struct set_window_info_reply) == 48 );
+C_ASSERT( sizeof(struct get_window_shm_region_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_window_shm_region_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_window_shm_region_reply, size) == 12 );
+C_ASSERT( sizeof(struct get_window_shm_region_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_parent_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_parent_request, parent) == 16 );
 C_ASSERT( sizeof(struct set_parent_request) == 24 );
@@ -2319,6 +2354,9 @@ C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, cvalue) == 16 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, status) == 32 );
 C_ASSERT( sizeof(struct remove_completion_reply) == 40 );
+C_ASSERT( FIELD_OFFSET(struct remove_completions_request, handle) == 12 );
+C_ASSERT( sizeof(struct remove_completions_request) == 16 );
+C_ASSERT( sizeof(struct remove_completions_reply) == 8 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_request, handle) == 12 );
 C_ASSERT( sizeof(struct query_completion_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_reply, depth) == 8 );
@@ -2333,6 +2371,11 @@ C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, status) == 32 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, async) == 36 );
 C_ASSERT( sizeof(struct add_fd_completion_request) == 40 );
+C_ASSERT( FIELD_OFFSET(struct get_fd_completion_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_fd_completion_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fd_completion_reply, port) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_fd_completion_reply, ckey) == 16 );
+C_ASSERT( sizeof(struct get_fd_completion_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct set_fd_completion_mode_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_fd_completion_mode_request, flags) == 16 );
 C_ASSERT( sizeof(struct set_fd_completion_mode_request) == 24 );
@@ -2406,6 +2449,29 @@ C_ASSERT( sizeof(struct set_job_completion_port_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct terminate_job_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct terminate_job_request, status) == 16 );
 C_ASSERT( sizeof(struct terminate_job_request) == 24 );
+C_ASSERT( sizeof(struct get_fast_sync_region_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_region_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_region_reply, size) == 12 );
+C_ASSERT( sizeof(struct get_fast_sync_region_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_slot_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_fast_sync_slot_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_slot_reply, index) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_slot_reply, access) == 12 );
+C_ASSERT( sizeof(struct get_fast_sync_slot_reply) == 16 );
+C_ASSERT( sizeof(struct batch_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct batch_reply, count) == 8 );
+C_ASSERT( sizeof(struct batch_reply) == 16 );
+C_ASSERT( sizeof(struct get_request_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_request_shm_reply, handle) == 8 );
+C_ASSERT( sizeof(struct get_request_shm_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_server_stats_request, reset) == 12 );
+C_ASSERT( sizeof(struct get_server_stats_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_server_stats_reply, elapsed) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_server_stats_reply, loops) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_server_stats_reply, events) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_server_stats_reply, timeouts) == 32 );
+C_ASSERT( FIELD_OFFSET(struct get_server_stats_reply, wait_time) == 40 );
+C_ASSERT( sizeof(struct get_server_stats_reply) == 48 );
 
 #endif  /* WANT_REQUEST_HANDLERS */
 
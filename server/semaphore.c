@@ -39,24 +39,28 @@
 struct semaphore
 {
     struct object  obj;    /* object header */
-    unsigned int   count;  /* current count */
+    unsigned int   count;  /* current count, last known one for fast sync semaphores */
     unsigned int   max;    /* maximum possible count */
+    unsigned int   fast_sync; /* shared memory slot holding the count */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
 static struct object_type *semaphore_get_type( struct object *obj );
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int semaphore_map_access( struct object *obj, unsigned int access );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
     sizeof(struct semaphore),      /* size */
     semaphore_dump,                /* dump */
     semaphore_get_type,            /* get_type */
-    add_queue,                     /* add_queue */
-    remove_queue,                  /* remove_queue */
+    semaphore_add_queue,           /* add_queue */
+    semaphore_remove_queue,        /* remove_queue */
     semaphore_signaled,            /* signaled */
     semaphore_satisfied,           /* satisfied */
     semaphore_signal,              /* signal */
@@ -69,7 +73,7 @@ static const struct object_ops semaphore_ops =
     default_unlink_name,           /* unlink_name */
     no_open_file,                  /* open_file */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
@@ -91,14 +95,52 @@ static struct semaphore *create_semaphore( struct object *root, const struct uni
             /* initialize it if it didn't already exist */
             sem->count = initial;
             sem->max   = max;
+            sem->fast_sync = FAST_SYNC_NO_SLOT;
+            if (max <= FAST_SYNC_VALUE_MASK)
+                sem->fast_sync = alloc_fast_sync_slot( FAST_SYNC_SEMAPHORE, initial, max );
         }
     }
     return sem;
 }
 
+/* retrieve the current count, which lives in shared memory for fast sync semaphores */
+static inline unsigned int get_count( struct semaphore *sem )
+{
+    unsigned int count;
+
+    if (sem->fast_sync == FAST_SYNC_NO_SLOT) return sem->count;
+    /* clients can write anything there, fall back to the last count we have seen */
+    if ((count = get_fast_sync_value( sem->fast_sync )) > sem->max) return sem->count;
+    return sem->count = count;
+}
+
 static int release_semaphore( struct semaphore *sem, unsigned int count,
                               unsigned int *prev )
 {
+    unsigned int cur = get_count( sem );
+
+    if (sem->fast_sync != FAST_SYNC_NO_SLOT)
+    {
+        /* clients may be acquiring it concurrently if no server thread is waiting */
+        for (;;)
+        {
+            unsigned int old;
+
+            if (prev) *prev = cur;
+            if (cur + count < cur || cur + count > sem->max) break;
+            if ((old = cmpxchg_fast_sync_value( sem->fast_sync, cur + count, cur )) == cur)
+            {
+                sem->count = cur + count;
+                wake_fast_sync_waiters( sem->fast_sync );
+                if (!cur) wake_up( &sem->obj, count );
+                return 1;
+            }
+            cur = old;
+        }
+        set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
+        return 0;
+    }
+
     if (prev) *prev = sem->count;
     if (sem->count + count < sem->count || sem->count + count > sem->max)
     {
@@ -118,11 +160,17 @@ static int release_semaphore( struct semaphore *sem, unsigned int count,
     return 1;
 }
 
+unsigned int get_semaphore_fast_sync( struct object *obj )
+{
+    if (obj->ops != &semaphore_ops) return FAST_SYNC_NO_SLOT;
+    return ((struct semaphore *)obj)->fast_sync;
+}
+
 static void semaphore_dump( struct object *obj, int verbose )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    fprintf( stderr, "Semaphore count=%d max=%d\n", sem->count, sem->max );
+    fprintf( stderr, "Semaphore count=%d max=%d\n", get_count( sem ), sem->max );
 }
 
 static struct object_type *semaphore_get_type( struct object *obj )
@@ -132,17 +180,46 @@ static struct object_type *semaphore_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    /* clients must not change the count behind our back while we are waiting */
+    if (sem->fast_sync != FAST_SYNC_NO_SLOT) set_fast_sync_server_wait( sem->fast_sync, 1 );
+    return add_queue( obj, entry );
+}
+
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->fast_sync != FAST_SYNC_NO_SLOT && list_head( &obj->wait_queue ) == &entry->entry &&
+        list_tail( &obj->wait_queue ) == &entry->entry)
+        set_fast_sync_server_wait( sem->fast_sync, 0 );
+    remove_queue( obj, entry );
+}
+
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    return (sem->count > 0);
+    return (get_count( sem ) > 0);
 }
 
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
+    if (sem->fast_sync != FAST_SYNC_NO_SLOT)
+    {
+        unsigned int count = get_count( sem );
+
+        /* a client may have cleared it despite the server wait flag */
+        if (count) count--;
+        sem->count = count;
+        set_fast_sync_value( sem->fast_sync, count );
+        return;
+    }
     assert( sem->count );
     sem->count--;
 }
@@ -169,6 +246,13 @@ static int semaphore_signal( struct object *obj, unsigned int access )
     return release_semaphore( sem, 1, NULL );
 }
 
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->fast_sync != FAST_SYNC_NO_SLOT) free_fast_sync_slot( sem->fast_sync );
+}
+
 /* create a semaphore */
 DECL_HANDLER(create_semaphore)
 {
@@ -223,7 +307,7 @@ DECL_HANDLER(query_semaphore)
     if ((sem = (struct semaphore *)get_handle_obj( current->process, req->handle,
                                                    SEMAPHORE_QUERY_STATE, &semaphore_ops )))
     {
-        reply->current = sem->count;
+        reply->current = get_count( sem );
         reply->max = sem->max;
         release_object( sem );
     }
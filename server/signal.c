@@ -179,6 +179,9 @@ static void sighup_callback(void)
 #ifdef DEBUG_OBJECTS
     dump_objects();
 #endif
+    fprintf( stderr, "wineserver: %u pending timeouts\n", get_timeout_count() );
+    dump_namespaces();
+    dump_server_stats();
 }
 
 /* SIGTERM callback */
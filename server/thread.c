@@ -168,6 +168,7 @@ static const struct fd_ops thread_fd_ops =
 };
 
 static struct list thread_list = LIST_INIT(thread_list);
+static unsigned int nb_threads;  /* number of entries in thread_list */
 
 /* initialize the structure for a newly allocated thread */
 static inline void init_thread_structure( struct thread *thread )
@@ -188,12 +189,15 @@ static inline void init_thread_structure( struct thread *thread )
     thread->wait            = NULL;
     thread->error           = 0;
     thread->req_data        = NULL;
+    thread->req_buffer      = NULL;
     thread->req_toread      = 0;
     thread->reply_data      = NULL;
     thread->reply_towrite   = 0;
     thread->request_fd      = NULL;
     thread->reply_fd        = NULL;
     thread->wait_fd         = NULL;
+    thread->request_shm     = NULL;
+    thread->shm_request     = 0;
     thread->state           = RUNNING;
     thread->exit_code       = 0;
     thread->priority        = 0;
@@ -262,6 +266,7 @@ struct thread *create_thread( int fd, struct process *process, const struct secu
     if (!current) current = thread;
 
     list_add_head( &thread_list, &thread->entry );
+    nb_threads++;
 
     if (sd && !set_sd_defaults_from_token( &thread->obj, sd,
                                            OWNER_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION |
@@ -310,11 +315,13 @@ static void cleanup_thread( struct thread *thread )
 
     clear_apc_queue( &thread->system_apc );
     clear_apc_queue( &thread->user_apc );
-    free( thread->req_data );
+    if (thread->req_data != thread->req_buffer) free( thread->req_data );
+    free( thread->req_buffer );
     free( thread->reply_data );
     if (thread->request_fd) release_object( thread->request_fd );
     if (thread->reply_fd) release_object( thread->reply_fd );
     if (thread->wait_fd) release_object( thread->wait_fd );
+    free_request_shm( thread );
     free( thread->suspend_context );
     cleanup_clipboard_thread(thread);
     destroy_thread_windows( thread );
@@ -329,6 +336,7 @@ static void cleanup_thread( struct thread *thread )
         }
     }
     thread->req_data = NULL;
+    thread->req_buffer = NULL;
     thread->reply_data = NULL;
     thread->request_fd = NULL;
     thread->reply_fd = NULL;
@@ -346,6 +354,7 @@ static void destroy_thread( struct object *obj )
 
     assert( !thread->debug_ctx );  /* cannot still be debugging something */
     list_remove( &thread->entry );
+    nb_threads--;
     cleanup_thread( thread );
     release_object( thread->process );
     if (thread->id) free_ptid( thread->id );
@@ -444,6 +453,12 @@ struct thread *get_thread_from_handle( obj_handle_t handle, unsigned int access
                                             access, &thread_ops );
 }
 
+/* retrieve the number of existing threads */
+unsigned int get_thread_count(void)
+{
+    return nb_threads;
+}
+
 /* find a thread from a Unix tid */
 struct thread *get_thread_from_tid( int tid )
 {
@@ -1220,6 +1220,44 @@ static void dump_varargs_handle_infos( const char *prefix, data_size_t size )
     fputc( '}', stderr );
 }
 
+static void dump_varargs_completion_msgs( const char *prefix, data_size_t size )
+{
+    const struct completion_msg *msg;
+
+    fprintf( stderr, "%s{", prefix );
+    while (size >= sizeof(*msg))
+    {
+        msg = cur_data;
+        dump_uint64( "{ckey=", &msg->ckey );
+        dump_uint64( ",cvalue=", &msg->cvalue );
+        dump_uint64( ",information=", &msg->information );
+        fprintf( stderr, ",status=%08x}", msg->status );
+        size -= sizeof(*msg);
+        remove_data( sizeof(*msg) );
+        if (size) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+}
+
+static void dump_varargs_request_stats( const char *prefix, data_size_t size )
+{
+    const struct request_stats *stats;
+
+    fprintf( stderr, "%s{", prefix );
+    while (size >= sizeof(*stats))
+    {
+        stats = cur_data;
+        fprintf( stderr, "{name=%.*s,count=%u,max_time=%u", (int)sizeof(stats->name), stats->name,
+                 stats->count, stats->max_time );
+        dump_uint64( ",total_time=", &stats->total_time );
+        fputc( '}', stderr );
+        size -= sizeof(*stats);
+        remove_data( sizeof(*stats) );
+        if (size) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+}
+
 typedef void (*dump_func)( const void *req );
 
 /* Everything below this line is generated automatically by tools/make_requests */
@@ -2758,6 +2796,17 @@ static void dump_get_msg_queue_request( const struct get_msg_queue_request *req
 static void dump_get_msg_queue_reply( const struct get_msg_queue_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", shm_slot=%08x", req->shm_slot );
+}
+
+static void dump_get_queue_shm_region_request( const struct get_queue_shm_region_request *req )
+{
+}
+
+static void dump_get_queue_shm_region_reply( const struct get_queue_shm_region_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", size=%u", req->size );
 }
 
 static void dump_set_queue_fd_request( const struct set_queue_fd_request *req )
@@ -3125,6 +3174,16 @@ static void dump_set_window_info_reply( const struct set_window_info_reply *req
     fprintf( stderr, ", old_id=%08x", req->old_id );
 }
 
+static void dump_get_window_shm_region_request( const struct get_window_shm_region_request *req )
+{
+}
+
+static void dump_get_window_shm_region_reply( const struct get_window_shm_region_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", size=%u", req->size );
+}
+
 static void dump_set_parent_request( const struct set_parent_request *req )
 {
     fprintf( stderr, " handle=%08x", req->handle );
@@ -4364,6 +4423,16 @@ static void dump_remove_completion_reply( const struct remove_completion_reply *
     fprintf( stderr, ", status=%08x", req->status );
 }
 
+static void dump_remove_completions_request( const struct remove_completions_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_remove_completions_reply( const struct remove_completions_reply *req )
+{
+    dump_varargs_completion_msgs( " msgs=", cur_size );
+}
+
 static void dump_query_completion_request( const struct query_completion_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4390,6 +4459,17 @@ static void dump_add_fd_completion_request( const struct add_fd_completion_reque
     fprintf( stderr, ", async=%d", req->async );
 }
 
+static void dump_get_fd_completion_request( const struct get_fd_completion_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_fd_completion_reply( const struct get_fd_completion_reply *req )
+{
+    fprintf( stderr, " port=%04x", req->port );
+    dump_uint64( ", ckey=", &req->ckey );
+}
+
 static void dump_set_fd_completion_mode_request( const struct set_fd_completion_mode_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4541,6 +4621,62 @@ static void dump_terminate_job_request( const struct terminate_job_request *req
     fprintf( stderr, ", status=%d", req->status );
 }
 
+static void dump_get_fast_sync_region_request( const struct get_fast_sync_region_request *req )
+{
+}
+
+static void dump_get_fast_sync_region_reply( const struct get_fast_sync_region_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", size=%u", req->size );
+}
+
+static void dump_get_fast_sync_slot_request( const struct get_fast_sync_slot_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_fast_sync_slot_reply( const struct get_fast_sync_slot_reply *req )
+{
+    fprintf( stderr, " index=%08x", req->index );
+    fprintf( stderr, ", access=%08x", req->access );
+}
+
+static void dump_batch_request( const struct batch_request *req )
+{
+    dump_varargs_bytes( " requests=", cur_size );
+}
+
+static void dump_batch_reply( const struct batch_reply *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+    dump_varargs_bytes( ", replies=", cur_size );
+}
+
+static void dump_get_request_shm_request( const struct get_request_shm_request *req )
+{
+}
+
+static void dump_get_request_shm_reply( const struct get_request_shm_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_server_stats_request( const struct get_server_stats_request *req )
+{
+    fprintf( stderr, " reset=%d", req->reset );
+}
+
+static void dump_get_server_stats_reply( const struct get_server_stats_reply *req )
+{
+    dump_uint64( " elapsed=", &req->elapsed );
+    dump_uint64( ", loops=", &req->loops );
+    dump_uint64( ", events=", &req->events );
+    dump_uint64( ", timeouts=", &req->timeouts );
+    dump_uint64( ", wait_time=", &req->wait_time );
+    dump_varargs_request_stats( ", stats=", cur_size );
+}
+
 static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_new_process_request,
     (dump_func)dump_exec_process_request,
@@ -4676,6 +4812,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_empty_atom_table_request,
     (dump_func)dump_init_atom_table_request,
     (dump_func)dump_get_msg_queue_request,
+    (dump_func)dump_get_queue_shm_region_request,
     (dump_func)dump_set_queue_fd_request,
     (dump_func)dump_set_queue_mask_request,
     (dump_func)dump_get_queue_status_request,
@@ -4707,6 +4844,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_window_owner_request,
     (dump_func)dump_get_window_info_request,
     (dump_func)dump_set_window_info_request,
+    (dump_func)dump_get_window_shm_region_request,
     (dump_func)dump_set_parent_request,
     (dump_func)dump_get_window_parents_request,
     (dump_func)dump_get_window_children_request,
@@ -4812,9 +4950,11 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_request,
     (dump_func)dump_add_completion_request,
     (dump_func)dump_remove_completion_request,
+    (dump_func)dump_remove_completions_request,
     (dump_func)dump_query_completion_request,
     (dump_func)dump_set_completion_info_request,
     (dump_func)dump_add_fd_completion_request,
+    (dump_func)dump_get_fd_completion_request,
     (dump_func)dump_set_fd_completion_mode_request,
     (dump_func)dump_set_fd_disp_info_request,
     (dump_func)dump_set_fd_name_info_request,
@@ -4833,6 +4973,11 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_job_limits_request,
     (dump_func)dump_set_job_completion_port_request,
     (dump_func)dump_terminate_job_request,
+    (dump_func)dump_get_fast_sync_region_request,
+    (dump_func)dump_get_fast_sync_slot_request,
+    (dump_func)dump_batch_request,
+    (dump_func)dump_get_request_shm_request,
+    (dump_func)dump_get_server_stats_request,
 };
 
 static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
@@ -4970,6 +5115,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     (dump_func)dump_init_atom_table_reply,
     (dump_func)dump_get_msg_queue_reply,
+    (dump_func)dump_get_queue_shm_region_reply,
     NULL,
     (dump_func)dump_set_queue_mask_reply,
     (dump_func)dump_get_queue_status_reply,
@@ -5001,6 +5147,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_window_owner_reply,
     (dump_func)dump_get_window_info_reply,
     (dump_func)dump_set_window_info_reply,
+    (dump_func)dump_get_window_shm_region_reply,
     (dump_func)dump_set_parent_reply,
     (dump_func)dump_get_window_parents_reply,
     (dump_func)dump_get_window_children_reply,
@@ -5106,9 +5253,11 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_reply,
     NULL,
     (dump_func)dump_remove_completion_reply,
+    (dump_func)dump_remove_completions_reply,
     (dump_func)dump_query_completion_reply,
     NULL,
     NULL,
+    (dump_func)dump_get_fd_completion_reply,
     NULL,
     NULL,
     NULL,
@@ -5127,6 +5276,11 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     NULL,
     NULL,
+    (dump_func)dump_get_fast_sync_region_reply,
+    (dump_func)dump_get_fast_sync_slot_reply,
+    (dump_func)dump_batch_reply,
+    (dump_func)dump_get_request_shm_reply,
+    (dump_func)dump_get_server_stats_reply,
 };
 
 static const char * const req_names[REQ_NB_REQUESTS] = {
@@ -5264,6 +5418,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "empty_atom_table",
     "init_atom_table",
     "get_msg_queue",
+    "get_queue_shm_region",
     "set_queue_fd",
     "set_queue_mask",
     "get_queue_status",
@@ -5295,6 +5450,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "set_window_owner",
     "get_window_info",
     "set_window_info",
+    "get_window_shm_region",
     "set_parent",
     "get_window_parents",
     "get_window_children",
@@ -5400,9 +5556,11 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "open_completion",
     "add_completion",
     "remove_completion",
+    "remove_completions",
     "query_completion",
     "set_completion_info",
     "add_fd_completion",
+    "get_fd_completion",
     "set_fd_completion_mode",
     "set_fd_disp_info",
     "set_fd_name_info",
@@ -5421,6 +5579,11 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "set_job_limits",
     "set_job_completion_port",
     "terminate_job",
+    "get_fast_sync_region",
+    "get_fast_sync_slot",
+    "batch",
+    "get_request_shm",
+    "get_server_stats",
 };
 
 static const struct
@@ -5612,6 +5775,11 @@ static const char *get_status_name( unsigned int status )
     return buffer;
 }
 
+const char *get_request_name( enum request req )
+{
+    return req < REQ_NB_REQUESTS ? req_names[req] : "?";
+}
+
 void trace_request(void)
 {
     enum request req = current->req.request_header.req;
@@ -23,6 +23,11 @@
 
 #include <assert.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#include <unistd.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -33,6 +38,8 @@
 #include "winternl.h"
 
 #include "object.h"
+#include "file.h"
+#include "handle.h"
 #include "request.h"
 #include "thread.h"
 #include "process.h"
@@ -187,6 +194,97 @@ static unsigned int get_monitor_dpi( struct window *win )
     return win->dpi ? win->dpi : USER_DEFAULT_SCREEN_DPI;
 }
 
+/*
+ * When WINESHAREDWINDOWS is set in the environment, the attributes that
+ * clients commonly query for windows of other processes are mirrored in a
+ * shared memory region that clients map read-only. The slot of a window is
+ * given by the index of its user handle, and the server bumps the sequence
+ * counter of the slot around each update so that clients can read it
+ * consistently without locking.
+ */
+
+#define WINDOW_SHM_REGION_SIZE  (WINDOW_SHM_MAX_SLOTS * sizeof(struct window_shm_slot))
+
+static int window_shm_enabled = -1;               /* is the shared window state enabled? */
+static struct window_shm_slot *window_shm_slots;  /* server view of the shared region */
+static struct file *window_shm_file;              /* file object backing the region */
+
+/* create the shared region on first use */
+static int init_window_shm(void)
+{
+#ifdef HAVE_SYS_MMAN_H
+    int fd;
+    void *ptr;
+
+    if (window_shm_enabled != -1) return window_shm_enabled;
+
+    window_shm_enabled = 0;
+    if (!getenv( "WINESHAREDWINDOWS" ) || !atoi( getenv( "WINESHAREDWINDOWS" ))) return 0;
+
+    if ((fd = create_temp_file( WINDOW_SHM_REGION_SIZE )) == -1) return 0;
+    ptr = mmap( NULL, WINDOW_SHM_REGION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if (ptr == MAP_FAILED)
+    {
+        close( fd );
+        return 0;
+    }
+    if (!(window_shm_file = create_file_for_fd( fd, FILE_GENERIC_READ, 0 )))
+    {
+        munmap( ptr, WINDOW_SHM_REGION_SIZE );
+        return 0;
+    }
+    make_object_static( (struct object *)window_shm_file );
+    window_shm_slots = ptr;
+    window_shm_enabled = 1;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+static inline struct window_shm_slot *get_window_shm_slot( user_handle_t handle )
+{
+    return &window_shm_slots[((handle & 0xffff) - FIRST_USER_HANDLE) >> 1];
+}
+
+/* publish the window attributes to its shared slot */
+static void update_window_shm( struct window *win )
+{
+    struct window_shm_slot *slot;
+
+    if (!init_window_shm()) return;
+
+    slot = get_window_shm_slot( win->handle );
+    interlocked_xchg_add( (int *)&slot->seq, 1 );
+    slot->handle      = win->handle;
+    slot->parent      = win->parent ? win->parent->handle : 0;
+    slot->owner       = win->owner;
+    slot->style       = win->style;
+    slot->ex_style    = win->ex_style;
+    slot->id          = win->id;
+    slot->dpi         = win->dpi;
+    slot->tid         = win->thread ? get_thread_id( win->thread ) : 0;
+    slot->pid         = win->thread ? get_process_id( win->thread->process ) : 0;
+    slot->instance    = win->instance;
+    slot->user_data   = win->user_data;
+    slot->window_rect = win->window_rect;
+    slot->client_rect = win->client_rect;
+    interlocked_xchg_add( (int *)&slot->seq, 1 );
+}
+
+/* clear the shared slot of a destroyed window */
+static void clear_window_shm( struct window *win )
+{
+    struct window_shm_slot *slot;
+
+    if (!window_shm_slots) return;
+
+    slot = get_window_shm_slot( win->handle );
+    interlocked_xchg_add( (int *)&slot->seq, 1 );
+    slot->handle = 0;
+    interlocked_xchg_add( (int *)&slot->seq, 1 );
+}
+
 /* link a window at the right place in the siblings list */
 static void link_window( struct window *win, struct window *previous )
 {
@@ -240,6 +338,7 @@ static void link_window( struct window *win, struct window *previous )
     }
 
     win->is_linked = 1;
+    update_window_shm( win );
 }
 
 /* change the parent of a window (or unlink the window if the new parent is NULL) */
@@ -282,6 +381,7 @@ static int set_parent_window( struct window *win, struct window *parent )
         list_add_head( &win->parent->unlinked, &win->entry );
         win->is_linked = 0;
     }
+    update_window_shm( win );
     return 1;
 }
 
@@ -420,6 +520,7 @@ static void detach_window_thread( struct window *win )
     /* destroyed when the desktop ref count reaches zero */
     release_object( win->desktop );
     win->thread = NULL;
+    update_window_shm( win );
 }
 
 /* get the process owning the top window of a given desktop */
@@ -1700,6 +1801,7 @@ static void set_window_pos( struct window *win, struct window *previous,
     if (!(swp_flags & SWP_NOZORDER) && win->parent) link_window( win, previous );
     if (swp_flags & SWP_SHOWWINDOW) win->style |= WS_VISIBLE;
     else if (swp_flags & SWP_HIDEWINDOW) win->style &= ~WS_VISIBLE;
+    update_window_shm( win );
 
     /* keep children at the same position relative to top right corner when the parent is mirrored */
     if (win->ex_style & WS_EX_LAYOUTRTL)
@@ -1714,6 +1816,7 @@ static void set_window_pos( struct window *win, struct window *previous,
             offset_rect( &child->visible_rect, new_size - old_size, 0 );
             offset_rect( &child->surface_rect, new_size - old_size, 0 );
             offset_rect( &child->client_rect, new_size - old_size, 0 );
+            update_window_shm( child );
         }
     }
 
@@ -1899,6 +2002,7 @@ void destroy_window( struct window *win )
     if (win == taskman_window) taskman_window = NULL;
     free_hotkeys( win->desktop, win->handle );
     cleanup_clipboard_window( win->desktop, win->handle );
+    clear_window_shm( win );
     free_user_handle( win->handle );
     destroy_properties( win );
     list_remove( &win->entry );
@@ -1963,6 +2067,7 @@ DECL_HANDLER(create_window)
         win->dpi_awareness = req->awareness;
         win->dpi = req->dpi;
     }
+    update_window_shm( win );
 
     reply->handle    = win->handle;
     reply->parent    = win->parent ? win->parent->handle : 0;
@@ -1974,6 +2079,19 @@ DECL_HANDLER(create_window)
 }
 
 
+/* retrieve a handle to the shared windows region */
+DECL_HANDLER(get_window_shm_region)
+{
+    if (!init_window_shm())
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    reply->handle = alloc_handle( current->process, window_shm_file, FILE_READ_DATA, 0 );
+    reply->size = WINDOW_SHM_REGION_SIZE;
+}
+
+
 /* set the parent of a window */
 DECL_HANDLER(set_parent)
 {
@@ -2025,6 +2143,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->top_window );
             desktop->top_window->style  = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->top_window );
         }
     }
 
@@ -2037,6 +2156,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->msg_window );
             desktop->msg_window->style = WS_POPUP | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->msg_window );
         }
     }
 
@@ -2072,6 +2192,7 @@ DECL_HANDLER(set_window_owner)
 
     reply->prev_owner = win->owner;
     reply->full_owner = win->owner = owner ? owner->handle : 0;
+    update_window_shm( win );
 }
 
 
@@ -2143,6 +2264,7 @@ DECL_HANDLER(set_window_info)
     if (req->flags & SET_WIN_USERDATA) win->user_data = req->user_data;
     if (req->flags & SET_WIN_EXTRA) memcpy( win->extra_bytes + req->extra_offset,
                                             &req->extra_value, req->extra_size );
+    if (req->flags) update_window_shm( win );
 
     /* changing window style triggers a non-client paint */
     if (req->flags & SET_WIN_STYLE) win->paint_flags |= PAINT_NONCLIENT;